@@ -0,0 +1,109 @@
+/***********************************************************************
+ * Source:
+ *    Bench Frozen
+ * Summary:
+ *    Compare the pointer-based BST::find() against the frozen Eytzinger
+ *    and van Emde Boas layouts, from 1K elements up to a limit given on
+ *    the command line (1K to 10M by default):
+ *        benchFrozen [maxSize] [numQueries]
+ *    for example "benchFrozen 1000000000" runs through 1B. Build with
+ *    optimizations on; each BST node costs about 32 bytes per element
+ *    and each frozen copy another 4 to 8 bytes, so size the limit to RAM.
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#include "bst.h"
+#include "eytzinger.h"
+#include "veb.h"
+
+#include <chrono>     // for std::chrono::steady_clock
+#include <cstdio>     // for printf
+#include <cstdlib>    // for strtoull
+#include <vector>     // for std::vector
+#include <utility>    // for std::swap
+
+/**********************************************************************
+ * RANDOM
+ * A small, fast generator so the setup does not dominate the run
+ ***********************************************************************/
+class Random
+{
+public:
+   Random(unsigned long long seed) : state(seed) {}
+   unsigned long long next()
+   {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      return state;
+   }
+private:
+   unsigned long long state;
+};
+
+/**********************************************************************
+ * TIME FINDS
+ * Average nanoseconds per find() over all the probes. The sum of the
+ * hits keeps the optimizer from throwing the searches away
+ ***********************************************************************/
+template <typename Tree>
+double timeFinds(Tree& tree, const std::vector<int>& probes, long long& checksum)
+{
+   auto start = std::chrono::steady_clock::now();
+   for (int probe : probes)
+   {
+      auto it = tree.find(probe);
+      if (it != tree.end())
+         checksum += *it;
+   }
+   auto stop = std::chrono::steady_clock::now();
+   return std::chrono::duration<double, std::nano>(stop - start).count() / probes.size();
+}
+
+/**********************************************************************
+ * MAIN
+ * One row per size: the cost of a find in each layout
+ ***********************************************************************/
+int main(int argc, char** argv)
+{
+   size_t maxSize    = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 10000000;
+   size_t numQueries = argc > 2 ? (size_t)strtoull(argv[2], nullptr, 10) : 1000000;
+
+   printf("%12s %14s %14s %14s\n", "size", "BST ns/find", "Eytz ns/find", "vEB ns/find");
+
+   long long checksum = 0;
+   for (size_t size = 1000; size <= maxSize; size *= 10)
+   {
+      Random random(size);
+
+      // the even numbers 0 .. 2(size-1) in random order
+      std::vector<int> values(size);
+      for (size_t i = 0; i < size; i++)
+         values[i] = (int)(2 * i);
+      for (size_t i = size - 1; i > 0; i--)
+         std::swap(values[i], values[random.next() % (i + 1)]);
+
+      custom::BST<int> bst;
+      for (int value : values)
+         bst.insert(value);
+      values.clear();
+      values.shrink_to_fit();
+
+      custom::Eytzinger<int>   eytzinger = bst.freeze();
+      custom::VanEmdeBoas<int> veb(bst);
+
+      // half of the probes hit (even), half miss (odd)
+      std::vector<int> probes(numQueries);
+      for (int& probe : probes)
+         probe = (int)(random.next() % (2 * size));
+
+      double nsBst       = timeFinds(bst, probes, checksum);
+      double nsEytzinger = timeFinds(eytzinger, probes, checksum);
+      double nsVeb       = timeFinds(veb, probes, checksum);
+      printf("%12zu %14.1f %14.1f %14.1f\n", size, nsBst, nsEytzinger, nsVeb);
+   }
+
+   printf("checksum: %lld\n", checksum);
+   return 0;
+}
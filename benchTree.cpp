@@ -0,0 +1,387 @@
+/***********************************************************************
+ * Source:
+ *    Bench Tree
+ * Summary:
+ *    The cost of the everyday operations on a BST next to std::set,
+ *    std::multiset, and a sorted std::vector, from 1K elements up to a
+ *    limit given on the command line (1K to 1M by default):
+ *        benchTree [maxSize] [numQueries]
+ *    for example "benchTree 100000000" runs through 100M. Build with
+ *    optimizations on and size the limit to RAM: the node-based
+ *    containers take 40 to 50 bytes per int.
+ *
+ *    Each row is one operation on one container at one size, with
+ *        ns/op      : wall time per operation, over every element
+ *        cmp/op     : < and == per operation, counted by running the
+ *                     same operation again with Spy keys (up to 1M)
+ *        bytes/elem : heap the container holds per element once built,
+ *                     as the allocator sees it (insertRandom rows only)
+ *    Inserting into or erasing from a sorted vector moves half of it,
+ *    so those rows stop at 100K elements.
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#include "bst.h"
+#include "spy.h"
+
+#include <algorithm>  // for std::sort, std::lower_bound, std::equal_range
+#include <chrono>     // for std::chrono::steady_clock
+#include <cstdio>     // for printf and snprintf
+#include <cstdlib>    // for strtoull, malloc and free
+#include <limits>     // for std::numeric_limits
+#include <new>        // for std::bad_alloc
+#include <set>        // for std::set and std::multiset
+#include <string>     // for std::string
+#include <utility>    // for std::swap
+#include <vector>     // for std::vector
+
+#if defined(_WIN32)
+#include <malloc.h>          // for _msize
+static size_t blockSize(void* p) { return _msize(p); }
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>   // for malloc_size
+static size_t blockSize(void* p) { return malloc_size(p); }
+#else
+#include <malloc.h>          // for malloc_usable_size
+static size_t blockSize(void* p) { return malloc_usable_size(p); }
+#endif
+
+int Spy::counters[] = {};
+
+/**********************************************************************
+ * HEAP ACCOUNTING
+ * Every new and delete in the program goes through here so we know
+ * how many bytes the containers hold, including the allocator's
+ * rounding. The benchmark runs on one thread
+ ***********************************************************************/
+static size_t heapBytes = 0;
+
+void* operator new(size_t size)
+{
+   void* p = malloc(size ? size : 1);
+   if (!p)
+      throw std::bad_alloc();
+   heapBytes += blockSize(p);
+   return p;
+}
+
+void operator delete(void* p) noexcept
+{
+   if (p)
+   {
+      heapBytes -= blockSize(p);
+      free(p);
+   }
+}
+
+void* operator new[](size_t size)               { return operator new(size); }
+void  operator delete[](void* p) noexcept       { operator delete(p); }
+void  operator delete(void* p, size_t) noexcept   { operator delete(p); }
+void  operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+/**********************************************************************
+ * RANDOM
+ * A small, fast generator so the setup does not dominate the run
+ ***********************************************************************/
+class Random
+{
+public:
+   Random(unsigned long long seed) : state(seed) {}
+   unsigned long long next()
+   {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      return state;
+   }
+private:
+   unsigned long long state;
+};
+
+/**********************************************************************
+ * SORTED VECTOR
+ * The flat alternative: a vector kept in order, searched by bisection
+ ***********************************************************************/
+template <typename K>
+class SortedVector
+{
+public:
+   typedef typename std::vector<K>::const_iterator iterator;
+
+   void insert(const K& k)
+   {
+      v.insert(std::upper_bound(v.begin(), v.end(), k), k);
+   }
+   iterator find(const K& k) const
+   {
+      iterator it = std::lower_bound(v.begin(), v.end(), k);
+      return (it != v.end() && !(k < *it)) ? it : v.end();
+   }
+   size_t erase(const K& k)
+   {
+      auto range = std::equal_range(v.begin(), v.end(), k);
+      size_t num = range.second - range.first;
+      v.erase(range.first, range.second);
+      return num;
+   }
+   void assign(const std::vector<K>& keys)
+   {
+      v = keys;
+      std::sort(v.begin(), v.end());
+   }
+
+   iterator begin() const { return v.begin(); }
+   iterator end()   const { return v.end(); }
+   size_t   size()  const { return v.size(); }
+   void     clear()       { v.clear(); }
+
+private:
+   std::vector<K> v;
+};
+
+/**********************************************************************
+ * LIMITS
+ * The largest size worth inserting into or erasing from one element
+ * at a time
+ ***********************************************************************/
+template <class Container>
+struct Limits
+{
+   static constexpr size_t maxUpdates = std::numeric_limits<size_t>::max();
+};
+
+template <typename K>
+struct Limits<SortedVector<K>>
+{
+   static constexpr size_t maxUpdates = 100000;
+};
+
+/**********************************************************************
+ * OPERATIONS
+ ***********************************************************************/
+enum Op { insertRandom, insertAscending, insertDescending, findHit, findMiss,
+          erase, iterate, copy, clear, numOps };
+
+static const char* const opNames[numOps] =
+{
+   "insertRandom", "insertAscending", "insertDescending", "findHit", "findMiss",
+   "erase", "iterate", "copy", "clear"
+};
+
+/**********************************************************************
+ * KEYS
+ * What one size needs: every key in random order and in order, and
+ * probes that hit and that miss. The keys are the even numbers
+ * 0 .. 2(size-1), so the odd numbers all miss
+ ***********************************************************************/
+template <typename K>
+struct Keys
+{
+   std::vector<K> shuffled;
+   std::vector<K> sorted;
+   std::vector<K> hits;
+   std::vector<K> misses;
+};
+
+template <typename K>
+Keys<K> makeKeys(size_t size, size_t numQueries)
+{
+   Random random(size);
+   std::vector<int> values(size);
+   for (size_t i = 0; i < size; i++)
+      values[i] = (int)(2 * i);
+
+   Keys<K> keys;
+   keys.sorted.assign(values.begin(), values.end());
+   for (size_t i = size - 1; i > 0; i--)
+      std::swap(values[i], values[random.next() % (i + 1)]);
+   keys.shuffled.assign(values.begin(), values.end());
+   for (size_t i = 0; i < numQueries; i++)
+   {
+      int value = (int)(2 * (random.next() % size));
+      keys.hits.push_back(K(value));
+      keys.misses.push_back(K(value + 1));
+   }
+   return keys;
+}
+
+static int valueOf(int value)        { return value; }
+static int valueOf(const Spy& value) { return value.get(); }
+
+/**********************************************************************
+ * FILL
+ * Build a container from the shuffled keys, the way a program would
+ ***********************************************************************/
+template <class Container, typename K>
+void fill(Container& container, const std::vector<K>& keys)
+{
+   for (const K& k : keys)
+      container.insert(k);
+}
+
+template <typename K>
+void fill(SortedVector<K>& container, const std::vector<K>& keys)
+{
+   container.assign(keys);
+}
+
+/**********************************************************************
+ * TIME
+ * Average nanoseconds per operation when f does num of them. The
+ * Spy comparisons f made are left in numCompared, so the setup
+ * around it is not counted
+ ***********************************************************************/
+static long long numCompared = 0;
+
+template <class Function>
+double timePer(size_t num, Function f)
+{
+   long long before = (long long)Spy::numLessthan() + Spy::numEquals();
+   auto start = std::chrono::steady_clock::now();
+   f();
+   auto stop = std::chrono::steady_clock::now();
+   numCompared = (long long)Spy::numLessthan() + Spy::numEquals() - before;
+   return std::chrono::duration<double, std::nano>(stop - start).count() / num;
+}
+
+/**********************************************************************
+ * MEASURE
+ * Run one operation on a fresh container. Returns nanoseconds per
+ * operation and sets numOps to how many there were; insertRandom
+ * also sets bytes to the heap the built container holds
+ ***********************************************************************/
+template <class Container, typename K>
+double measure(Op op, const Keys<K>& keys, long long& checksum, size_t& num, size_t& bytes)
+{
+   const size_t size = keys.sorted.size();
+   Container container;
+   num = size;
+
+   switch (op)
+   {
+   case insertRandom:
+   {
+      size_t before = heapBytes;
+      double ns = timePer(num, [&]() { for (const K& k : keys.shuffled) container.insert(k); });
+      bytes = heapBytes - before;
+      return ns;
+   }
+   case insertAscending:
+      return timePer(num, [&]() { for (const K& k : keys.sorted) container.insert(k); });
+   case insertDescending:
+      return timePer(num, [&]()
+         {
+            for (auto it = keys.sorted.rbegin(); it != keys.sorted.rend(); ++it)
+               container.insert(*it);
+         });
+   case findHit:
+   case findMiss:
+   {
+      fill(container, keys.shuffled);
+      const std::vector<K>& probes = (op == findHit) ? keys.hits : keys.misses;
+      num = probes.size();
+      return timePer(num, [&]()
+         {
+            for (const K& k : probes)
+               checksum += (container.find(k) != container.end()) ? 1 : 0;
+         });
+   }
+   case erase:
+      fill(container, keys.shuffled);
+      return timePer(num, [&]() { for (const K& k : keys.shuffled) checksum += container.erase(k); });
+   case iterate:
+      fill(container, keys.shuffled);
+      return timePer(num, [&]() { for (const K& k : container) checksum += valueOf(k); });
+   case copy:
+   {
+      fill(container, keys.shuffled);
+      Container* pCopy = nullptr;
+      double ns = timePer(num, [&]() { pCopy = new Container(container); });
+      checksum += pCopy->size();
+      delete pCopy;
+      return ns;
+   }
+   case clear:
+      fill(container, keys.shuffled);
+      return timePer(num, [&]() { container.clear(); });
+   default:
+      return 0.0;
+   }
+}
+
+/**********************************************************************
+ * REPORT
+ * One row per operation for one container at one size. Timing and
+ * memory come from the int container, comparisons from the Spy one
+ ***********************************************************************/
+template <class IntContainer, class SpyContainer>
+void report(const char* name, const Keys<int>& keys, const Keys<Spy>* pSpyKeys, long long& checksum)
+{
+   const size_t size = keys.sorted.size();
+   for (int op = 0; op < numOps; op++)
+   {
+      std::string row = std::string(opNames[op]) + "/" + name + "/" + std::to_string(size);
+      bool isUpdate = op == insertRandom || op == insertAscending ||
+                      op == insertDescending || op == erase;
+      if (isUpdate && size > Limits<IntContainer>::maxUpdates)
+      {
+         printf("%-36s %12s %10s %12s\n", row.c_str(), "-", "-", "-");
+         continue;
+      }
+
+      size_t num = 0;
+      size_t bytes = 0;
+      double ns = measure<IntContainer>(Op(op), keys, checksum, num, bytes);
+
+      char cmp[32] = "-";
+      if (pSpyKeys)
+      {
+         size_t numSpy = 0;
+         size_t bytesSpy = 0;
+         Spy::reset();
+         measure<SpyContainer>(Op(op), *pSpyKeys, checksum, numSpy, bytesSpy);
+         snprintf(cmp, sizeof(cmp), "%.1f", double(numCompared) / numSpy);
+      }
+
+      char perElement[32] = "-";
+      if (op == insertRandom)
+         snprintf(perElement, sizeof(perElement), "%.1f", double(bytes) / size);
+
+      printf("%-36s %12.1f %10s %12s\n", row.c_str(), ns, cmp, perElement);
+   }
+}
+
+/**********************************************************************
+ * MAIN
+ * For each size, every operation on every container
+ ***********************************************************************/
+int main(int argc, char** argv)
+{
+   size_t maxSize    = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 1000000;
+   size_t numQueries = argc > 2 ? (size_t)strtoull(argv[2], nullptr, 10) : 1000000;
+   const size_t maxSpySize = 1000000;   // Spy keys each own a heap int
+
+   printf("%-36s %12s %10s %12s\n", "Benchmark", "ns/op", "cmp/op", "bytes/elem");
+
+   long long checksum = 0;
+   for (size_t size = 1000; size <= maxSize; size *= 10)
+   {
+      Keys<int> keys = makeKeys<int>(size, numQueries);
+      Keys<Spy> spyKeys;
+      const Keys<Spy>* pSpyKeys = nullptr;
+      if (size <= maxSpySize)
+      {
+         spyKeys = makeKeys<Spy>(size, std::min(numQueries, size));
+         pSpyKeys = &spyKeys;
+      }
+
+      report<custom::BST<int>,   custom::BST<Spy>>  ("BST",          keys, pSpyKeys, checksum);
+      report<std::set<int>,      std::set<Spy>>     ("set",          keys, pSpyKeys, checksum);
+      report<std::multiset<int>, std::multiset<Spy>>("multiset",     keys, pSpyKeys, checksum);
+      report<SortedVector<int>,  SortedVector<Spy>> ("sortedVector", keys, pSpyKeys, checksum);
+   }
+
+   printf("checksum: %lld\n", checksum);
+   return 0;
+}
@@ -13,6 +13,8 @@
  *    This will contain the class definition of:
  *        BST                 : A class that represents a binary search tree
  *        BST::iterator       : An iterator through BST
+ *        BST::StatsScan      : A walk of the tree's shape, a few nodes at a time
+ *        ShapeStats          : The height and depths of a tree
  * Author
  *    Nathan Bird, Brock Hoskins
  ************************************************************************/
@@ -25,15 +27,42 @@
 #define debug(x)
 #endif // !DEBUG
 
+// Define CHECKED_ITERATORS to catch iterators used after an erase
+#ifdef CHECKED_ITERATORS
+#define checked(...) __VA_ARGS__
+#include <atomic>     // for std::atomic
+#include <stdexcept>  // for std::logic_error
+#else // !CHECKED_ITERATORS
+#define checked(...)
+#endif // !CHECKED_ITERATORS
+
+// Define BST_COUNTERS to count allocations, comparisons and balance cases
+#ifdef BST_COUNTERS
+#define counted(...) __VA_ARGS__
+#include "counters.h"
+#else // !BST_COUNTERS
+#define counted(...)
+#endif // !BST_COUNTERS
+
 #include <cassert>
 #include <utility>
 #include <memory>     // for std::allocator
 #include <functional> // for std::less
+#include <cstddef>    // for std::ptrdiff_t
+#include <iterator>   // for std::bidirectional_iterator_tag
+#include <iosfwd>     // for std::istream and std::ostream
+#include <limits>     // for std::numeric_limits
+#include <optional>   // for std::optional
 #include <utility>    // for std::pair
+#include <vector>     // for std::vector
 
 class TestBST; // forward declaration for unit tests
 class TestSet;
 class TestMap;
+class TestParallel;
+class TestSerialize;
+class TestDurable;
+class TestExternal;
 
 namespace custom
 {
@@ -42,6 +71,39 @@ namespace custom
    class set;
    template <typename KK, typename VV>
    class map;
+   template <typename TT>
+   class Eytzinger;
+   template <typename TT>
+   struct BitwiseCodec;
+#ifdef __cpp_impl_coroutine
+   namespace coro
+   {
+      template <typename TT>
+      class Lookup;
+   }
+#endif // __cpp_impl_coroutine
+   namespace parallel
+   {
+      class Pool;
+   }
+
+   /*****************************************************************
+    * SHAPE STATS
+    * The shape of a tree, from BST::stats(). The root is at depth 0
+    *****************************************************************/
+   struct ShapeStats
+   {
+      size_t size = 0;              // nodes visited
+      size_t height = 0;            // levels, so 0 for an empty tree
+      size_t blackHeight = 0;       // black nodes from the root down to a leaf
+      bool   blackBalanced = true;  // every path down to a leaf had blackHeight
+      size_t totalDepth = 0;        // the depths of every node, added up
+      std::vector<size_t> levels;   // levels[d] is how many nodes are at depth d
+
+      double averageDepth() const;
+      size_t percentileDepth(double percent) const;
+      size_t minHeight() const;
+   };
 
 /*****************************************************************
  * BINARY SEARCH TREE
@@ -53,6 +115,10 @@ namespace custom
       friend class ::TestBST; // give unit tests access to private members
       friend class ::TestSet;
       friend class ::TestMap;
+      friend class ::TestParallel;
+      friend class ::TestSerialize;
+      friend class ::TestDurable;
+      friend class ::TestExternal;
 
       template <class TT>
       friend class custom::set;
@@ -91,7 +157,30 @@ namespace custom
       // Access
       //
 
-      iterator find(const T& t);
+      iterator find(const T& t) const;
+      iterator lower_bound(const T& t) const;
+      iterator upper_bound(const T& t) const;
+
+      //
+      // Shape
+      //
+
+      class StatsScan;
+      ShapeStats stats() const;
+
+      //
+      // Freeze (defined in eytzinger.h)
+      //
+
+      Eytzinger<T> freeze() const;
+
+#ifdef __cpp_impl_coroutine
+      //
+      // Find as a coroutine (defined in coro.h)
+      //
+
+      coro::Lookup<T> co_find(T t) const;
+#endif // __cpp_impl_coroutine
 
       // 
       // Insert
@@ -100,11 +189,50 @@ namespace custom
       std::pair<iterator, bool> insert(const T& t, bool keepUnique = false);
       std::pair<iterator, bool> insert(T&& t, bool keepUnique = false);
 
+      //
+      // Build (defined in parallel.h)
+      //
+
+      template <class Iterator, class Policy>
+      void build(Iterator first, Iterator last, Policy policy, bool keepUnique = false);
+
+      //
+      // Build from sorted input in O(n) (defined in external.h)
+      //
+
+      template <class InputIt>
+      bool build_sorted(InputIt first, InputIt last, bool keepUnique = false);
+
+      //
+      // Persist (defined in serialize.h)
+      //
+
+      template <class Codec = BitwiseCodec<T>>
+      bool serialize(std::ostream& out, Codec codec = Codec()) const;
+      template <class Codec = BitwiseCodec<T>>
+      bool deserialize(std::istream& in, Codec codec = Codec());
+
+      //
+      // Traverse (defined in parallel.h)
+      //
+
+      template <class Policy, class Function>
+      void for_each(Policy policy, Function f, bool balanced = false) const;
+      template <class Policy, class U, class Reduce, class Transform>
+      U    transform_reduce(Policy policy, U init, Reduce reduce, Transform transform,
+                            bool balanced = false) const;
+      template <class Policy, class Function>
+      void for_each_chunk(Policy policy, Function f) const;
+
       //
       // Remove
       // 
 
       iterator erase(iterator& it);
+      iterator erase(iterator first, iterator last);
+      size_t   erase(const T& t);
+      template <class Predicate>
+      size_t   erase_if(Predicate pred);
       void     clear() noexcept;
 
       // 
@@ -117,8 +245,40 @@ namespace custom
    private:
 
       class  BNode;
+
+      // remove a batch of nodes, relinking the survivors if the batch is large
+      size_t eraseNodes(std::vector<BNode*>& doomed);
+      size_t eraseRun(std::vector<BNode*>& doomed, BNode* pLast);
+
+      // split and join at black height, for cutting out a run of nodes
+      static size_t blackHeight(const BNode* pNode);
+      static BNode* detach(BNode* pNode, size_t& height);
+      static BNode* join(BNode* pLeft, size_t hLeft, BNode* pMiddle,
+                         BNode* pRight, size_t hRight, size_t& height);
+      static void   split(BNode* pNode, size_t height, BNode*& pLeft, size_t& hLeft,
+                          BNode*& pRight, size_t& hRight);
+
+      // make nodes already in order the whole tree, or free them
+      void adoptSorted(std::vector<BNode*>& nodes, BNode* pRoot = nullptr);
+      static void discard(std::vector<BNode*>& nodes) noexcept;
+
+      // red-black delete: unlink a node, then restore the rules
+      void transplant(BNode* pOld, BNode* pNew);
+      void rotateLeft(BNode* pNode);
+      void rotateRight(BNode* pNode);
+      void fixup(BNode* pNode, BNode* pParent);
+
+      // split the tree into runs in order for the pool to walk (defined in parallel.h)
+      std::vector<BNode*> pieces(size_t minPieces) const;
+      std::vector<BNode*> chunks(parallel::Pool& pool, bool balanced,
+                                 std::vector<size_t>* pOffsets) const;
+
       BNode* root;              // root node of the binary search tree
       size_t numElements;       // number of elements currently in the tree
+      size_t numChanges;        // bumped by every insert or erase
+#ifdef CHECKED_ITERATORS
+      std::atomic<size_t> epoch; // bumped whenever nodes are freed or reused
+#endif // CHECKED_ITERATORS
    };
 
 
@@ -135,11 +295,23 @@ namespace custom
       // Construct
       //
       BNode() : data(T()), pLeft(nullptr), pRight(nullptr), pParent(nullptr), isRed(true)
-      {}
+      {
+         counted(counters::local().allocated();)
+      }
       BNode(const T& t) : data(t), pLeft(nullptr), pRight(nullptr), pParent(nullptr), isRed(true)
-      {}
+      {
+         counted(counters::local().allocated();)
+      }
       BNode(T&& t) : data(std::move(t)), pLeft(nullptr), pRight(nullptr), pParent(nullptr), isRed(true)
-      {}
+      {
+         counted(counters::local().allocated();)
+      }
+#ifdef BST_COUNTERS
+      ~BNode()
+      {
+         counters::local().freed();
+      }
+#endif // BST_COUNTERS
 
       //
       // Copy
@@ -166,14 +338,20 @@ namespace custom
       //
       static void clear(BST<T>::BNode*& pNode) noexcept;
 
+      //
+      // Build
+      //
+      static BNode* build(BNode* const* ppNodes, size_t num, size_t depth, size_t redDepth);
+      static size_t redDepth(size_t num);
+
       // 
       // Status
       //
-      bool isRightChild(BNode* pNode) const { return pParent == pNode && pNode->pRight == this; }
-      bool isLeftChild (BNode* pNode) const { return pParent == pNode && pNode->pLeft == this; }
+      bool isRightChild(BNode* pNode) const { return pNode && pParent == pNode && pNode->pRight == this; }
+      bool isLeftChild (BNode* pNode) const { return pNode && pParent == pNode && pNode->pLeft == this; }
 
-      // balance the tree
-      void balance(BNode*& pRoot);
+      // balance the tree. Returns true if its black height grew
+      bool balance(BNode*& pRoot);
 
    #ifdef DEBUG
       //
@@ -209,14 +387,26 @@ namespace custom
       template <class KK, class VV>
       friend class custom::map;
    public:
+      // for std::iterator_traits, so the standard algorithms accept us
+      typedef std::bidirectional_iterator_tag iterator_category;
+      typedef T                               value_type;
+      typedef std::ptrdiff_t                  difference_type;
+      typedef const T*                        pointer;
+      typedef const T&                        reference;
+
       // constructors and assignment
-      iterator(BNode* p = nullptr) : pNode(p)
+      iterator(BNode* p = nullptr) : pNode(p) checked(, pEpoch(nullptr), epoch(0))
+      {}
+      iterator(BNode* p, [[maybe_unused]] const BST* pTree) : pNode(p)
+         checked(, pEpoch(&pTree->epoch), epoch(pTree->epoch.load(std::memory_order_relaxed)))
       {}
-      iterator(const iterator& rhs) : pNode(rhs.pNode)
+      iterator(const iterator& rhs) : pNode(rhs.pNode) checked(, pEpoch(rhs.pEpoch), epoch(rhs.epoch))
       {}
       iterator& operator =(const iterator& rhs)
       {
          pNode = rhs.pNode;
+         checked(pEpoch = rhs.pEpoch;)
+         checked(epoch = rhs.epoch;)
          return *this;
       }
 
@@ -233,32 +423,85 @@ namespace custom
       // de-reference. Cannot change because it will invalidate the BST
       const T& operator *() const
       {
+         check();
          return pNode->data;
       }
 
       // increment and decrement
       iterator& operator ++();
-      iterator  operator ++(int postfix)
+      iterator  operator ++(int)
       {
          iterator temp(*this);
-         ++this;
+         ++(*this);
          return temp;
       }
       iterator& operator --();
-      iterator  operator --(int postfix)
+      iterator  operator --(int)
       {
          iterator temp(*this);
-         --this;
+         --(*this);
          return temp;
       }
 
       // must give friend status to remove so it can call getNode() from it
       friend BST<T>::iterator BST<T>::erase(iterator& it);
+      friend class BST<T>;
 
    private:
 
+      // throw if the tree has freed or reused nodes since we were made.
+      // One load of the tree's epoch: we never read the node to find out
+      void check() const
+      {
+         checked(if (pEpoch && pEpoch->load(std::memory_order_relaxed) != epoch)
+                    throw std::logic_error("BST iterator used after the tree changed");)
+      }
+
       // the node
       BNode* pNode;
+#ifdef CHECKED_ITERATORS
+      const std::atomic<size_t>* pEpoch; // the tree's epoch, or nullptr if unchecked
+      size_t epoch;                      // the tree's epoch when we were made
+#endif // CHECKED_ITERATORS
+   };
+
+   /**********************************************************
+    * BINARY SEARCH TREE STATS SCAN
+    * Walk the shape of a tree a few nodes per step, so a caller
+    * holding a lock can let go between steps. A step picks up at
+    * the node the last one stopped at; only if the tree changed in
+    * between does it find its place again by key, and the result
+    * then mixes the shapes before and after
+    *********************************************************/
+   template <typename T>
+   class BST<T>::StatsScan
+   {
+   public:
+      StatsScan(const BST& bst) : pTree(&bst), pNext(nullptr), pLast(nullptr),
+         depthNext(0), blackNext(0), numChanges(0), numLast(0), done(false) {}
+
+      // visit up to budget more nodes; true once every node has been visited
+      bool step(size_t budget);
+      bool isDone() const { return done; }
+      void restart();
+
+      const ShapeStats& stats() const { return result; }
+
+   private:
+      BNode* resume(size_t& depth, size_t& black);
+      void visit(const BNode* p, size_t depth, size_t black);
+      static void advance(BNode*& p, size_t& depth, size_t& black);
+
+      const BST* pTree;       // the tree being walked
+      ShapeStats result;      // what we have seen so far
+      BNode* pNext;           // the next node to visit, good while numChanges matches the tree
+      const BNode* pLast;     // the last node visited, likewise
+      size_t depthNext;       // pNext's depth
+      size_t blackNext;       // pNext's black depth
+      size_t numChanges;      // the tree's numChanges when the last step ended
+      std::optional<T> last;  // the last key visited, kept in case the tree changes
+      size_t numLast;         // how many nodes equal to last we have visited
+      bool done;              // every node has been visited
    };
 
 
@@ -275,7 +518,7 @@ namespace custom
      * BST :: DEFAULT CONSTRUCTOR
      ********************************************/
    template <typename T>
-   BST<T>::BST() : numElements(0), root(nullptr) {}
+   BST<T>::BST() : numElements(0), root(nullptr), numChanges(0) checked(, epoch(0)) {}
 
    /*********************************************
     * BST :: COPY CONSTRUCTOR
@@ -326,6 +569,8 @@ namespace custom
    {
       BNode::assign(root, rhs.root);
       numElements = rhs.numElements;
+      numChanges++;
+      checked(epoch.fetch_add(1, std::memory_order_relaxed);)
       return *this;
    }
 
@@ -363,6 +608,10 @@ namespace custom
    {
       std::swap(root, rhs.root);
       std::swap(numElements, rhs.numElements);
+      numChanges++;
+      rhs.numChanges++;
+      checked(epoch.fetch_add(1, std::memory_order_relaxed);)
+      checked(rhs.epoch.fetch_add(1, std::memory_order_relaxed);)
    }
 
    /*****************************************************
@@ -378,15 +627,22 @@ namespace custom
          root = new BNode(t);
          root->balance(root);
          numElements++;
-         return { iterator(root), true };
+         numChanges++;
+         counted(counters::local().insert(0, 0);)
+         return { iterator(root, this), true };
       }
 
       // Go down the tree until you reach a leaf.
       BNode* current = root;
+      counted(size_t depth = 0;)   // nodes visited, and so the new node's depth
       while (true)
       {
+         counted(depth++;)
          if (keepUnique && t == current->data)
-            return { iterator(current), false };  // Don't insert duplicates if keepUnique.
+         {
+            counted(counters::local().compared(2 * depth - 1);)
+            return { iterator(current, this), false };  // Don't insert duplicates if keepUnique.
+         }
 
          if (t < current->data)  // Left subtree
          {
@@ -396,7 +652,9 @@ namespace custom
                current->addLeft(newNode);
                newNode->balance(root);
                numElements++;
-               return { iterator(newNode), true };
+               numChanges++;
+               counted(counters::local().insert(depth, keepUnique ? 2 * depth : depth);)
+               return { iterator(newNode, this), true };
             }
             current = current->pLeft;
          }
@@ -408,7 +666,9 @@ namespace custom
                current->addRight(newNode);
                newNode->balance(root);
                numElements++;
-               return { iterator(newNode), true };
+               numChanges++;
+               counted(counters::local().insert(depth, keepUnique ? 2 * depth : depth);)
+               return { iterator(newNode, this), true };
             }
             current = current->pRight;
          }
@@ -424,15 +684,22 @@ namespace custom
          root = new BNode(std::move(t));
          root->balance(root);
          numElements++;
-         return { iterator(root), true };
+         numChanges++;
+         counted(counters::local().insert(0, 0);)
+         return { iterator(root, this), true };
       }
 
       // Go down the tree until you reach a leaf.
       BNode* current = root;
+      counted(size_t depth = 0;)   // nodes visited, and so the new node's depth
       while (true)
       {
+         counted(depth++;)
          if (keepUnique && t == current->data)
-            return { iterator(current), false };  // Don't insert duplicates if keepUnique.
+         {
+            counted(counters::local().compared(2 * depth - 1);)
+            return { iterator(current, this), false };  // Don't insert duplicates if keepUnique.
+         }
 
          if (t < current->data)  // Left subtree
          {
@@ -442,7 +709,9 @@ namespace custom
                current->addLeft(newNode);
                newNode->balance(root);
                numElements++;
-               return { iterator(newNode), true };
+               numChanges++;
+               counted(counters::local().insert(depth, keepUnique ? 2 * depth : depth);)
+               return { iterator(newNode, this), true };
             }
             current = current->pLeft;
          }
@@ -454,7 +723,9 @@ namespace custom
                current->addRight(newNode);
                newNode->balance(root);
                numElements++;
-               return { iterator(newNode), true };
+               numChanges++;
+               counted(counters::local().insert(depth, keepUnique ? 2 * depth : depth);)
+               return { iterator(newNode, this), true };
             }
             current = current->pRight;
          }
@@ -463,7 +734,13 @@ namespace custom
 
    /*************************************************
     * BST :: ERASE
-    * Remove a given node as specified by the iterator
+    * Remove a given node as specified by the iterator.
+    * The node is unlinked, never copied over, so in an
+    * unchecked build iterators to every other node stay
+    * good. With CHECKED_ITERATORS the erase bumps the
+    * tree's epoch, and only the returned iterator survives.
+    * If a black node left its path one black short,
+    * fixup() restores the red-black rules in O(1) rotations
     ************************************************/
    template <typename T>
    typename BST<T>::iterator BST<T>::erase(iterator& it)
@@ -471,105 +748,527 @@ namespace custom
       // If the iterator is at the end, do nothing
       if (it == end())
          return end();
+      it.check();
+      checked(epoch.fetch_add(1, std::memory_order_relaxed);)
 
-      iterator itReturn = it;  // copy assignment operator
+      iterator itReturn(it.pNode, this);  // stamped after the bump above
       ++itReturn;  // always return the next node
 
       BNode* pDelete = it.pNode;
+      BNode* pChild;               // the node that takes the removed one's place
+      BNode* pParent;              // pChild's parent, as pChild may be null
+      bool removedBlack = !pDelete->isRed;
 
-      // Case 1: No Children
-      if (!pDelete->pLeft && !pDelete->pRight)
+      // Case 1 and 2: No children or one child - replace node with child
+      if (!pDelete->pLeft || !pDelete->pRight)
       {
-         // Make parent forget about us
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = nullptr;
-         else if (pDelete->pParent)
-            // Must be right child if has parent and is not left child
-            pDelete->pParent->pRight = nullptr;
-
-         delete pDelete;
-         numElements--;
-         return itReturn;
+         pChild = pDelete->pLeft ? pDelete->pLeft : pDelete->pRight;
+         pParent = pDelete->pParent;
+         transplant(pDelete, pChild);
       }
 
-      // Case 2: One Child - Replace node with child
-      //   Only left child
-      if (!pDelete->pRight && pDelete->pLeft)
+      // Case 3: Two Children - replace node with in-order successor, which
+      //         takes over pDelete's color; the successor's old spot is
+      //         where a black may have gone missing
+      else
       {
-         // Hook up child to parent
-         pDelete->pLeft->pParent = pDelete->pParent;
-         // Hook up parent to child: left
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = pDelete->pLeft;
-         // Hook up parent to child: right
-         else if (pDelete->pParent)
-            pDelete->pParent->pRight = pDelete->pLeft;
-
-         delete pDelete;
-         numElements--;
-         return itReturn;
+         BNode* pNext = itReturn.pNode;  // itReturn already points to next node in sequence.
+         removedBlack = !pNext->isRed;
+         pChild = pNext->pRight;
+
+         if (pNext->pParent == pDelete)
+            pParent = pNext;
+         else
+         {
+            // pNext is a left child with no left child of its own
+            pParent = pNext->pParent;
+            transplant(pNext, pNext->pRight);
+            pNext->pRight = pDelete->pRight;
+            pNext->pRight->pParent = pNext;
+         }
+
+         transplant(pDelete, pNext);
+         pNext->pLeft = pDelete->pLeft;
+         pNext->pLeft->pParent = pNext;
+         pNext->isRed = pDelete->isRed;
       }
-      //   Only right child
-      else if (pDelete->pRight && !pDelete->pLeft)
+
+      delete pDelete;
+      numElements--;
+      numChanges++;
+
+      if (removedBlack)
+         fixup(pChild, pParent);
+      return itReturn;
+   }
+
+   /*************************************************
+    * BST :: TRANSPLANT
+    * Put pNew (which may be null) where pOld hangs
+    * from its parent, or at the root
+    ************************************************/
+   template <typename T>
+   void BST<T>::transplant(BNode* pOld, BNode* pNew)
+   {
+      if (!pOld->pParent)
+         root = pNew;
+      else if (pOld->pParent->pLeft == pOld)
+         pOld->pParent->pLeft = pNew;
+      else
+         pOld->pParent->pRight = pNew;
+      if (pNew)
+         pNew->pParent = pOld->pParent;
+   }
+
+   /*************************************************
+    * BST :: ROTATE LEFT
+    * pNode's right child takes its place and pNode
+    * becomes that child's left
+    ************************************************/
+   template <typename T>
+   void BST<T>::rotateLeft(BNode* pNode)
+   {
+      BNode* pRight = pNode->pRight;
+      pNode->pRight = pRight->pLeft;
+      if (pRight->pLeft)
+         pRight->pLeft->pParent = pNode;
+      transplant(pNode, pRight);
+      pRight->pLeft = pNode;
+      pNode->pParent = pRight;
+   }
+
+   /*************************************************
+    * BST :: ROTATE RIGHT
+    * pNode's left child takes its place and pNode
+    * becomes that child's right
+    ************************************************/
+   template <typename T>
+   void BST<T>::rotateRight(BNode* pNode)
+   {
+      BNode* pLeft = pNode->pLeft;
+      pNode->pLeft = pLeft->pRight;
+      if (pLeft->pRight)
+         pLeft->pRight->pParent = pNode;
+      transplant(pNode, pLeft);
+      pLeft->pRight = pNode;
+      pNode->pParent = pLeft;
+   }
+
+   /*************************************************
+    * BST :: FIXUP
+    * After a black node left the tree, every path through
+    * pNode (a child of pParent, possibly null) is one black
+    * short. Push the missing black up, or borrow one from
+    * the sibling's side with at most three rotations
+    ************************************************/
+   template <typename T>
+   void BST<T>::fixup(BNode* pNode, BNode* pParent)
+   {
+      while (pNode != root && (!pNode || !pNode->isRed))
       {
-         // Hook up child to parent
-         pDelete->pRight->pParent = pDelete->pParent;
-         // Hook up parent to child: left
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = pDelete->pRight;
-         // hook up parent to child: right
-         else if (pDelete->pParent)
-            pDelete->pParent->pRight = pDelete->pRight;
-
-         delete pDelete;
-         numElements--;
-         return itReturn;
+         bool isLeft = (pNode == pParent->pLeft);
+         BNode* pSibling = isLeft ? pParent->pRight : pParent->pLeft;
+
+         // Case 1: red sibling. Rotate it up so the sibling is black
+         if (pSibling->isRed)
+         {
+            counted(counters::local().balance(counters::erase1, 1, 2);)
+            pSibling->isRed = false;
+            pParent->isRed = true;
+            if (isLeft)
+               rotateLeft(pParent);
+            else
+               rotateRight(pParent);
+            pSibling = isLeft ? pParent->pRight : pParent->pLeft;
+         }
+
+         BNode* pNear = isLeft ? pSibling->pLeft : pSibling->pRight;
+         BNode* pFar  = isLeft ? pSibling->pRight : pSibling->pLeft;
+
+         // Case 2: black sibling with black children. Take a black off
+         //         the sibling's side too and push the shortage up
+         if ((!pNear || !pNear->isRed) && (!pFar || !pFar->isRed))
+         {
+            counted(counters::local().balance(counters::erase2, 0, 1);)
+            pSibling->isRed = true;
+            pNode = pParent;
+            pParent = pNode->pParent;
+            continue;
+         }
+
+         // Case 3: only the near nephew is red. Rotate it up to be the sibling
+         if (!pFar || !pFar->isRed)
+         {
+            counted(counters::local().balance(counters::erase3, 1, 2);)
+            pNear->isRed = false;
+            pSibling->isRed = true;
+            if (isLeft)
+               rotateRight(pSibling);
+            else
+               rotateLeft(pSibling);
+            pFar = pSibling;
+            pSibling = isLeft ? pParent->pRight : pParent->pLeft;
+         }
+
+         // Case 4: the far nephew is red. One rotation at the parent
+         //         gives our side the black it lost
+         counted(counters::local().balance(counters::erase4, 1, 3);)
+         pSibling->isRed = pParent->isRed;
+         pParent->isRed = false;
+         pFar->isRed = false;
+         if (isLeft)
+            rotateLeft(pParent);
+         else
+            rotateRight(pParent);
+         pNode = root;
       }
 
-      // Case 3: Two Children - Replace node with in-order successor
-      if (pDelete->pLeft && pDelete->pRight)
+      if (pNode)
+         pNode->isRed = false;
+   }
+
+   /*************************************************
+    * BST :: ERASE RANGE
+    * Remove every node in [first, last), O(k + log n)
+    * for k of them. Returns last
+    ************************************************/
+   template <typename T>
+   typename BST<T>::iterator BST<T>::erase(iterator first, iterator last)
+   {
+      // Nothing to remove
+      first.check();
+      last.check();
+      if (first == last)
+         return last;
+
+      // The whole tree: no need to visit the survivors at all
+      if (first == begin() && last == end())
       {
-         // Find in-order successor
-         BNode* pNext = itReturn.pNode;  // itReturn already points to next node in sequence.
+         clear();
+         return end();
+      }
 
-         // Part A: Copy the pointers from pDelete to pNext
-         pNext->pLeft = pDelete->pLeft;
-         pNext->pLeft->pParent = pNext;
+      std::vector<BNode*> doomed;
+      for (iterator it = first; it != last; ++it)
+         doomed.push_back(it.pNode);
+
+      eraseRun(doomed, last.pNode);
+      return iterator(last.pNode, this);
+   }
+
+   /*************************************************
+    * BST :: ERASE KEY
+    * Remove every element equivalent to t, a run cut out
+    * as erase(first, last) does. Returns the number of
+    * elements removed
+    ************************************************/
+   template <typename T>
+   size_t BST<T>::erase(const T& t)
+   {
+      std::vector<BNode*> doomed;
+      iterator last = upper_bound(t);
+      for (iterator it = lower_bound(t); it != last; ++it)
+         doomed.push_back(it.pNode);
+
+      return eraseRun(doomed, last.pNode);
+   }
+
+   /*************************************************
+    * BST :: ERASE IF
+    * Remove every element for which pred is true in a
+    * single in-order pass. Returns the number removed
+    ************************************************/
+   template <typename T>
+   template <class Predicate>
+   size_t BST<T>::erase_if(Predicate pred)
+   {
+      std::vector<BNode*> doomed;
+      for (iterator it = begin(); it != end(); ++it)
+         if (pred(*it))
+            doomed.push_back(it.pNode);
+
+      return eraseNodes(doomed);
+   }
+
+   /*************************************************
+    * BST :: ERASE RUN
+    * Remove k nodes that sit side by side in order, just
+    * before pLast (nullptr for the end). A small run
+    * (k < n/4) is cut out with two splits and the two
+    * sides joined again around pLast, O(k + log n): only
+    * the paths above the cuts are touched. A large run
+    * goes to eraseNodes()
+    ************************************************/
+   template <typename T>
+   size_t BST<T>::eraseRun(std::vector<BNode*>& doomed, BNode* pLast)
+   {
+      size_t numDoomed = doomed.size();
+      if (numDoomed == 0 || numDoomed * 4 >= numElements)
+         return eraseNodes(doomed);
+
+      // everything before the run, and the run with all after it
+      BNode* pBefore;
+      BNode* pAfter;
+      size_t hBefore;
+      size_t hAfter;
+      split(doomed.front(), blackHeight(root), pBefore, hBefore, pAfter, hAfter);
+
+      // the rest of the run, and everything after pLast
+      if (pLast)
+      {
+         BNode* pRun;
+         BNode* pRest;
+         size_t hRun;
+         size_t hRest;
+         split(pLast, hAfter, pRun, hRun, pRest, hRest);
+         size_t height;
+         root = join(pBefore, hBefore, pLast, pRest, hRest, height);
+      }
+      else
+         root = pBefore;
+
+      numElements -= numDoomed;
+      numChanges++;
+      checked(epoch.fetch_add(1, std::memory_order_relaxed);)
+      discard(doomed);
+      return numDoomed;
+   }
 
-         // Special case: if pNext is not pDelete's direct right child
-         if (pNext != pDelete->pRight)
+   /*************************************************
+    * BST :: ERASE NODES
+    * Remove a batch of k nodes listed in sorted order. A
+    * small batch (k < n/4) is unlinked one node at a time,
+    * O(k log n). A large batch is cheaper to drop all at
+    * once: the survivors are relinked into a balanced tree
+    * and the doomed nodes freed in bulk, O(n), which is O(k)
+    * since k is at least n/4. Either way the red-black
+    * rules hold afterwards
+    ************************************************/
+   template <typename T>
+   size_t BST<T>::eraseNodes(std::vector<BNode*>& doomed)
+   {
+      size_t numDoomed = doomed.size();
+
+      // Case 1: Small batch. Each unlink is cheap compared to a rebuild
+      if (numDoomed * 4 < numElements)
+      {
+         for (BNode* pDelete : doomed)
          {
-            // Hook up pNext's right child to pNext's parent if it exists
-            if (pNext->pRight)
-            {
-               pNext->pRight->pParent = pNext->pParent;
-               pNext->pParent->pLeft = pNext->pRight;  // pNext must be a left child
-            }
-            else
-               pNext->pParent->pLeft = nullptr;
+            iterator it(pDelete);
+            erase(it);
+         }
+         return numDoomed;
+      }
 
-            // Hook up pDelete's right child to pNext
-            pNext->pRight = pDelete->pRight;
-            pNext->pRight->pParent = pNext;
+      // Case 2: Everything goes
+      if (numDoomed == numElements)
+      {
+         clear();
+         return numDoomed;
+      }
+
+      // Case 3: Large batch. Collect the survivors in order, skipping the
+      //         doomed nodes which are also in order
+      std::vector<BNode*> survivors;
+      survivors.reserve(numElements - numDoomed);
+      size_t iDoomed = 0;
+      for (iterator it = begin(); it != end(); ++it)
+      {
+         if (iDoomed < numDoomed && it.pNode == doomed[iDoomed])
+            iDoomed++;
+         else
+            survivors.push_back(it.pNode);
+      }
+      assert(iDoomed == numDoomed);
+
+      checked(epoch.fetch_add(1, std::memory_order_relaxed);)
+      discard(doomed);
+      adoptSorted(survivors);
+      return numDoomed;
+   }
+
+   /*************************************************
+    * BST :: BLACK HEIGHT
+    * The black nodes on any path down from pNode, itself
+    * included, O(log n)
+    ************************************************/
+   template <typename T>
+   size_t BST<T>::blackHeight(const BNode* pNode)
+   {
+      size_t height = 0;
+      for (; pNode; pNode = pNode->pLeft)
+         if (!pNode->isRed)
+            height++;
+      return height;
+   }
+
+   /*************************************************
+    * BST :: DETACH
+    * Make a subtree a tree of its own, with a black root.
+    * height is its black height, and grows if the root
+    * had to be blackened
+    ************************************************/
+   template <typename T>
+   typename BST<T>::BNode* BST<T>::detach(BNode* pNode, size_t& height)
+   {
+      if (pNode)
+      {
+         pNode->pParent = nullptr;
+         if (pNode->isRed)
+         {
+            pNode->isRed = false;
+            height++;
          }
+      }
+      return pNode;
+   }
 
-         // Hook up pNext to pDelete's parent
-         pNext->pParent = pDelete->pParent;
-         if (pDelete->pParent && pDelete->isLeftChild(pDelete->pParent))
-            pDelete->pParent->pLeft = pNext;
-         else if (pDelete->pParent)
-            pDelete->pParent->pRight = pNext;
-         else  // pDelete was the root
-            root = pNext;
-
-         delete pDelete;
-         numElements--;
-         return itReturn;
+   /*************************************************
+    * BST :: JOIN
+    * Make one tree of pLeft, then pMiddle, then pRight,
+    * whose roots are black and whose black heights are
+    * hLeft and hRight. pMiddle hangs red where the spine
+    * of the taller tree comes down to the other's black
+    * height, and balance() fixes the red above it, so the
+    * cost is O(|hLeft - hRight| + 1). Returns the root and
+    * sets height to its black height
+    ************************************************/
+   template <typename T>
+   typename BST<T>::BNode* BST<T>::join(BNode* pLeft, size_t hLeft, BNode* pMiddle,
+                                        BNode* pRight, size_t hRight, size_t& height)
+   {
+      pMiddle->pParent = nullptr;
+      pMiddle->isRed = true;
+
+      // Case 1: Even. The middle node becomes the root
+      if (hLeft == hRight)
+      {
+         pMiddle->addLeft(pLeft);
+         pMiddle->addRight(pRight);
+         pMiddle->isRed = false;
+         height = hLeft + 1;
+         return pMiddle;
       }
 
-      assert(false && "Unreachable");
+      // Case 2: The left is taller. Down its right spine
+      BNode* pRoot;
+      if (hLeft > hRight)
+      {
+         BNode* pParent = nullptr;
+         BNode* pNode = pLeft;
+         for (size_t h = hLeft; pNode && (pNode->isRed || h > hRight); pNode = pNode->pRight)
+         {
+            h -= pNode->isRed ? 0 : 1;
+            pParent = pNode;
+         }
+         pMiddle->addLeft(pNode);
+         pMiddle->addRight(pRight);
+         pParent->addRight(pMiddle);
+         pRoot = pLeft;
+         height = hLeft;
+      }
 
-      return itReturn;
+      // Case 3: The right is taller. Down its left spine
+      else
+      {
+         BNode* pParent = nullptr;
+         BNode* pNode = pRight;
+         for (size_t h = hRight; pNode && (pNode->isRed || h > hLeft); pNode = pNode->pLeft)
+         {
+            h -= pNode->isRed ? 0 : 1;
+            pParent = pNode;
+         }
+         pMiddle->addLeft(pLeft);
+         pMiddle->addRight(pNode);
+         pParent->addLeft(pMiddle);
+         pRoot = pRight;
+         height = hRight;
+      }
+
+      if (pMiddle->balance(pRoot))
+         height++;
+      return pRoot;
+   }
+
+   /*************************************************
+    * BST :: SPLIT
+    * Take the tree pNode is in, whose black height is
+    * height, apart into what comes before pNode and what
+    * comes after it, leaving pNode on its own. Going up
+    * from pNode, each ancestor and its other subtree join
+    * the side they belong to. The joins cost the
+    * differences in black height between neighbors on the
+    * path, which add up to O(log n)
+    ************************************************/
+   template <typename T>
+   void BST<T>::split(BNode* pNode, size_t height, BNode*& pLeft, size_t& hLeft,
+                      BNode*& pRight, size_t& hRight)
+   {
+      // a red-black tree is at most 2 lg(n + 1) deep, so nothing to allocate
+      BNode* path[2 * std::numeric_limits<size_t>::digits];
+      size_t heights[2 * std::numeric_limits<size_t>::digits];
+      size_t depth = 0;
+      for (BNode* p = pNode; p; p = p->pParent)
+         path[depth++] = p;
+      for (size_t i = depth; i-- > 0; )
+      {
+         heights[i] = height;
+         height -= path[i]->isRed ? 0 : 1;
+      }
+
+      hLeft = hRight = height;   // now that of pNode's subtrees
+      pLeft = detach(pNode->pLeft, hLeft);
+      pRight = detach(pNode->pRight, hRight);
+      for (size_t i = 1; i < depth; i++)
+      {
+         BNode* pUp = path[i];
+         size_t hSide = heights[i] - (pUp->isRed ? 0 : 1);
+         if (pUp->pRight == path[i - 1])
+         {
+            BNode* pSide = detach(pUp->pLeft, hSide);
+            pLeft = join(pSide, hSide, pUp, pLeft, hLeft, hLeft);
+         }
+         else
+         {
+            BNode* pSide = detach(pUp->pRight, hSide);
+            pRight = join(pRight, hRight, pUp, pSide, hSide, hRight);
+         }
+      }
+      pNode->pLeft = pNode->pRight = pNode->pParent = nullptr;
+   }
+
+   /*************************************************
+    * BST :: ADOPT SORTED
+    * Link nodes, already in order and in no other tree,
+    * into a balanced tree colored by depth and make it
+    * the whole tree, O(n). A caller that linked them
+    * itself, as BNode::build() would, passes the root.
+    * Whatever root pointed to before must already be
+    * freed or among the nodes
+    ************************************************/
+   template <typename T>
+   void BST<T>::adoptSorted(std::vector<BNode*>& nodes, BNode* pRoot)
+   {
+      root = pRoot ? pRoot : BNode::build(nodes.data(), nodes.size(), 0, BNode::redDepth(nodes.size()));
+      numElements = nodes.size();
+      numChanges++;
+      if (root)
+      {
+         root->pParent = nullptr;
+         root->isRed = false;
+      }
+   }
+
+   /*************************************************
+    * BST :: DISCARD
+    * Free each of a list of nodes, leaving the list empty
+    ************************************************/
+   template <typename T>
+   void BST<T>::discard(std::vector<BNode*>& nodes) noexcept
+   {
+      for (BNode* pNode : nodes)
+         delete pNode;
+      nodes.clear();
    }
 
    /*****************************************************
@@ -581,6 +1280,8 @@ namespace custom
    {
       BNode::clear(root);
       numElements = 0;
+      numChanges++;
+      checked(epoch.fetch_add(1, std::memory_order_relaxed);)
    }
 
    /*****************************************************
@@ -598,7 +1299,7 @@ namespace custom
       while (p->pLeft)
          p = p->pLeft;
 
-      return iterator(p);
+      return iterator(p, this);
    }
 
 
@@ -607,26 +1308,322 @@ namespace custom
     * Return the node corresponding to a given value
     ****************************************************/
    template <typename T>
-   typename BST<T>::iterator BST<T>::find(const T& t)
+   typename BST<T>::iterator BST<T>::find(const T& t) const
    {
       BNode* p = root;
+      counted(size_t depth = 0;)   // nodes visited: == at each, and < at all but a match
 
       if (!p)
+      {
+         counted(counters::local().find(0, 0);)
          return end();
+      }
 
       while (p)
       {
+         counted(depth++;)
          if (t == p->data)
-            return iterator(p);
+         {
+            counted(counters::local().find(depth, 2 * depth - 1);)
+            return iterator(p, this);
+         }
          else if (t < p->data)
             p = p->pLeft;
          else
             p = p->pRight;
       }
 
+      counted(counters::local().find(depth, 2 * depth);)
       return end();
    }
 
+   /****************************************************
+    * BST :: LOWER BOUND
+    * Return the first element that is not less than t
+    ****************************************************/
+   template <typename T>
+   typename BST<T>::iterator BST<T>::lower_bound(const T& t) const
+   {
+      BNode* pResult = nullptr;
+      BNode* p = root;
+      counted(size_t depth = 0;)
+
+      while (p)
+      {
+         counted(depth++;)
+         if (p->data < t)
+            p = p->pRight;
+         else
+         {
+            pResult = p;
+            p = p->pLeft;
+         }
+      }
+      counted(counters::local().compared(depth);)
+
+      return iterator(pResult, this);
+   }
+
+   /****************************************************
+    * BST :: UPPER BOUND
+    * Return the first element that is greater than t
+    ****************************************************/
+   template <typename T>
+   typename BST<T>::iterator BST<T>::upper_bound(const T& t) const
+   {
+      BNode* pResult = nullptr;
+      BNode* p = root;
+      counted(size_t depth = 0;)
+
+      while (p)
+      {
+         counted(depth++;)
+         if (t < p->data)
+         {
+            pResult = p;
+            p = p->pLeft;
+         }
+         else
+            p = p->pRight;
+      }
+      counted(counters::local().compared(depth);)
+
+      return iterator(pResult, this);
+   }
+
+   /****************************************************
+    * BST :: STATS
+    * The shape of the whole tree, in one pass. Use a
+    * StatsScan instead to spread the walk over several steps
+    ****************************************************/
+   template <typename T>
+   ShapeStats BST<T>::stats() const
+   {
+      StatsScan scan(*this);
+      scan.step(std::numeric_limits<size_t>::max());
+      return scan.stats();
+   }
+
+   /****************************************************
+    * SHAPE STATS :: AVERAGE DEPTH
+    ****************************************************/
+   inline double ShapeStats::averageDepth() const
+   {
+      return size ? double(totalDepth) / double(size) : 0.0;
+   }
+
+   /****************************************************
+    * SHAPE STATS :: PERCENTILE DEPTH
+    * The smallest depth that percent of the nodes are at
+    * or above: 50 for the median, 99 for the tail
+    ****************************************************/
+   inline size_t ShapeStats::percentileDepth(double percent) const
+   {
+      double wanted = double(size) * percent / 100.0;
+      size_t seen = 0;
+      for (size_t depth = 0; depth < levels.size(); depth++)
+      {
+         seen += levels[depth];
+         if (double(seen) >= wanted)
+            return depth;
+      }
+      return levels.empty() ? 0 : levels.size() - 1;
+   }
+
+   /****************************************************
+    * SHAPE STATS :: MIN HEIGHT
+    * The levels a perfectly balanced tree of this size
+    * would have. A red-black tree stays within twice this
+    ****************************************************/
+   inline size_t ShapeStats::minHeight() const
+   {
+      size_t numLevels = 0;
+      for (size_t capacity = 0; capacity < size; capacity = capacity * 2 + 1)
+         numLevels++;
+      return numLevels;
+   }
+
+   /******************************************************
+    ******************************************************
+    ******************************************************
+    ******************** STATS SCAN **********************
+    ******************************************************
+    ******************************************************
+    ******************************************************/
+
+
+   /****************************************************
+    * STATS SCAN :: STEP
+    * Visit the next budget nodes in order, tracking the
+    * depth and black depth of each as we go
+    ****************************************************/
+   template <typename T>
+   bool BST<T>::StatsScan::step(size_t budget)
+   {
+      if (done)
+         return true;
+
+      size_t depth = 0;   // edges from the root to p
+      size_t black = 0;   // black nodes from the root to p, p included
+      BNode* p = resume(depth, black);
+
+      for (; p && budget > 0; budget--)
+      {
+         visit(p, depth, black);
+         advance(p, depth, black);
+      }
+
+      done = (p == nullptr);
+      pNext = p;
+      depthNext = depth;
+      blackNext = black;
+      numChanges = pTree->numChanges;
+
+      // one copy per step, in case the tree changes before the next
+      if (!done && pLast)
+         last = pLast->data;
+      return done;
+   }
+
+   /****************************************************
+    * STATS SCAN :: RESTART
+    * Forget what we have seen and start over
+    ****************************************************/
+   template <typename T>
+   void BST<T>::StatsScan::restart()
+   {
+      result = ShapeStats();
+      pNext = nullptr;
+      pLast = nullptr;
+      last.reset();
+      numLast = 0;
+      done = false;
+   }
+
+   /****************************************************
+    * STATS SCAN :: RESUME
+    * The next node to visit: the first in the tree, or the
+    * one after the last we visited. If the tree has not
+    * changed that is the node we stopped at, O(1). Otherwise
+    * we look it up by key, and its depth and black depth
+    * come from the walk up to the root
+    ****************************************************/
+   template <typename T>
+   typename BST<T>::BNode* BST<T>::StatsScan::resume(size_t& depth, size_t& black)
+   {
+      if (last && numChanges == pTree->numChanges)
+      {
+         depth = depthNext;
+         black = blackNext;
+         return pNext;
+      }
+      pLast = nullptr;
+
+      BNode* p = pTree->root;
+      if (!p)
+         return nullptr;
+
+      if (!last)
+      {
+         while (p->pLeft)
+            p = p->pLeft;
+      }
+      else
+      {
+         // the first node not less than last, then past the equal ones we saw
+         BNode* pResult = nullptr;
+         while (p)
+         {
+            if (p->data < *last)
+               p = p->pRight;
+            else
+            {
+               pResult = p;
+               p = p->pLeft;
+            }
+         }
+         p = pResult;
+         for (size_t i = 0; p && i < numLast && !(*last < p->data); i++)
+            advance(p, depth, black);
+         if (!p)
+            return nullptr;
+      }
+
+      depth = 0;
+      black = 0;
+      for (const BNode* pUp = p; pUp; pUp = pUp->pParent)
+      {
+         depth++;
+         black += pUp->isRed ? 0 : 1;
+      }
+      depth--;
+      return p;
+   }
+
+   /****************************************************
+    * STATS SCAN :: ADVANCE
+    * Move p to its in-order successor, keeping its depth and
+    * black depth up to date
+    ****************************************************/
+   template <typename T>
+   void BST<T>::StatsScan::advance(BNode*& p, size_t& depth, size_t& black)
+   {
+      if (p->pRight)
+      {
+         p = p->pRight;
+         depth++;
+         black += p->isRed ? 0 : 1;
+         while (p->pLeft)
+         {
+            p = p->pLeft;
+            depth++;
+            black += p->isRed ? 0 : 1;
+         }
+      }
+      else
+      {
+         while (p->pParent && p->pParent->pRight == p)
+         {
+            black -= p->isRed ? 0 : 1;
+            p = p->pParent;
+            depth--;
+         }
+         black -= p->isRed ? 0 : 1;
+         p = p->pParent;
+         depth--;
+      }
+   }
+
+   /****************************************************
+    * STATS SCAN :: VISIT
+    * Count one node, and the leaves below it
+    ****************************************************/
+   template <typename T>
+   void BST<T>::StatsScan::visit(const BNode* p, size_t depth, size_t black)
+   {
+      if (result.levels.size() <= depth)
+         result.levels.resize(depth + 1);
+      result.levels[depth]++;
+      result.size++;
+      result.totalDepth += depth;
+      result.height = result.levels.size();
+
+      // every missing child is a leaf; all of them should agree on black height
+      int numLeaves = (p->pLeft ? 0 : 1) + (p->pRight ? 0 : 1);
+      if (numLeaves > 0)
+      {
+         if (result.blackHeight == 0)
+            result.blackHeight = black;
+         else if (result.blackHeight != black)
+            result.blackBalanced = false;
+      }
+
+      // compare with the node before, or after a change with its key
+      bool sameAsLast = pLast ? !(pLast->data < p->data) : (last && !(*last < p->data));
+      numLast = sameAsLast ? numLast + 1 : 1;
+      pLast = p;
+   }
+
    /******************************************************
     ******************************************************
     ******************************************************
@@ -748,7 +1745,7 @@ namespace custom
    template <typename T>
    void BST<T>::BNode::addRight(const T& t)
    {
-      addLeft(new BNode(t));
+      addRight(new BNode(t));
    }
 
    /******************************************************
@@ -778,6 +1775,53 @@ namespace custom
       pNode = nullptr;
    }
 
+   /*****************************************************
+    * BINARY NODE :: BUILD
+    * Link num sorted nodes into a balanced subtree and return
+    * its root. Every leaf ends up on one of the bottom two
+    * levels, so coloring the nodes at redDepth red and all
+    * others black satisfies the red-black rules
+    ****************************************************/
+   template <typename T>
+   typename BST<T>::BNode* BST<T>::BNode::build(BNode* const* ppNodes, size_t num,
+                                               size_t depth, size_t redDepth)
+   {
+      if (num == 0)
+         return nullptr;
+
+      size_t iMiddle = num / 2;
+      BNode* pNode = ppNodes[iMiddle];
+      pNode->isRed = (depth == redDepth);
+      pNode->pParent = nullptr;
+
+      pNode->pLeft = build(ppNodes, iMiddle, depth + 1, redDepth);
+      if (pNode->pLeft)
+         pNode->pLeft->pParent = pNode;
+
+      pNode->pRight = build(ppNodes + iMiddle + 1, num - iMiddle - 1, depth + 1, redDepth);
+      if (pNode->pRight)
+         pNode->pRight->pParent = pNode;
+
+      return pNode;
+   }
+
+   /*****************************************************
+    * BINARY NODE :: RED DEPTH
+    * The depth of the bottom level of a balanced tree of
+    * num nodes: the only level that is colored red
+    ****************************************************/
+   template <typename T>
+   size_t BST<T>::BNode::redDepth(size_t num)
+   {
+      size_t height = 0;
+      while (num)
+      {
+         height++;
+         num >>= 1;
+      }
+      return height ? height - 1 : 0;
+   }
+
 #ifdef DEBUG
 /****************************************************
  * BINARY NODE :: FIND DEPTH
@@ -902,21 +1946,27 @@ namespace custom
 
    /******************************************************
     * BINARY NODE :: BALANCE
-    * Balance the tree from a given location
+    * Balance the tree from a given location. Only case 1
+    * blackens a red root, so only it adds a black to
+    * every path
     ******************************************************/
    template <typename T>
-   void BST<T>::BNode::balance(BNode*& pRoot)
+   bool BST<T>::BNode::balance(BNode*& pRoot)
    {
       // Case 1: if we are the root, then color ourselves black and call it a day.
       if (!pParent)
       {
          isRed = false;
-         return;
+         counted(counters::local().balance(counters::case1, 0, 1);)
+         return true;
       }
 
       // Case 2: if the parent is black, then there is nothing left to do
       if (!pParent->isRed)
-         return;
+      {
+         counted(counters::local().balance(counters::case2, 0, 0);)
+         return false;
+      }
 
       BNode* pGranny = pParent->pParent;
       BNode* pAunt   = pParent->isLeftChild(pGranny)
@@ -935,9 +1985,9 @@ namespace custom
          pAunt->isRed = false;
          // grandparent turns red
          pGranny->isRed = true;
+         counted(counters::local().balance(counters::case3, 0, 3);)
          // recurse off of grandparent
-         pGranny->balance(pRoot);
-         return;
+         return pGranny->balance(pRoot);
       }
 
       // Case 4: if the aunt is black or non-existant, then we need to rotate
@@ -959,11 +2009,12 @@ namespace custom
 
             pGranny->isRed = true;
             pParent->isRed = false;
+            counted(counters::local().balance(counters::case4a, 1, 2);)
 
             if (!pParent->pParent)
                pRoot = pParent;
 
-            return;
+            return false;
          }
 
          // case 4b: We are mom's right and mom is granny's right
@@ -982,11 +2033,12 @@ namespace custom
 
             pGranny->isRed = true;
             pParent->isRed = false;
+            counted(counters::local().balance(counters::case4b, 1, 2);)
 
             if (!pParent->pParent)
                pRoot = pParent;
 
-            return;
+            return false;
          }
 
          // Case 4c: We are mom's right and mom is granny's left
@@ -996,11 +2048,10 @@ namespace custom
             pParent->addRight(this->pLeft);
 
             BNode* pParentTemp = pParent;  // Save pointer to parent
-            if (!pGranny->pParent)
-               this->pParent = nullptr;
-            else if (pGranny->isLeftChild(pGranny->pParent))
+            this->pParent = pGranny->pParent;
+            if (pGranny->pParent && pGranny->isLeftChild(pGranny->pParent))
                pGranny->pParent->pLeft = this;
-            else
+            else if (pGranny->pParent)
                pGranny->pParent->pRight = this;
 
             this->addRight(pGranny);
@@ -1008,11 +2059,12 @@ namespace custom
 
             pGranny->isRed = true;
             this->isRed = false;
+            counted(counters::local().balance(counters::case4c, 2, 2);)
 
             if (!pParent)
                pRoot = this;
 
-            return;
+            return false;
          }
 
          // case 4d: we are mom's left and mom is granny's right
@@ -1022,11 +2074,10 @@ namespace custom
             pParent->addLeft(this->pRight);
 
             BNode* pParentTemp = pParent;  // Save pointer to parent
-            if (!pGranny->pParent)
-               this->pParent = nullptr;
-            else if (pGranny->isLeftChild(pGranny->pParent))
+            this->pParent = pGranny->pParent;
+            if (pGranny->pParent && pGranny->isLeftChild(pGranny->pParent))
                pGranny->pParent->pLeft = this;
-            else
+            else if (pGranny->pParent)
                pGranny->pParent->pRight = this;
 
             this->addLeft(pGranny);
@@ -1034,13 +2085,15 @@ namespace custom
 
             pGranny->isRed = true;
             this->isRed = false;
+            counted(counters::local().balance(counters::case4d, 2, 2);)
 
             if (!pParent)
                pRoot = this;
 
-            return;
+            return false;
          }
       }  // Case 4
+      return false;
    }  // balance()
 
    /*************************************************
@@ -1058,6 +2111,8 @@ namespace custom
    template <typename T>
    typename BST<T>::iterator& BST<T>::iterator::operator ++()
    {
+      check();
+
       // Don't increment if we're already at the end
       if (!pNode)
          return *this;
@@ -1078,8 +2133,8 @@ namespace custom
          return *this;
       }
 
-      // Case 3: No right child and pCurr is parent's right child
-      if (!pNode->pRight && pNode->isRightChild(pNode->pParent))
+      // Case 3: No right child and pCurr is parent's right child (or the root)
+      if (!pNode->pRight && !pNode->isLeftChild(pNode->pParent))
       {
          while (pNode->pParent && pNode->isRightChild(pNode->pParent))
             pNode = pNode->pParent;
@@ -1099,6 +2154,8 @@ namespace custom
    template <typename T>
    typename BST<T>::iterator& BST<T>::iterator::operator --()
    {
+      check();
+
       // Don't increment if we're already at the end
       if (!pNode)
          return *this;
@@ -1119,8 +2176,8 @@ namespace custom
          return *this;
       }
 
-      // Case 3: No left child and pCurr is parent's left child
-      if (!pNode->pLeft && pNode->isLeftChild(pNode->pParent))
+      // Case 3: No left child and pCurr is parent's left child (or the root)
+      if (!pNode->pLeft && !pNode->isRightChild(pNode->pParent))
       {
          while (pNode->pParent && pNode->isLeftChild(pNode->pParent))
             pNode = pNode->pParent;
@@ -0,0 +1,1103 @@
+/***********************************************************************
+ * Header:
+ *    BTREE
+ * Summary:
+ *    A B-tree with the same interface as BST. Each node holds many keys
+ *    in one contiguous array sized to a few cache lines, so a search
+ *    touches a handful of nodes instead of one node per comparison, and
+ *    existing callers of BST can switch over with a typedef:
+ *        typedef custom::BTree<int> Tree;    // was custom::BST<int>
+ *
+ *    Every node except the root holds between minKeys and maxKeys keys.
+ *    Leaves are NodeBytes long; internal nodes add one child pointer
+ *    per key. Key slots are constructed only as they fill, so T need
+ *    not be default-constructible. Like BST, equal keys are kept in
+ *    insertion order.
+ *
+ *    This will contain the class definition of:
+ *        BTree               : A class that represents a B-tree
+ *        BTree::iterator     : An iterator through BTree
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <new>        // for placement new
+#include <optional>   // for std::optional
+#include <utility>    // for std::pair and std::move
+#include <vector>     // for std::vector
+#include <initializer_list>
+#include "simd.h"     // for lowerBound and upperBound within a node
+
+class TestBTree; // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * B-TREE
+ * Create a B-tree of nodes roughly NodeBytes in size
+ *****************************************************************/
+   template <typename T, size_t NodeBytes = 256>
+   class BTree
+   {
+      friend class ::TestBTree; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      BTree();
+      BTree(const BTree& rhs);
+      BTree(BTree&& rhs);
+      BTree(const std::initializer_list<T>& il);
+      ~BTree();
+
+      //
+      // Assign
+      //
+
+      BTree& operator =(const BTree& rhs);
+      BTree& operator =(BTree&& rhs);
+      BTree& operator =(const std::initializer_list<T>& il);
+      void swap(BTree& rhs);
+
+      //
+      // Iterator
+      //
+
+      class iterator;
+      iterator begin() const noexcept;
+      iterator end()   const noexcept { return iterator(nullptr, 0); }
+
+      //
+      // Access
+      //
+
+      iterator find(const T& t) const;
+      iterator lower_bound(const T& t) const;
+      iterator upper_bound(const T& t) const;
+
+      //
+      // Insert
+      //
+
+      std::pair<iterator, bool> insert(const T& t, bool keepUnique = false);
+      std::pair<iterator, bool> insert(T&& t, bool keepUnique = false);
+
+      //
+      // Remove
+      //
+
+      iterator erase(iterator& it);
+      iterator erase(iterator first, iterator last);
+      size_t   erase(const T& t);
+      template <class Predicate>
+      size_t   erase_if(Predicate pred);
+      void     clear() noexcept;
+
+      //
+      // Status
+      //
+
+      bool   empty() const noexcept { return size() == 0; }
+      size_t size()  const noexcept { return numElements; }
+
+   private:
+
+      class BNode;
+      class BInternal;
+
+      template <typename U>
+      std::pair<iterator, bool> insertAny(U&& t, bool keepUnique);
+      void removeFromLeaf(BNode* pLeaf, int index);
+      iterator eraseRun(iterator first, iterator last, size_t num);
+      void build(std::vector<T>& sorted);
+
+      BNode* root;              // root node of the B-tree
+      size_t numElements;       // number of elements currently in the tree
+   };
+
+
+   /*****************************************************************
+    * B-TREE NODE
+    * A leaf: a sorted run of keys. An internal node (BInternal) adds
+    * the children; children[i] holds the keys that sort before keys[i]
+    *****************************************************************/
+   template <typename T, size_t NodeBytes>
+   class BTree<T, NodeBytes>::BNode
+   {
+   public:
+      // the keys that fit in NodeBytes after the header, rounded down to
+      // an odd number so a full node splits into two equal halves
+      static constexpr size_t header  = sizeof(void*) + 2 * sizeof(int);
+      static constexpr size_t fit     = NodeBytes > header + 3 * sizeof(T)
+                                      ? (NodeBytes - header) / sizeof(T) : 3;
+      static constexpr int    maxKeys = (int)(fit % 2 ? fit : fit - 1);
+      static constexpr int    minKeys = maxKeys / 2;
+
+      //
+      // Construct
+      //
+      BNode(bool isLeaf = true) : pParent(nullptr), numKeys(0), isLeaf(isLeaf)
+      {}
+      BNode(const BNode&) = delete;
+      ~BNode()
+      {
+         truncate(0);
+      }
+
+      //
+      // Keys. Only the first numKeys slots hold a constructed T
+      //
+      template <typename U>
+      void insertKey(int i, U&& t);
+      template <typename U>
+      void pushKey(U&& t);
+      void eraseKey(int i);
+      void truncate(int num) noexcept;
+
+      //
+      // Search within the node
+      //
+      int lowerBound(const T& t) const;
+      int upperBound(const T& t) const;
+
+      //
+      // Navigate
+      //
+      BNode*& child(int i);
+      BNode*  child(int i) const;
+      int     indexInParent() const;
+      static BNode* copy(const BNode* pSrc, BNode* pParent);
+      static void   clear(BNode* pNode) noexcept;
+
+      //
+      // Data
+      //
+      BNode* pParent;          // Parent, or nullptr for the root
+      int numKeys;             // Number of keys in use
+      bool isLeaf;             // No children?
+      union
+      {
+         T keys[maxKeys];      // Sorted keys, raw storage past numKeys
+      };
+   };
+
+   template <typename T, size_t NodeBytes>
+   class BTree<T, NodeBytes>::BInternal : public BTree<T, NodeBytes>::BNode
+   {
+   public:
+      BInternal() : BNode(false)
+      {
+         for (BNode*& p : children)
+            p = nullptr;
+      }
+      BNode* children[BNode::maxKeys + 1];
+   };
+
+   /**********************************************************
+    * B-TREE ITERATOR
+    * Forward and reverse iterator through a BTree
+    *********************************************************/
+   template <typename T, size_t NodeBytes>
+   class BTree<T, NodeBytes>::iterator
+   {
+      friend class ::TestBTree; // give unit tests access to the privates
+      friend class BTree<T, NodeBytes>;
+   public:
+      // constructors and assignment
+      iterator(BNode* p = nullptr, int i = 0) : pNode(p), index(i)
+      {}
+
+      // compare
+      bool operator ==(const iterator& rhs) const
+      {
+         return pNode == rhs.pNode && index == rhs.index;
+      }
+      bool operator !=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      // de-reference. Cannot change because it will invalidate the BTree
+      const T& operator *() const
+      {
+         return pNode->keys[index];
+      }
+
+      // increment and decrement
+      iterator& operator ++();
+      iterator  operator ++(int)
+      {
+         iterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+      iterator& operator --();
+      iterator  operator --(int)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+
+      BNode* pNode;            // the node
+      int index;               // the key within the node
+   };
+
+
+   /*********************************************
+    *********************************************
+    *********************************************
+    ****************** B-TREE *******************
+    *********************************************
+    *********************************************
+    *********************************************/
+
+
+   /*********************************************
+    * B-TREE :: DEFAULT CONSTRUCTOR
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>::BTree() : root(nullptr), numElements(0) {}
+
+   /*********************************************
+    * B-TREE :: COPY CONSTRUCTOR
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>::BTree(const BTree& rhs) : BTree()
+   {
+      *this = rhs;
+   }
+
+   /*********************************************
+    * B-TREE :: MOVE CONSTRUCTOR
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>::BTree(BTree&& rhs) : BTree()
+   {
+      swap(rhs);
+   }
+
+   /*********************************************
+    * B-TREE :: INITIALIZER LIST CONSTRUCTOR
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>::BTree(const std::initializer_list<T>& il) : BTree()
+   {
+      *this = il;
+   }
+
+   /*********************************************
+    * B-TREE :: DESTRUCTOR
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>::~BTree()
+   {
+      clear();
+   }
+
+   /*********************************************
+    * B-TREE :: ASSIGNMENT OPERATOR
+    * Copy one tree to another, node for node
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>& BTree<T, NodeBytes>::operator =(const BTree& rhs)
+   {
+      if (this != &rhs)
+      {
+         clear();
+         root = BNode::copy(rhs.root, nullptr);
+         numElements = rhs.numElements;
+      }
+      return *this;
+   }
+
+   /*********************************************
+    * B-TREE :: ASSIGN-MOVE OPERATOR
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>& BTree<T, NodeBytes>::operator =(BTree&& rhs)
+   {
+      clear();
+      swap(rhs);
+      return *this;
+   }
+
+   /*********************************************
+    * B-TREE :: ASSIGNMENT OPERATOR with INITIALIZATION LIST
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   BTree<T, NodeBytes>& BTree<T, NodeBytes>::operator =(const std::initializer_list<T>& il)
+   {
+      clear();
+      for (const T& t : il)
+         insert(t);
+      return *this;
+   }
+
+   /*********************************************
+    * B-TREE :: SWAP
+    ********************************************/
+   template <typename T, size_t NodeBytes>
+   void BTree<T, NodeBytes>::swap(BTree& rhs)
+   {
+      std::swap(root, rhs.root);
+      std::swap(numElements, rhs.numElements);
+   }
+
+   /*****************************************************
+    * B-TREE :: BEGIN
+    * The first key of the left-most leaf
+    ****************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator BTree<T, NodeBytes>::begin() const noexcept
+   {
+      if (empty())
+         return end();
+
+      BNode* p = root;
+      while (!p->isLeaf)
+         p = p->child(0);
+      return iterator(p, 0);
+   }
+
+   /****************************************************
+    * B-TREE :: FIND
+    * Return an element equivalent to t, or end()
+    ****************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator BTree<T, NodeBytes>::find(const T& t) const
+   {
+      BNode* p = root;
+      while (p)
+      {
+         int i = p->lowerBound(t);
+         if (i < p->numKeys && !(t < p->keys[i]))
+            return iterator(p, i);
+         p = p->isLeaf ? nullptr : p->child(i);
+      }
+      return end();
+   }
+
+   /****************************************************
+    * B-TREE :: LOWER BOUND
+    * Return the first element that is not less than t
+    ****************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator BTree<T, NodeBytes>::lower_bound(const T& t) const
+   {
+      iterator itResult = end();
+      BNode* p = root;
+      while (p)
+      {
+         int i = p->lowerBound(t);
+         if (i < p->numKeys)
+            itResult = iterator(p, i);
+         p = p->isLeaf ? nullptr : p->child(i);
+      }
+      return itResult;
+   }
+
+   /****************************************************
+    * B-TREE :: UPPER BOUND
+    * Return the first element that is greater than t
+    ****************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator BTree<T, NodeBytes>::upper_bound(const T& t) const
+   {
+      iterator itResult = end();
+      BNode* p = root;
+      while (p)
+      {
+         int i = p->upperBound(t);
+         if (i < p->numKeys)
+            itResult = iterator(p, i);
+         p = p->isLeaf ? nullptr : p->child(i);
+      }
+      return itResult;
+   }
+
+   /*****************************************************
+    * B-TREE :: INSERT
+    * Insert a key after any equal keys. Full nodes are split on
+    * the way down so the leaf always has room
+    ****************************************************/
+   template <typename T, size_t NodeBytes>
+   std::pair<typename BTree<T, NodeBytes>::iterator, bool> BTree<T, NodeBytes>::insert(const T& t, bool keepUnique)
+   {
+      return insertAny(t, keepUnique);
+   }
+
+   template <typename T, size_t NodeBytes>
+   std::pair<typename BTree<T, NodeBytes>::iterator, bool> BTree<T, NodeBytes>::insert(T&& t, bool keepUnique)
+   {
+      return insertAny(std::move(t), keepUnique);
+   }
+
+   template <typename T, size_t NodeBytes>
+   template <typename U>
+   std::pair<typename BTree<T, NodeBytes>::iterator, bool> BTree<T, NodeBytes>::insertAny(U&& t, bool keepUnique)
+   {
+      const int maxKeys = BNode::maxKeys;
+      const int half    = BNode::minKeys;   // keys left on each side of a split
+
+      if (keepUnique)
+      {
+         iterator it = find(t);
+         if (it != end())
+            return { it, false };  // Don't insert duplicates if keepUnique.
+      }
+
+      if (!root)
+         root = new BNode(true /*isLeaf*/);
+
+      // A full root grows the tree by one level
+      if (root->numKeys == maxKeys)
+      {
+         BInternal* pNewRoot = new BInternal;
+         pNewRoot->children[0] = root;
+         root->pParent = pNewRoot;
+         root = pNewRoot;
+      }
+
+      BNode* p = root;
+      while (true)
+      {
+         int i = p->upperBound(t);
+         if (p->isLeaf)
+         {
+            p->insertKey(i, std::forward<U>(t));
+            numElements++;
+            return { iterator(p, i), true };
+         }
+
+         // Split a full child around its median before going into it
+         BNode* pChild = p->child(i);
+         if (pChild->numKeys == maxKeys)
+         {
+            BNode* pRight = pChild->isLeaf ? new BNode(true) : new BInternal;
+            pRight->pParent = p;
+            for (int j = 0; j < half; j++)
+               pRight->pushKey(std::move(pChild->keys[half + 1 + j]));
+            if (!pChild->isLeaf)
+               for (int j = 0; j <= half; j++)
+               {
+                  pRight->child(j) = pChild->child(half + 1 + j);
+                  pRight->child(j)->pParent = pRight;
+                  pChild->child(half + 1 + j) = nullptr;
+               }
+
+            // the median moves up into p between pChild and pRight
+            for (int j = p->numKeys; j > i; j--)
+               p->child(j + 1) = p->child(j);
+            p->child(i + 1) = pRight;
+            p->insertKey(i, std::move(pChild->keys[half]));
+            pChild->truncate(half);
+
+            // equal keys stay to the left of the new key
+            if (!(t < p->keys[i]))
+               pChild = pRight;
+         }
+         p = pChild;
+      }
+   }
+
+   /*************************************************
+    * B-TREE :: ERASE
+    * Remove the element at it and return the one after it.
+    * Keys shift within and between nodes so every iterator into
+    * the tree, other than the one returned, is invalidated
+    ************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator BTree<T, NodeBytes>::erase(iterator& it)
+   {
+      // If the iterator is at the end, do nothing
+      if (it == end())
+         return end();
+
+      // Remember where the next element is in terms of values: its key and,
+      // when it equals ours, how many equal keys come before it
+      iterator itNext = it;
+      ++itNext;
+      std::optional<T> next;
+      size_t numEqualBefore = 0;
+      if (itNext != end())
+      {
+         next.emplace(*itNext);
+         if (!(*it < *next))
+            for (iterator itEqual = lower_bound(*it); itEqual != it; ++itEqual)
+               numEqualBefore++;
+      }
+
+      // An internal key trades places with its predecessor, the last key
+      // of the right-most leaf of the subtree to its left
+      BNode* pNode = it.pNode;
+      int index = it.index;
+      if (!pNode->isLeaf)
+      {
+         BNode* pLeaf = pNode->child(index);
+         while (!pLeaf->isLeaf)
+            pLeaf = pLeaf->child(pLeaf->numKeys);
+         pNode->keys[index] = std::move(pLeaf->keys[pLeaf->numKeys - 1]);
+         pNode = pLeaf;
+         index = pLeaf->numKeys - 1;
+      }
+      removeFromLeaf(pNode, index);
+
+      if (!next)
+         return end();
+      iterator itReturn = lower_bound(*next);
+      for (size_t i = 0; i < numEqualBefore; i++)
+         ++itReturn;
+      return itReturn;
+   }
+
+   /*************************************************
+    * B-TREE :: REMOVE FROM LEAF
+    * Take a key out of a leaf, then refill any node that fell
+    * below minKeys by borrowing from or merging with a sibling
+    ************************************************/
+   template <typename T, size_t NodeBytes>
+   void BTree<T, NodeBytes>::removeFromLeaf(BNode* pNode, int index)
+   {
+      pNode->eraseKey(index);
+      numElements--;
+
+      while (pNode != root && pNode->numKeys < BNode::minKeys)
+      {
+         BNode* pParent = pNode->pParent;
+         int i = pNode->indexInParent();
+         BNode* pLeft  = i > 0                  ? pParent->child(i - 1) : nullptr;
+         BNode* pRight = i < pParent->numKeys   ? pParent->child(i + 1) : nullptr;
+
+         // Case 1: Borrow from the left sibling through the parent
+         if (pLeft && pLeft->numKeys > BNode::minKeys)
+         {
+            if (!pNode->isLeaf)
+            {
+               for (int j = pNode->numKeys + 1; j > 0; j--)
+                  pNode->child(j) = pNode->child(j - 1);
+               pNode->child(0) = pLeft->child(pLeft->numKeys);
+               pNode->child(0)->pParent = pNode;
+               pLeft->child(pLeft->numKeys) = nullptr;
+            }
+            pNode->insertKey(0, std::move(pParent->keys[i - 1]));
+            pParent->keys[i - 1] = std::move(pLeft->keys[pLeft->numKeys - 1]);
+            pLeft->eraseKey(pLeft->numKeys - 1);
+            return;
+         }
+
+         // Case 2: Borrow from the right sibling through the parent
+         if (pRight && pRight->numKeys > BNode::minKeys)
+         {
+            if (!pNode->isLeaf)
+            {
+               pNode->child(pNode->numKeys + 1) = pRight->child(0);
+               pNode->child(pNode->numKeys + 1)->pParent = pNode;
+               for (int j = 0; j < pRight->numKeys; j++)
+                  pRight->child(j) = pRight->child(j + 1);
+               pRight->child(pRight->numKeys) = nullptr;
+            }
+            pNode->pushKey(std::move(pParent->keys[i]));
+            pParent->keys[i] = std::move(pRight->keys[0]);
+            pRight->eraseKey(0);
+            return;
+         }
+
+         // Case 3: Merge with a sibling, pulling the separator down
+         if (!pLeft)
+         {
+            pLeft = pNode;
+            i++;
+         }
+         BNode* pDoomed = pParent->child(i);
+         if (!pLeft->isLeaf)
+            for (int j = 0; j <= pDoomed->numKeys; j++)
+            {
+               pLeft->child(pLeft->numKeys + 1 + j) = pDoomed->child(j);
+               pLeft->child(pLeft->numKeys + 1 + j)->pParent = pLeft;
+            }
+         pLeft->pushKey(std::move(pParent->keys[i - 1]));
+         for (int j = 0; j < pDoomed->numKeys; j++)
+            pLeft->pushKey(std::move(pDoomed->keys[j]));
+
+         for (int j = i; j < pParent->numKeys; j++)
+            pParent->child(j) = pParent->child(j + 1);
+         pParent->child(pParent->numKeys) = nullptr;
+         pParent->eraseKey(i - 1);
+         if (pDoomed->isLeaf)
+            delete pDoomed;
+         else
+            delete static_cast<BInternal*>(pDoomed);
+
+         pNode = pParent;
+      }
+
+      // An empty root gives way to its only child, or to nothing
+      if (root->numKeys == 0)
+      {
+         BNode* pOld = root;
+         if (root->isLeaf)
+         {
+            root = nullptr;
+            delete pOld;
+         }
+         else
+         {
+            root = root->child(0);
+            root->pParent = nullptr;
+            delete static_cast<BInternal*>(pOld);
+         }
+      }
+   }
+
+   /*************************************************
+    * B-TREE :: ERASE RANGE
+    * Remove every element in [first, last). Returns the element
+    * that followed the range
+    ************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator BTree<T, NodeBytes>::erase(iterator first, iterator last)
+   {
+      size_t num = 0;
+      for (iterator it = first; it != last; ++it)
+         num++;
+      return eraseRun(first, last, num);
+   }
+
+   /*************************************************
+    * B-TREE :: ERASE KEY
+    * Remove every element equivalent to t
+    ************************************************/
+   template <typename T, size_t NodeBytes>
+   size_t BTree<T, NodeBytes>::erase(const T& t)
+   {
+      iterator first = lower_bound(t);
+      iterator last = upper_bound(t);
+      size_t num = 0;
+      for (iterator it = first; it != last; ++it)
+         num++;
+      eraseRun(first, last, num);
+      return num;
+   }
+
+   /*************************************************
+    * B-TREE :: ERASE RUN
+    * Remove the num elements in [first, last). One at a time
+    * is O(num log n) when the run is short and no equal key
+    * comes before first, as each erase then finds its way back
+    * with a single lower_bound. Otherwise the survivors are
+    * moved out in one pass and the tree rebuilt from them, O(n)
+    ************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator BTree<T, NodeBytes>::eraseRun(iterator first, iterator last, size_t num)
+   {
+      if (num == 0)
+         return last;
+      if (num == numElements)
+      {
+         clear();
+         return end();
+      }
+
+      iterator itPrev = first;
+      if (num * 4 < numElements && (first == begin() || *--itPrev < *first))
+      {
+         for (size_t i = 0; i < num; i++)
+            first = erase(first);
+         return first;
+      }
+
+      std::vector<T> survivors;
+      survivors.reserve(numElements - num);
+      size_t numBefore = 0;   // survivors that come before the run
+      bool inRun = false;
+      for (iterator it = begin(); it != end(); ++it)
+      {
+         if (it == first)
+         {
+            inRun = true;
+            numBefore = survivors.size();
+         }
+         if (it == last)
+            inRun = false;
+         if (!inRun)
+            survivors.push_back(std::move(it.pNode->keys[it.index]));
+      }
+
+      build(survivors);
+      iterator itReturn = begin();
+      for (size_t i = 0; i < numBefore; i++)
+         ++itReturn;
+      return itReturn;
+   }
+
+   /*************************************************
+    * B-TREE :: ERASE IF
+    * Remove every element for which pred is true. pred sees
+    * every key before any is moved, so if it throws the tree is
+    * untouched. The survivors are then moved out in one pass and
+    * the tree rebuilt from them
+    ************************************************/
+   template <typename T, size_t NodeBytes>
+   template <class Predicate>
+   size_t BTree<T, NodeBytes>::erase_if(Predicate pred)
+   {
+      std::vector<bool> doomed;
+      doomed.reserve(numElements);
+      size_t numErased = 0;
+      for (iterator it = begin(); it != end(); ++it)
+      {
+         doomed.push_back(pred(*it));
+         numErased += doomed.back() ? 1 : 0;
+      }
+      if (numErased == 0)
+         return 0;
+
+      std::vector<T> survivors;
+      survivors.reserve(numElements - numErased);
+      size_t i = 0;
+      for (iterator it = begin(); it != end(); ++it)
+         if (!doomed[i++])
+            survivors.push_back(std::move(it.pNode->keys[it.index]));
+      build(survivors);
+      return numErased;
+   }
+
+   /*************************************************
+    * B-TREE :: BUILD
+    * Replace the contents with a sorted vector in O(n). Each
+    * node gets as few children as will hold its share of the keys
+    * (but at least the minimum), and the keys are split evenly
+    ************************************************/
+   template <typename T, size_t NodeBytes>
+   void BTree<T, NodeBytes>::build(std::vector<T>& sorted)
+   {
+      clear();
+      if (sorted.empty())
+         return;
+
+      const size_t maxChildren = BNode::maxKeys + 1;
+      const size_t minChildren = BNode::minKeys + 1;
+
+      // capacity[h] is the most keys a subtree of height h can hold
+      std::vector<size_t> capacity(1, 0);
+      while (capacity.back() < sorted.size())
+         capacity.push_back(capacity.back() * maxChildren + BNode::maxKeys);
+
+      struct Builder
+      {
+         std::vector<T>& sorted;
+         const std::vector<size_t>& capacity;
+         size_t minChildren;
+
+         BNode* build(size_t first, size_t num, size_t height, BNode* pParent)
+         {
+            if (height == 1)
+            {
+               BNode* pLeaf = new BNode(true);
+               pLeaf->pParent = pParent;
+               for (size_t i = 0; i < num; i++)
+                  pLeaf->pushKey(std::move(sorted[first + i]));
+               return pLeaf;
+            }
+
+            size_t numChildren = (num + 1 + capacity[height - 1]) / (capacity[height - 1] + 1);
+            if (numChildren < (pParent ? minChildren : 2))
+               numChildren = pParent ? minChildren : 2;
+
+            BInternal* pNode = new BInternal;
+            pNode->pParent = pParent;
+
+            // child i gets (num + 1) / numChildren keys plus a separator, give or take one
+            size_t next = first;
+            for (size_t i = 0; i < numChildren; i++)
+            {
+               size_t share = (num + 1) / numChildren + (i < (num + 1) % numChildren ? 1 : 0) - 1;
+               pNode->children[i] = build(next, share, height - 1, pNode);
+               next += share;
+               if (i + 1 < numChildren)
+                  pNode->pushKey(std::move(sorted[next++]));
+            }
+            return pNode;
+         }
+      } builder{ sorted, capacity, minChildren };
+
+      root = builder.build(0, sorted.size(), capacity.size() - 1, nullptr);
+      numElements = sorted.size();
+   }
+
+   /*****************************************************
+    * B-TREE :: CLEAR
+    ****************************************************/
+   template <typename T, size_t NodeBytes>
+   void BTree<T, NodeBytes>::clear() noexcept
+   {
+      BNode::clear(root);
+      root = nullptr;
+      numElements = 0;
+   }
+
+   /******************************************************
+    ******************************************************
+    ******************************************************
+    *********************** B NODE ***********************
+    ******************************************************
+    ******************************************************
+    ******************************************************/
+
+   /******************************************************
+    * B-TREE NODE :: INSERT KEY
+    * Put t at index i, constructing the slot past the old
+    * last key and moving the keys after i up by one
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   template <typename U>
+   void BTree<T, NodeBytes>::BNode::insertKey(int i, U&& t)
+   {
+      assert(numKeys < maxKeys);
+      if (i == numKeys)
+         new (&keys[numKeys]) T(std::forward<U>(t));
+      else
+      {
+         new (&keys[numKeys]) T(std::move(keys[numKeys - 1]));
+         for (int j = numKeys - 1; j > i; j--)
+            keys[j] = std::move(keys[j - 1]);
+         keys[i] = std::forward<U>(t);
+      }
+      numKeys++;
+   }
+
+   /******************************************************
+    * B-TREE NODE :: PUSH KEY
+    * Construct t in the slot after the last key
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   template <typename U>
+   void BTree<T, NodeBytes>::BNode::pushKey(U&& t)
+   {
+      assert(numKeys < maxKeys);
+      new (&keys[numKeys]) T(std::forward<U>(t));
+      numKeys++;
+   }
+
+   /******************************************************
+    * B-TREE NODE :: ERASE KEY
+    * Move the keys after i down by one and destroy the
+    * slot left over at the end
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   void BTree<T, NodeBytes>::BNode::eraseKey(int i)
+   {
+      assert(0 <= i && i < numKeys);
+      for (int j = i; j + 1 < numKeys; j++)
+         keys[j] = std::move(keys[j + 1]);
+      truncate(numKeys - 1);
+   }
+
+   /******************************************************
+    * B-TREE NODE :: TRUNCATE
+    * Destroy every key from index num on
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   void BTree<T, NodeBytes>::BNode::truncate(int num) noexcept
+   {
+      for (int j = num; j < numKeys; j++)
+         keys[j].~T();
+      numKeys = num;
+   }
+
+   /******************************************************
+    * B-TREE NODE :: LOWER BOUND
+    * Index of the first key that is not less than t. A node is
+    * a few cache lines, so comparing against every key at once
+    * (see simd.h) beats a binary search
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   int BTree<T, NodeBytes>::BNode::lowerBound(const T& t) const
+   {
+      return custom::lowerBound(keys, numKeys, t);
+   }
+
+   /******************************************************
+    * B-TREE NODE :: UPPER BOUND
+    * Index of the first key that is greater than t
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   int BTree<T, NodeBytes>::BNode::upperBound(const T& t) const
+   {
+      return custom::upperBound(keys, numKeys, t);
+   }
+
+   /******************************************************
+    * B-TREE NODE :: CHILD
+    * The i-th child of an internal node
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::BNode*& BTree<T, NodeBytes>::BNode::child(int i)
+   {
+      assert(!isLeaf);
+      return static_cast<BInternal*>(this)->children[i];
+   }
+
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::BNode* BTree<T, NodeBytes>::BNode::child(int i) const
+   {
+      assert(!isLeaf);
+      return static_cast<const BInternal*>(this)->children[i];
+   }
+
+   /******************************************************
+    * B-TREE NODE :: INDEX IN PARENT
+    * Which child of our parent are we?
+    ******************************************************/
+   template <typename T, size_t NodeBytes>
+   int BTree<T, NodeBytes>::BNode::indexInParent() const
+   {
+      assert(pParent);
+      int i = 0;
+      while (pParent->child(i) != this)
+         i++;
+      return i;
+   }
+
+   /**********************************************
+    * B-TREE NODE :: COPY
+    * Copy a subtree, hooking it to a new parent
+    *********************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::BNode* BTree<T, NodeBytes>::BNode::copy(const BNode* pSrc, BNode* pParent)
+   {
+      if (!pSrc)
+         return nullptr;
+
+      BNode* pDest = pSrc->isLeaf ? new BNode(true) : new BInternal;
+      pDest->pParent = pParent;
+      for (int i = 0; i < pSrc->numKeys; i++)
+         pDest->pushKey(pSrc->keys[i]);
+      if (!pSrc->isLeaf)
+         for (int i = 0; i <= pSrc->numKeys; i++)
+            pDest->child(i) = copy(pSrc->child(i), pDest);
+      return pDest;
+   }
+
+   /*****************************************************
+    * B-TREE NODE :: CLEAR
+    * Delete a subtree
+    ****************************************************/
+   template <typename T, size_t NodeBytes>
+   void BTree<T, NodeBytes>::BNode::clear(BNode* pNode) noexcept
+   {
+      if (!pNode)
+         return;
+
+      if (pNode->isLeaf)
+         delete pNode;
+      else
+      {
+         for (int i = 0; i <= pNode->numKeys; i++)
+            clear(pNode->child(i));
+         delete static_cast<BInternal*>(pNode);
+      }
+   }
+
+   /*************************************************
+    *************************************************
+    *************************************************
+    ****************** ITERATOR *********************
+    *************************************************
+    *************************************************
+    *************************************************/
+
+   /**************************************************
+    * B-TREE ITERATOR :: INCREMENT PREFIX
+    * advance by one
+    *************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator& BTree<T, NodeBytes>::iterator::operator ++()
+   {
+      // Don't increment if we're already at the end
+      if (!pNode)
+         return *this;
+
+      // Case 1: Internal node. The next key is the first of the subtree to the right
+      if (!pNode->isLeaf)
+      {
+         pNode = pNode->child(index + 1);
+         while (!pNode->isLeaf)
+            pNode = pNode->child(0);
+         index = 0;
+         return *this;
+      }
+
+      // Case 2: More keys in this leaf
+      if (++index < pNode->numKeys)
+         return *this;
+
+      // Case 3: Climb until we come up from a child that has a key after it
+      while (pNode->pParent)
+      {
+         int i = pNode->indexInParent();
+         pNode = pNode->pParent;
+         if (i < pNode->numKeys)
+         {
+            index = i;
+            return *this;
+         }
+      }
+      pNode = nullptr;
+      index = 0;
+      return *this;
+   }
+
+   /**************************************************
+    * B-TREE ITERATOR :: DECREMENT PREFIX
+    * back up by one
+    *************************************************/
+   template <typename T, size_t NodeBytes>
+   typename BTree<T, NodeBytes>::iterator& BTree<T, NodeBytes>::iterator::operator --()
+   {
+      // Don't decrement if we're already at the end
+      if (!pNode)
+         return *this;
+
+      // Case 1: Internal node. The previous key is the last of the subtree to the left
+      if (!pNode->isLeaf)
+      {
+         pNode = pNode->child(index);
+         while (!pNode->isLeaf)
+            pNode = pNode->child(pNode->numKeys);
+         index = pNode->numKeys - 1;
+         return *this;
+      }
+
+      // Case 2: More keys in this leaf
+      if (index > 0)
+      {
+         index--;
+         return *this;
+      }
+
+      // Case 3: Climb until we come up from a child that has a key before it
+      while (pNode->pParent)
+      {
+         int i = pNode->indexInParent();
+         pNode = pNode->pParent;
+         if (i > 0)
+         {
+            index = i - 1;
+            return *this;
+         }
+      }
+      pNode = nullptr;
+      index = 0;
+      return *this;
+   }
+
+} // namespace custom
@@ -0,0 +1,68 @@
+/***********************************************************************
+ * Header:
+ *    CACHE
+ * Summary:
+ *    Small helpers shared by the cache-friendly tree layouts:
+ *        prefetch            : Hint that an address will be read soon
+ *        countTrailingZeros  : Index of the lowest set bit
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cstddef>    // for size_t
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>   // for _BitScanForward64 and _mm_prefetch
+#endif // _MSC_VER
+
+namespace custom
+{
+
+   /******************************************************
+    * PREFETCH
+    * Ask the hardware to start loading the cache line holding p.
+    * This is only a hint: it never faults, even on a bad address
+    ******************************************************/
+   inline void prefetch(const void* p) noexcept
+   {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+      _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+      __builtin_prefetch(p, 0 /* read */, 3 /* keep in all levels */);
+#else
+      (void)p;
+#endif
+   }
+
+   /******************************************************
+    * COUNT TRAILING ZEROS
+    * Number of zero bits below the lowest set bit. x must not be 0
+    ******************************************************/
+   inline unsigned countTrailingZeros(size_t x) noexcept
+   {
+      assert(x != 0);
+#if defined(_MSC_VER) && defined(_WIN64)
+      unsigned long index;
+      _BitScanForward64(&index, x);
+      return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+      unsigned long index;
+      _BitScanForward(&index, static_cast<unsigned long>(x));
+      return static_cast<unsigned>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+      return static_cast<unsigned>(__builtin_ctzll(static_cast<unsigned long long>(x)));
+#else
+      unsigned count = 0;
+      while (!(x & 1))
+      {
+         x >>= 1;
+         count++;
+      }
+      return count;
+#endif
+   }
+
+} // namespace custom
@@ -0,0 +1,280 @@
+/***********************************************************************
+ * Header:
+ *    CONCURRENT
+ * Summary:
+ *    A tree that many threads can share. One reader-writer lock guards
+ *    the whole tree: any number of readers at once, or one writer.
+ *
+ *    Iterators hold raw node pointers that a writer on another thread
+ *    can free, so nothing here hands one out. Reads return a value, a
+ *    flag, or a copy instead. To do several things under one lock, pass
+ *    a function to read() or write(); it gets the tree itself and must
+ *    not let an iterator escape:
+ *        tree.write([&](custom::BST<int>& bst)
+ *        {
+ *           for (int i : batch)
+ *              bst.insert(i);
+ *        });
+ *
+ *    This will contain the class definition of:
+ *        concurrent::BST     : A tree guarded by a reader-writer lock
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <mutex>          // for std::unique_lock
+#include <shared_mutex>   // for std::shared_mutex and std::shared_lock
+#include <optional>       // for std::optional
+#include <vector>         // for std::vector
+#include <initializer_list>
+#include "bst.h"
+
+class TestConcurrent; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace concurrent
+   {
+
+   /*****************************************************************
+    * CONCURRENT BST
+    * A BST (or anything with its interface, such as BTree) behind
+    * a reader-writer lock
+    *****************************************************************/
+   template <typename T, typename Tree = custom::BST<T>>
+   class BST
+   {
+      friend class ::TestConcurrent; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      BST() {}
+      BST(const std::initializer_list<T>& il) : tree(il) {}
+      BST(const BST& rhs) = delete;
+      BST& operator =(const BST& rhs) = delete;
+
+      //
+      // Read: takes the lock shared
+      //
+
+      bool             contains(const T& t) const;
+      std::optional<T> find(const T& t) const;
+      std::optional<T> lower_bound(const T& t) const;
+      std::optional<T> upper_bound(const T& t) const;
+      std::vector<T>   snapshot() const;
+      Tree             copy() const;
+      size_t           size() const;
+      bool             empty() const { return size() == 0; }
+      template <class Function>
+      auto             read(Function f) const;
+
+      //
+      // Write: takes the lock exclusive
+      //
+
+      bool             insert(const T& t, bool keepUnique = false);
+      bool             insert(T&& t, bool keepUnique = false);
+      template <class InputIt>
+      size_t           insert(InputIt first, InputIt last, bool keepUnique = false);
+      size_t           erase(const T& t);
+      template <class Predicate>
+      size_t           erase_if(Predicate pred);
+      void             clear();
+      template <class Function>
+      auto             write(Function f);
+
+   private:
+      typedef std::shared_lock<std::shared_mutex> ReadLock;
+      typedef std::unique_lock<std::shared_mutex> WriteLock;
+
+      mutable std::shared_mutex mutex;  // readers share, writers own
+      Tree tree;                        // guarded by mutex
+   };
+
+   /****************************************************
+    * CONCURRENT BST :: CONTAINS
+    * Is there an element equivalent to t?
+    ****************************************************/
+   template <typename T, typename Tree>
+   bool BST<T, Tree>::contains(const T& t) const
+   {
+      ReadLock lock(mutex);
+      return tree.find(t) != tree.end();
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: FIND
+    * A copy of the element equivalent to t, if there is one
+    ****************************************************/
+   template <typename T, typename Tree>
+   std::optional<T> BST<T, Tree>::find(const T& t) const
+   {
+      ReadLock lock(mutex);
+      auto it = tree.find(t);
+      if (it == tree.end())
+         return std::nullopt;
+      return *it;
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: LOWER BOUND
+    * A copy of the first element not less than t
+    ****************************************************/
+   template <typename T, typename Tree>
+   std::optional<T> BST<T, Tree>::lower_bound(const T& t) const
+   {
+      ReadLock lock(mutex);
+      auto it = tree.lower_bound(t);
+      if (it == tree.end())
+         return std::nullopt;
+      return *it;
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: UPPER BOUND
+    * A copy of the first element greater than t
+    ****************************************************/
+   template <typename T, typename Tree>
+   std::optional<T> BST<T, Tree>::upper_bound(const T& t) const
+   {
+      ReadLock lock(mutex);
+      auto it = tree.upper_bound(t);
+      if (it == tree.end())
+         return std::nullopt;
+      return *it;
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: SNAPSHOT
+    * Every element, in order
+    ****************************************************/
+   template <typename T, typename Tree>
+   std::vector<T> BST<T, Tree>::snapshot() const
+   {
+      ReadLock lock(mutex);
+      std::vector<T> elements;
+      elements.reserve(tree.size());
+      for (auto it = tree.begin(); it != tree.end(); ++it)
+         elements.push_back(*it);
+      return elements;
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: COPY
+    * A private copy of the tree that is safe to iterate
+    ****************************************************/
+   template <typename T, typename Tree>
+   Tree BST<T, Tree>::copy() const
+   {
+      ReadLock lock(mutex);
+      return tree;
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: SIZE
+    ****************************************************/
+   template <typename T, typename Tree>
+   size_t BST<T, Tree>::size() const
+   {
+      ReadLock lock(mutex);
+      return tree.size();
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: READ
+    * Call f(const Tree&) once under one shared lock and
+    * return what it returns
+    ****************************************************/
+   template <typename T, typename Tree>
+   template <class Function>
+   auto BST<T, Tree>::read(Function f) const
+   {
+      ReadLock lock(mutex);
+      return f(static_cast<const Tree&>(tree));
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: INSERT
+    * Returns false if keepUnique turned the element away
+    ****************************************************/
+   template <typename T, typename Tree>
+   bool BST<T, Tree>::insert(const T& t, bool keepUnique)
+   {
+      WriteLock lock(mutex);
+      return tree.insert(t, keepUnique).second;
+   }
+
+   template <typename T, typename Tree>
+   bool BST<T, Tree>::insert(T&& t, bool keepUnique)
+   {
+      WriteLock lock(mutex);
+      return tree.insert(std::move(t), keepUnique).second;
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: INSERT RANGE
+    * Insert a batch under one lock. Returns how many went in
+    ****************************************************/
+   template <typename T, typename Tree>
+   template <class InputIt>
+   size_t BST<T, Tree>::insert(InputIt first, InputIt last, bool keepUnique)
+   {
+      WriteLock lock(mutex);
+      size_t num = 0;
+      for (; first != last; ++first)
+         if (tree.insert(*first, keepUnique).second)
+            num++;
+      return num;
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: ERASE
+    * Remove every element equivalent to t
+    ****************************************************/
+   template <typename T, typename Tree>
+   size_t BST<T, Tree>::erase(const T& t)
+   {
+      WriteLock lock(mutex);
+      return tree.erase(t);
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: ERASE IF
+    ****************************************************/
+   template <typename T, typename Tree>
+   template <class Predicate>
+   size_t BST<T, Tree>::erase_if(Predicate pred)
+   {
+      WriteLock lock(mutex);
+      return tree.erase_if(pred);
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: CLEAR
+    ****************************************************/
+   template <typename T, typename Tree>
+   void BST<T, Tree>::clear()
+   {
+      WriteLock lock(mutex);
+      tree.clear();
+   }
+
+   /****************************************************
+    * CONCURRENT BST :: WRITE
+    * Call f(Tree&) once under one exclusive lock and
+    * return what it returns
+    ****************************************************/
+   template <typename T, typename Tree>
+   template <class Function>
+   auto BST<T, Tree>::write(Function f)
+   {
+      WriteLock lock(mutex);
+      return f(tree);
+   }
+
+   } // namespace concurrent
+} // namespace custom
@@ -0,0 +1,267 @@
+/***********************************************************************
+ * Header:
+ *    CORO
+ * Summary:
+ *    Interleaved lookups with C++20 coroutines, to hide the latency of
+ *    cache misses when the tree is far larger than the cache.
+ *
+ *    A plain find() stalls on every node it reads. BST::co_find() reads
+ *    a node, picks the child, asks the hardware to start loading it,
+ *    and suspends. A scheduler that keeps several lookups in flight
+ *    resumes the others meanwhile, so by the time a lookup comes around
+ *    again its node has arrived and the misses of all of them overlap.
+ *
+ *    Everything here needs coroutine support from the compiler, and is
+ *    left out without it.
+ *
+ *    This will contain the definitions of:
+ *        BST::co_find()        : A find() that suspends at every node
+ *        coro::Lookup          : The handle of one suspended lookup
+ *        coro::interleave()    : Run many lookups, a few at a time
+ *        coro::findAll()       : Find many keys, results in order
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef __cpp_impl_coroutine
+
+#include <coroutine>  // for std::coroutine_handle and std::suspend_always
+#include <exception>  // for std::exception_ptr
+#include <new>        // for ::operator new
+#include <utility>    // for std::exchange
+#include <vector>     // for std::vector
+#include "bst.h"
+#include "cache.h"    // for prefetch
+
+class TestCoro; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace coro
+   {
+
+   /*****************************************************************
+    * LOOKUP
+    * Owns one suspended co_find(). resume() takes it one node
+    * further; once done(), get() is what find() would return
+    *****************************************************************/
+   template <typename T>
+   class Lookup
+   {
+      friend class ::TestCoro; // give unit tests access to private members
+   public:
+      struct promise_type;
+      typedef typename BST<T>::iterator iterator;
+
+      Lookup() : handle(nullptr) {}
+      Lookup(Lookup&& rhs) noexcept : handle(std::exchange(rhs.handle, nullptr)) {}
+      Lookup& operator =(Lookup&& rhs) noexcept
+      {
+         if (this != &rhs)
+         {
+            if (handle)
+               handle.destroy();
+            handle = std::exchange(rhs.handle, nullptr);
+         }
+         return *this;
+      }
+      Lookup(const Lookup& rhs) = delete;
+      Lookup& operator =(const Lookup& rhs) = delete;
+      ~Lookup()
+      {
+         if (handle)
+            handle.destroy();
+      }
+
+      explicit operator bool() const { return handle != nullptr; }
+      bool done() const             { return handle.done(); }
+      void resume()                 { handle.resume(); }
+      iterator get() const
+      {
+         if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+         return handle.promise().result;
+      }
+
+      // run to the end without interleaving
+      iterator wait()
+      {
+         while (!done())
+            resume();
+         return get();
+      }
+
+   private:
+      explicit Lookup(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+      std::coroutine_handle<promise_type> handle;
+   };
+
+   /*****************************************************************
+    * LOOKUP :: PROMISE TYPE
+    * Starts suspended so the scheduler decides when it runs, and
+    * stays suspended at the end so the result can be read. Every
+    * frame of one thread is the same size, so freed frames are
+    * kept for the next lookup rather than going back to the heap
+    *****************************************************************/
+   template <typename T>
+   struct Lookup<T>::promise_type
+   {
+      iterator result;
+      std::exception_ptr error;
+
+      Lookup get_return_object()
+      {
+         return Lookup(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      std::suspend_always final_suspend()   noexcept { return {}; }
+      void return_value(iterator it)                  { result = it; }
+      void unhandled_exception()                      { error = std::current_exception(); }
+
+      static void* operator new(size_t size)
+      {
+         Spare& spare = spareFrames();
+         if (size == spare.size && !spare.frames.empty())
+         {
+            void* p = spare.frames.back();
+            spare.frames.pop_back();
+            return p;
+         }
+         return ::operator new(size);
+      }
+      static void operator delete(void* p, size_t size)
+      {
+         Spare& spare = spareFrames();
+         if (spare.size == 0)
+            spare.size = size;
+         if (size == spare.size && spare.frames.size() < maxSpare)
+            spare.frames.push_back(p);
+         else
+            ::operator delete(p);
+      }
+
+   private:
+      static constexpr size_t maxSpare = 64;
+      struct Spare
+      {
+         ~Spare()
+         {
+            for (void* p : frames)
+               ::operator delete(p);
+         }
+         size_t size = 0;             // the size of the frames we keep
+         std::vector<void*> frames;   // freed frames ready for reuse
+      };
+      static Spare& spareFrames()
+      {
+         thread_local Spare spare;
+         return spare;
+      }
+   };
+
+   /*****************************************************************
+    * INTERLEAVE
+    * Look up every key in [first, last), keeping width lookups in
+    * flight and resuming them round robin. Call f(i, it) as each
+    * finishes, where i is the key's position in the range and it
+    * is what find() would return. Lookups finish out of order.
+    * The keys are copied, but the tree must not change meanwhile
+    *****************************************************************/
+   template <typename T, class Iterator, class Function>
+   void interleave(const BST<T>& bst, Iterator first, Iterator last, Function f, size_t width = 16)
+   {
+      struct Slot
+      {
+         Lookup<T> lookup;
+         size_t i;
+      };
+      std::vector<Slot> slots(width > 0 ? width : 1);
+      size_t iNext = 0;
+      size_t numActive = 0;
+
+      for (Slot& slot : slots)
+         if (first != last)
+         {
+            slot.lookup = bst.co_find(*first++);
+            slot.i = iNext++;
+            numActive++;
+         }
+
+      while (numActive)
+         for (Slot& slot : slots)
+         {
+            if (!slot.lookup)
+               continue;
+            slot.lookup.resume();
+            if (!slot.lookup.done())
+               continue;
+
+            f(slot.i, slot.lookup.get());
+            if (first != last)
+            {
+               slot.lookup = bst.co_find(*first++);
+               slot.i = iNext++;
+            }
+            else
+            {
+               slot.lookup = Lookup<T>();
+               numActive--;
+            }
+         }
+   }
+
+   /*****************************************************************
+    * FIND ALL
+    * find() of every key in [first, last), in the keys' order
+    *****************************************************************/
+   template <typename T, class Iterator>
+   std::vector<typename BST<T>::iterator> findAll(const BST<T>& bst, Iterator first, Iterator last,
+                                                  size_t width = 16)
+   {
+      std::vector<typename BST<T>::iterator> results;
+      interleave(bst, first, last, [&results](size_t i, typename BST<T>::iterator it)
+         {
+            if (i >= results.size())
+               results.resize(i + 1);
+            results[i] = it;
+         }, width);
+      return results;
+   }
+
+   } // namespace coro
+
+   /****************************************************
+    * BST :: CO FIND
+    * find() that suspends each time it steps to a child,
+    * right after asking for that child to be loaded. It
+    * keeps its own copy of the key; the tree must outlive
+    * it and not change while it runs
+    ****************************************************/
+   template <typename T>
+   coro::Lookup<T> BST<T>::co_find(T t) const
+   {
+      BNode* p = root;
+      while (p)
+      {
+         if (t == p->data)
+            co_return iterator(p, this);
+         else if (t < p->data)
+            p = p->pLeft;
+         else
+            p = p->pRight;
+
+         if (p)
+         {
+            prefetch(p);
+            co_await std::suspend_always();
+         }
+      }
+      co_return end();
+   }
+
+} // namespace custom
+
+#endif // __cpp_impl_coroutine
@@ -0,0 +1,320 @@
+/***********************************************************************
+ * Header:
+ *    COUNTERS
+ * Summary:
+ *    What the trees of this process have been doing, counted as they
+ *    do it, for a metrics system to read. bst.h counts only when
+ *    BST_COUNTERS is defined before it is included; otherwise every
+ *    counting statement compiles away and nothing here is used.
+ *
+ *    Counted are node allocations and frees, comparisons made while
+ *    descending in find(), lower_bound(), upper_bound() and insert(),
+ *    every case of balance() and of the fixup() after an erase, the
+ *    rotations and recolors those cases do, and how deep each find()
+ *    and insert() went, as a total and as a histogram.
+ *
+ *    Each thread counts into a block of its own, so counting never
+ *    contends: an increment is a plain load and store. snapshot() adds
+ *    the blocks of the live threads to what finished threads left.
+ *    Numbers read while other threads are counting are a moment old.
+ *
+ *    This will contain the definitions of:
+ *        counters::Counts      : A snapshot of every counter
+ *        counters::Local       : The counters of one thread
+ *        counters::local()     : The calling thread's counters
+ *        counters::snapshot()  : Every thread's counters, added up
+ *        counters::reset()     : Start every counter over from zero
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <algorithm>  // for std::find
+#include <atomic>     // for std::atomic
+#include <cstdint>    // for uint64_t
+#include <mutex>      // for std::mutex and std::lock_guard
+#include <string>     // for std::string and std::to_string
+#include <vector>     // for std::vector
+
+namespace custom
+{
+   namespace counters
+   {
+
+   // the cases of BST::BNode::balance(), then of BST::fixup()
+   enum Case { case1, case2, case3, case4a, case4b, case4c, case4d,
+               erase1, erase2, erase3, erase4, numCases };
+
+   // depths at or beyond this share the last bucket of a histogram
+   inline constexpr size_t maxDepth = 64;
+
+   /*****************************************************************
+    * COUNTS
+    * Every counter at one moment, as plain numbers
+    *****************************************************************/
+   struct Counts
+   {
+      uint64_t allocations = 0;            // nodes made
+      uint64_t frees = 0;                  // nodes deleted
+      uint64_t comparisons = 0;            // < and == while descending
+      uint64_t rotations = 0;              // single rotations; 4c and 4d do two
+      uint64_t recolors = 0;               // nodes whose color balance() or fixup() set
+      uint64_t cases[numCases] = {};       // times balance() or fixup() took each case
+      uint64_t finds = 0;                  // calls to find()
+      uint64_t findDepth = 0;              // nodes all of them visited
+      uint64_t inserts = 0;                // nodes insert() added
+      uint64_t insertDepth = 0;            // depth of each new node, added up
+      uint64_t findDepths[maxDepth] = {};  // finds that visited i nodes
+      uint64_t insertDepths[maxDepth] = {};// new nodes at depth i
+
+      // hand each counter to f(name, value), to export them. Each
+      // histogram bucket is named for its histogram and depth, as in
+      // "findDepth.3"; the last bucket holds every depth beyond it too
+      template <class Function>
+      void forEach(Function f) const
+      {
+         static const char* const caseNames[numCases] =
+            { "case1", "case2", "case3", "case4a", "case4b", "case4c", "case4d",
+              "erase1", "erase2", "erase3", "erase4" };
+         auto bucketNames = [](const char* prefix)
+         {
+            std::vector<std::string> names;
+            for (size_t i = 0; i < maxDepth; i++)
+               names.push_back(std::string(prefix) + "." + std::to_string(i));
+            return names;
+         };
+         static const std::vector<std::string> findNames = bucketNames("findDepth");
+         static const std::vector<std::string> insertNames = bucketNames("insertDepth");
+         f("allocations", allocations);
+         f("frees", frees);
+         f("comparisons", comparisons);
+         f("rotations", rotations);
+         f("recolors", recolors);
+         for (size_t i = 0; i < numCases; i++)
+            f(caseNames[i], cases[i]);
+         f("finds", finds);
+         f("findDepth", findDepth);
+         f("inserts", inserts);
+         f("insertDepth", insertDepth);
+         for (size_t i = 0; i < maxDepth; i++)
+            f(findNames[i].c_str(), findDepths[i]);
+         for (size_t i = 0; i < maxDepth; i++)
+            f(insertNames[i].c_str(), insertDepths[i]);
+      }
+   };
+
+   /*****************************************************************
+    * LOCAL
+    * The counters of one thread. Only that thread writes them, so
+    * an increment needs no read-modify-write; others may read
+    *****************************************************************/
+   class Local
+   {
+   public:
+      Local();
+      ~Local();
+      Local(const Local& rhs) = delete;
+      Local& operator =(const Local& rhs) = delete;
+
+      static void add(std::atomic<uint64_t>& counter, uint64_t n = 1)
+      {
+         counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      }
+      static size_t bucket(size_t depth) { return depth < maxDepth ? depth : maxDepth - 1; }
+
+      void allocated() { add(allocations); }
+      void freed()     { add(frees); }
+      void compared(size_t numComparisons) { add(comparisons, numComparisons); }
+      void find(size_t depth, size_t numComparisons)
+      {
+         add(finds);
+         add(findDepth, depth);
+         add(findDepths[bucket(depth)]);
+         add(comparisons, numComparisons);
+      }
+      void insert(size_t depth, size_t numComparisons)
+      {
+         add(inserts);
+         add(insertDepth, depth);
+         add(insertDepths[bucket(depth)]);
+         add(comparisons, numComparisons);
+      }
+      void balance(Case c, size_t numRotations, size_t numRecolors)
+      {
+         add(cases[c]);
+         add(rotations, numRotations);
+         add(recolors, numRecolors);
+      }
+
+      Counts read() const;
+      void clear();
+
+      std::atomic<uint64_t> allocations{ 0 };
+      std::atomic<uint64_t> frees{ 0 };
+      std::atomic<uint64_t> comparisons{ 0 };
+      std::atomic<uint64_t> rotations{ 0 };
+      std::atomic<uint64_t> recolors{ 0 };
+      std::atomic<uint64_t> cases[numCases] = {};
+      std::atomic<uint64_t> finds{ 0 };
+      std::atomic<uint64_t> findDepth{ 0 };
+      std::atomic<uint64_t> inserts{ 0 };
+      std::atomic<uint64_t> insertDepth{ 0 };
+      std::atomic<uint64_t> findDepths[maxDepth] = {};
+      std::atomic<uint64_t> insertDepths[maxDepth] = {};
+   };
+
+   /*****************************************************************
+    * REGISTRY
+    * The counters of every live thread, and the sum of those of the
+    * threads that have finished
+    *****************************************************************/
+   struct Registry
+   {
+      std::mutex mutex;
+      std::vector<Local*> live;
+      Counts retired;
+   };
+
+   // never destroyed, so threads that finish while the process exits
+   // can still fold their counters in
+   inline Registry& registry()
+   {
+      static Registry* pRegistry = new Registry;
+      return *pRegistry;
+   }
+
+   // add rhs into lhs, counter by counter
+   inline void accumulate(Counts& lhs, const Counts& rhs)
+   {
+      lhs.allocations += rhs.allocations;
+      lhs.frees       += rhs.frees;
+      lhs.comparisons += rhs.comparisons;
+      lhs.rotations   += rhs.rotations;
+      lhs.recolors    += rhs.recolors;
+      for (size_t i = 0; i < numCases; i++)
+         lhs.cases[i] += rhs.cases[i];
+      lhs.finds       += rhs.finds;
+      lhs.findDepth   += rhs.findDepth;
+      lhs.inserts     += rhs.inserts;
+      lhs.insertDepth += rhs.insertDepth;
+      for (size_t i = 0; i < maxDepth; i++)
+      {
+         lhs.findDepths[i]   += rhs.findDepths[i];
+         lhs.insertDepths[i] += rhs.insertDepths[i];
+      }
+   }
+
+   /*********************************************
+    * LOCAL :: CONSTRUCTOR and DESTRUCTOR
+    * Join the registry; on the way out, leave what we
+    * counted behind in it
+    ********************************************/
+   inline Local::Local()
+   {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.live.push_back(this);
+   }
+
+   inline Local::~Local()
+   {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      accumulate(r.retired, read());
+      r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+   }
+
+   /*********************************************
+    * LOCAL :: READ
+    ********************************************/
+   inline Counts Local::read() const
+   {
+      auto get = [](const std::atomic<uint64_t>& counter)
+      {
+         return counter.load(std::memory_order_relaxed);
+      };
+      Counts counts;
+      counts.allocations = get(allocations);
+      counts.frees       = get(frees);
+      counts.comparisons = get(comparisons);
+      counts.rotations   = get(rotations);
+      counts.recolors    = get(recolors);
+      for (size_t i = 0; i < numCases; i++)
+         counts.cases[i] = get(cases[i]);
+      counts.finds       = get(finds);
+      counts.findDepth   = get(findDepth);
+      counts.inserts     = get(inserts);
+      counts.insertDepth = get(insertDepth);
+      for (size_t i = 0; i < maxDepth; i++)
+      {
+         counts.findDepths[i]   = get(findDepths[i]);
+         counts.insertDepths[i] = get(insertDepths[i]);
+      }
+      return counts;
+   }
+
+   /*********************************************
+    * LOCAL :: CLEAR
+    ********************************************/
+   inline void Local::clear()
+   {
+      auto zero = [](std::atomic<uint64_t>& counter) { counter.store(0, std::memory_order_relaxed); };
+      zero(allocations);
+      zero(frees);
+      zero(comparisons);
+      zero(rotations);
+      zero(recolors);
+      for (std::atomic<uint64_t>& counter : cases)
+         zero(counter);
+      zero(finds);
+      zero(findDepth);
+      zero(inserts);
+      zero(insertDepth);
+      for (size_t i = 0; i < maxDepth; i++)
+      {
+         zero(findDepths[i]);
+         zero(insertDepths[i]);
+      }
+   }
+
+   /*****************************************************************
+    * LOCAL
+    * The calling thread's counters, made on first use
+    *****************************************************************/
+   inline Local& local()
+   {
+      thread_local Local counters;
+      return counters;
+   }
+
+   /*****************************************************************
+    * SNAPSHOT
+    * Every thread's counters, added up
+    *****************************************************************/
+   inline Counts snapshot()
+   {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      Counts counts = r.retired;
+      for (const Local* pLocal : r.live)
+         accumulate(counts, pLocal->read());
+      return counts;
+   }
+
+   /*****************************************************************
+    * RESET
+    * Start over from zero. A thread counting at that moment may
+    * keep an increment or two from before
+    *****************************************************************/
+   inline void reset()
+   {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.retired = Counts();
+      for (Local* pLocal : r.live)
+         pLocal->clear();
+   }
+
+   } // namespace counters
+} // namespace custom
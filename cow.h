@@ -0,0 +1,288 @@
+/***********************************************************************
+ * Header:
+ *    COW
+ * Summary:
+ *    A tree with the BST interface whose copies are O(1). A copy shares
+ *    every node with the original; when either one writes, only the
+ *    nodes on the path to the change are cloned, O(log n) of them, and
+ *    the rest stay shared. A copy that is only ever read costs nothing.
+ *
+ *    BST cannot share nodes this way: each node knows its one parent,
+ *    and BST's iterators climb through that pointer. CowBST is built on
+ *    PersistentBST instead, whose nodes have no parent and are never
+ *    changed once built. Every write makes a new version of this tree;
+ *    copies keep the version they were made from.
+ *
+ *    As with BTree, a write invalidates every iterator into the tree it
+ *    changed (but not into its copies).
+ *
+ *    This will contain the class definition of:
+ *        CowBST              : A copy-on-write tree with the BST interface
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <utility>        // for std::pair and std::swap
+#include <vector>         // for std::vector
+#include <initializer_list>
+#include "persistent.h"   // for the shared nodes
+
+class TestCow; // forward declaration for unit tests
+
+namespace custom
+{
+
+   /*****************************************************************
+    * COPY-ON-WRITE BST
+    * A mutable tree over persistent versions
+    *****************************************************************/
+   template <typename T>
+   class CowBST
+   {
+      friend class ::TestCow; // give unit tests access to private members
+   public:
+      //
+      // Construct. Copies and copy-assignment are O(1)
+      //
+
+      CowBST() {}
+      CowBST(const std::initializer_list<T>& il) : version(il) {}
+      CowBST(const CowBST& rhs) = default;
+      CowBST(CowBST&& rhs) : CowBST() { swap(rhs); }
+      ~CowBST() {}
+
+      //
+      // Assign
+      //
+
+      CowBST& operator =(const CowBST& rhs) = default;
+      CowBST& operator =(CowBST&& rhs)
+      {
+         clear();
+         swap(rhs);
+         return *this;
+      }
+      CowBST& operator =(const std::initializer_list<T>& il)
+      {
+         version = PersistentBST<T>(il);
+         return *this;
+      }
+      void swap(CowBST& rhs) { std::swap(version, rhs.version); }
+
+      //
+      // Iterator
+      //
+
+      typedef typename PersistentBST<T>::iterator iterator;
+      iterator begin() const { return version.begin(); }
+      iterator end()   const { return version.end(); }
+
+      //
+      // Access
+      //
+
+      iterator find(const T& t) const        { return version.find(t); }
+      iterator lower_bound(const T& t) const { return version.lower_bound(t); }
+      iterator upper_bound(const T& t) const { return version.upper_bound(t); }
+
+      //
+      // Insert
+      //
+
+      std::pair<iterator, bool> insert(const T& t, bool keepUnique = false);
+
+      //
+      // Remove
+      //
+
+      iterator erase(iterator& it);
+      iterator erase(iterator first, iterator last);
+      size_t   erase(const T& t);
+      template <class Predicate>
+      size_t   erase_if(Predicate pred);
+      void     clear() noexcept { version = PersistentBST<T>(); }
+
+      //
+      // Status
+      //
+
+      bool   empty() const noexcept { return version.empty(); }
+      size_t size()  const noexcept { return version.size(); }
+
+   private:
+      PersistentBST<T> version;   // the current version, perhaps shared with copies
+   };
+
+   /*****************************************************
+    * COW BST :: INSERT
+    * The new element goes after any equal ones, so it is
+    * the one just before the upper bound
+    ****************************************************/
+   template <typename T>
+   std::pair<typename CowBST<T>::iterator, bool> CowBST<T>::insert(const T& t, bool keepUnique)
+   {
+      if (keepUnique)
+      {
+         iterator it = find(t);
+         if (it != end())
+            return { it, false };  // Don't insert duplicates if keepUnique.
+      }
+
+      version = version.insert(t);
+      iterator it = upper_bound(t);
+      if (it != end())
+         return { --it, true };
+
+      // nothing is greater, so the new element is the right-most
+      for (auto* p = version.root.get(); p; p = p->pRight.get())
+         it.path.push_back(p);
+      return { it, true };
+   }
+
+   /*************************************************
+    * COW BST :: ERASE
+    * Remove the element at it and return the one after it.
+    * The next element is found again in the new version by
+    * its value and its place among any equal elements
+    ************************************************/
+   template <typename T>
+   typename CowBST<T>::iterator CowBST<T>::erase(iterator& it)
+   {
+      if (it == end())
+         return end();
+
+      iterator itNext = it;
+      ++itNext;
+      if (itNext == end())
+      {
+         version = version.erase(it);
+         return end();
+      }
+
+      T next = *itNext;
+      size_t numEqualBefore = 0;
+      if (!(*it < next))
+         for (iterator itEqual = lower_bound(*it); itEqual != it; ++itEqual)
+            numEqualBefore++;
+
+      version = version.erase(it);
+
+      iterator itReturn = lower_bound(next);
+      for (size_t i = 0; i < numEqualBefore; i++)
+         ++itReturn;
+      return itReturn;
+   }
+
+   /*************************************************
+    * COW BST :: ERASE RANGE
+    * Remove every element in [first, last) and return the
+    * one that was at last. The old version is split just
+    * before first and just after last, and what comes before
+    * is joined to last and what comes after. Only the nodes on
+    * those two paths are copied, O(k + log n) in all, and the
+    * subtrees hanging off them stay shared. last is found
+    * again by its value and its place among the equal
+    * survivors before it
+    ************************************************/
+   template <typename T>
+   typename CowBST<T>::iterator CowBST<T>::erase(iterator first, iterator last)
+   {
+      if (first == last)
+         return last;
+
+      size_t num = 0;
+      for (iterator it = first; it != last; ++it)
+         num++;
+
+      typedef typename PersistentBST<T>::Ptr Ptr;
+      size_t height = PersistentBST<T>::blackHeight(version.root);
+      Ptr pBefore;
+      Ptr pRest;
+      size_t hBefore;
+      size_t hRest;
+      PersistentBST<T>::split(version.root, height, first.path, 0, pBefore, hBefore, pRest, hRest);
+      if (last == end())
+      {
+         version = PersistentBST<T>(pBefore, size() - num);
+         return end();
+      }
+
+      T next = *last;
+      size_t numEqualBefore = 0;
+      iterator itBegin = begin();
+      for (iterator it = first; it != itBegin && !(*--it < next); )
+         numEqualBefore++;
+
+      Ptr pAfter;
+      size_t hAfter;
+      PersistentBST<T>::split(version.root, height, last.path, 0, pRest, hRest, pAfter, hAfter);
+      size_t hNew;
+      Ptr pRoot = PersistentBST<T>::join(pBefore, hBefore, next, pAfter, hAfter, hNew);
+      version = PersistentBST<T>(pRoot, size() - num);
+
+      iterator itReturn = lower_bound(next);
+      for (size_t i = 0; i < numEqualBefore; i++)
+         ++itReturn;
+      return itReturn;
+   }
+
+   /*************************************************
+    * COW BST :: ERASE KEY
+    * Remove every element equivalent to t
+    ************************************************/
+   template <typename T>
+   size_t CowBST<T>::erase(const T& t)
+   {
+      size_t before = size();
+      version = version.erase(t);
+      return before - size();
+   }
+
+   /*************************************************
+    * COW BST :: ERASE IF
+    * Remove every element for which pred is true. pred is
+    * asked of every element in one in-order pass first. A
+    * few doomed elements (fewer than a quarter) are cut out of
+    * the old version with joins, so only the paths to them are
+    * copied and the rest stays shared. More than that, and one
+    * new version is built from the survivors in O(n)
+    ************************************************/
+   template <typename T>
+   template <class Predicate>
+   size_t CowBST<T>::erase_if(Predicate pred)
+   {
+      std::vector<bool> doomed;
+      doomed.reserve(size());
+      size_t numErased = 0;
+      for (iterator it = begin(); it != end(); ++it)
+      {
+         doomed.push_back(pred(*it));
+         numErased += doomed.back() ? 1 : 0;
+      }
+      if (numErased == 0)
+         return 0;
+
+      if (numErased * 4 < size())
+      {
+         size_t i = 0;
+         auto isDoomed = [&doomed, &i](const T&) { return bool(doomed[i++]); };
+         size_t height;
+         auto pRoot = PersistentBST<T>::filter(version.root, PersistentBST<T>::blackHeight(version.root),
+                                               isDoomed, height);
+         version = PersistentBST<T>(PersistentBST<T>::blacken(pRoot, height), size() - numErased);
+         return numErased;
+      }
+
+      std::vector<const T*> survivors;
+      survivors.reserve(size() - numErased);
+      size_t i = 0;
+      for (iterator it = begin(); it != end(); ++it)
+         if (!doomed[i++])
+            survivors.push_back(&*it);
+      version = PersistentBST<T>::build(survivors);
+      return numErased;
+   }
+
+} // namespace custom
@@ -0,0 +1,671 @@
+/***********************************************************************
+ * Header:
+ *    DURABLE
+ * Summary:
+ *    A BST that survives a crash. Every insert and erase is appended to
+ *    a write-ahead log before it counts as done, and now and then the
+ *    whole tree is saved as a checkpoint so the log can start over.
+ *    Opening the tree loads the latest checkpoint and replays the log.
+ *
+ *    Two files sit next to each other on local disk:
+ *        path.ckpt   generation (uint64), then what BST::serialize()
+ *                    writes
+ *        path.wal    magic "BSTW", version (uint32), generation
+ *                    (uint64), then records:
+ *                        length   uint32   bytes of the element
+ *                        checksum uint32   FNV-1a of op and element
+ *                        op       uint8    insert or erase
+ *                        element  length bytes, written by the codec
+ *    A log only applies to the checkpoint of the same generation. A
+ *    checkpoint is written beside the old one and renamed over it, and
+ *    a new, empty log of the next generation replaces the old log the
+ *    same way; a crash between the two leaves a log from an older
+ *    generation, which is ignored rather than replayed twice. Replay
+ *    stops at the first record that is short or fails its checksum,
+ *    and the log is cut back to there: that is a write the crash tore.
+ *
+ *    Records wait in memory until a commit writes and syncs them all
+ *    at once, so one fsync pays for many operations. A commit happens
+ *    every groupSize records, or when a thread calls sync(). Threads
+ *    that sync while a commit is on its way to disk wait for it and
+ *    then one of them commits everything that arrived meanwhile.
+ *
+ *    This will contain the definitions of:
+ *        durable::LogFile        : An append-only file that can be synced
+ *        DurableBST              : A BST with a write-ahead log
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <condition_variable> // for std::condition_variable
+#include <cstdint>     // for uint8_t, uint32_t and uint64_t
+#include <cstdio>      // for std::remove
+#include <cstring>     // for std::memcpy and std::memcmp
+#include <fstream>     // for std::ifstream and std::ofstream
+#include <iterator>    // for std::istreambuf_iterator
+#include <mutex>       // for std::mutex and std::unique_lock
+#include <sstream>     // for std::ostringstream and std::istringstream
+#include <string>      // for std::string
+#include <type_traits> // for std::is_same_v
+#include "bst.h"
+#include "serialize.h" // for BitwiseCodec and the checkpoint format
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#include <windows.h>   // for CreateFile, WriteFile and FlushFileBuffers
+#else // !_WIN32
+#include <fcntl.h>     // for open
+#include <unistd.h>    // for write, fsync, ftruncate and close
+#endif // !_WIN32
+
+class TestDurable; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace durable
+   {
+
+   /*****************************************************************
+    * LOG FILE
+    * A file opened for appending whose writes can be forced to disk
+    *****************************************************************/
+   class LogFile
+   {
+   public:
+#ifdef _WIN32
+      LogFile() : hFile(INVALID_HANDLE_VALUE) {}
+#else // !_WIN32
+      LogFile() : fd(-1) {}
+#endif // !_WIN32
+      LogFile(const LogFile& rhs) = delete;
+      LogFile& operator =(const LogFile& rhs) = delete;
+      ~LogFile() { close(); }
+
+      // open or create the file, cut it to size bytes, and append after that
+      bool open(const std::string& path, uint64_t size)
+      {
+         close();
+#ifdef _WIN32
+         hFile = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+         LARGE_INTEGER offset;
+         offset.QuadPart = (LONGLONG)size;
+         if (hFile == INVALID_HANDLE_VALUE ||
+             !SetFilePointerEx(hFile, offset, nullptr, FILE_BEGIN) || !SetEndOfFile(hFile))
+#else // !_WIN32
+         fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+         if (fd < 0 || ftruncate(fd, (off_t)size) != 0 || lseek(fd, 0, SEEK_END) < 0)
+#endif // !_WIN32
+         {
+            close();
+            return false;
+         }
+         return true;
+      }
+
+      bool write(const char* p, size_t num)
+      {
+         while (num > 0)
+         {
+#ifdef _WIN32
+            DWORD numWritten;
+            DWORD numAsk = num > 0x40000000 ? 0x40000000 : (DWORD)num;
+            if (!WriteFile(hFile, p, numAsk, &numWritten, nullptr))
+               return false;
+#else // !_WIN32
+            ssize_t numWritten = ::write(fd, p, num);
+            if (numWritten < 0)
+               return false;
+#endif // !_WIN32
+            p += numWritten;
+            num -= (size_t)numWritten;
+         }
+         return true;
+      }
+
+      // back only once the bytes written so far are on the disk
+      bool sync()
+      {
+#ifdef _WIN32
+         return FlushFileBuffers(hFile) != 0;
+#else // !_WIN32
+         return fsync(fd) == 0;
+#endif // !_WIN32
+      }
+
+      void close() noexcept
+      {
+#ifdef _WIN32
+         if (hFile != INVALID_HANDLE_VALUE)
+            CloseHandle(hFile);
+         hFile = INVALID_HANDLE_VALUE;
+#else // !_WIN32
+         if (fd >= 0)
+            ::close(fd);
+         fd = -1;
+#endif // !_WIN32
+      }
+
+      bool isOpen() const noexcept
+      {
+#ifdef _WIN32
+         return hFile != INVALID_HANDLE_VALUE;
+#else // !_WIN32
+         return fd >= 0;
+#endif // !_WIN32
+      }
+
+   private:
+#ifdef _WIN32
+      HANDLE hFile;
+#else // !_WIN32
+      int fd;
+#endif // !_WIN32
+   };
+
+   /*****************************************************************
+    * SYNC FILE
+    * Force a file that was written some other way onto the disk
+    *****************************************************************/
+   inline bool syncFile(const std::string& path)
+   {
+      std::ifstream in(path, std::ios::binary | std::ios::ate);
+      if (!in)
+         return false;
+      LogFile file;
+      return file.open(path, (uint64_t)in.tellg()) && file.sync();
+   }
+
+   /*****************************************************************
+    * REPLACE FILE
+    * Rename from over to so that a crash leaves one or the other,
+    * never half of each, and make the rename itself durable
+    *****************************************************************/
+   inline bool replaceFile(const std::string& from, const std::string& to)
+   {
+#ifdef _WIN32
+      return MoveFileExA(from.c_str(), to.c_str(),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else // !_WIN32
+      if (std::rename(from.c_str(), to.c_str()) != 0)
+         return false;
+      size_t iSlash = to.find_last_of('/');
+      std::string directory = iSlash == std::string::npos ? "." :
+                              iSlash == 0 ? "/" : to.substr(0, iSlash);
+      int fd = ::open(directory.c_str(), O_RDONLY);
+      if (fd < 0)
+         return false;
+      bool synced = fsync(fd) == 0;
+      ::close(fd);
+      return synced;
+#endif // !_WIN32
+   }
+
+   /*****************************************************************
+    * CHECKSUM
+    * 32-bit FNV-1a, continuing from a previous value
+    *****************************************************************/
+   inline uint32_t checksum(const char* p, size_t num, uint32_t hash = 2166136261u)
+   {
+      for (size_t i = 0; i < num; i++)
+         hash = (hash ^ (uint8_t)p[i]) * 16777619u;
+      return hash;
+   }
+
+   inline constexpr char magic[4] = { 'B', 'S', 'T', 'W' };
+   inline constexpr uint32_t version = 1;
+   inline constexpr size_t headerSize = sizeof(magic) + sizeof(uint32_t) + sizeof(uint64_t);
+   inline constexpr size_t recordSize = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t);
+
+   } // namespace durable
+
+   /*****************************************************************
+    * DURABLE BST
+    * A BST whose changes are logged to disk before they count
+    *****************************************************************/
+   template <typename T, class Codec = BitwiseCodec<T>>
+   class DurableBST
+   {
+      friend class ::TestDurable; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      DurableBST(size_t groupSize = 64, Codec codec = Codec()) :
+         codec(codec), groupSize(groupSize > 0 ? groupSize : 1), generation(0),
+         numPending(0), lsnAppended(0), lsnDurable(0), numCommits(0),
+         flushing(false), failed(false) {}
+      DurableBST(const DurableBST& rhs) = delete;
+      DurableBST& operator =(const DurableBST& rhs) = delete;
+      ~DurableBST() { close(); }
+
+      //
+      // Files
+      //
+
+      bool open(const std::string& path);
+      bool close();
+      bool checkpoint();
+
+      //
+      // Write: each is durable once the next commit is
+      //
+
+      bool   insert(const T& t, bool keepUnique = false);
+      size_t erase(const T& t);
+      bool   sync();
+
+      //
+      // Read
+      //
+
+      bool contains(const T& t) const
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         return bst.find(t) != bst.end();
+      }
+      size_t size() const
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         return bst.size();
+      }
+      bool empty() const { return size() == 0; }
+
+      // the tree itself; not safe while another thread writes
+      const BST<T>& tree() const noexcept { return bst; }
+
+      //
+      // Status
+      //
+
+      bool isOpen() const noexcept { return log.isOpen(); }
+      bool good()   const
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         return log.isOpen() && !failed;
+      }
+
+   private:
+      enum Op : uint8_t { opInsert = 1, opErase = 2 };
+
+      std::string checkpointPath() const { return path + ".ckpt"; }
+      std::string logPath()        const { return path + ".wal"; }
+
+      void append(Op op, const T& t);
+      bool apply(Op op, const char* p, size_t num);
+      uint64_t replay(const std::string& bytes);
+      bool newLog(uint64_t generation);
+      bool commitLocked(std::unique_lock<std::mutex>& lock, uint64_t lsn);
+      bool drainLocked(std::unique_lock<std::mutex>& lock);
+
+      mutable std::mutex mutex;          // guards everything below
+      std::condition_variable committed; // a commit finished
+      BST<T> bst;                        // the tree, as of the latest record
+      Codec codec;                       // turns elements into bytes and back
+      durable::LogFile log;              // the write-ahead log
+      std::string path;                  // the files, less their extensions
+      size_t groupSize;                  // records that force a commit
+      uint64_t generation;               // of the checkpoint and the log
+      std::string pending;               // records not yet written
+      size_t numPending;                 // how many records are in pending
+      uint64_t lsnAppended;              // records made so far
+      uint64_t lsnDurable;               // records on the disk so far
+      uint64_t numCommits;               // writes and syncs of the log
+      bool flushing;                     // a commit is writing outside the lock
+      bool failed;                       // the log could not be written
+   };
+
+   /*********************************************
+    * DURABLE BST :: OPEN
+    * Load path.ckpt if it is there, replay path.wal if it
+    * belongs to that checkpoint, and cut off a torn last
+    * record. False if the checkpoint or the log cannot be
+    * read or written; the tree is then empty and closed
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::open(const std::string& path)
+   {
+      close();
+      std::unique_lock<std::mutex> lock(mutex);
+      this->path = path;
+      bst.clear();
+      generation = 0;
+      lsnAppended = lsnDurable = 0;
+      failed = false;
+
+      std::ifstream checkpointIn(checkpointPath(), std::ios::binary);
+      if (checkpointIn)
+      {
+         if (!checkpointIn.read(reinterpret_cast<char*>(&generation), sizeof(generation)) ||
+             !bst.deserialize(checkpointIn, codec))
+            return false;
+         checkpointIn.close();
+      }
+
+      std::ifstream logIn(logPath(), std::ios::binary);
+      std::string bytes((std::istreambuf_iterator<char>(logIn)), std::istreambuf_iterator<char>());
+      logIn.close();
+      uint32_t logVersion;
+      uint64_t logGeneration;
+      if (bytes.size() >= durable::headerSize)
+      {
+         std::memcpy(&logVersion, bytes.data() + sizeof(durable::magic), sizeof(logVersion));
+         std::memcpy(&logGeneration, bytes.data() + sizeof(durable::magic) + sizeof(logVersion),
+                     sizeof(logGeneration));
+      }
+      if (bytes.size() < durable::headerSize ||
+          std::memcmp(bytes.data(), durable::magic, sizeof(durable::magic)) != 0 ||
+          logVersion != durable::version || logGeneration != generation)
+      {
+         // no log, a torn header, or one an earlier checkpoint already holds
+         if (!newLog(generation) || !log.open(logPath(), durable::headerSize))
+         {
+            bst.clear();
+            return false;
+         }
+         return true;
+      }
+
+      uint64_t end = replay(bytes);
+      if (!log.open(logPath(), end) || (end < bytes.size() && !log.sync()))
+      {
+         bst.clear();
+         log.close();
+         return false;
+      }
+      return true;
+   }
+
+   /*********************************************
+    * DURABLE BST :: CLOSE
+    * Commit what is pending and let go of the log.
+    * False if the last commit failed
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::close()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!log.isOpen())
+         return true;
+      bool drained = drainLocked(lock);
+      log.close();
+      pending.clear();
+      numPending = 0;
+      return drained;
+   }
+
+   /*********************************************
+    * DURABLE BST :: CHECKPOINT
+    * Save the tree as the next generation and start a new,
+    * empty log for it. Writers wait until it is done. If
+    * it fails partway the old checkpoint and log stand
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::checkpoint()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!log.isOpen() || !drainLocked(lock))
+         return false;
+
+      std::string temporary = checkpointPath() + ".tmp";
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      uint64_t next = generation + 1;
+      out.write(reinterpret_cast<const char*>(&next), sizeof(next));
+      bool saved = out && bst.serialize(out, codec);
+      out.close();
+      if (!saved || !out || !durable::syncFile(temporary) ||
+          !durable::replaceFile(temporary, checkpointPath()))
+      {
+         std::remove(temporary.c_str());
+         return false;
+      }
+
+      // the checkpoint now holds everything; the old log is stale
+      generation = next;
+      log.close();
+      if (!newLog(generation) || !log.open(logPath(), durable::headerSize))
+      {
+         failed = true;
+         return false;
+      }
+      return true;
+   }
+
+   /*********************************************
+    * DURABLE BST :: INSERT
+    * Insert into the tree and log it. False, and nothing
+    * logged, if keepUnique turned it away, the tree is not
+    * open, or the log has failed. False too if this insert
+    * made the group commit and the commit failed: the tree
+    * has the element, but it will not survive a restart
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::insert(const T& t, bool keepUnique)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!log.isOpen() || failed || !bst.insert(t, keepUnique).second)
+         return false;
+      append(opInsert, t);
+      if (numPending >= groupSize)
+         return commitLocked(lock, lsnAppended);
+      return true;
+   }
+
+   /*********************************************
+    * DURABLE BST :: ERASE
+    * Erase every element equal to t and log it, if there
+    * were any. Zero, and nothing erased, if the log has
+    * failed. Zero too if this erase made the group commit
+    * and the commit failed, as with insert()
+    ********************************************/
+   template <typename T, class Codec>
+   size_t DurableBST<T, Codec>::erase(const T& t)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!log.isOpen() || failed)
+         return 0;
+      size_t numErased = bst.erase(t);
+      if (numErased == 0)
+         return 0;
+      append(opErase, t);
+      if (numPending >= groupSize && !commitLocked(lock, lsnAppended))
+         return 0;
+      return numErased;
+   }
+
+   /*********************************************
+    * DURABLE BST :: SYNC
+    * Return once every change made before the call is
+    * on the disk. False if the log could not be written
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::sync()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!log.isOpen())
+         return false;
+      return commitLocked(lock, lsnAppended);
+   }
+
+   /*********************************************
+    * DURABLE BST :: APPEND
+    * Add one record to those waiting for a commit
+    ********************************************/
+   template <typename T, class Codec>
+   void DurableBST<T, Codec>::append(Op op, const T& t)
+   {
+      size_t iRecord = pending.size();
+      pending.resize(iRecord + durable::recordSize);
+      if constexpr (std::is_same_v<Codec, BitwiseCodec<T>>)
+         pending.append(reinterpret_cast<const char*>(&t), sizeof(T));
+      else
+      {
+         std::ostringstream out;
+         codec.write(out, t);
+         pending += out.str();
+      }
+
+      uint32_t length = (uint32_t)(pending.size() - iRecord - durable::recordSize);
+      char opByte = (char)op;
+      uint32_t sum = durable::checksum(pending.data() + iRecord + durable::recordSize, length,
+                                       durable::checksum(&opByte, 1));
+      char* p = &pending[iRecord];
+      std::memcpy(p, &length, sizeof(length));
+      std::memcpy(p + sizeof(length), &sum, sizeof(sum));
+      p[sizeof(length) + sizeof(sum)] = opByte;
+      numPending++;
+      lsnAppended++;
+   }
+
+   /*********************************************
+    * DURABLE BST :: APPLY
+    * Redo one logged operation. False if the element
+    * does not decode
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::apply(Op op, const char* p, size_t num)
+   {
+      T t;
+      if constexpr (std::is_same_v<Codec, BitwiseCodec<T>>)
+      {
+         if (num != sizeof(T))
+            return false;
+         std::memcpy(&t, p, sizeof(T));
+      }
+      else
+      {
+         std::istringstream in(std::string(p, num));
+         if (!codec.read(in, t))
+            return false;
+      }
+
+      if (op == opInsert)
+         bst.insert(std::move(t));
+      else if (op == opErase)
+         bst.erase(t);
+      else
+         return false;
+      return true;
+   }
+
+   /*********************************************
+    * DURABLE BST :: REPLAY
+    * Apply the records of a log in order, stopping at the
+    * first one that is cut short or does not check out.
+    * Return where the good records end
+    ********************************************/
+   template <typename T, class Codec>
+   uint64_t DurableBST<T, Codec>::replay(const std::string& bytes)
+   {
+      size_t iRecord = durable::headerSize;
+      while (bytes.size() - iRecord >= durable::recordSize)
+      {
+         uint32_t length;
+         uint32_t sum;
+         const char* p = bytes.data() + iRecord;
+         std::memcpy(&length, p, sizeof(length));
+         std::memcpy(&sum, p + sizeof(length), sizeof(sum));
+         const char* pOp = p + sizeof(length) + sizeof(sum);
+         const char* pElement = p + durable::recordSize;
+         if (length > bytes.size() - iRecord - durable::recordSize ||
+             durable::checksum(pElement, length, durable::checksum(pOp, 1)) != sum ||
+             !apply((Op)(uint8_t)*pOp, pElement, length))
+            break;
+         iRecord += durable::recordSize + length;
+         lsnAppended++;
+      }
+      lsnDurable = lsnAppended;
+      return iRecord;
+   }
+
+   /*********************************************
+    * DURABLE BST :: NEW LOG
+    * Put an empty log of this generation in place of the
+    * old one, all at once
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::newLog(uint64_t generation)
+   {
+      std::string temporary = logPath() + ".tmp";
+      {
+         std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+         out.write(durable::magic, sizeof(durable::magic));
+         out.write(reinterpret_cast<const char*>(&durable::version), sizeof(durable::version));
+         out.write(reinterpret_cast<const char*>(&generation), sizeof(generation));
+         out.close();
+         if (!out)
+            return false;
+      }
+      if (!durable::syncFile(temporary) || !durable::replaceFile(temporary, logPath()))
+      {
+         std::remove(temporary.c_str());
+         return false;
+      }
+      return true;
+   }
+
+   /*********************************************
+    * DURABLE BST :: COMMIT LOCKED
+    * Wait until record lsn is on the disk. If no commit is
+    * under way, become the one that writes: take every
+    * pending record, write and sync them without the lock
+    * so others can keep adding records, then wake everyone
+    * who was waiting. The lock is held on entry and exit
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::commitLocked(std::unique_lock<std::mutex>& lock, uint64_t lsn)
+   {
+      while (lsnDurable < lsn && !failed)
+      {
+         if (flushing)
+         {
+            committed.wait(lock);
+            continue;
+         }
+
+         flushing = true;
+         std::string batch;
+         batch.swap(pending);
+         uint64_t lsnBatch = lsnAppended;
+         numPending = 0;
+
+         lock.unlock();
+         bool written = log.write(batch.data(), batch.size()) && log.sync();
+         lock.lock();
+
+         flushing = false;
+         numCommits++;
+         if (written)
+            lsnDurable = lsnBatch;
+         else
+            failed = true;
+         committed.notify_all();
+      }
+      return !failed;
+   }
+
+   /*********************************************
+    * DURABLE BST :: DRAIN LOCKED
+    * Commit everything and leave no commit under way, so
+    * the caller has the log to itself while it holds the
+    * lock
+    ********************************************/
+   template <typename T, class Codec>
+   bool DurableBST<T, Codec>::drainLocked(std::unique_lock<std::mutex>& lock)
+   {
+      while (!failed && (flushing || lsnDurable < lsnAppended))
+      {
+         if (flushing)
+            committed.wait(lock);
+         else
+            commitLocked(lock, lsnAppended);
+      }
+      return !failed;
+   }
+
+} // namespace custom
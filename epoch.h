@@ -0,0 +1,233 @@
+/***********************************************************************
+ * Header:
+ *    EPOCH
+ * Summary:
+ *    Epoch-based reclamation: a writer that unlinks a node from a shared
+ *    structure cannot delete it on the spot, because a reader on another
+ *    thread may be standing on it. Instead the writer retires the node,
+ *    tagged with the current epoch, and deletes it only once every
+ *    reader that was active at that epoch has left.
+ *
+ *    Readers announce themselves by holding an epoch::Guard for the
+ *    duration of a read. The outermost Guard of a thread claims one of
+ *    maxThreads slots, starting with the one the thread had last, and
+ *    gives it back when it ends, so only threads reading right now hold
+ *    a slot. Pinning is then one store and one fence into that slot, and
+ *    readers never touch a shared cache line for writing. If every slot
+ *    is taken, the reader joins a shared overflow slot behind a lock
+ *    instead of waiting.
+ *
+ *    This will contain the definitions of:
+ *        epoch::Guard        : Pin the calling thread for a read
+ *        epoch::Overflow     : Readers that found every slot taken
+ *        epoch::Retired      : Nodes waiting for readers to leave
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <atomic>     // for std::atomic
+#include <cstdint>    // for uint64_t
+#include <functional> // for std::hash
+#include <mutex>      // for std::mutex and std::lock_guard
+#include <thread>     // for std::this_thread::get_id
+#include <utility>    // for std::pair
+#include <vector>     // for std::vector
+
+namespace custom
+{
+   namespace epoch
+   {
+
+      // the most threads that can be pinned at once in their own slots.
+      // More share the overflow slot
+      const size_t maxThreads = 256;
+
+      inline std::atomic<uint64_t> globalEpoch{ 1 };
+
+      /******************************************************
+       * SLOT
+       * One reader's announcement: the epoch it pinned at, or 0.
+       * Each sits on its own cache line
+       ******************************************************/
+      struct alignas(64) Slot
+      {
+         std::atomic<uint64_t> epoch{ 0 };   // 0 when not reading
+         std::atomic<bool>     inUse{ false };// claimed by a reader
+      };
+
+      /******************************************************
+       * OVERFLOW
+       * The readers that found every slot taken. The epoch is
+       * the one the first of them pinned at, which is no later
+       * than any of the others, and stays until the last leaves
+       ******************************************************/
+      struct Overflow
+      {
+         void join()
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (numReaders++ == 0)
+               epoch.store(globalEpoch.load(), std::memory_order_seq_cst);
+         }
+         void leave()
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--numReaders == 0)
+               epoch.store(0, std::memory_order_release);
+         }
+
+         std::mutex mutex;
+         size_t numReaders = 0;
+         std::atomic<uint64_t> epoch{ 0 };   // 0 when no one is here
+      };
+
+      inline Slot slots[maxThreads];
+      inline Overflow overflow;
+
+      /******************************************************
+       * CLAIM
+       * A free slot for the calling thread, trying the one it
+       * had last first, or nullptr if every slot is in use
+       ******************************************************/
+      inline Slot* claim()
+      {
+         thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id()) % maxThreads;
+         for (size_t i = 0; i < maxThreads; i++)
+         {
+            size_t iSlot = (hint + i) % maxThreads;
+            Slot& slot = slots[iSlot];
+            bool expected = false;
+            if (!slot.inUse.load(std::memory_order_relaxed) &&
+                slot.inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+               hint = iSlot;
+               return &slot;
+            }
+         }
+         return nullptr;
+      }
+
+      /******************************************************
+       * GUARD
+       * While a Guard is alive, nothing retired from now on is
+       * deleted. Guards nest; only the outermost one pins
+       ******************************************************/
+      class Guard
+      {
+      public:
+         Guard()
+         {
+            if (depth()++ == 0)
+            {
+               Slot*& pSlot = pinned();
+               pSlot = claim();
+               if (pSlot)
+                  pSlot->epoch.store(globalEpoch.load(), std::memory_order_seq_cst);
+               else
+                  overflow.join();
+               // our announcement must be visible before we read the structure
+               std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+         }
+         ~Guard()
+         {
+            if (--depth() == 0)
+            {
+               Slot* pSlot = pinned();
+               if (pSlot)
+               {
+                  pSlot->epoch.store(0, std::memory_order_release);
+                  pSlot->inUse.store(false, std::memory_order_release);
+               }
+               else
+                  overflow.leave();
+            }
+         }
+         Guard(const Guard&) = delete;
+         Guard& operator =(const Guard&) = delete;
+
+      private:
+         static int& depth()
+         {
+            thread_local int depth = 0;
+            return depth;
+         }
+         // the slot of the outermost guard, or nullptr for the overflow
+         static Slot*& pinned()
+         {
+            thread_local Slot* pSlot = nullptr;
+            return pSlot;
+         }
+      };
+
+      /******************************************************
+       * OLDEST ACTIVE
+       * The earliest epoch any reader is pinned at, or the
+       * largest epoch there is when no one is reading
+       ******************************************************/
+      inline uint64_t oldestActive()
+      {
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         uint64_t oldest = UINT64_MAX;
+         for (const Slot& slot : slots)
+         {
+            uint64_t epoch = slot.epoch.load(std::memory_order_acquire);
+            if (epoch && epoch < oldest)
+               oldest = epoch;
+         }
+         uint64_t epoch = overflow.epoch.load(std::memory_order_acquire);
+         if (epoch && epoch < oldest)
+            oldest = epoch;
+         return oldest;
+      }
+
+      /******************************************************
+       * RETIRED
+       * Nodes unlinked by a writer, waiting to be deleted. Not
+       * thread safe itself: the writers of the structure that
+       * owns it must already be serialized
+       ******************************************************/
+      template <typename Node>
+      class Retired
+      {
+      public:
+         Retired() {}
+         Retired(const Retired&) = delete;
+         Retired& operator =(const Retired&) = delete;
+         ~Retired()
+         {
+            for (auto& retired : nodes)
+               delete retired.first;
+         }
+
+         // a node that is already unreachable for new readers
+         void retire(Node* pNode)
+         {
+            nodes.push_back({ pNode, globalEpoch.fetch_add(1) });
+         }
+
+         // delete everything no reader can still see
+         void reclaim()
+         {
+            if (nodes.empty())
+               return;
+            uint64_t oldest = oldestActive();
+            size_t kept = 0;
+            for (auto& retired : nodes)
+               if (retired.second < oldest)
+                  delete retired.first;
+               else
+                  nodes[kept++] = retired;
+            nodes.resize(kept);
+         }
+
+         size_t size() const { return nodes.size(); }
+
+      private:
+         std::vector<std::pair<Node*, uint64_t>> nodes; // node and the epoch it left at
+      };
+
+   } // namespace epoch
+} // namespace custom
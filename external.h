@@ -0,0 +1,512 @@
+/***********************************************************************
+ * Header:
+ *    EXTERNAL
+ * Summary:
+ *    Load a tree from a file of keys too large to sort in memory. The
+ *    file is raw, trivially copyable keys in any order. Sorting it is an
+ *    external merge sort within a memory budget:
+ *        runs    read as many keys as the budget holds, sort them, and
+ *                write them out as a run; repeat to the end of the file
+ *        merge   while there are more runs than the budget can read at
+ *                once, merge them a group at a time into longer runs
+ *        stream  merge the last few runs into whatever takes the keys,
+ *                which never sees the whole file at once
+ *    During the merges the budget is split into one block per run being
+ *    read and one for the run being written, so each pass reads and
+ *    writes the file once in large, sequential pieces. The runs live
+ *    next to the input on local disk and are removed when done.
+ *
+ *    The sorted keys stream into BST::build_sorted(), which links them
+ *    into a balanced tree in O(n), or into MappedBST::write().
+ *
+ *    This will contain the definitions of:
+ *        external::BlockReader    : Read a file of keys a block at a time
+ *        external::RunMerger      : The smallest key of many runs, in turn
+ *        external::Sorter         : Sort a file of keys within a budget
+ *        external::load()         : Sort a file into a BST
+ *        external::writeMapped()  : Sort a file into a MappedBST file
+ *        BST::build_sorted()      : Link sorted keys into a tree in O(n)
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <algorithm>   // for std::sort, std::unique and std::push_heap
+#include <cstddef>     // for std::ptrdiff_t
+#include <cstdio>      // for std::remove
+#include <fstream>     // for std::ifstream and std::ofstream
+#include <iterator>    // for std::input_iterator_tag
+#include <memory>      // for std::unique_ptr
+#include <string>      // for std::string and std::to_string
+#include <type_traits> // for std::is_trivially_copyable_v
+#include <vector>      // for std::vector
+#include "bst.h"
+#include "mapped.h"    // for MappedBST::write()
+
+class TestExternal; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace external
+   {
+
+   inline constexpr size_t defaultBudget = 64 << 20;   // bytes
+   inline constexpr size_t maxBlockBytes = 1 << 16;    // the most one run reads at once
+
+   /*****************************************************************
+    * BLOCK READER
+    * The keys of a file, one at a time, read a block at a time
+    *****************************************************************/
+   template <typename T>
+   class BlockReader
+   {
+   public:
+      BlockReader(const std::string& path, size_t blockSize) :
+         in(path, std::ios::binary), block(blockSize > 0 ? blockSize : 1),
+         iNext(0), numInBlock(0), failed(!in) {}
+
+      // the next key, or false at the end
+      bool next(T& t)
+      {
+         if (iNext == numInBlock && !fill())
+            return false;
+         t = block[iNext++];
+         return true;
+      }
+
+      // could not be read, or ended partway through a key
+      bool bad() const noexcept { return failed; }
+
+   private:
+      bool fill()
+      {
+         if (failed)
+            return false;
+         in.read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(T));
+         size_t numBytes = (size_t)in.gcount();
+         failed = numBytes % sizeof(T) != 0 || (!in && !in.eof());
+         numInBlock = numBytes / sizeof(T);
+         iNext = 0;
+         return numInBlock > 0;
+      }
+
+      std::ifstream in;
+      std::vector<T> block;
+      size_t iNext;        // the next key in block
+      size_t numInBlock;   // keys read into block
+      bool failed;
+   };
+
+   /*****************************************************************
+    * RUN MERGER
+    * Hands out the keys of several sorted runs in order, keeping
+    * the head of each run in a min-heap. With unique, repeats of
+    * the key just handed out are skipped
+    *****************************************************************/
+   template <typename T>
+   class RunMerger
+   {
+   public:
+      RunMerger(const std::vector<std::string>& paths, size_t blockSize, bool unique) :
+         unique(unique), hasLast(false)
+      {
+         for (const std::string& path : paths)
+         {
+            readers.emplace_back(new BlockReader<T>(path, blockSize));
+            Head head;
+            head.iReader = readers.size() - 1;
+            if (readers.back()->next(head.t))
+               heap.push_back(head);
+         }
+         std::make_heap(heap.begin(), heap.end(), later);
+      }
+
+      // the next key in order, or false when every run is done
+      bool next(T& t)
+      {
+         do
+         {
+            if (heap.empty())
+               return false;
+            std::pop_heap(heap.begin(), heap.end(), later);
+            t = heap.back().t;
+            if (readers[heap.back().iReader]->next(heap.back().t))
+               std::push_heap(heap.begin(), heap.end(), later);
+            else
+               heap.pop_back();
+         }
+         while (unique && hasLast && !(last < t));
+
+         if (unique)
+         {
+            last = t;
+            hasLast = true;
+         }
+         return true;
+      }
+
+      bool bad() const
+      {
+         for (const std::unique_ptr<BlockReader<T>>& pReader : readers)
+            if (pReader->bad())
+               return true;
+         return false;
+      }
+
+   private:
+      struct Head
+      {
+         T t;              // the smallest key left in the run
+         size_t iReader;   // the run it came from
+      };
+      static bool later(const Head& lhs, const Head& rhs) { return rhs.t < lhs.t; }
+
+      std::vector<std::unique_ptr<BlockReader<T>>> readers;
+      std::vector<Head> heap;
+      bool unique;
+      bool hasLast;
+      T last;              // the key just handed out, when unique
+   };
+
+   /*****************************************************************
+    * SORTER
+    * Sort a file of keys through runs on disk. After sort(),
+    * [begin(), end()) is every key in order, read from the last
+    * merge as it goes. It can be walked once
+    *****************************************************************/
+   template <typename T>
+   class Sorter
+   {
+      static_assert(std::is_trivially_copyable_v<T>, "the keys are sorted as raw bytes");
+      friend class ::TestExternal; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      Sorter(size_t memoryBudget = defaultBudget, const std::string& tempPrefix = "sort",
+             bool unique = false);
+      Sorter(const Sorter& rhs) = delete;
+      Sorter& operator =(const Sorter& rhs) = delete;
+      ~Sorter() { removeRuns(); }
+
+      //
+      // Sort
+      //
+
+      bool sort(const std::string& inPath);
+      bool good() const noexcept { return !failed; }
+
+      //
+      // Iterator
+      //
+
+      class iterator;
+      iterator begin();
+      iterator end() { return iterator(); }
+
+   private:
+      std::string runPath(size_t iRun) const { return tempPrefix + ".run" + std::to_string(iRun); }
+      bool makeRuns(const std::string& inPath);
+      bool mergeRuns(const std::vector<std::string>& paths, const std::string& outPath);
+      bool advance();
+      void removeRuns();
+
+      std::string tempPrefix;   // the runs are this plus a number
+      size_t budget;            // keys that fit in the memory budget
+      size_t blockSize;         // keys each run reads at once while merging
+      size_t fanIn;             // runs merged at once
+      bool unique;              // drop repeats
+
+      std::vector<std::string> runs;     // on disk, waiting to be merged
+      size_t numRunsMade;                // runs written, across all passes
+      size_t numPasses;                  // merges before the last
+      std::unique_ptr<RunMerger<T>> pFinal; // the last merge, as it streams
+      T current;                         // the key the iterator is on
+      bool failed;
+   };
+
+   /**********************************************************
+    * SORTER ITERATOR
+    * Reads one key at a time from the last merge
+    *********************************************************/
+   template <typename T>
+   class Sorter<T>::iterator
+   {
+      friend class Sorter<T>;
+   public:
+      typedef std::input_iterator_tag iterator_category;
+      typedef T                       value_type;
+      typedef std::ptrdiff_t          difference_type;
+      typedef const T*                pointer;
+      typedef const T&                reference;
+
+      iterator() : pSorter(nullptr) {}
+
+      const T& operator *() const { return pSorter->current; }
+      iterator& operator ++()
+      {
+         if (!pSorter->advance())
+            pSorter = nullptr;
+         return *this;
+      }
+
+      bool operator ==(const iterator& rhs) const { return pSorter == rhs.pSorter; }
+      bool operator !=(const iterator& rhs) const { return pSorter != rhs.pSorter; }
+
+   private:
+      explicit iterator(Sorter* pSorter) : pSorter(pSorter) {}
+
+      Sorter* pSorter;   // nullptr at the end
+   };
+
+   /*********************************************
+    * SORTER :: CONSTRUCTOR
+    * Split the budget: all of it holds one run while the
+    * runs are made; while merging, each run being read and
+    * the one being written get a block of it
+    ********************************************/
+   template <typename T>
+   Sorter<T>::Sorter(size_t memoryBudget, const std::string& tempPrefix, bool unique) :
+      tempPrefix(tempPrefix), unique(unique), numRunsMade(0), numPasses(0), failed(false)
+   {
+      budget = memoryBudget / sizeof(T) > 3 ? memoryBudget / sizeof(T) : 3;
+      blockSize = std::min(maxBlockBytes / sizeof(T), budget / 3);
+      if (blockSize == 0)
+         blockSize = 1;
+      fanIn = budget / blockSize - 1;
+   }
+
+   /*********************************************
+    * SORTER :: SORT
+    * Make the runs, then merge them until one more merge
+    * will finish the job. False if a file could not be
+    * read or written, or the input ends partway through
+    * a key
+    ********************************************/
+   template <typename T>
+   bool Sorter<T>::sort(const std::string& inPath)
+   {
+      removeRuns();
+      pFinal.reset();
+      failed = false;
+      numRunsMade = numPasses = 0;
+
+      if (!makeRuns(inPath))
+      {
+         failed = true;
+         return false;
+      }
+
+      while (runs.size() > fanIn)
+      {
+         std::vector<std::string> merged;
+         for (size_t iFirst = 0; iFirst < runs.size() && !failed; iFirst += fanIn)
+         {
+            size_t iLast = std::min(iFirst + fanIn, runs.size());
+            std::vector<std::string> group(runs.begin() + iFirst, runs.begin() + iLast);
+            merged.push_back(runPath(numRunsMade++));
+            failed = !mergeRuns(group, merged.back());
+            for (std::string& path : group)
+               std::remove(path.c_str());
+            for (size_t iRun = iFirst; iRun < iLast; iRun++)
+               runs[iRun].clear();
+         }
+
+         // whatever is left, merged or not, is still ours to remove
+         for (std::string& path : runs)
+            if (!path.empty())
+               merged.push_back(path);
+         runs.swap(merged);
+         if (failed)
+            return false;
+         numPasses++;
+      }
+      return true;
+   }
+
+   /*********************************************
+    * SORTER :: BEGIN
+    * Start the last merge
+    ********************************************/
+   template <typename T>
+   typename Sorter<T>::iterator Sorter<T>::begin()
+   {
+      if (failed)
+         return end();
+      pFinal.reset(new RunMerger<T>(runs, blockSize, unique));
+      return advance() ? iterator(this) : end();
+   }
+
+   /*********************************************
+    * SORTER :: MAKE RUNS
+    * Fill the budget from the input, sort it, and write
+    * it out, until the input is done
+    ********************************************/
+   template <typename T>
+   bool Sorter<T>::makeRuns(const std::string& inPath)
+   {
+      std::ifstream in(inPath, std::ios::binary);
+      if (!in)
+         return false;
+      std::vector<T> buffer(budget);
+      while (in)
+      {
+         in.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(T));
+         size_t numBytes = (size_t)in.gcount();
+         if (numBytes % sizeof(T) != 0 || (!in && !in.eof()))
+            return false;
+         if (numBytes == 0)
+            break;
+
+         auto last = buffer.begin() + numBytes / sizeof(T);
+         std::sort(buffer.begin(), last, [](const T& lhs, const T& rhs) { return lhs < rhs; });
+         if (unique)
+            last = std::unique(buffer.begin(), last,
+                               [](const T& lhs, const T& rhs) { return !(lhs < rhs) && !(rhs < lhs); });
+
+         runs.push_back(runPath(numRunsMade++));
+         std::ofstream out(runs.back(), std::ios::binary | std::ios::trunc);
+         out.write(reinterpret_cast<const char*>(buffer.data()), (last - buffer.begin()) * sizeof(T));
+         out.close();
+         if (!out)
+            return false;
+      }
+      return true;
+   }
+
+   /*********************************************
+    * SORTER :: MERGE RUNS
+    * Merge some runs into one, a block at a time
+    ********************************************/
+   template <typename T>
+   bool Sorter<T>::mergeRuns(const std::vector<std::string>& paths, const std::string& outPath)
+   {
+      RunMerger<T> merger(paths, blockSize, unique);
+      std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+      std::vector<T> block;
+      block.reserve(blockSize);
+      T t;
+      while (out && merger.next(t))
+      {
+         block.push_back(t);
+         if (block.size() == blockSize)
+         {
+            out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(T));
+            block.clear();
+         }
+      }
+      out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(T));
+      out.close();
+      return out && !merger.bad();
+   }
+
+   /*********************************************
+    * SORTER :: ADVANCE
+    * Take the next key from the last merge
+    ********************************************/
+   template <typename T>
+   bool Sorter<T>::advance()
+   {
+      if (pFinal && pFinal->next(current))
+         return true;
+      if (pFinal && pFinal->bad())
+         failed = true;
+      return false;
+   }
+
+   /*********************************************
+    * SORTER :: REMOVE RUNS
+    ********************************************/
+   template <typename T>
+   void Sorter<T>::removeRuns()
+   {
+      pFinal.reset();
+      for (const std::string& path : runs)
+         std::remove(path.c_str());
+      runs.clear();
+   }
+
+   /*****************************************************************
+    * LOAD
+    * Replace the contents of bst with the keys in the file at
+    * inPath, sorted within memoryBudget bytes. False, leaving bst
+    * as it was, if the file could not be sorted
+    *****************************************************************/
+   template <typename T>
+   bool load(BST<T>& bst, const std::string& inPath, size_t memoryBudget = defaultBudget,
+             bool keepUnique = false)
+   {
+      Sorter<T> sorter(memoryBudget, inPath + ".sort", keepUnique);
+      if (!sorter.sort(inPath))
+         return false;
+      BST<T> loaded;
+      if (!loaded.build_sorted(sorter.begin(), sorter.end()) || !sorter.good())
+         return false;
+      bst.swap(loaded);
+      return true;
+   }
+
+   /*****************************************************************
+    * WRITE MAPPED
+    * Sort the keys in the file at inPath within memoryBudget bytes
+    * into a file MappedBST can open at outPath
+    *****************************************************************/
+   template <typename T>
+   bool writeMapped(const std::string& inPath, const std::string& outPath,
+                    size_t memoryBudget = defaultBudget, bool keepUnique = false)
+   {
+      Sorter<T> sorter(memoryBudget, inPath + ".sort", keepUnique);
+      if (!sorter.sort(inPath))
+         return false;
+      if (!MappedBST<T>::write(sorter.begin(), sorter.end(), outPath) || !sorter.good())
+      {
+         std::remove(outPath.c_str());
+         return false;
+      }
+      return true;
+   }
+
+   } // namespace external
+
+   /****************************************************
+    * BST :: BUILD SORTED
+    * Replace the contents with [first, last), which is
+    * already in order, walking it once. Each element
+    * becomes a node as it arrives; then the nodes link
+    * into a balanced tree colored by depth, as erase_if()
+    * does. False, leaving the tree as it was, if the
+    * input is out of order
+    ****************************************************/
+   template <typename T>
+   template <class InputIt>
+   bool BST<T>::build_sorted(InputIt first, InputIt last, bool keepUnique)
+   {
+      std::vector<BNode*> nodes;
+      try
+      {
+         for (; first != last; ++first)
+         {
+            const T& t = *first;
+            if (!nodes.empty() && t < nodes.back()->data)
+            {
+               discard(nodes);
+               return false;
+            }
+            if (!keepUnique || nodes.empty() || nodes.back()->data < t)
+               nodes.push_back(new BNode(t));
+         }
+      }
+      catch (...)
+      {
+         discard(nodes);
+         throw;
+      }
+
+      clear();
+      adoptSorted(nodes);
+      return true;
+   }
+
+} // namespace custom
@@ -0,0 +1,317 @@
+/***********************************************************************
+ * Header:
+ *    EYTZINGER
+ * Summary:
+ *    A frozen, read-only snapshot of a BST. The keys live in one
+ *    contiguous array in Eytzinger (breadth-first) order: the root is
+ *    at position 1 and the children of position k are at 2k and 2k+1.
+ *    A search is a branch-free walk down the array with the next few
+ *    levels prefetched, so there is no pointer chasing at all.
+ *
+ *    This will contain the class definition of:
+ *        Eytzinger           : A frozen snapshot of a BST
+ *        Eytzinger::iterator : An in-order iterator through the snapshot
+ *    and the layout functions in custom::eytzinger that work on any
+ *    array in this order.
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <vector>     // for std::vector
+#include "bst.h"
+#include "cache.h"    // for prefetch and countTrailingZeros
+
+class TestEytzinger; // forward declaration for unit tests
+
+namespace custom
+{
+
+   /*****************************************************************
+    * EYTZINGER LAYOUT
+    * Positions are 1-based: position k is stored at keys[k - 1] and
+    * position 0 means "no element." Every function works on a bare
+    * pointer so it can run over any storage: a vector, a mapped file...
+    *****************************************************************/
+   namespace eytzinger
+   {
+      /**************************************************
+       * DESCEND
+       * Walk from the root to a leaf: right when goRight() is true,
+       * left otherwise. The path is encoded in the bits of the final
+       * position, so undoing the trailing right turns plus the last left
+       * turn leads back to the last node where we went left
+       *************************************************/
+      template <typename T, typename GoRight>
+      size_t descend(const T* keys, size_t num, GoRight goRight)
+      {
+         // cache lines are 64 bytes; prefetching the great-great-grandchildren
+         // of k (positions 16k .. 16k+15) keeps four levels in flight
+         size_t k = 1;
+         while (k <= num)
+         {
+            if (16 * k <= num)
+               prefetch(keys + 16 * k - 1);
+            k = 2 * k + (goRight(keys[k - 1]) ? 1 : 0);
+         }
+         return k >> (countTrailingZeros(~k) + 1);
+      }
+
+      /**************************************************
+       * LOWER BOUND
+       * Position of the first key that is not less than t, or 0
+       *************************************************/
+      template <typename T>
+      size_t lowerBound(const T* keys, size_t num, const T& t)
+      {
+         return descend(keys, num, [&t](const T& key) { return key < t; });
+      }
+
+      /**************************************************
+       * UPPER BOUND
+       * Position of the first key that is greater than t, or 0
+       *************************************************/
+      template <typename T>
+      size_t upperBound(const T* keys, size_t num, const T& t)
+      {
+         return descend(keys, num, [&t](const T& key) { return !(t < key); });
+      }
+
+      /**************************************************
+       * FIRST and LAST
+       * Position of the smallest / largest key, or 0 when empty
+       *************************************************/
+      inline size_t first(size_t num) noexcept
+      {
+         if (num == 0)
+            return 0;
+         size_t k = 1;
+         while (2 * k <= num)
+            k = 2 * k;
+         return k;
+      }
+
+      inline size_t last(size_t num) noexcept
+      {
+         if (num == 0)
+            return 0;
+         size_t k = 1;
+         while (2 * k + 1 <= num)
+            k = 2 * k + 1;
+         return k;
+      }
+
+      /**************************************************
+       * NEXT
+       * The in-order successor of position k, or 0 past the end
+       *************************************************/
+      inline size_t next(size_t k, size_t num) noexcept
+      {
+         assert(k != 0);
+
+         // Case 1: Have a right child. Go right, then all the way left
+         if (2 * k + 1 <= num)
+         {
+            k = 2 * k + 1;
+            while (2 * k <= num)
+               k = 2 * k;
+            return k;
+         }
+
+         // Case 2: Climb while we are a right child, then once more
+         return k >> (countTrailingZeros(~k) + 1);
+      }
+
+      /**************************************************
+       * PREV
+       * The in-order predecessor of position k, or 0 before the start.
+       * The predecessor of 0 is the last position
+       *************************************************/
+      inline size_t prev(size_t k, size_t num) noexcept
+      {
+         if (k == 0)
+            return last(num);
+
+         // Case 1: Have a left child. Go left, then all the way right
+         if (2 * k <= num)
+         {
+            k = 2 * k;
+            while (2 * k + 1 <= num)
+               k = 2 * k + 1;
+            return k;
+         }
+
+         // Case 2: Climb while we are a left child, then once more
+         return k >> (countTrailingZeros(k) + 1);
+      }
+
+      /**************************************************
+       * FILL
+       * Place a sorted sequence into the array by walking the implicit
+       * tree in order. Each element of the sequence is read exactly once
+       *************************************************/
+      template <typename T, typename InputIt>
+      void fill(T* keys, size_t num, InputIt& it, size_t k = 1)
+      {
+         if (k > num)
+            return;
+         fill(keys, num, it, 2 * k);
+         keys[k - 1] = *it;
+         ++it;
+         fill(keys, num, it, 2 * k + 1);
+      }
+   } // namespace eytzinger
+
+   /*****************************************************************
+    * EYTZINGER
+    * An immutable snapshot of a BST, made by BST::freeze()
+    *****************************************************************/
+   template <typename T>
+   class Eytzinger
+   {
+      friend class ::TestEytzinger; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      Eytzinger() {}
+      Eytzinger(const BST<T>& bst);
+      template <typename InputIt>
+      Eytzinger(InputIt first, size_t num);
+
+      //
+      // Iterator
+      //
+
+      class iterator;
+      iterator begin() const noexcept { return iterator(this, eytzinger::first(size())); }
+      iterator end()   const noexcept { return iterator(this, 0); }
+
+      //
+      // Access
+      //
+
+      iterator find(const T& t) const;
+      iterator lower_bound(const T& t) const
+      {
+         return iterator(this, eytzinger::lowerBound(keys.data(), size(), t));
+      }
+      iterator upper_bound(const T& t) const
+      {
+         return iterator(this, eytzinger::upperBound(keys.data(), size(), t));
+      }
+
+      //
+      // Status
+      //
+
+      bool   empty() const noexcept { return keys.empty(); }
+      size_t size()  const noexcept { return keys.size(); }
+
+   private:
+      std::vector<T> keys;      // the keys in Eytzinger order
+   };
+
+   /**********************************************************
+    * EYTZINGER ITERATOR
+    * Forward and reverse iterator through the snapshot in order
+    *********************************************************/
+   template <typename T>
+   class Eytzinger<T>::iterator
+   {
+      friend class ::TestEytzinger; // give unit tests access to the privates
+   public:
+      // constructors and assignment
+      iterator() : pTree(nullptr), k(0)
+      {}
+      iterator(const Eytzinger* pTree, size_t k) : pTree(pTree), k(k)
+      {}
+
+      // compare
+      bool operator ==(const iterator& rhs) const { return k == rhs.k; }
+      bool operator !=(const iterator& rhs) const { return k != rhs.k; }
+
+      // de-reference. Cannot change because the snapshot is frozen
+      const T& operator *() const
+      {
+         assert(k != 0);
+         return pTree->keys[k - 1];
+      }
+
+      // increment and decrement
+      iterator& operator ++()
+      {
+         if (k)
+            k = eytzinger::next(k, pTree->size());
+         return *this;
+      }
+      iterator  operator ++(int)
+      {
+         iterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+      iterator& operator --()
+      {
+         k = eytzinger::prev(k, pTree->size());
+         return *this;
+      }
+      iterator  operator --(int)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+      const Eytzinger* pTree;   // the snapshot we belong to
+      size_t k;                 // 1-based position; 0 is the end
+   };
+
+   /*********************************************
+    * EYTZINGER :: CONSTRUCTOR from a BST
+    * One in-order walk of the tree fills the array
+    ********************************************/
+   template <typename T>
+   Eytzinger<T>::Eytzinger(const BST<T>& bst) : Eytzinger(bst.begin(), bst.size())
+   {
+   }
+
+   /*********************************************
+    * EYTZINGER :: CONSTRUCTOR from a sorted sequence
+    * Read num sorted elements starting at first
+    ********************************************/
+   template <typename T>
+   template <typename InputIt>
+   Eytzinger<T>::Eytzinger(InputIt first, size_t num) : keys(num)
+   {
+      eytzinger::fill(keys.data(), num, first);
+   }
+
+   /****************************************************
+    * EYTZINGER :: FIND
+    * Return the element equivalent to t, or end()
+    ****************************************************/
+   template <typename T>
+   typename Eytzinger<T>::iterator Eytzinger<T>::find(const T& t) const
+   {
+      size_t k = eytzinger::lowerBound(keys.data(), size(), t);
+      if (k && !(t < keys[k - 1]))
+         return iterator(this, k);
+      return end();
+   }
+
+   /****************************************************
+    * BST :: FREEZE
+    * Take a read-only snapshot of the tree
+    ****************************************************/
+   template <typename T>
+   Eytzinger<T> BST<T>::freeze() const
+   {
+      return Eytzinger<T>(*this);
+   }
+
+} // namespace custom
@@ -0,0 +1,603 @@
+/***********************************************************************
+ * Header:
+ *    LSM
+ * Summary:
+ *    A log-structured merge index for write-heavy work. Writes go to a
+ *    small BST, the memtable, and nowhere else. When the memtable is
+ *    full it is frozen into an immutable run, a sorted array, and a new
+ *    memtable starts. Runs are merged by size, in the background: a
+ *    frozen memtable is a tier 0 run, and once a tier holds more than
+ *    maxRuns runs a compaction merges them into one run of the next
+ *    tier. Each key is merged about once a tier, and there are
+ *    O(log n) tiers, so a write costs O(log n) merging in all rather
+ *    than a share of merging everything.
+ *
+ *    The index is a set. Erasing a key writes a tombstone, which hides
+ *    the key in every older run until a compaction drops both. A newer
+ *    entry for a key always wins over an older one:
+ *        memtable   newest
+ *        runs       newest last
+ *    A point lookup asks the memtable, then each run from newest to
+ *    oldest, stopping at the first that knows the key. Runs are never
+ *    reordered, and a tier is never younger than the one after it, so
+ *    the runs of a tier always sit together. Each run keeps
+ *    a Bloom filter of its keys, so runs without the key are usually
+ *    passed over without a search.
+ *
+ *    A scan merges the memtable and every run into one ordered stream,
+ *    the newest entry for each key winning and tombstones left out. The
+ *    iterator holds its own copy of the memtable and shares the runs,
+ *    so it sees the index as it was when it was made whatever happens
+ *    after.
+ *
+ *    Writers hold the lock exclusive, and readers share it. A
+ *    compaction merges without the lock and only takes it to swap the
+ *    old runs for the new one.
+ *
+ *    This will contain the definitions of:
+ *        lsm::BloomFilter      : A set of hashes that may say yes wrongly
+ *        lsm::Entry            : A key, or a tombstone for one
+ *        lsm::Run              : Sorted entries that never change
+ *        LsmBST                : The index
+ *        LsmBST::iterator      : A merged scan of the index
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <algorithm>          // for std::lower_bound
+#include <condition_variable> // for std::condition_variable
+#include <cstddef>            // for std::ptrdiff_t
+#include <cstdint>            // for uint64_t
+#include <functional>         // for std::hash
+#include <iterator>           // for std::forward_iterator_tag
+#include <memory>             // for std::shared_ptr
+#include <mutex>              // for std::mutex and std::unique_lock
+#include <shared_mutex>       // for std::shared_mutex and std::shared_lock
+#include <thread>             // for std::thread
+#include <vector>             // for std::vector
+#include "bst.h"
+
+class TestLsm; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace lsm
+   {
+
+   /*****************************************************************
+    * BLOOM FILTER
+    * About ten bits and seven probes per key, for a false yes about
+    * one time in a hundred. Never a false no
+    *****************************************************************/
+   class BloomFilter
+   {
+   public:
+      BloomFilter(size_t numKeys = 0) :
+         bits((numKeys * bitsPerKey + 63) / 64 + 1, 0) {}
+
+      void add(size_t hash)
+      {
+         uint64_t h1 = mix(hash);
+         uint64_t h2 = mix(h1) | 1;
+         size_t numBits = bits.size() * 64;
+         for (int i = 0; i < numProbes; i++)
+         {
+            size_t iBit = (size_t)((h1 + i * h2) % numBits);
+            bits[iBit / 64] |= uint64_t(1) << (iBit % 64);
+         }
+      }
+
+      bool mayContain(size_t hash) const
+      {
+         uint64_t h1 = mix(hash);
+         uint64_t h2 = mix(h1) | 1;
+         size_t numBits = bits.size() * 64;
+         for (int i = 0; i < numProbes; i++)
+         {
+            size_t iBit = (size_t)((h1 + i * h2) % numBits);
+            if (!(bits[iBit / 64] & (uint64_t(1) << (iBit % 64))))
+               return false;
+         }
+         return true;
+      }
+
+   private:
+      static constexpr size_t bitsPerKey = 10;
+      static constexpr int numProbes = 7;
+
+      // std::hash is often the identity; spread the bits out first
+      static uint64_t mix(uint64_t x)
+      {
+         x += 0x9e3779b97f4a7c15ull;
+         x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+         x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+         return x ^ (x >> 31);
+      }
+
+      std::vector<uint64_t> bits;
+   };
+
+   /*****************************************************************
+    * ENTRY
+    * A key, or a tombstone saying it was erased. Ordered by key
+    *****************************************************************/
+   template <typename T>
+   struct Entry
+   {
+      T key;
+      mutable bool erased;   // not part of the order, so the memtable can flip it in place
+
+      bool operator < (const Entry& rhs) const { return key < rhs.key; }
+      bool operator ==(const Entry& rhs) const { return key == rhs.key; }
+   };
+
+   /*****************************************************************
+    * RUN
+    * A frozen memtable, or the merge of several runs
+    *****************************************************************/
+   template <typename T>
+   struct Run
+   {
+      std::vector<Entry<T>> entries;   // sorted, one per key
+      BloomFilter bloom;               // of every key in entries
+      size_t tier = 0;                 // merges it took to make: 0 for a frozen memtable
+
+      // the entry for t, or nullptr
+      const Entry<T>* find(const T& t) const
+      {
+         auto it = std::lower_bound(entries.begin(), entries.end(), Entry<T>{ t, false });
+         return it != entries.end() && !(t < it->key) ? &*it : nullptr;
+      }
+   };
+
+   } // namespace lsm
+
+   /*****************************************************************
+    * LSM BST
+    * A set kept as a BST memtable over immutable sorted runs
+    *****************************************************************/
+   template <typename T, class Hash = std::hash<T>>
+   class LsmBST
+   {
+      friend class ::TestLsm; // give unit tests access to private members
+   public:
+      typedef lsm::Entry<T> Entry;
+      typedef lsm::Run<T> Run;
+
+      //
+      // Construct
+      //
+
+      LsmBST(size_t memtableLimit = 4096, size_t maxRuns = 4, bool background = true);
+      LsmBST(const LsmBST& rhs) = delete;
+      LsmBST& operator =(const LsmBST& rhs) = delete;
+      ~LsmBST();
+
+      //
+      // Write: takes the lock exclusive
+      //
+
+      void insert(const T& t) { write(Entry{ t, false }); }
+      void erase(const T& t)  { write(Entry{ t, true }); }
+      void flush();
+      void compact();   // merge every run into one, dropping the tombstones
+
+      //
+      // Read: takes the lock shared
+      //
+
+      bool contains(const T& t) const;
+      size_t numRuns() const
+      {
+         ReadLock lock(mutex);
+         return runs.size();
+      }
+
+      //
+      // Iterator: a snapshot, merged as it goes
+      //
+
+      class iterator;
+      iterator begin() const;
+      iterator end()   const { return iterator(); }
+      iterator lower_bound(const T& t) const;
+
+   private:
+      typedef std::shared_lock<std::shared_mutex> ReadLock;
+      typedef std::unique_lock<std::shared_mutex> WriteLock;
+
+      void write(const Entry& entry);
+      std::shared_ptr<const Run> freeze(bool withBloom) const;
+      bool crowded(size_t& iFirst, size_t& iLast) const;
+      void compactNow(bool all);
+      void compactor();
+
+      mutable std::shared_mutex mutex;   // guards memtable and runs
+      BST<Entry> memtable;               // the newest entries
+      std::vector<std::shared_ptr<const Run>> runs; // oldest first
+      Hash hash;
+      size_t memtableLimit;              // entries that fill the memtable
+      size_t maxRuns;                    // runs a tier may hold before they are merged
+
+      std::mutex compacting;             // one compaction at a time
+      size_t numCompactions;             // guarded by compacting
+      size_t numMerged;                  // entries written by compactions, guarded by compacting
+
+      // the background compactor
+      bool background;
+      std::mutex wakeMutex;              // guards wanted and stopping
+      std::condition_variable wake;
+      bool wanted;                       // a tier is crowded
+      bool stopping;                     // the destructor is waiting
+      std::thread thread;
+   };
+
+   /**********************************************************
+    * LSM BST ITERATOR
+    * Walks a snapshot of the memtable and the runs in order.
+    * At each step the smallest key among the sources comes
+    * next, from the newest source that has it; every source
+    * at that key moves past it. A tombstone is skipped. There
+    * are only a handful of sources, so finding the smallest is
+    * a straight look through them
+    *********************************************************/
+   template <typename T, class Hash>
+   class LsmBST<T, Hash>::iterator
+   {
+      friend class LsmBST<T, Hash>;
+   public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef T                         value_type;
+      typedef std::ptrdiff_t            difference_type;
+      typedef const T*                  pointer;
+      typedef const T&                  reference;
+
+      iterator() : pCurrent(nullptr), keepErased(false) {}
+
+      const T& operator *() const { return pCurrent->key; }
+      iterator& operator ++()
+      {
+         settle();
+         return *this;
+      }
+      iterator  operator ++(int)
+      {
+         iterator temp(*this);
+         settle();
+         return temp;
+      }
+
+      bool operator ==(const iterator& rhs) const { return pCurrent == rhs.pCurrent; }
+      bool operator !=(const iterator& rhs) const { return pCurrent != rhs.pCurrent; }
+
+   private:
+      // move to the next key that is not erased, or the next key at all
+      // when keepErased is set
+      void settle()
+      {
+         while (true)
+         {
+            const Entry* pMin = nullptr;
+            for (size_t iSource = 0; iSource < sources.size(); iSource++)
+            {
+               const std::vector<Entry>& entries = sources[iSource]->entries;
+               if (positions[iSource] < entries.size() &&
+                   (!pMin || !(pMin->key < entries[positions[iSource]].key)))
+                  pMin = &entries[positions[iSource]];   // smaller, or as small and newer
+            }
+            if (!pMin)
+            {
+               pCurrent = nullptr;
+               return;
+            }
+
+            for (size_t iSource = 0; iSource < sources.size(); iSource++)
+            {
+               const std::vector<Entry>& entries = sources[iSource]->entries;
+               if (positions[iSource] < entries.size() &&
+                   !(pMin->key < entries[positions[iSource]].key))
+                  positions[iSource]++;
+            }
+            if (!pMin->erased || keepErased)
+            {
+               pCurrent = pMin;
+               return;
+            }
+         }
+      }
+
+      std::vector<std::shared_ptr<const Run>> sources; // oldest first; the memtable last
+      std::vector<size_t> positions;                   // the next entry in each source
+      const Entry* pCurrent;                           // in one of the sources; nullptr at the end
+      bool keepErased;                                 // stop at tombstones too, for a compaction
+   };
+
+   /*********************************************
+    * LSM BST :: CONSTRUCTOR
+    * Start the compactor if compactions go in the
+    * background; otherwise the writer that crowds a tier
+    * compacts before it returns
+    ********************************************/
+   template <typename T, class Hash>
+   LsmBST<T, Hash>::LsmBST(size_t memtableLimit, size_t maxRuns, bool background) :
+      memtableLimit(memtableLimit > 0 ? memtableLimit : 1), maxRuns(maxRuns > 0 ? maxRuns : 1),
+      numCompactions(0), numMerged(0), background(background), wanted(false), stopping(false)
+   {
+      if (background)
+         thread = std::thread(&LsmBST::compactor, this);
+   }
+
+   /*********************************************
+    * LSM BST :: DESTRUCTOR
+    * Let a compaction under way finish, then stop
+    ********************************************/
+   template <typename T, class Hash>
+   LsmBST<T, Hash>::~LsmBST()
+   {
+      if (thread.joinable())
+      {
+         {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+         }
+         wake.notify_one();
+         thread.join();
+      }
+   }
+
+   /*********************************************
+    * LSM BST :: WRITE
+    * Put the entry in the memtable, or overwrite the one
+    * already there for the same key in place, and freeze
+    * the memtable if that filled it
+    ********************************************/
+   template <typename T, class Hash>
+   void LsmBST<T, Hash>::write(const Entry& entry)
+   {
+      bool tooMany = false;
+      {
+         WriteLock lock(mutex);
+         auto inserted = memtable.insert(entry, true /*keepUnique*/);
+         if (!inserted.second)
+            (*inserted.first).erased = entry.erased;
+         if (memtable.size() >= memtableLimit)
+         {
+            runs.push_back(freeze(true));
+            memtable.clear();
+            size_t iFirst;
+            size_t iLast;
+            tooMany = crowded(iFirst, iLast);
+         }
+      }
+
+      if (!tooMany)
+         return;
+      if (!background)
+         compactNow(false);
+      else
+      {
+         {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wanted = true;
+         }
+         wake.notify_one();
+      }
+   }
+
+   /*********************************************
+    * LSM BST :: FLUSH
+    * Freeze the memtable now, even if it is not full
+    ********************************************/
+   template <typename T, class Hash>
+   void LsmBST<T, Hash>::flush()
+   {
+      WriteLock lock(mutex);
+      if (memtable.empty())
+         return;
+      runs.push_back(freeze(true));
+      memtable.clear();
+   }
+
+   /*********************************************
+    * LSM BST :: COMPACT
+    * Merge every run into one now, and wait for it
+    ********************************************/
+   template <typename T, class Hash>
+   void LsmBST<T, Hash>::compact()
+   {
+      compactNow(true);
+   }
+
+   /*********************************************
+    * LSM BST :: CONTAINS
+    * The newest entry for t decides: the memtable's, or
+    * the first run's, newest first, whose Bloom filter
+    * lets it through and that has t
+    ********************************************/
+   template <typename T, class Hash>
+   bool LsmBST<T, Hash>::contains(const T& t) const
+   {
+      ReadLock lock(mutex);
+      auto it = memtable.find(Entry{ t, false });
+      if (it != memtable.end())
+         return !(*it).erased;
+
+      size_t h = hash(t);
+      for (auto itRun = runs.rbegin(); itRun != runs.rend(); ++itRun)
+      {
+         if (!(*itRun)->bloom.mayContain(h))
+            continue;
+         if (const Entry* pEntry = (*itRun)->find(t))
+            return !pEntry->erased;
+      }
+      return false;
+   }
+
+   /*********************************************
+    * LSM BST :: BEGIN
+    * A scan from the smallest key. The memtable is copied,
+    * and the runs are shared, under the lock
+    ********************************************/
+   template <typename T, class Hash>
+   typename LsmBST<T, Hash>::iterator LsmBST<T, Hash>::begin() const
+   {
+      iterator it;
+      {
+         ReadLock lock(mutex);
+         it.sources = runs;
+         it.sources.push_back(freeze(false));
+      }
+      it.positions.assign(it.sources.size(), 0);
+      it.settle();
+      return it;
+   }
+
+   /*********************************************
+    * LSM BST :: LOWER BOUND
+    * A scan from the first key not less than t
+    ********************************************/
+   template <typename T, class Hash>
+   typename LsmBST<T, Hash>::iterator LsmBST<T, Hash>::lower_bound(const T& t) const
+   {
+      iterator it;
+      {
+         ReadLock lock(mutex);
+         it.sources = runs;
+         it.sources.push_back(freeze(false));
+      }
+      for (const std::shared_ptr<const Run>& pSource : it.sources)
+         it.positions.push_back(std::lower_bound(pSource->entries.begin(), pSource->entries.end(),
+                                                 Entry{ t, false }) - pSource->entries.begin());
+      it.settle();
+      return it;
+   }
+
+   /*********************************************
+    * LSM BST :: FREEZE
+    * The memtable as a run, tombstones and all. The caller
+    * holds the lock
+    ********************************************/
+   template <typename T, class Hash>
+   std::shared_ptr<const typename LsmBST<T, Hash>::Run> LsmBST<T, Hash>::freeze(bool withBloom) const
+   {
+      std::shared_ptr<Run> pRun = std::make_shared<Run>();
+      pRun->entries.reserve(memtable.size());
+      for (auto it = memtable.begin(); it != memtable.end(); ++it)
+         pRun->entries.push_back(*it);
+      if (withBloom)
+      {
+         pRun->bloom = lsm::BloomFilter(pRun->entries.size());
+         for (const Entry& entry : pRun->entries)
+            pRun->bloom.add(hash(entry.key));
+      }
+      return pRun;
+   }
+
+   /*********************************************
+    * LSM BST :: CROWDED
+    * The newest tier holding more than maxRuns runs, as
+    * [iFirst, iLast) in runs. The caller holds the lock
+    ********************************************/
+   template <typename T, class Hash>
+   bool LsmBST<T, Hash>::crowded(size_t& iFirst, size_t& iLast) const
+   {
+      iLast = runs.size();
+      while (iLast > 0)
+      {
+         iFirst = iLast - 1;
+         while (iFirst > 0 && runs[iFirst - 1]->tier == runs[iLast - 1]->tier)
+            iFirst--;
+         if (iLast - iFirst > maxRuns)
+            return true;
+         iLast = iFirst;
+      }
+      return false;
+   }
+
+   /*********************************************
+    * LSM BST :: COMPACT NOW
+    * Merge runs without the lock: every run if all is set,
+    * otherwise each crowded tier into one run of the next,
+    * until none is crowded. Only a merge that takes in the
+    * oldest run drops tombstones, since there is no older
+    * entry left for them to hide. Runs frozen meanwhile go
+    * after the merged ones, since they are newer
+    ********************************************/
+   template <typename T, class Hash>
+   void LsmBST<T, Hash>::compactNow(bool all)
+   {
+      std::lock_guard<std::mutex> lockCompacting(compacting);
+
+      while (true)
+      {
+         iterator it;
+         size_t iFirst = 0;
+         size_t iLast;
+         size_t tier = 0;
+         {
+            ReadLock lock(mutex);
+            if (all)
+            {
+               iLast = runs.size();
+               if (iLast < 2)
+                  return;
+            }
+            else if (!crowded(iFirst, iLast))
+               return;
+            it.sources.assign(runs.begin() + iFirst, runs.begin() + iLast);
+         }
+         for (const std::shared_ptr<const Run>& pSource : it.sources)
+            tier = std::max(tier, pSource->tier);
+         it.keepErased = iFirst > 0;
+         it.positions.assign(it.sources.size(), 0);
+         it.settle();
+
+         size_t numEntries = 0;
+         for (const std::shared_ptr<const Run>& pSource : it.sources)
+            numEntries += pSource->entries.size();
+         std::shared_ptr<Run> pMerged = std::make_shared<Run>();
+         pMerged->entries.reserve(numEntries);
+         for (; it != end(); ++it)
+            pMerged->entries.push_back(*it.pCurrent);
+         pMerged->bloom = lsm::BloomFilter(pMerged->entries.size());
+         for (const Entry& entry : pMerged->entries)
+            pMerged->bloom.add(hash(entry.key));
+         pMerged->tier = all ? tier : tier + 1;
+
+         {
+            WriteLock lock(mutex);
+            runs.erase(runs.begin() + iFirst, runs.begin() + iLast);
+            if (!pMerged->entries.empty())
+               runs.insert(runs.begin() + iFirst, pMerged);
+         }
+         numCompactions++;
+         numMerged += pMerged->entries.size();
+         if (all)
+            return;
+      }
+   }
+
+   /*********************************************
+    * LSM BST :: COMPACTOR
+    * The background thread: sleep until a writer crowds
+    * a tier, then compact
+    ********************************************/
+   template <typename T, class Hash>
+   void LsmBST<T, Hash>::compactor()
+   {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      while (true)
+      {
+         wake.wait(lock, [this]() { return wanted || stopping; });
+         if (stopping)
+            return;
+         wanted = false;
+         lock.unlock();
+         compactNow(false);
+         lock.lock();
+      }
+   }
+
+} // namespace custom
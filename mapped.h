@@ -0,0 +1,395 @@
+/***********************************************************************
+ * Header:
+ *    MAPPED
+ * Summary:
+ *    A read-only tree stored in a file and queried in place through a
+ *    memory map, so opening it costs nothing however large it is.
+ *
+ *    The layout is a static B+ tree of two levels, with offsets in
+ *    place of pointers:
+ *        header  one page       magic, element width, counts, offsets
+ *        keys    page aligned   every key in sorted order, so a page
+ *                               of the file is a leaf of the tree
+ *        index   after keys     the first key of each page, sorted
+ *    A search looks through the index, which is small and stays in
+ *    memory, then through the one leaf page it names: one page read
+ *    per lookup when the file is cold. Iterating is walking the keys.
+ *
+ *    Only trivially copyable types can be stored; numbers are in the
+ *    byte order of the machine that wrote the file.
+ *
+ *    This will contain the class definition of:
+ *        MappedBST           : A tree in a memory-mapped file
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <algorithm>   // for std::lower_bound and std::upper_bound
+#include <cstdint>     // for uint32_t and uint64_t
+#include <cstring>     // for std::memcmp
+#include <fstream>     // for std::ofstream
+#include <string>      // for std::string
+#include <type_traits> // for std::is_trivially_copyable_v
+#include <utility>     // for std::swap
+#include <vector>      // for std::vector
+#include "bst.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#include <windows.h>   // for CreateFileMapping and MapViewOfFile
+#else // !_WIN32
+#include <fcntl.h>     // for open
+#include <sys/mman.h>  // for mmap and munmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for close
+#endif // !_WIN32
+
+class TestMapped; // forward declaration for unit tests
+
+namespace custom
+{
+
+   /*****************************************************************
+    * MAPPED BST
+    * A sorted, read-only set of keys in a memory-mapped file
+    *****************************************************************/
+   template <typename T>
+   class MappedBST
+   {
+      static_assert(std::is_trivially_copyable_v<T>, "MappedBST stores its keys as raw bytes");
+      friend class ::TestMapped; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      MappedBST() : pBase(nullptr), numBytes(0), keys(nullptr), index(nullptr),
+                    num(0), perPage(1), numPages(0)
+      {
+#ifdef _WIN32
+         hFile = INVALID_HANDLE_VALUE;
+         hMapping = nullptr;
+#endif // _WIN32
+      }
+      MappedBST(MappedBST&& rhs) noexcept : MappedBST() { swap(rhs); }
+      MappedBST& operator =(MappedBST&& rhs) noexcept
+      {
+         close();
+         swap(rhs);
+         return *this;
+      }
+      MappedBST(const MappedBST& rhs) = delete;
+      MappedBST& operator =(const MappedBST& rhs) = delete;
+      ~MappedBST() { close(); }
+
+      //
+      // Files
+      //
+
+      static bool write(const BST<T>& bst, const std::string& path)
+      {
+         return write(bst.begin(), bst.end(), path);
+      }
+      template <class InputIt>
+      static bool write(InputIt first, InputIt last, const std::string& path);
+
+      bool open(const std::string& path);
+      void close() noexcept;
+      void swap(MappedBST& rhs) noexcept;
+
+      //
+      // Iterator
+      //
+
+      typedef const T* iterator;
+      iterator begin() const noexcept { return keys; }
+      iterator end()   const noexcept { return keys + num; }
+
+      //
+      // Access
+      //
+
+      iterator find(const T& t) const;
+      iterator lower_bound(const T& t) const;
+      iterator upper_bound(const T& t) const;
+
+      //
+      // Status
+      //
+
+      bool   empty()  const noexcept { return num == 0; }
+      size_t size()   const noexcept { return num; }
+      bool   isOpen() const noexcept { return pBase != nullptr; }
+
+   private:
+      static constexpr size_t pageSize = 4096;
+
+      struct Header
+      {
+         char     magic[4];     // "BSTM"
+         uint32_t width;        // sizeof(T)
+         uint64_t num;          // number of keys
+         uint64_t perPage;      // keys in one leaf page
+         uint64_t numPages;     // leaf pages, and entries in the index
+         uint64_t keysOffset;   // where the keys start
+         uint64_t indexOffset;  // where the index starts
+      };
+      static constexpr char magic[4] = { 'B', 'S', 'T', 'M' };
+      static constexpr size_t keysPerPage = pageSize / sizeof(T) > 0 ? pageSize / sizeof(T) : 1;
+
+      // the keys of the leaf page where the search for t ends
+      void pageRange(size_t iAfter, const T*& pBegin, const T*& pEnd) const;
+
+      // the mapping
+      void*  pBase;
+      size_t numBytes;
+#ifdef _WIN32
+      HANDLE hFile;
+      HANDLE hMapping;
+#endif // _WIN32
+
+      // views into the mapping
+      const T* keys;
+      const T* index;
+      size_t num;
+      size_t perPage;
+      size_t numPages;
+   };
+
+   /*********************************************
+    * MAPPED BST :: WRITE
+    * Stream the sorted keys in [first, last) into a new
+    * file. The first key of each page is kept aside for
+    * the index, which goes after the keys; the header is
+    * filled in last. False if the keys are out of order or
+    * the file could not be written
+    ********************************************/
+   template <typename T>
+   template <class InputIt>
+   bool MappedBST<T>::write(InputIt first, InputIt last, const std::string& path)
+   {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      if (!out)
+         return false;
+
+      std::vector<char> padding(pageSize, 0);
+      out.write(padding.data(), pageSize);
+
+      std::vector<T> pageFirst;     // becomes the index
+      std::vector<T> block;         // the page being filled
+      std::vector<T> previous;      // the last key of the page before
+      block.reserve(keysPerPage);
+      uint64_t count = 0;
+      for (; first != last && out; ++first)
+      {
+         const T& t = *first;
+         if (!block.empty() ? t < block.back() : !previous.empty() && t < previous.back())
+            return false;
+         if (block.empty())
+            pageFirst.push_back(t);
+         block.push_back(t);
+         count++;
+         if (block.size() == keysPerPage)
+         {
+            out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(T));
+            previous.assign(1, block.back());
+            block.clear();
+         }
+      }
+      out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(T));
+
+      Header header;
+      std::memcpy(header.magic, magic, sizeof(magic));
+      header.width       = (uint32_t)sizeof(T);
+      header.num         = count;
+      header.perPage     = keysPerPage;
+      header.numPages    = pageFirst.size();
+      header.keysOffset  = pageSize;
+      header.indexOffset = pageSize + count * sizeof(T);
+      out.write(reinterpret_cast<const char*>(pageFirst.data()), pageFirst.size() * sizeof(T));
+      out.seekp(0);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.close();
+      return bool(out);
+   }
+
+   /*********************************************
+    * MAPPED BST :: OPEN
+    * Map a file written by write() and check that its
+    * header fits the file and this type. Nothing is read
+    * until it is searched. False, and closed, otherwise
+    ********************************************/
+   template <typename T>
+   bool MappedBST<T>::open(const std::string& path)
+   {
+      close();
+
+#ifdef _WIN32
+      hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (hFile == INVALID_HANDLE_VALUE)
+         return false;
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(hFile, &size) || (uint64_t)size.QuadPart < sizeof(Header))
+      {
+         CloseHandle(hFile);
+         return false;
+      }
+      hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!hMapping)
+      {
+         CloseHandle(hFile);
+         return false;
+      }
+      pBase = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+      if (!pBase)
+      {
+         CloseHandle(hMapping);
+         CloseHandle(hFile);
+         return false;
+      }
+      numBytes = (size_t)size.QuadPart;
+#else // !_WIN32
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+         return false;
+      struct stat status;
+      if (fstat(fd, &status) != 0 || (uint64_t)status.st_size < sizeof(Header))
+      {
+         ::close(fd);
+         return false;
+      }
+      void* p = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);   // the mapping keeps the file open
+      if (p == MAP_FAILED)
+         return false;
+      pBase = p;
+      numBytes = (size_t)status.st_size;
+#endif // !_WIN32
+
+      const Header* pHeader = static_cast<const Header*>(pBase);
+      if (std::memcmp(pHeader->magic, magic, sizeof(magic)) != 0 ||
+          pHeader->width != sizeof(T) ||
+          pHeader->perPage == 0 ||
+          pHeader->numPages != (pHeader->num + pHeader->perPage - 1) / pHeader->perPage ||
+          pHeader->keysOffset % alignof(T) != 0 ||
+          pHeader->indexOffset % alignof(T) != 0 ||
+          pHeader->keysOffset + pHeader->num * sizeof(T) > numBytes ||
+          pHeader->indexOffset + pHeader->numPages * sizeof(T) > numBytes)
+      {
+         close();
+         return false;
+      }
+
+      const char* pBytes = static_cast<const char*>(pBase);
+      keys     = reinterpret_cast<const T*>(pBytes + pHeader->keysOffset);
+      index    = reinterpret_cast<const T*>(pBytes + pHeader->indexOffset);
+      num      = (size_t)pHeader->num;
+      perPage  = (size_t)pHeader->perPage;
+      numPages = (size_t)pHeader->numPages;
+      return true;
+   }
+
+   /*********************************************
+    * MAPPED BST :: CLOSE
+    * Unmap the file; every iterator is now stale
+    ********************************************/
+   template <typename T>
+   void MappedBST<T>::close() noexcept
+   {
+      if (pBase)
+      {
+#ifdef _WIN32
+         UnmapViewOfFile(pBase);
+         CloseHandle(hMapping);
+         CloseHandle(hFile);
+#else // !_WIN32
+         munmap(pBase, numBytes);
+#endif // !_WIN32
+      }
+      pBase = nullptr;
+      numBytes = 0;
+      keys = index = nullptr;
+      num = numPages = 0;
+      perPage = 1;
+   }
+
+   /*********************************************
+    * MAPPED BST :: SWAP
+    ********************************************/
+   template <typename T>
+   void MappedBST<T>::swap(MappedBST& rhs) noexcept
+   {
+      std::swap(pBase, rhs.pBase);
+      std::swap(numBytes, rhs.numBytes);
+#ifdef _WIN32
+      std::swap(hFile, rhs.hFile);
+      std::swap(hMapping, rhs.hMapping);
+#endif // _WIN32
+      std::swap(keys, rhs.keys);
+      std::swap(index, rhs.index);
+      std::swap(num, rhs.num);
+      std::swap(perPage, rhs.perPage);
+      std::swap(numPages, rhs.numPages);
+   }
+
+   /*********************************************
+    * MAPPED BST :: PAGE RANGE
+    * iAfter is the first page the index places after the
+    * answer, so the answer is in the page before it or is
+    * the first key of page iAfter itself
+    ********************************************/
+   template <typename T>
+   void MappedBST<T>::pageRange(size_t iAfter, const T*& pBegin, const T*& pEnd) const
+   {
+      size_t iPage = iAfter > 0 ? iAfter - 1 : 0;
+      pBegin = keys + iPage * perPage;
+      pEnd   = keys + (iAfter * perPage < num ? iAfter * perPage : num);
+   }
+
+   /*********************************************
+    * MAPPED BST :: LOWER BOUND
+    * The first key not less than t, or end()
+    ********************************************/
+   template <typename T>
+   typename MappedBST<T>::iterator MappedBST<T>::lower_bound(const T& t) const
+   {
+      size_t iAfter = std::lower_bound(index, index + numPages, t) - index;
+      const T* pBegin;
+      const T* pEnd;
+      pageRange(iAfter, pBegin, pEnd);
+      return std::lower_bound(pBegin, pEnd, t);
+   }
+
+   /*********************************************
+    * MAPPED BST :: UPPER BOUND
+    * The first key greater than t, or end()
+    ********************************************/
+   template <typename T>
+   typename MappedBST<T>::iterator MappedBST<T>::upper_bound(const T& t) const
+   {
+      size_t iAfter = std::upper_bound(index, index + numPages, t) - index;
+      const T* pBegin;
+      const T* pEnd;
+      pageRange(iAfter, pBegin, pEnd);
+      return std::upper_bound(pBegin, pEnd, t);
+   }
+
+   /*********************************************
+    * MAPPED BST :: FIND
+    * The first key equivalent to t, or end()
+    ********************************************/
+   template <typename T>
+   typename MappedBST<T>::iterator MappedBST<T>::find(const T& t) const
+   {
+      iterator it = lower_bound(t);
+      if (it != end() && !(t < *it))
+         return it;
+      return end();
+   }
+
+} // namespace custom
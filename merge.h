@@ -0,0 +1,258 @@
+/***********************************************************************
+ * Header:
+ *    MERGE
+ * Summary:
+ *    One ordered scan across several BSTs without copying them into a
+ *    temporary tree. Each tree, or a range of one, is a source; the
+ *    scan keeps a loser tree (a tournament) over the sources' current
+ *    elements, so stepping costs one comparison per level, ceil(log2 k)
+ *    for k sources, whatever the sizes of the trees.
+ *
+ *    The loser tree is k-1 internal matches over k leaves, one per
+ *    source. Each match remembers who lost; the overall winner is kept
+ *    aside. When the winner's source steps, it only has to replay the
+ *    matches on its own path to the root, against the losers stored
+ *    there. A source that runs out loses every match.
+ *
+ *    Equal elements come out in the order of their sources. With
+ *    unique, only the first of a run of equal elements comes out, from
+ *    whichever sources hold it. seek() jumps forward to the first
+ *    element not less than a key with each tree's lower_bound().
+ *
+ *    This will contain the class definition of:
+ *        MergeIterator          : A forward iterator over many trees
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cstddef>     // for std::ptrdiff_t
+#include <iterator>    // for std::forward_iterator_tag
+#include <utility>     // for std::move and std::swap
+#include <vector>      // for std::vector
+#include "bst.h"
+
+class TestMerge; // forward declaration for unit tests
+
+namespace custom
+{
+
+   /*****************************************************************
+    * MERGE ITERATOR
+    * Walks the elements of several trees in order, as if they were
+    * one. Default constructed, it is the end of every scan. The
+    * trees must outlive it and not change while it runs
+    *****************************************************************/
+   template <typename T>
+   class MergeIterator
+   {
+      friend class ::TestMerge; // give unit tests access to private members
+   public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef T                         value_type;
+      typedef std::ptrdiff_t            difference_type;
+      typedef const T*                  pointer;
+      typedef const T&                  reference;
+
+      // one tree, or [first, last) of it
+      struct Range
+      {
+         Range(const BST<T>& tree) : pTree(&tree), it(tree.begin()), last(tree.end()) {}
+         Range(const BST<T>& tree, typename BST<T>::iterator first, typename BST<T>::iterator last) :
+            pTree(&tree), it(first), last(last) {}
+
+         const BST<T>* pTree;
+         typename BST<T>::iterator it;     // the element this source offers
+         typename BST<T>::iterator last;   // where it runs out
+      };
+
+      //
+      // Construct
+      //
+
+      MergeIterator() : iWinner(0), unique(false), pPrevious(nullptr) {}
+      MergeIterator(std::vector<Range> ranges, bool unique = false);
+
+      //
+      // Access
+      //
+
+      const T& operator *() const { return *sources[iWinner].it; }
+      bool done() const noexcept  { return sources.empty() || isDone(iWinner); }
+
+      bool operator ==(const MergeIterator& rhs) const
+      {
+         if (done() || rhs.done())
+            return done() == rhs.done();
+         return sources[iWinner].it == rhs.sources[rhs.iWinner].it;
+      }
+      bool operator !=(const MergeIterator& rhs) const { return !(*this == rhs); }
+
+      //
+      // Move
+      //
+
+      MergeIterator& operator ++();
+      MergeIterator  operator ++(int)
+      {
+         MergeIterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+      MergeIterator& seek(const T& t);
+
+   private:
+      bool isDone(size_t iSource) const { return sources[iSource].it == sources[iSource].last; }
+      bool beats(size_t iLeft, size_t iRight) const;
+      size_t build(size_t iNode);
+      void replay(size_t iSource);
+      void step();
+      void skipRepeats();
+
+      std::vector<Range> sources;   // leaf i of the tournament
+      std::vector<size_t> losers;   // losers[n] lost the match at node n, 1 <= n < k
+      size_t iWinner;               // the source offering the next element
+      bool unique;                  // skip repeats of the element just given
+      const T* pPrevious;           // the element just given, when unique
+   };
+
+   /*********************************************
+    * MERGE ITERATOR :: CONSTRUCTOR
+    * Hold the first match of every pair and stand on the
+    * smallest element of all the sources
+    ********************************************/
+   template <typename T>
+   MergeIterator<T>::MergeIterator(std::vector<Range> ranges, bool unique) :
+      sources(std::move(ranges)), losers(sources.size()), iWinner(0),
+      unique(unique), pPrevious(nullptr)
+   {
+      if (!sources.empty())
+         iWinner = build(1);
+   }
+
+   /*********************************************
+    * MERGE ITERATOR :: INCREMENT
+    * Step the winning source and replay its matches
+    ********************************************/
+   template <typename T>
+   MergeIterator<T>& MergeIterator<T>::operator ++()
+   {
+      if (unique)
+         pPrevious = &*sources[iWinner].it;
+      step();
+      skipRepeats();
+      return *this;
+   }
+
+   /*********************************************
+    * MERGE ITERATOR :: SEEK
+    * Move forward to the first element not less than t.
+    * A source already there stays where it is; the others
+    * jump with their tree's lower_bound(). Then the matches
+    * are played again from the start
+    ********************************************/
+   template <typename T>
+   MergeIterator<T>& MergeIterator<T>::seek(const T& t)
+   {
+      if (done() || !(*sources[iWinner].it < t))
+         return *this;
+
+      for (Range& source : sources)
+      {
+         if (source.it == source.last || !(*source.it < t))
+            continue;
+         source.it = source.pTree->lower_bound(t);
+         // a range ends before its last; past that, this source is spent
+         if (source.it == source.pTree->end() ||
+             (source.last != source.pTree->end() && *source.last < *source.it))
+            source.it = source.last;
+      }
+      iWinner = build(1);
+      pPrevious = nullptr;
+      return *this;
+   }
+
+   /*********************************************
+    * MERGE ITERATOR :: BEATS
+    * Does the left source's element come first? A spent
+    * source never wins; between equals the lower source
+    * does. One comparison at most
+    ********************************************/
+   template <typename T>
+   bool MergeIterator<T>::beats(size_t iLeft, size_t iRight) const
+   {
+      if (isDone(iLeft))
+         return false;
+      if (isDone(iRight))
+         return true;
+      if (iLeft < iRight)
+         return !(*sources[iRight].it < *sources[iLeft].it);
+      return *sources[iLeft].it < *sources[iRight].it;
+   }
+
+   /*********************************************
+    * MERGE ITERATOR :: BUILD
+    * Play every match under node iNode, recording the
+    * losers, and return the winner. Nodes 1 .. k-1 are
+    * matches and k .. 2k-1 are the sources, as in a heap
+    ********************************************/
+   template <typename T>
+   size_t MergeIterator<T>::build(size_t iNode)
+   {
+      size_t k = sources.size();
+      if (iNode >= k)
+         return iNode - k;
+      size_t iLeft = build(2 * iNode);
+      size_t iRight = build(2 * iNode + 1);
+      if (beats(iLeft, iRight))
+      {
+         losers[iNode] = iRight;
+         return iLeft;
+      }
+      losers[iNode] = iLeft;
+      return iRight;
+   }
+
+   /*********************************************
+    * MERGE ITERATOR :: REPLAY
+    * The element of source iSource changed: play it
+    * against the losers on its way to the root
+    ********************************************/
+   template <typename T>
+   void MergeIterator<T>::replay(size_t iSource)
+   {
+      size_t iCandidate = iSource;
+      for (size_t iNode = (iSource + sources.size()) / 2; iNode > 0; iNode /= 2)
+         if (beats(losers[iNode], iCandidate))
+            std::swap(losers[iNode], iCandidate);
+      iWinner = iCandidate;
+   }
+
+   /*********************************************
+    * MERGE ITERATOR :: STEP
+    * Move past the winning element
+    ********************************************/
+   template <typename T>
+   void MergeIterator<T>::step()
+   {
+      ++sources[iWinner].it;
+      replay(iWinner);
+   }
+
+   /*********************************************
+    * MERGE ITERATOR :: SKIP REPEATS
+    * When unique, step past anything equal to what we
+    * just gave. The nodes of the trees do not move, so
+    * the previous element is still where it was
+    ********************************************/
+   template <typename T>
+   void MergeIterator<T>::skipRepeats()
+   {
+      if (!unique || !pPrevious)
+         return;
+      while (!done() && !(*pPrevious < *sources[iWinner].it))
+         step();
+   }
+
+} // namespace custom
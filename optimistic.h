@@ -0,0 +1,772 @@
+/***********************************************************************
+ * Header:
+ *    OPTIMISTIC
+ * Summary:
+ *    A concurrent set with no lock over the whole tree, after Bronson,
+ *    Casper, Chafi and Olukotun, "A Practical Concurrent Binary Search
+ *    Tree" (PPoPP 2010). Each node carries its own lock and a version.
+ *
+ *    Readers take no lock. Walking down, they note each node's version,
+ *    read the child, and check the version again before stepping on.
+ *    A node's version changes only when a rotation moves it down (so
+ *    that keys that used to be below it may no longer be) or when it is
+ *    unlinked; a reader that sees the change backs up one level and
+ *    tries again from there, not from the root.
+ *
+ *    Writers search the same way, then lock only the nodes they change:
+ *    the parent for a new leaf, the parent and the node to unlink one,
+ *    and up to four nodes for a rotation, always top-down. Erasing a
+ *    node with two children only marks it absent; it stays as a routing
+ *    node until it is down to one child, when it is unlinked too.
+ *
+ *    The balance is a relaxed AVL: heights are repaired on the way back
+ *    up after every change, so a tree left alone is strictly AVL, but
+ *    while writers race it may briefly be off by more than one.
+ *
+ *    Unlinked nodes are freed by epoch-based reclamation (see epoch.h).
+ *
+ *    This will contain the class definition of:
+ *        concurrent::OptimisticBST : A set with per-node locks and versions
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <atomic>       // for std::atomic
+#include <cstdint>      // for uint64_t
+#include <mutex>        // for std::mutex and std::lock_guard
+#include <optional>     // for std::optional
+#include <vector>       // for std::vector
+#include "epoch.h"      // for epoch::Guard and epoch::Retired
+
+class TestOptimistic; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace concurrent
+   {
+
+   /*****************************************************************
+    * OPTIMISTIC BST
+    * A set whose readers validate versions instead of locking
+    *****************************************************************/
+   template <typename T>
+   class OptimisticBST
+   {
+      friend class ::TestOptimistic; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      OptimisticBST() {}
+      OptimisticBST(const OptimisticBST& rhs) = delete;
+      OptimisticBST& operator =(const OptimisticBST& rhs) = delete;
+      ~OptimisticBST();
+
+      //
+      // Read: lock-free
+      //
+
+      bool             contains(const T& t) const { return find(t).has_value(); }
+      std::optional<T> find(const T& t) const;
+      std::vector<T>   snapshot() const;
+      size_t           size() const { return numElements.load(std::memory_order_relaxed); }
+      bool             empty() const { return size() == 0; }
+
+      //
+      // Write: locks a few nodes
+      //
+
+      bool insert(const T& t);
+      bool erase(const T& t);
+      void clear();
+
+   private:
+
+      class Link;
+      class BNode;
+
+      enum Outcome { done, retry };
+
+      // version bits: unlinked is final; shrinking is set while a rotation
+      // moves the node down, and each finished one adds shrinkCountIncr
+      static const uint64_t unlinked        = 1;
+      static const uint64_t shrinking       = 2;
+      static const uint64_t shrinkCountIncr = 4;
+
+      // what nodeCondition() can ask for, besides a new height
+      static const int nothingRequired   = -1;
+      static const int unlinkRequired    = -2;
+      static const int rebalanceRequired = -3;
+
+      // spins before waiting for a rotation on its node's lock
+      static const int spinsBeforeLock = 100;
+
+      // unlinked nodes to collect before trying to free them
+      static const size_t reclaimBatch = 64;
+
+      static int  compare(const T& t, const T& key) { return t < key ? -1 : (key < t ? 1 : 0); }
+      static int  height(const Link* p) { return p ? p->height.load() : 0; }
+      static bool isShrinkingOrUnlinked(uint64_t version) { return version & (shrinking | unlinked); }
+      static bool isUnlinked(uint64_t version) { return version & unlinked; }
+      static void waitUntilNotChanging(Link* p);
+
+      Outcome attemptFind(const T& t, Link* pNode, int dir, uint64_t version, const BNode*& pFound) const;
+      Outcome attemptUpdate(const T& t, bool isInsert, Link* pNode, int dir, uint64_t version, bool& wasPresent);
+      Outcome attemptNodeUpdate(bool isInsert, Link* pParent, BNode* pNode, bool& wasPresent);
+      bool    attemptUnlink(Link* pParent, BNode* pNode);
+
+      // repairing heights and balance on the way up; the ones that take
+      // a node expect it (and its parent, if they take that) to be locked
+      void  fixHeightAndRebalance(Link* pNode);
+      static int nodeCondition(Link* p);
+      static Link* fixHeight(Link* p);
+      Link* rebalance(Link* pParent, BNode* pNode);
+      Link* rebalanceFrom(Link* pParent, BNode* pNode, int side, BNode* pChild, int hOther);
+      Link* rotate(Link* pParent, BNode* pNode, int side, BNode* pChild,
+                   int hOther, int hOuter, BNode* pInner, int hInner);
+      Link* rotateDouble(Link* pParent, BNode* pNode, int side, BNode* pChild,
+                         int hOther, int hOuter, BNode* pInner, int hInnerOuter);
+
+      void retire(BNode* p);
+
+      mutable Link holder;                  // the root is its right child
+      std::atomic<size_t> numElements{ 0 }; // kept by insert() and erase(), exact once writers are done
+      std::mutex retiredMutex;              // guards retired
+      epoch::Retired<BNode> retired;        // unlinked nodes readers may still hold
+   };
+
+   /*****************************************************************
+    * OPTIMISTIC BST LINK
+    * Everything a node has but its key. The holder above the root
+    * is only this, so rebalancing can treat it as one more parent.
+    * All of it is atomic: writers read their neighbors unlocked
+    *****************************************************************/
+   template <typename T>
+   class OptimisticBST<T>::Link
+   {
+   public:
+      Link() : pLeft(nullptr), pRight(nullptr), pParent(nullptr), height(0), version(0), isPresent(false)
+      {}
+
+      std::atomic<BNode*>& child(int dir) { return dir < 0 ? pLeft : pRight; }
+
+      std::atomic<BNode*>   pLeft;      // left child
+      std::atomic<BNode*>   pRight;     // right child
+      std::atomic<Link*>    pParent;    // parent, or nullptr for the holder
+      std::atomic<int>      height;     // 1 for a leaf
+      std::atomic<uint64_t> version;    // see unlinked and shrinking
+      std::atomic<bool>     isPresent;  // false for a routing node
+      std::mutex            mutex;      // held to change any of the above
+   };
+
+   /*****************************************************************
+    * OPTIMISTIC BST NODE
+    *****************************************************************/
+   template <typename T>
+   class OptimisticBST<T>::BNode : public Link
+   {
+   public:
+      BNode(const T& t, Link* pParent) : key(t)
+      {
+         this->pParent = pParent;
+         this->height = 1;
+         this->isPresent = true;
+      }
+
+      const T key;                      // never changes
+   };
+
+   /*********************************************
+    * OPTIMISTIC BST :: DESTRUCTOR
+    * No other thread may still be using the tree
+    ********************************************/
+   template <typename T>
+   OptimisticBST<T>::~OptimisticBST()
+   {
+      std::vector<BNode*> stack;
+      if (BNode* p = holder.pRight.load())
+         stack.push_back(p);
+      while (!stack.empty())
+      {
+         BNode* p = stack.back();
+         stack.pop_back();
+         if (p->pLeft.load())
+            stack.push_back(p->pLeft.load());
+         if (p->pRight.load())
+            stack.push_back(p->pRight.load());
+         delete p;
+      }
+   }
+
+   /****************************************************
+    * OPTIMISTIC BST :: FIND
+    * A copy of the element equivalent to t, if there is one
+    ****************************************************/
+   template <typename T>
+   std::optional<T> OptimisticBST<T>::find(const T& t) const
+   {
+      epoch::Guard guard;
+      const BNode* pFound = nullptr;
+      while (attemptFind(t, &holder, 1, holder.version.load(), pFound) == retry)
+         ;
+      if (pFound && pFound->isPresent.load())
+         return pFound->key;
+      return std::nullopt;
+   }
+
+   /****************************************************
+    * OPTIMISTIC BST :: ATTEMPT FIND
+    * t is below pNode on side dir, and pNode's version was
+    * version when we got here. Find the node holding t, or
+    * nullptr. A retry means pNode changed under us: back up
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Outcome OptimisticBST<T>::attemptFind(const T& t, Link* pNode, int dir,
+                                                                  uint64_t version, const BNode*& pFound) const
+   {
+      while (true)
+      {
+         BNode* pChild = pNode->child(dir).load();
+         if (!pChild)
+         {
+            if (pNode->version.load() != version)
+               return retry;
+            pFound = nullptr;
+            return done;
+         }
+
+         int dirChild = compare(t, pChild->key);
+         if (dirChild == 0)
+         {
+            pFound = pChild;
+            return done;
+         }
+
+         uint64_t versionChild = pChild->version.load();
+         if (isShrinkingOrUnlinked(versionChild))
+         {
+            waitUntilNotChanging(pChild);
+            if (pNode->version.load() != version)
+               return retry;
+         }
+         else if (pChild != pNode->child(dir).load())
+         {
+            if (pNode->version.load() != version)
+               return retry;
+         }
+         else
+         {
+            // the child was still ours after we read its version
+            if (pNode->version.load() != version)
+               return retry;
+            if (attemptFind(t, pChild, dirChild, versionChild, pFound) == done)
+               return done;
+         }
+      }
+   }
+
+   /****************************************************
+    * OPTIMISTIC BST :: WAIT UNTIL NOT CHANGING
+    * A rotation is moving p. Spin a little, then queue on the
+    * lock the rotating writer holds
+    ****************************************************/
+   template <typename T>
+   void OptimisticBST<T>::waitUntilNotChanging(Link* p)
+   {
+      uint64_t version = p->version.load();
+      if (!(version & shrinking))
+         return;
+      for (int i = 0; i < spinsBeforeLock; i++)
+         if (p->version.load() != version)
+            return;
+      std::lock_guard<std::mutex> lock(p->mutex);
+   }
+
+   /****************************************************
+    * OPTIMISTIC BST :: SNAPSHOT
+    * Every element, in order. Exact when no one is writing;
+    * while writers work, an element added or erased during the
+    * walk may or may not be in it
+    ****************************************************/
+   template <typename T>
+   std::vector<T> OptimisticBST<T>::snapshot() const
+   {
+      epoch::Guard guard;
+      std::vector<T> elements;
+      std::vector<const BNode*> stack;
+      const BNode* p = holder.pRight.load();
+      while (p || !stack.empty())
+      {
+         for (; p; p = p->pLeft.load())
+            stack.push_back(p);
+         p = stack.back();
+         stack.pop_back();
+         if (p->isPresent.load())
+            elements.push_back(p->key);
+         p = p->pRight.load();
+      }
+      return elements;
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: INSERT
+    * Returns false if t was already there
+    ****************************************************/
+   template <typename T>
+   bool OptimisticBST<T>::insert(const T& t)
+   {
+      epoch::Guard guard;
+      bool wasPresent = false;
+      while (attemptUpdate(t, true /*isInsert*/, &holder, 1, holder.version.load(), wasPresent) == retry)
+         ;
+      if (!wasPresent)
+         numElements.fetch_add(1, std::memory_order_relaxed);
+      return !wasPresent;
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: ERASE
+    * Returns false if t was not there
+    ****************************************************/
+   template <typename T>
+   bool OptimisticBST<T>::erase(const T& t)
+   {
+      epoch::Guard guard;
+      bool wasPresent = false;
+      while (attemptUpdate(t, false /*isInsert*/, &holder, 1, holder.version.load(), wasPresent) == retry)
+         ;
+      if (wasPresent)
+         numElements.fetch_sub(1, std::memory_order_relaxed);
+      return wasPresent;
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: CLEAR
+    * Erase what is there now; safe alongside other threads
+    ****************************************************/
+   template <typename T>
+   void OptimisticBST<T>::clear()
+   {
+      for (const T& t : snapshot())
+         erase(t);
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: ATTEMPT UPDATE
+    * Insert or erase t below pNode on side dir, validating as
+    * attemptFind() does. A new leaf needs only its parent locked
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Outcome OptimisticBST<T>::attemptUpdate(const T& t, bool isInsert, Link* pNode,
+                                                                    int dir, uint64_t version, bool& wasPresent)
+   {
+      while (true)
+      {
+         BNode* pChild = pNode->child(dir).load();
+         if (pNode->version.load() != version)
+            return retry;
+
+         if (!pChild)
+         {
+            wasPresent = false;
+            if (!isInsert)
+               return done;
+
+            Link* pDamaged;
+            {
+               std::lock_guard<std::mutex> lock(pNode->mutex);
+               if (pNode->version.load() != version)
+                  return retry;
+               if (pNode->child(dir).load())
+                  continue;   // another writer got here first: look again
+               pNode->child(dir).store(new BNode(t, pNode));
+               pDamaged = fixHeight(pNode);
+            }
+            fixHeightAndRebalance(pDamaged);
+            return done;
+         }
+
+         int dirChild = compare(t, pChild->key);
+         if (dirChild == 0)
+         {
+            if (attemptNodeUpdate(isInsert, pNode, pChild, wasPresent) == done)
+               return done;
+            continue;
+         }
+
+         uint64_t versionChild = pChild->version.load();
+         if (isShrinkingOrUnlinked(versionChild))
+            waitUntilNotChanging(pChild);
+         else if (pChild == pNode->child(dir).load())
+         {
+            if (pNode->version.load() != version)
+               return retry;
+            if (attemptUpdate(t, isInsert, pChild, dirChild, versionChild, wasPresent) == done)
+               return done;
+         }
+      }
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: ATTEMPT NODE UPDATE
+    * pNode holds the key. Inserting marks it present. Erasing
+    * unlinks it if it has a child to spare, with its parent
+    * locked too, or else leaves it as a routing node
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Outcome OptimisticBST<T>::attemptNodeUpdate(bool isInsert, Link* pParent,
+                                                                        BNode* pNode, bool& wasPresent)
+   {
+      // nothing to change
+      wasPresent = pNode->isPresent.load();
+      if (wasPresent == isInsert)
+         return done;
+
+      if (!isInsert && (!pNode->pLeft.load() || !pNode->pRight.load()))
+      {
+         Link* pDamaged;
+         {
+            std::lock_guard<std::mutex> lockParent(pParent->mutex);
+            if (isUnlinked(pParent->version.load()) || pNode->pParent.load() != pParent)
+               return retry;
+            std::lock_guard<std::mutex> lockNode(pNode->mutex);
+            wasPresent = pNode->isPresent.load();
+            if (!wasPresent)
+               return done;
+            if (!attemptUnlink(pParent, pNode))
+               return retry;
+            pDamaged = fixHeight(pParent);
+         }
+         retire(pNode);
+         fixHeightAndRebalance(pDamaged);
+         return done;
+      }
+
+      std::lock_guard<std::mutex> lockNode(pNode->mutex);
+      if (isUnlinked(pNode->version.load()))
+         return retry;
+      // it lost a child meanwhile, so it has to be unlinked instead
+      if (!isInsert && (!pNode->pLeft.load() || !pNode->pRight.load()))
+         return retry;
+      wasPresent = pNode->isPresent.load();
+      pNode->isPresent.store(isInsert);
+      return done;
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: ATTEMPT UNLINK
+    * Splice out pNode, which has at most one child. Both it
+    * and pParent are locked
+    ****************************************************/
+   template <typename T>
+   bool OptimisticBST<T>::attemptUnlink(Link* pParent, BNode* pNode)
+   {
+      BNode* pParentLeft  = pParent->pLeft.load();
+      BNode* pParentRight = pParent->pRight.load();
+      if (pParentLeft != pNode && pParentRight != pNode)
+         return false;
+
+      BNode* pLeft  = pNode->pLeft.load();
+      BNode* pRight = pNode->pRight.load();
+      if (pLeft && pRight)
+         return false;
+
+      BNode* pSplice = pLeft ? pLeft : pRight;
+      if (pParentLeft == pNode)
+         pParent->pLeft.store(pSplice);
+      else
+         pParent->pRight.store(pSplice);
+      if (pSplice)
+         pSplice->pParent.store(pParent);
+
+      pNode->version.store(unlinked);
+      pNode->isPresent.store(false);
+      return true;
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: RETIRE
+    * Hand an unlinked node to epoch reclamation
+    ****************************************************/
+   template <typename T>
+   void OptimisticBST<T>::retire(BNode* p)
+   {
+      std::lock_guard<std::mutex> lock(retiredMutex);
+      retired.retire(p);
+      if (retired.size() >= reclaimBatch)
+         retired.reclaim();
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: FIX HEIGHT AND REBALANCE
+    * Walk up from pNode, fixing heights, unlinking routing
+    * nodes that lost a child, and rotating where the balance
+    * is off, until nothing more is needed. A rotation that
+    * leaves a moved node needing more work hands that node
+    * back; the parent above the rotation is revisited after,
+    * since its child's height changed too
+    ****************************************************/
+   template <typename T>
+   void OptimisticBST<T>::fixHeightAndRebalance(Link* pNode)
+   {
+      std::vector<Link*> revisit;
+      while (true)
+      {
+         while (pNode && pNode->pParent.load())
+         {
+            int condition = nodeCondition(pNode);
+            if (condition == nothingRequired || isUnlinked(pNode->version.load()))
+               break;
+
+            if (condition != unlinkRequired && condition != rebalanceRequired)
+            {
+               std::lock_guard<std::mutex> lock(pNode->mutex);
+               pNode = fixHeight(pNode);
+            }
+            else
+            {
+               Link* pParent = pNode->pParent.load();
+               std::lock_guard<std::mutex> lockParent(pParent->mutex);
+               if (!isUnlinked(pParent->version.load()) && pNode->pParent.load() == pParent)
+               {
+                  std::lock_guard<std::mutex> lockNode(pNode->mutex);
+                  pNode = rebalance(pParent, static_cast<BNode*>(pNode));
+                  if (pNode && pNode != pParent && pNode != pParent->pParent.load())
+                     revisit.push_back(pParent);
+               }
+               // else the parent changed: look at pNode again
+            }
+         }
+
+         if (revisit.empty())
+            return;
+         pNode = revisit.back();
+         revisit.pop_back();
+      }
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: NODE CONDITION
+    * What p needs: to be unlinked, to be rebalanced, a new
+    * height (returned as is), or nothing
+    ****************************************************/
+   template <typename T>
+   int OptimisticBST<T>::nodeCondition(Link* p)
+   {
+      BNode* pLeft  = p->pLeft.load();
+      BNode* pRight = p->pRight.load();
+      if ((!pLeft || !pRight) && !p->isPresent.load())
+         return unlinkRequired;
+
+      int hNode  = p->height.load();
+      int hLeft  = height(pLeft);
+      int hRight = height(pRight);
+      int hNodeRepl = 1 + (hLeft > hRight ? hLeft : hRight);
+      int balance = hLeft - hRight;
+      if (balance < -1 || balance > 1)
+         return rebalanceRequired;
+      return hNode != hNodeRepl ? hNodeRepl : nothingRequired;
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: FIX HEIGHT
+    * With p locked, set its height if that is all it needs.
+    * Returns the next node to look at: p if it needs more,
+    * its parent if its height changed, or nullptr
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Link* OptimisticBST<T>::fixHeight(Link* p)
+   {
+      int condition = nodeCondition(p);
+      if (condition == rebalanceRequired || condition == unlinkRequired)
+         return p;
+      if (condition == nothingRequired)
+         return nullptr;
+      p->height.store(condition);
+      return p->pParent.load();
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: REBALANCE
+    * With pParent and pNode locked, unlink pNode if it is a
+    * spent routing node, or rotate toward its shorter side
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Link* OptimisticBST<T>::rebalance(Link* pParent, BNode* pNode)
+   {
+      BNode* pLeft  = pNode->pLeft.load();
+      BNode* pRight = pNode->pRight.load();
+      if ((!pLeft || !pRight) && !pNode->isPresent.load())
+      {
+         if (!attemptUnlink(pParent, pNode))
+            return pNode;
+         retire(pNode);
+         return fixHeight(pParent);
+      }
+
+      int hNode  = pNode->height.load();
+      int hLeft  = height(pLeft);
+      int hRight = height(pRight);
+      int hNodeRepl = 1 + (hLeft > hRight ? hLeft : hRight);
+      int balance = hLeft - hRight;
+      if (balance > 1)
+         return rebalanceFrom(pParent, pNode, -1, pLeft, hRight);
+      if (balance < -1)
+         return rebalanceFrom(pParent, pNode, 1, pRight, hLeft);
+      if (hNodeRepl != hNode)
+      {
+         pNode->height.store(hNodeRepl);
+         return fixHeight(pParent);
+      }
+      return nullptr;
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: REBALANCE FROM
+    * pNode's side (-1 left, 1 right) is too tall. Lock the
+    * child there and rotate it up, or its inner child up twice.
+    * If the inner child is itself out of balance, fix that first
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Link* OptimisticBST<T>::rebalanceFrom(Link* pParent, BNode* pNode, int side,
+                                                                   BNode* pChild, int hOther)
+   {
+      std::lock_guard<std::mutex> lockChild(pChild->mutex);
+      int hChild = pChild->height.load();
+      if (hChild - hOther <= 1)
+         return pNode;   // it changed before we locked it: look again
+
+      BNode* pInner = pChild->child(-side).load();
+      int hOuter = height(pChild->child(side).load());
+      int hInner = height(pInner);
+      if (hOuter >= hInner)
+         return rotate(pParent, pNode, side, pChild, hOther, hOuter, pInner, hInner);
+
+      {
+         std::lock_guard<std::mutex> lockInner(pInner->mutex);
+         hInner = pInner->height.load();
+         if (hOuter >= hInner)
+            return rotate(pParent, pNode, side, pChild, hOther, hOuter, pInner, hInner);
+
+         int hInnerOuter = height(pInner->child(side).load());
+         int balance = hOuter - hInnerOuter;
+         if (balance >= -1 && balance <= 1)
+            return rotateDouble(pParent, pNode, side, pChild, hOther, hOuter, pInner, hInnerOuter);
+      }
+
+      // balance the child first; pNode will be looked at again after
+      return rebalanceFrom(pNode, pChild, -side, pInner, hOuter);
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: ROTATE
+    * Move pChild, on pNode's side, up into pNode's place.
+    * pNode moves down, so readers passing it must retry.
+    * pParent, pNode and pChild are locked
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Link* OptimisticBST<T>::rotate(Link* pParent, BNode* pNode, int side, BNode* pChild,
+                                                            int hOther, int hOuter, BNode* pInner, int hInner)
+   {
+      uint64_t version = pNode->version.load();
+      BNode* pParentLeft = pParent->pLeft.load();
+
+      pNode->version.store(version | shrinking);
+
+      pNode->child(side).store(pInner);
+      if (pInner)
+         pInner->pParent.store(pNode);
+      pChild->child(-side).store(pNode);
+      pNode->pParent.store(pChild);
+      if (pParentLeft == pNode)
+         pParent->pLeft.store(pChild);
+      else
+         pParent->pRight.store(pChild);
+      pChild->pParent.store(pParent);
+
+      int hNodeRepl = 1 + (hInner > hOther ? hInner : hOther);
+      pNode->height.store(hNodeRepl);
+      pChild->height.store(1 + (hOuter > hNodeRepl ? hOuter : hNodeRepl));
+
+      pNode->version.store(version + shrinkCountIncr);
+
+      // see if either moved node needs more work
+      int balanceNode = hInner - hOther;
+      if (balanceNode < -1 || balanceNode > 1)
+         return pNode;
+      if ((!pInner || hOther == 0) && !pNode->isPresent.load())
+         return pNode;
+      int balanceChild = hOuter - hNodeRepl;
+      if (balanceChild < -1 || balanceChild > 1)
+         return pChild;
+      if (hOuter == 0 && !pChild->isPresent.load())
+         return pChild;
+      return fixHeight(pParent);
+   }
+
+   /*****************************************************
+    * OPTIMISTIC BST :: ROTATE DOUBLE
+    * Move pInner, the inner child of pChild, up into pNode's
+    * place, with pChild and pNode as its children. Both move
+    * down. All four are locked
+    ****************************************************/
+   template <typename T>
+   typename OptimisticBST<T>::Link* OptimisticBST<T>::rotateDouble(Link* pParent, BNode* pNode, int side,
+                                                                  BNode* pChild, int hOther, int hOuter,
+                                                                  BNode* pInner, int hInnerOuter)
+   {
+      uint64_t versionNode  = pNode->version.load();
+      uint64_t versionChild = pChild->version.load();
+      BNode* pParentLeft = pParent->pLeft.load();
+      BNode* pInnerOuter = pInner->child(side).load();
+      BNode* pInnerInner = pInner->child(-side).load();
+      int hInnerInner = height(pInnerInner);
+
+      pNode->version.store(versionNode | shrinking);
+      pChild->version.store(versionChild | shrinking);
+
+      pNode->child(side).store(pInnerInner);
+      if (pInnerInner)
+         pInnerInner->pParent.store(pNode);
+      pChild->child(-side).store(pInnerOuter);
+      if (pInnerOuter)
+         pInnerOuter->pParent.store(pChild);
+      pInner->child(side).store(pChild);
+      pChild->pParent.store(pInner);
+      pInner->child(-side).store(pNode);
+      pNode->pParent.store(pInner);
+      if (pParentLeft == pNode)
+         pParent->pLeft.store(pInner);
+      else
+         pParent->pRight.store(pInner);
+      pInner->pParent.store(pParent);
+
+      int hNodeRepl = 1 + (hInnerInner > hOther ? hInnerInner : hOther);
+      pNode->height.store(hNodeRepl);
+      int hChildRepl = 1 + (hOuter > hInnerOuter ? hOuter : hInnerOuter);
+      pChild->height.store(hChildRepl);
+      pInner->height.store(1 + (hChildRepl > hNodeRepl ? hChildRepl : hNodeRepl));
+
+      pNode->version.store(versionNode + shrinkCountIncr);
+      pChild->version.store(versionChild + shrinkCountIncr);
+
+      // see if either moved node needs more work
+      int balanceNode = hInnerInner - hOther;
+      if (balanceNode < -1 || balanceNode > 1)
+         return pNode;
+      if ((!pInnerInner || hOther == 0) && !pNode->isPresent.load())
+         return pNode;
+      // a routing child left with one child is unlinked next
+      if ((hOuter == 0 || hInnerOuter == 0) && !pChild->isPresent.load())
+         return pChild;
+      int balanceInner = hChildRepl - hNodeRepl;
+      if (balanceInner < -1 || balanceInner > 1)
+         return pInner;
+      return fixHeight(pParent);
+   }
+
+   } // namespace concurrent
+} // namespace custom
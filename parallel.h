@@ -0,0 +1,851 @@
+/***********************************************************************
+ * Header:
+ *    PARALLEL
+ * Summary:
+ *    Fork-join parallelism for bulk work on trees, and BST::build(),
+ *    which loads a BST from unsorted data on every core.
+ *
+ *    parallel::Pool keeps one worker thread per core but one. The
+ *    caller of invoke(f, g) queues g, runs f itself, and then runs g
+ *    too unless an idle worker has stolen it meanwhile; while waiting
+ *    for a stolen g it runs other queued work. Each thread queues to
+ *    its own deque and steals from the far end of the others', so
+ *    forks nest cheaply and big pieces of work are the ones stolen.
+ *
+ *    The policies in custom::execution pick the serial or parallel
+ *    version of an algorithm, like those in <execution>, which not
+ *    every standard library can run in parallel.
+ *
+ *    This will contain the definitions of:
+ *        execution::seq, execution::par : Execution policies
+ *        parallel::Pool                 : A work-stealing fork-join pool
+ *        parallel::forRange()           : Split an index range among cores
+ *        parallel::sort()               : A parallel, stable merge sort
+ *        parallel::unique()             : A parallel copy without repeats
+ *        BST::build()                   : Load a BST in O(n log n / cores)
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <algorithm>          // for std::sort, std::merge, std::unique
+#include <atomic>             // for std::atomic
+#include <condition_variable> // for std::condition_variable
+#include <deque>              // for std::deque
+#include <exception>          // for std::exception_ptr
+#include <functional>         // for std::function
+#include <iterator>           // for std::iterator_traits and std::make_move_iterator
+#include <memory>             // for std::unique_ptr
+#include <mutex>              // for std::mutex and std::lock_guard
+#include <optional>           // for std::optional
+#include <thread>             // for std::thread
+#include <type_traits>        // for std::is_same_v and std::void_t
+#include <unordered_map>      // for std::unordered_map
+#include <vector>             // for std::vector
+#include "bst.h"
+
+class TestParallel; // forward declaration for unit tests
+
+namespace custom
+{
+
+   /*****************************************************************
+    * EXECUTION POLICIES
+    * Tags that choose how an algorithm runs
+    *****************************************************************/
+   namespace execution
+   {
+      struct sequenced_policy {};
+      struct parallel_policy {};
+
+      inline constexpr sequenced_policy seq{};
+      inline constexpr parallel_policy  par{};
+   } // namespace execution
+
+   namespace parallel
+   {
+
+   /*****************************************************************
+    * POOL
+    * Worker threads that steal forked work from one another
+    *****************************************************************/
+   class Pool
+   {
+      friend class ::TestParallel; // give unit tests access to private members
+   public:
+      Pool(size_t numWorkers);
+      Pool(const Pool& rhs) = delete;
+      Pool& operator =(const Pool& rhs) = delete;
+      ~Pool();
+
+      // the pool shared by everything that does not bring its own
+      static Pool& instance();
+
+      // the threads that can work at once: the workers and the caller
+      size_t concurrency() const { return workers.size() + 1; }
+
+      // run f and g, perhaps at the same time, and return when both are done
+      template <class F, class G>
+      void invoke(F&& f, G&& g);
+
+   private:
+      struct Task
+      {
+         Task(std::function<void()>&& run) : run(std::move(run)), isDone(false) {}
+         std::function<void()> run;     // the work
+         std::atomic<bool> isDone;      // set once run() has returned
+         std::exception_ptr error;      // what run() threw, if anything
+      };
+
+      struct alignas(64) Queue
+      {
+         std::mutex mutex;              // guards tasks
+         std::deque<Task*> tasks;       // the owner works at the back, thieves at the front
+      };
+
+      size_t myQueue() const;
+      void   push(size_t iQueue, Task* pTask);
+      bool   takeBack(size_t iQueue, Task* pTask);
+      bool   runOne(size_t iQueue);
+      void   work(size_t iQueue);
+      static void execute(Task* pTask);
+
+      // which pool and queue the calling thread works for
+      struct Worker
+      {
+         const Pool* pPool;
+         size_t iQueue;
+      };
+      static Worker& me()
+      {
+         thread_local Worker worker = { nullptr, 0 };
+         return worker;
+      }
+
+      std::unique_ptr<Queue[]> queues;     // one per worker, and one for everyone else
+      size_t numQueues;
+      std::vector<std::thread> workers;
+      std::atomic<size_t> numQueued;       // tasks waiting in any queue
+      std::atomic<size_t> numSleeping;     // workers waiting for a task
+      std::mutex sleepMutex;               // guards isStopping, and waking
+      std::condition_variable wake;        // a task was queued, or we are stopping
+      bool isStopping;
+   };
+
+   /*********************************************
+    * POOL :: CONSTRUCTOR
+    ********************************************/
+   inline Pool::Pool(size_t numWorkers) :
+      queues(new Queue[numWorkers + 1]), numQueues(numWorkers + 1),
+      numQueued(0), numSleeping(0), isStopping(false)
+   {
+      for (size_t i = 0; i < numWorkers; i++)
+         workers.emplace_back([this, i]() { work(i); });
+   }
+
+   /*********************************************
+    * POOL :: DESTRUCTOR
+    * No invoke() may still be running
+    ********************************************/
+   inline Pool::~Pool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(sleepMutex);
+         isStopping = true;
+      }
+      wake.notify_all();
+      for (std::thread& worker : workers)
+         worker.join();
+   }
+
+   /*********************************************
+    * POOL :: INSTANCE
+    * One worker per core, leaving a core for the caller
+    ********************************************/
+   inline Pool& Pool::instance()
+   {
+      static Pool pool(std::thread::hardware_concurrency() > 1 ?
+                       std::thread::hardware_concurrency() - 1 : 0);
+      return pool;
+   }
+
+   /*********************************************
+    * POOL :: INVOKE
+    * Queue g where a thief can find it, run f, then take g
+    * back and run it here unless it was stolen. Waiting for
+    * a stolen g, help with whatever else is queued. An
+    * exception from either is thrown here once both are done
+    ********************************************/
+   template <class F, class G>
+   void Pool::invoke(F&& f, G&& g)
+   {
+      size_t iQueue = myQueue();
+      Task task([&g]() { g(); });
+      push(iQueue, &task);
+
+      std::exception_ptr error;
+      try
+      {
+         f();
+      }
+      catch (...)
+      {
+         error = std::current_exception();
+      }
+
+      if (takeBack(iQueue, &task))
+      {
+         if (!error)
+            g();
+      }
+      else
+      {
+         while (!task.isDone.load(std::memory_order_acquire))
+            if (!runOne(iQueue))
+               std::this_thread::yield();
+         if (!error)
+            error = task.error;
+      }
+
+      if (error)
+         std::rethrow_exception(error);
+   }
+
+   /*********************************************
+    * POOL :: MY QUEUE
+    * A worker's own queue; every other thread shares the last
+    ********************************************/
+   inline size_t Pool::myQueue() const
+   {
+      return me().pPool == this ? me().iQueue : numQueues - 1;
+   }
+
+   /*********************************************
+    * POOL :: PUSH
+    * Queue a task and wake a sleeping worker to steal it
+    ********************************************/
+   inline void Pool::push(size_t iQueue, Task* pTask)
+   {
+      {
+         std::lock_guard<std::mutex> lock(queues[iQueue].mutex);
+         queues[iQueue].tasks.push_back(pTask);
+      }
+      numQueued++;
+      if (numSleeping.load())
+      {
+         { std::lock_guard<std::mutex> lock(sleepMutex); }
+         wake.notify_one();
+      }
+   }
+
+   /*********************************************
+    * POOL :: TAKE BACK
+    * Remove our own task if no one has stolen it yet
+    ********************************************/
+   inline bool Pool::takeBack(size_t iQueue, Task* pTask)
+   {
+      std::lock_guard<std::mutex> lock(queues[iQueue].mutex);
+      std::deque<Task*>& tasks = queues[iQueue].tasks;
+      for (auto it = tasks.rbegin(); it != tasks.rend(); ++it)
+         if (*it == pTask)
+         {
+            tasks.erase(std::next(it).base());
+            numQueued--;
+            return true;
+         }
+      return false;
+   }
+
+   /*********************************************
+    * POOL :: RUN ONE
+    * Run the newest task in our queue, or else steal the
+    * oldest from someone else's. False if there was none
+    ********************************************/
+   inline bool Pool::runOne(size_t iQueue)
+   {
+      Task* pTask = nullptr;
+      {
+         std::lock_guard<std::mutex> lock(queues[iQueue].mutex);
+         if (!queues[iQueue].tasks.empty())
+         {
+            pTask = queues[iQueue].tasks.back();
+            queues[iQueue].tasks.pop_back();
+         }
+      }
+      for (size_t i = 1; !pTask && i < numQueues; i++)
+      {
+         Queue& victim = queues[(iQueue + i) % numQueues];
+         std::lock_guard<std::mutex> lock(victim.mutex);
+         if (!victim.tasks.empty())
+         {
+            pTask = victim.tasks.front();
+            victim.tasks.pop_front();
+         }
+      }
+      if (!pTask)
+         return false;
+
+      numQueued--;
+      execute(pTask);
+      return true;
+   }
+
+   /*********************************************
+    * POOL :: EXECUTE
+    * The task's owner may free it the moment isDone is set
+    ********************************************/
+   inline void Pool::execute(Task* pTask)
+   {
+      try
+      {
+         pTask->run();
+      }
+      catch (...)
+      {
+         pTask->error = std::current_exception();
+      }
+      pTask->isDone.store(true, std::memory_order_release);
+   }
+
+   /*********************************************
+    * POOL :: WORK
+    * A worker's loop: run or steal tasks, and sleep when
+    * there are none
+    ********************************************/
+   inline void Pool::work(size_t iQueue)
+   {
+      me() = { this, iQueue };
+      while (true)
+      {
+         if (runOne(iQueue))
+            continue;
+
+         std::unique_lock<std::mutex> lock(sleepMutex);
+         numSleeping++;
+         wake.wait(lock, [this]() { return isStopping || numQueued.load() > 0; });
+         numSleeping--;
+         if (isStopping)
+            return;
+      }
+   }
+
+   /*****************************************************************
+    * FOR RANGE
+    * Call f(begin, end) on pieces of [begin, end) no larger
+    * than grain, in parallel
+    *****************************************************************/
+   template <class Function>
+   void forRange(size_t begin, size_t end, size_t grain, Function& f, Pool& pool)
+   {
+      if (end - begin <= grain)
+      {
+         if (begin < end)
+            f(begin, end);
+         return;
+      }
+      size_t middle = begin + (end - begin) / 2;
+      pool.invoke([&]() { forRange(begin, middle, grain, f, pool); },
+                  [&]() { forRange(middle, end, grain, f, pool); });
+   }
+
+   // pieces small enough to balance the load, big enough to pay for a fork
+   inline size_t grainFor(size_t num, const Pool& pool, size_t minGrain = 4096)
+   {
+      size_t grain = num / (8 * pool.concurrency());
+      return grain > minGrain ? grain : minGrain;
+   }
+
+   template <class Function>
+   void forRange(size_t begin, size_t end, Function f, Pool& pool = Pool::instance())
+   {
+      forRange(begin, end, grainFor(end - begin, pool), f, pool);
+   }
+
+   /*****************************************************************
+    * MERGE
+    * Move the sorted runs a and b into out. Split the longer
+    * run at its middle, find where that element lands in the
+    * other, and merge the two halves in parallel. Equal elements
+    * from a stay ahead of those from b
+    *****************************************************************/
+   template <typename T, class Compare>
+   void merge(T* a, size_t numA, T* b, size_t numB, T* out, Compare less, Pool& pool, size_t grain)
+   {
+      if (numA + numB <= grain)
+      {
+         std::merge(std::make_move_iterator(a), std::make_move_iterator(a + numA),
+                    std::make_move_iterator(b), std::make_move_iterator(b + numB), out, less);
+         return;
+      }
+
+      size_t iA;
+      size_t iB;
+      if (numA >= numB)
+      {
+         iA = numA / 2;
+         iB = std::lower_bound(b, b + numB, a[iA], less) - b;
+         out[iA + iB] = std::move(a[iA]);
+         pool.invoke([&]() { merge(a, iA, b, iB, out, less, pool, grain); },
+                     [&]() { merge(a + iA + 1, numA - iA - 1, b + iB, numB - iB,
+                                   out + iA + iB + 1, less, pool, grain); });
+      }
+      else
+      {
+         iB = numB / 2;
+         iA = std::upper_bound(a, a + numA, b[iB], less) - a;
+         out[iA + iB] = std::move(b[iB]);
+         pool.invoke([&]() { merge(a, iA, b, iB, out, less, pool, grain); },
+                     [&]() { merge(a + iA, numA - iA, b + iB + 1, numB - iB - 1,
+                                   out + iA + iB + 1, less, pool, grain); });
+      }
+   }
+
+   /*****************************************************************
+    * MERGE SORT
+    * Sort num elements at src. The halves sort in parallel
+    * into the other buffer and are merged back, so the result
+    * lands in dest when toDest is set and in src otherwise
+    *****************************************************************/
+   template <typename T, class Compare>
+   void mergeSort(T* src, T* dest, size_t num, bool toDest, Compare less, Pool& pool, size_t grain)
+   {
+      if (num <= grain)
+      {
+         std::stable_sort(src, src + num, less);
+         if (toDest)
+            std::move(src, src + num, dest);
+         return;
+      }
+
+      size_t half = num / 2;
+      pool.invoke([&]() { mergeSort(src, dest, half, !toDest, less, pool, grain); },
+                  [&]() { mergeSort(src + half, dest + half, num - half, !toDest, less, pool, grain); });
+      if (toDest)
+         merge(src, half, src + half, num - half, dest, less, pool, grain);
+      else
+         merge(dest, half, dest + half, num - half, src, less, pool, grain);
+   }
+
+   /*****************************************************************
+    * SORT
+    * A stable sort of [first, last) on every core. Needs room
+    * for a second copy of the elements
+    *****************************************************************/
+   template <typename T, class Compare>
+   void sort(T* first, T* last, Compare less, Pool& pool = Pool::instance())
+   {
+      size_t num = last - first;
+      size_t grain = grainFor(num, pool, 1 << 14);
+      if (num <= grain)
+      {
+         std::stable_sort(first, last, less);
+         return;
+      }
+      std::vector<T> buffer(num);
+      mergeSort(first, buffer.data(), num, false, less, pool, grain);
+   }
+
+   /*****************************************************************
+    * UNIQUE
+    * Move the first of each run of equivalent elements in the
+    * sorted [first, last) to out, and return how many there
+    * were. Each piece marks and counts its keepers, then all
+    * of them move at once to offsets summed from those counts.
+    * Every comparison is made in the first pass: once moving
+    * starts, a neighbor may already be moved from
+    *****************************************************************/
+   template <typename T, class Compare>
+   size_t unique(T* first, T* last, T* out, Compare less, Pool& pool = Pool::instance())
+   {
+      size_t num = last - first;
+      size_t grain = grainFor(num, pool);
+      size_t numPieces = (num + grain - 1) / grain;
+      std::vector<char> isKeeper(num);   // not vector<bool>: pieces write their own bytes
+
+      std::vector<size_t> offsets(numPieces + 1, 0);
+      auto count = [&](size_t begin, size_t end)
+      {
+         for (size_t iPiece = begin; iPiece < end; iPiece++)
+            for (size_t i = iPiece * grain; i < num && i < (iPiece + 1) * grain; i++)
+            {
+               isKeeper[i] = i == 0 || less(first[i - 1], first[i]);
+               offsets[iPiece + 1] += isKeeper[i] ? 1 : 0;
+            }
+      };
+      forRange(0, numPieces, 1, count, pool);
+      for (size_t iPiece = 0; iPiece < numPieces; iPiece++)
+         offsets[iPiece + 1] += offsets[iPiece];
+
+      auto move = [&](size_t begin, size_t end)
+      {
+         for (size_t iPiece = begin; iPiece < end; iPiece++)
+         {
+            T* pOut = out + offsets[iPiece];
+            for (size_t i = iPiece * grain; i < num && i < (iPiece + 1) * grain; i++)
+               if (isKeeper[i])
+                  *pOut++ = std::move(first[i]);
+         }
+      };
+      forRange(0, numPieces, 1, move, pool);
+      return offsets[numPieces];
+   }
+
+   // can the distance between two of these be taken in O(1)?
+   template <class Iterator, class = void>
+   struct isRandomAccess : std::false_type {};
+   template <class Iterator>
+   struct isRandomAccess<Iterator, std::void_t<typename std::iterator_traits<Iterator>::iterator_category>> :
+      std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category> {};
+
+   } // namespace parallel
+
+   /****************************************************
+    * BST :: BUILD
+    * Replace the contents with [first, last), in any order.
+    * Sort a copy, drop repeats if keepUnique, make the nodes
+    * and link them into a balanced tree colored by depth with
+    * adoptSorted(). With execution::par each step runs on
+    * every core: both halves of a subtree link independently.
+    * Nothing is inserted and nothing is rebalanced. The old
+    * contents stay if anything throws
+    ****************************************************/
+   template <typename T>
+   template <class Iterator, class Policy>
+   void BST<T>::build(Iterator first, Iterator last, Policy, bool keepUnique)
+   {
+      constexpr bool isParallel = std::is_same_v<Policy, execution::parallel_policy>;
+      parallel::Pool& pool = parallel::Pool::instance();
+      auto less = [](const T& lhs, const T& rhs) { return lhs < rhs; };
+
+      // copy
+      std::vector<T> values;
+      if constexpr (isParallel && parallel::isRandomAccess<Iterator>::value)
+      {
+         values.resize(last - first);
+         parallel::forRange(0, values.size(), [&](size_t begin, size_t end)
+            {
+               std::copy(first + begin, first + end, values.begin() + begin);
+            }, pool);
+      }
+      else
+         for (; first != last; ++first)
+            values.push_back(*first);
+
+      // sort, and perhaps drop the repeats
+      if constexpr (isParallel)
+      {
+         parallel::sort(values.data(), values.data() + values.size(), less, pool);
+         if (keepUnique)
+         {
+            std::vector<T> unique(values.size());
+            unique.resize(parallel::unique(values.data(), values.data() + values.size(),
+                                           unique.data(), less, pool));
+            values.swap(unique);
+         }
+      }
+      else
+      {
+         std::sort(values.begin(), values.end(), less);
+         if (keepUnique)
+            values.erase(std::unique(values.begin(), values.end(),
+                                     [](const T& lhs, const T& rhs) { return !(lhs < rhs) && !(rhs < lhs); }),
+                         values.end());
+      }
+
+      // make the nodes in order, so neighbors are near in memory
+      size_t num = values.size();
+      std::vector<BNode*> nodes(num, nullptr);
+      auto allocate = [&](size_t begin, size_t end)
+      {
+         for (size_t i = begin; i < end; i++)
+            nodes[i] = new BNode(std::move(values[i]));
+      };
+      try
+      {
+         if constexpr (isParallel)
+            parallel::forRange(0, num, allocate, pool);
+         else
+            allocate(0, num);
+      }
+      catch (...)
+      {
+         discard(nodes);
+         throw;
+      }
+
+      // link, in parallel before the old contents go since forking can throw
+      BNode* pRoot = nullptr;
+      if constexpr (isParallel)
+      {
+         size_t redDepth = BNode::redDepth(num);
+         size_t grain = parallel::grainFor(num, pool, 1 << 14);
+         auto link = [&pool, grain, redDepth](auto& self, BNode* const* ppNodes, size_t num, size_t depth) -> BNode*
+         {
+            if (num <= grain)
+               return BNode::build(ppNodes, num, depth, redDepth);
+
+            size_t iMiddle = num / 2;
+            BNode* pNode = ppNodes[iMiddle];
+            pNode->isRed = (depth == redDepth);
+            pool.invoke([&]() { pNode->pLeft  = self(self, ppNodes, iMiddle, depth + 1); },
+                        [&]() { pNode->pRight = self(self, ppNodes + iMiddle + 1, num - iMiddle - 1, depth + 1); });
+            pNode->pLeft->pParent  = pNode;
+            pNode->pRight->pParent = pNode;
+            return pNode;
+         };
+         pRoot = link(link, nodes.data(), num, 0);
+      }
+
+      clear();
+      adoptSorted(nodes, pRoot);
+   }
+
+   /****************************************************
+    * BST :: PIECES
+    * Split the tree into at least minPieces runs, in order,
+    * and return the first node of each followed by nullptr.
+    * Each subtree a few levels down starts a run, which goes
+    * on through the ancestors between it and the next. Red-
+    * black subtrees at one depth can differ in size, so the
+    * runs are only roughly even
+    ****************************************************/
+   template <typename T>
+   std::vector<typename BST<T>::BNode*> BST<T>::pieces(size_t minPieces) const
+   {
+      std::vector<BNode*> starts;
+      if (root)
+      {
+         size_t depthCut = 0;
+         while (((size_t)1 << depthCut) < minPieces)
+            depthCut++;
+
+         auto leftmost = [](BNode* p)
+         {
+            while (p->pLeft)
+               p = p->pLeft;
+            return p;
+         };
+         auto cut = [&](auto& self, BNode* p, size_t depth) -> void
+         {
+            if (depth == depthCut)
+               starts.push_back(leftmost(p));
+            else
+            {
+               if (p->pLeft)
+                  self(self, p->pLeft, depth + 1);
+               if (p->pRight)
+                  self(self, p->pRight, depth + 1);
+            }
+         };
+         cut(cut, root, 0);
+
+         // a short left spine leaves the smallest nodes before the first cut
+         BNode* pFirst = leftmost(root);
+         if (starts.empty() || starts.front() != pFirst)
+            starts.insert(starts.begin(), pFirst);
+      }
+      starts.push_back(nullptr);
+      return starts;
+   }
+
+   /****************************************************
+    * BST :: CHUNKS
+    * The runs to hand to the pool: a few per thread so a
+    * thief always finds one. Cutting at one depth is free
+    * but uneven. When balanced, or when the offset of each
+    * run is wanted, first count every subtree in parallel
+    * and remember the sizes of the big ones and of their
+    * children; then cut each branch as soon as its subtree
+    * is small, and join neighbors into chunks of about the
+    * same number of elements
+    ****************************************************/
+   template <typename T>
+   std::vector<typename BST<T>::BNode*> BST<T>::chunks(parallel::Pool& pool, bool balanced,
+                                                       std::vector<size_t>* pOffsets) const
+   {
+      size_t numWanted = 8 * pool.concurrency();
+      if (!balanced && !pOffsets)
+         return pieces(numWanted);
+
+      // count
+      size_t target = numElements / numWanted > 1 ? numElements / numWanted : 1;
+      size_t limit = (target + 1) / 2;
+      size_t depthFork = 0;
+      while (((size_t)1 << depthFork) < 4 * numWanted)
+         depthFork++;
+      std::unordered_map<const BNode*, size_t> sizes;
+      std::mutex sizesMutex;
+      auto count = [&](auto& self, const BNode* p, size_t depth) -> size_t
+      {
+         if (!p)
+            return 0;
+         size_t numLeft;
+         size_t numRight;
+         if (depth < depthFork)
+            pool.invoke([&]() { numLeft  = self(self, p->pLeft,  depth + 1); },
+                        [&]() { numRight = self(self, p->pRight, depth + 1); });
+         else
+         {
+            numLeft  = self(self, p->pLeft,  depth + 1);
+            numRight = self(self, p->pRight, depth + 1);
+         }
+         size_t num = numLeft + numRight + 1;
+         if (num > limit)
+         {
+            std::lock_guard<std::mutex> lock(sizesMutex);
+            sizes[p] = num;
+            sizes[p->pLeft] = numLeft;
+            sizes[p->pRight] = numRight;
+         }
+         return num;
+      };
+      count(count, root, 0);
+
+      // cut the small subtrees; the big ones' roots join the run before
+      std::vector<BNode*> starts;
+      std::vector<size_t> counts;
+      auto cut = [&](auto& self, BNode* p) -> void
+      {
+         auto it = sizes.find(p);
+         size_t num = it == sizes.end() ? numElements : it->second;
+         if (num <= limit)
+         {
+            BNode* pFirst = p;
+            while (pFirst->pLeft)
+               pFirst = pFirst->pLeft;
+            starts.push_back(pFirst);
+            counts.push_back(num);
+            return;
+         }
+         if (p->pLeft)
+            self(self, p->pLeft);
+         if (starts.empty())
+         {
+            starts.push_back(p);
+            counts.push_back(1);
+         }
+         else
+            counts.back()++;
+         if (p->pRight)
+            self(self, p->pRight);
+      };
+      if (root)
+         cut(cut, root);
+
+      // join
+      std::vector<BNode*> joined;
+      std::vector<size_t> joinedCounts;
+      for (size_t i = 0; i < starts.size(); i++)
+         if (joined.empty() || joinedCounts.back() >= target)
+         {
+            joined.push_back(starts[i]);
+            joinedCounts.push_back(counts[i]);
+         }
+         else
+            joinedCounts.back() += counts[i];
+      joined.push_back(nullptr);
+
+      if (pOffsets)
+      {
+         pOffsets->assign(joinedCounts.size(), 0);
+         for (size_t i = 1; i < joinedCounts.size(); i++)
+            (*pOffsets)[i] = (*pOffsets)[i - 1] + joinedCounts[i - 1];
+      }
+      return joined;
+   }
+
+   /****************************************************
+    * BST :: FOR EACH
+    * Call f(t) on every element. With execution::par the
+    * calls come from many threads, in no particular order
+    ****************************************************/
+   template <typename T>
+   template <class Policy, class Function>
+   void BST<T>::for_each(Policy, Function f, bool balanced) const
+   {
+      if constexpr (std::is_same_v<Policy, execution::parallel_policy>)
+      {
+         parallel::Pool& pool = parallel::Pool::instance();
+         std::vector<BNode*> starts = chunks(pool, balanced, nullptr);
+         auto visit = [&](size_t begin, size_t end)
+         {
+            for (size_t i = begin; i < end; i++)
+               for (iterator it(starts[i]); it != iterator(starts[i + 1]); ++it)
+                  f(*it);
+         };
+         parallel::forRange(0, starts.size() - 1, 1, visit, pool);
+      }
+      else
+         for (iterator it = begin(); it != end(); ++it)
+            f(*it);
+   }
+
+   /****************************************************
+    * BST :: TRANSFORM REDUCE
+    * Fold transform(t) of every element into init with
+    * reduce. Each run folds on its own and the runs fold
+    * together left to right, so reduce need only be
+    * associative, not commutative
+    ****************************************************/
+   template <typename T>
+   template <class Policy, class U, class Reduce, class Transform>
+   U BST<T>::transform_reduce(Policy, U init, Reduce reduce, Transform transform,
+                              bool balanced) const
+   {
+      if constexpr (std::is_same_v<Policy, execution::parallel_policy>)
+      {
+         parallel::Pool& pool = parallel::Pool::instance();
+         std::vector<BNode*> starts = chunks(pool, balanced, nullptr);
+         std::vector<std::optional<U>> partials(starts.size() - 1);
+         auto fold = [&](size_t begin, size_t end)
+         {
+            for (size_t i = begin; i < end; i++)
+            {
+               iterator it(starts[i]);
+               U partial = transform(*it);
+               for (++it; it != iterator(starts[i + 1]); ++it)
+                  partial = reduce(std::move(partial), transform(*it));
+               partials[i].emplace(std::move(partial));
+            }
+         };
+         parallel::forRange(0, partials.size(), 1, fold, pool);
+         for (std::optional<U>& partial : partials)
+            init = reduce(std::move(init), std::move(*partial));
+      }
+      else
+         for (iterator it = begin(); it != end(); ++it)
+            init = reduce(std::move(init), transform(*it));
+      return init;
+   }
+
+   /****************************************************
+    * BST :: FOR EACH CHUNK
+    * Call f(offset, first, last) on runs [first, last) that
+    * together cover the tree in order; offset is where first
+    * falls in that order, so results can be written straight
+    * to their place. With execution::par the runs are
+    * balanced and visited on many threads, otherwise the
+    * whole tree is one run
+    ****************************************************/
+   template <typename T>
+   template <class Policy, class Function>
+   void BST<T>::for_each_chunk(Policy, Function f) const
+   {
+      if constexpr (std::is_same_v<Policy, execution::parallel_policy>)
+      {
+         parallel::Pool& pool = parallel::Pool::instance();
+         std::vector<size_t> offsets;
+         std::vector<BNode*> starts = chunks(pool, true /*balanced*/, &offsets);
+         auto visit = [&](size_t begin, size_t end)
+         {
+            for (size_t i = begin; i < end; i++)
+               f(offsets[i], iterator(starts[i], this), iterator(starts[i + 1], this));
+         };
+         parallel::forRange(0, offsets.size(), 1, visit, pool);
+      }
+      else if (root)
+         f((size_t)0, begin(), end());
+   }
+
+} // namespace custom
@@ -0,0 +1,823 @@
+/***********************************************************************
+ * Header:
+ *    PERSISTENT
+ * Summary:
+ *    An immutable red-black tree. insert() and erase() leave the tree
+ *    alone and return a new version that shares every untouched subtree
+ *    with the old one: only the O(log n) nodes on the path to the change
+ *    are new. Copying a version is O(1), it is only another reference to
+ *    the same root, so a reader can hold a consistent snapshot for as long
+ *    as it likes while a writer goes on making new versions:
+ *        custom::PersistentBST<int> v1 = { 1, 2, 3 };
+ *        custom::PersistentBST<int> v2 = v1.insert(4);  // v1 still 1 2 3
+ *
+ *    Nodes are reference counted, so a subtree lives as long as some
+ *    version uses it. Nodes never change once built, so versions can be
+ *    shared between threads freely (each thread needs its own copy of a
+ *    version object if it assigns to it).
+ *
+ *    Balancing follows Okasaki for insert and Kahrs for erase: the same
+ *    red-black rules as BST, restated without parent pointers.
+ *
+ *    This will contain the class definition of:
+ *        PersistentBST           : An immutable, versioned red-black tree
+ *        PersistentBST::iterator : An in-order iterator through a version
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <memory>     // for std::shared_ptr
+#include <vector>     // for std::vector
+#include <initializer_list>
+
+class TestPersistent; // forward declaration for unit tests
+class TestCow;
+
+namespace custom
+{
+
+   template <typename TT>
+   class CowBST;
+
+   /*****************************************************************
+    * PERSISTENT BST
+    * One version of an immutable red-black tree
+    *****************************************************************/
+   template <typename T>
+   class PersistentBST
+   {
+      friend class ::TestPersistent; // give unit tests access to private members
+      friend class ::TestCow;
+
+      template <class TT>
+      friend class custom::CowBST;
+   public:
+      //
+      // Construct. Copies and assignment are O(1)
+      //
+
+      PersistentBST() : numElements(0) {}
+      PersistentBST(const std::initializer_list<T>& il);
+
+      //
+      // Iterator
+      //
+
+      class iterator;
+      iterator begin() const;
+      iterator end()   const { return iterator(); }
+
+      //
+      // Access
+      //
+
+      iterator find(const T& t) const;
+      iterator lower_bound(const T& t) const;
+      iterator upper_bound(const T& t) const;
+
+      //
+      // New versions
+      //
+
+      PersistentBST insert(const T& t, bool keepUnique = false) const;
+      PersistentBST erase(const T& t) const;
+      PersistentBST erase(const iterator& it) const;
+      PersistentBST clear() const { return PersistentBST(); }
+
+      //
+      // Status
+      //
+
+      bool   empty() const noexcept { return size() == 0; }
+      size_t size()  const noexcept { return numElements; }
+
+   private:
+
+      class BNode;
+      typedef std::shared_ptr<const BNode> Ptr;
+
+      PersistentBST(Ptr root, size_t numElements) : root(std::move(root)), numElements(numElements) {}
+
+      static Ptr red  (const Ptr& pLeft, const T& t, const Ptr& pRight);
+      static Ptr black(const Ptr& pLeft, const T& t, const Ptr& pRight);
+      static bool isRed  (const Ptr& p) { return p && p->isRed; }
+      static bool isBlack(const Ptr& p) { return p && !p->isRed; }
+
+      static Ptr insert(const Ptr& p, const T& t);
+      static Ptr balance(const Ptr& pLeft, const T& t, const Ptr& pRight);
+      template <typename Direction>
+      PersistentBST eraseAlong(Direction direction) const;
+      template <typename Direction>
+      static Ptr erase(const Ptr& p, Direction& direction, size_t depth);
+      static Ptr balanceLeft (const Ptr& pLeft, const T& t, const Ptr& pRight);
+      static Ptr balanceRight(const Ptr& pLeft, const T& t, const Ptr& pRight);
+      static Ptr redden(const Ptr& p);
+      static Ptr fuse(const Ptr& pLeft, const Ptr& pRight);
+
+      // a new version of elements already in order, balanced in O(n)
+      static PersistentBST build(const std::vector<const T*>& sorted);
+      static Ptr build(const T* const* ppData, size_t num, size_t depth, size_t redDepth);
+
+      // cut and paste whole subtrees; a height is the black nodes from the
+      // root of a subtree down to any leaf, the root included
+      static size_t blackHeight(const Ptr& p);
+      static Ptr blacken(const Ptr& p, size_t& height);
+      static Ptr join(const Ptr& pLeft, size_t hLeft, const T& t,
+                      const Ptr& pRight, size_t hRight, size_t& height);
+      static Ptr joinRight(const Ptr& pLeft, size_t hLeft, const T& t, const Ptr& pRight, size_t hRight);
+      static Ptr joinLeft (const Ptr& pLeft, size_t hLeft, const T& t, const Ptr& pRight, size_t hRight);
+      static Ptr concat(const Ptr& pLeft, size_t hLeft, const Ptr& pRight, size_t hRight, size_t& height);
+      static void split(const Ptr& p, size_t height, const std::vector<const BNode*>& path, size_t depth,
+                        Ptr& pLeft, size_t& hLeft, Ptr& pRight, size_t& hRight);
+      template <typename Doomed>
+      static Ptr filter(const Ptr& p, size_t height, Doomed& doomed, size_t& hNew);
+
+      template <typename GoRight>
+      iterator descend(GoRight goRight) const;
+
+      Ptr root;                 // root of this version, shared with others
+      size_t numElements;       // number of elements in this version
+   };
+
+   /*****************************************************************
+    * PERSISTENT BST NODE
+    * Built once, never changed
+    *****************************************************************/
+   template <typename T>
+   class PersistentBST<T>::BNode
+   {
+   public:
+      BNode(const Ptr& pLeft, const T& t, const Ptr& pRight, bool isRed) :
+         data(t), pLeft(pLeft), pRight(pRight), isRed(isRed)
+      {}
+
+      const T data;             // the element
+      const Ptr pLeft;          // left subtree, possibly shared
+      const Ptr pRight;         // right subtree, possibly shared
+      const bool isRed;         // red-black coloring
+   };
+
+   /**********************************************************
+    * PERSISTENT BST ITERATOR
+    * Nodes have no parent pointer (a shared node has many
+    * parents), so the iterator keeps the path from the root.
+    * It is only good while its version is
+    *********************************************************/
+   template <typename T>
+   class PersistentBST<T>::iterator
+   {
+      friend class ::TestPersistent; // give unit tests access to the privates
+      friend class PersistentBST<T>;
+      friend class CowBST<T>;
+   public:
+      iterator() {}
+
+      // compare
+      bool operator ==(const iterator& rhs) const
+      {
+         return path.empty() ? rhs.path.empty() : !rhs.path.empty() && path.back() == rhs.path.back();
+      }
+      bool operator !=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+
+      // de-reference. Cannot change because the version is immutable
+      const T& operator *() const
+      {
+         assert(!path.empty());
+         return path.back()->data;
+      }
+
+      // increment and decrement
+      iterator& operator ++();
+      iterator  operator ++(int)
+      {
+         iterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+      iterator& operator --();
+      iterator  operator --(int)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+      std::vector<const BNode*> path;   // root down to the current node; empty at the end
+   };
+
+
+   /*********************************************
+    * PERSISTENT BST :: INITIALIZER LIST CONSTRUCTOR
+    ********************************************/
+   template <typename T>
+   PersistentBST<T>::PersistentBST(const std::initializer_list<T>& il) : PersistentBST()
+   {
+      for (const T& t : il)
+         *this = insert(t);
+   }
+
+   /*********************************************
+    * PERSISTENT BST :: RED / BLACK
+    * Build a node
+    ********************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::red(const Ptr& pLeft, const T& t, const Ptr& pRight)
+   {
+      return std::make_shared<const BNode>(pLeft, t, pRight, true);
+   }
+
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::black(const Ptr& pLeft, const T& t, const Ptr& pRight)
+   {
+      return std::make_shared<const BNode>(pLeft, t, pRight, false);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: BEGIN
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::iterator PersistentBST<T>::begin() const
+   {
+      iterator it;
+      for (const BNode* p = root.get(); p; p = p->pLeft.get())
+         it.path.push_back(p);
+      return it;
+   }
+
+   /****************************************************
+    * PERSISTENT BST :: DESCEND
+    * Walk from the root: right when goRight() is true, left
+    * otherwise. Return the last node where we went left
+    ****************************************************/
+   template <typename T>
+   template <typename GoRight>
+   typename PersistentBST<T>::iterator PersistentBST<T>::descend(GoRight goRight) const
+   {
+      iterator it;
+      size_t lastLeft = 0;     // path length up to and including that node
+      for (const BNode* p = root.get(); p; )
+      {
+         it.path.push_back(p);
+         if (goRight(p->data))
+            p = p->pRight.get();
+         else
+         {
+            lastLeft = it.path.size();
+            p = p->pLeft.get();
+         }
+      }
+      it.path.resize(lastLeft);
+      return it;
+   }
+
+   /****************************************************
+    * PERSISTENT BST :: FIND
+    * An element equivalent to t, or end()
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::iterator PersistentBST<T>::find(const T& t) const
+   {
+      iterator it = lower_bound(t);
+      if (it != end() && !(t < *it))
+         return it;
+      return end();
+   }
+
+   /****************************************************
+    * PERSISTENT BST :: LOWER BOUND / UPPER BOUND
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::iterator PersistentBST<T>::lower_bound(const T& t) const
+   {
+      return descend([&t](const T& data) { return data < t; });
+   }
+
+   template <typename T>
+   typename PersistentBST<T>::iterator PersistentBST<T>::upper_bound(const T& t) const
+   {
+      return descend([&t](const T& data) { return !(t < data); });
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: INSERT
+    * A new version with t added after any equal elements
+    ****************************************************/
+   template <typename T>
+   PersistentBST<T> PersistentBST<T>::insert(const T& t, bool keepUnique) const
+   {
+      if (keepUnique && find(t) != end())
+         return *this;
+
+      Ptr p = insert(root, t);
+      if (p->isRed)
+         p = black(p->pLeft, p->data, p->pRight);
+      return PersistentBST(p, numElements + 1);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: INSERT (subtree)
+    * Copy the path down to where t goes. A red node may come
+    * back with a red child; the black node above fixes it
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::insert(const Ptr& p, const T& t)
+   {
+      if (!p)
+         return red(nullptr, t, nullptr);
+
+      if (t < p->data)
+      {
+         Ptr pLeft = insert(p->pLeft, t);
+         return p->isRed ? red(pLeft, p->data, p->pRight) : balance(pLeft, p->data, p->pRight);
+      }
+      Ptr pRight = insert(p->pRight, t);
+      return p->isRed ? red(p->pLeft, p->data, pRight) : balance(p->pLeft, p->data, pRight);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: BALANCE
+    * A black node whose children are pLeft and pRight. If a
+    * red child has a red child, the three become a red node
+    * with two black children:
+    *          z            z          x          x
+    *         /            /            \          \
+    *        y     or     x     or       z   or     y      =>      y
+    *       /              \            /            \            / \
+    *      x                y          y              z          x   z
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::balance(const Ptr& pLeft, const T& t, const Ptr& pRight)
+   {
+      if (isRed(pLeft) && isRed(pRight))
+         return red(black(pLeft->pLeft, pLeft->data, pLeft->pRight), t,
+                    black(pRight->pLeft, pRight->data, pRight->pRight));
+      if (isRed(pLeft) && isRed(pLeft->pLeft))
+         return red(black(pLeft->pLeft->pLeft, pLeft->pLeft->data, pLeft->pLeft->pRight), pLeft->data,
+                    black(pLeft->pRight, t, pRight));
+      if (isRed(pLeft) && isRed(pLeft->pRight))
+         return red(black(pLeft->pLeft, pLeft->data, pLeft->pRight->pLeft), pLeft->pRight->data,
+                    black(pLeft->pRight->pRight, t, pRight));
+      if (isRed(pRight) && isRed(pRight->pRight))
+         return red(black(pLeft, t, pRight->pLeft), pRight->data,
+                    black(pRight->pRight->pLeft, pRight->pRight->data, pRight->pRight->pRight));
+      if (isRed(pRight) && isRed(pRight->pLeft))
+         return red(black(pLeft, t, pRight->pLeft->pLeft), pRight->pLeft->data,
+                    black(pRight->pLeft->pRight, pRight->data, pRight->pRight));
+      return black(pLeft, t, pRight);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: ERASE
+    * A new version without any element equivalent to t
+    ****************************************************/
+   template <typename T>
+   PersistentBST<T> PersistentBST<T>::erase(const T& t) const
+   {
+      PersistentBST version = *this;
+      while (version.find(t) != version.end())
+         version = version.eraseAlong([&t](const BNode* p, size_t)
+            {
+               return t < p->data ? -1 : (p->data < t ? 1 : 0);
+            });
+      return version;
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: ERASE ITERATOR
+    * A new version without the very element it refers to,
+    * even when there are others equivalent to it
+    ****************************************************/
+   template <typename T>
+   PersistentBST<T> PersistentBST<T>::erase(const iterator& it) const
+   {
+      if (it == end())
+         return *this;
+
+      const std::vector<const BNode*>& path = it.path;
+      return eraseAlong([&path](const BNode* p, size_t depth)
+         {
+            if (depth + 1 == path.size())
+               return 0;
+            return path[depth + 1] == p->pLeft.get() ? -1 : 1;
+         });
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: ERASE ALONG
+    * Remove the one node that direction(p, depth) leads to:
+    * negative to go left, positive to go right, zero to stop
+    ****************************************************/
+   template <typename T>
+   template <typename Direction>
+   PersistentBST<T> PersistentBST<T>::eraseAlong(Direction direction) const
+   {
+      Ptr p = erase(root, direction, 0);
+      if (isRed(p))
+         p = black(p->pLeft, p->data, p->pRight);
+      return PersistentBST(p, numElements - 1);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: ERASE (subtree)
+    * Copy the path down to the node and fuse its two subtrees
+    * together in its place. Coming out of a black subtree, the
+    * tree may be one black short on that side; balanceLeft()
+    * and balanceRight() repay it
+    ****************************************************/
+   template <typename T>
+   template <typename Direction>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::erase(const Ptr& p, Direction& direction, size_t depth)
+   {
+      assert(p);
+      int goRight = direction(p.get(), depth);
+      if (goRight < 0)
+      {
+         if (isBlack(p->pLeft))
+            return balanceLeft(erase(p->pLeft, direction, depth + 1), p->data, p->pRight);
+         return red(erase(p->pLeft, direction, depth + 1), p->data, p->pRight);
+      }
+      if (goRight > 0)
+      {
+         if (isBlack(p->pRight))
+            return balanceRight(p->pLeft, p->data, erase(p->pRight, direction, depth + 1));
+         return red(p->pLeft, p->data, erase(p->pRight, direction, depth + 1));
+      }
+      return fuse(p->pLeft, p->pRight);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: BALANCE LEFT
+    * pLeft is one black shorter than pRight
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::balanceLeft(const Ptr& pLeft, const T& t, const Ptr& pRight)
+   {
+      // Case 1: The short side is red. Blacken it
+      if (isRed(pLeft))
+         return red(black(pLeft->pLeft, pLeft->data, pLeft->pRight), t, pRight);
+
+      // Case 2: The other side is black. Redden it and rebalance
+      if (isBlack(pRight))
+         return balance(pLeft, t, redden(pRight));
+
+      // Case 3: The other side is red with a black left child
+      assert(isRed(pRight) && isBlack(pRight->pLeft));
+      const Ptr& pInner = pRight->pLeft;
+      return red(black(pLeft, t, pInner->pLeft), pInner->data,
+                 balance(pInner->pRight, pRight->data, redden(pRight->pRight)));
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: BALANCE RIGHT
+    * pRight is one black shorter than pLeft
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::balanceRight(const Ptr& pLeft, const T& t, const Ptr& pRight)
+   {
+      // Case 1: The short side is red. Blacken it
+      if (isRed(pRight))
+         return red(pLeft, t, black(pRight->pLeft, pRight->data, pRight->pRight));
+
+      // Case 2: The other side is black. Redden it and rebalance
+      if (isBlack(pLeft))
+         return balance(redden(pLeft), t, pRight);
+
+      // Case 3: The other side is red with a black right child
+      assert(isRed(pLeft) && isBlack(pLeft->pRight));
+      const Ptr& pInner = pLeft->pRight;
+      return red(balance(redden(pLeft->pLeft), pLeft->data, pInner->pLeft), pInner->data,
+                 black(pInner->pRight, t, pRight));
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: REDDEN
+    * The same black node, colored red
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::redden(const Ptr& p)
+   {
+      assert(isBlack(p));
+      return red(p->pLeft, p->data, p->pRight);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: FUSE
+    * Join two subtrees of equal black height, every element of
+    * pLeft before every element of pRight
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::fuse(const Ptr& pLeft, const Ptr& pRight)
+   {
+      if (!pLeft)
+         return pRight;
+      if (!pRight)
+         return pLeft;
+
+      // Case 1: One side red. Keep it and fuse beneath it
+      if (pLeft->isRed && !pRight->isRed)
+         return red(pLeft->pLeft, pLeft->data, fuse(pLeft->pRight, pRight));
+      if (!pLeft->isRed && pRight->isRed)
+         return red(fuse(pLeft, pRight->pLeft), pRight->data, pRight->pRight);
+
+      // Case 2: Both the same color. Fuse the inner subtrees
+      Ptr pMiddle = fuse(pLeft->pRight, pRight->pLeft);
+      if (isRed(pMiddle))
+      {
+         bool isRedPair = pLeft->isRed;
+         Ptr pNewLeft  = isRedPair ? red  (pLeft->pLeft, pLeft->data, pMiddle->pLeft)
+                                   : black(pLeft->pLeft, pLeft->data, pMiddle->pLeft);
+         Ptr pNewRight = isRedPair ? red  (pMiddle->pRight, pRight->data, pRight->pRight)
+                                   : black(pMiddle->pRight, pRight->data, pRight->pRight);
+         return red(pNewLeft, pMiddle->data, pNewRight);
+      }
+      if (pLeft->isRed)
+         return red(pLeft->pLeft, pLeft->data, red(pMiddle, pRight->data, pRight->pRight));
+      return balanceLeft(pLeft->pLeft, pLeft->data, black(pMiddle, pRight->data, pRight->pRight));
+   }
+
+   /*************************************************
+    *************************************************
+    *************************************************
+    ****************** ITERATOR *********************
+    *************************************************
+    *************************************************
+    *************************************************/
+
+   /**************************************************
+    * PERSISTENT BST ITERATOR :: INCREMENT PREFIX
+    *************************************************/
+   template <typename T>
+   typename PersistentBST<T>::iterator& PersistentBST<T>::iterator::operator ++()
+   {
+      if (path.empty())
+         return *this;
+
+      // Case 1: A right child. The next is the left-most node beneath it
+      if (const BNode* p = path.back()->pRight.get())
+      {
+         for (; p; p = p->pLeft.get())
+            path.push_back(p);
+         return *this;
+      }
+
+      // Case 2: Climb until we come up from a left child
+      const BNode* pChild;
+      do
+      {
+         pChild = path.back();
+         path.pop_back();
+      }
+      while (!path.empty() && path.back()->pRight.get() == pChild);
+      return *this;
+   }
+
+   /**************************************************
+    * PERSISTENT BST ITERATOR :: DECREMENT PREFIX
+    *************************************************/
+   template <typename T>
+   typename PersistentBST<T>::iterator& PersistentBST<T>::iterator::operator --()
+   {
+      if (path.empty())
+         return *this;
+
+      // Case 1: A left child. The previous is the right-most node beneath it
+      if (const BNode* p = path.back()->pLeft.get())
+      {
+         for (; p; p = p->pRight.get())
+            path.push_back(p);
+         return *this;
+      }
+
+      // Case 2: Climb until we come up from a right child
+      const BNode* pChild;
+      do
+      {
+         pChild = path.back();
+         path.pop_back();
+      }
+      while (!path.empty() && path.back()->pLeft.get() == pChild);
+      return *this;
+   }
+
+   /*********************************************
+    * PERSISTENT BST :: BUILD
+    * A new version holding the elements sorted points to,
+    * which are already in order. Every leaf ends up on one
+    * of the bottom two levels, so coloring the bottom level
+    * red and all others black satisfies the red-black rules.
+    * A root alone on its level stays black
+    ********************************************/
+   template <typename T>
+   PersistentBST<T> PersistentBST<T>::build(const std::vector<const T*>& sorted)
+   {
+      size_t redDepth = 0;
+      for (size_t num = sorted.size(); num > 1; num >>= 1)
+         redDepth++;
+      return PersistentBST(build(sorted.data(), sorted.size(), 0, redDepth), sorted.size());
+   }
+
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::build(const T* const* ppData, size_t num,
+                                                          size_t depth, size_t redDepth)
+   {
+      if (num == 0)
+         return Ptr();
+
+      size_t iMiddle = num / 2;
+      Ptr pLeft  = build(ppData, iMiddle, depth + 1, redDepth);
+      Ptr pRight = build(ppData + iMiddle + 1, num - iMiddle - 1, depth + 1, redDepth);
+      return depth == redDepth && depth > 0 ? red  (pLeft, *ppData[iMiddle], pRight)
+                                            : black(pLeft, *ppData[iMiddle], pRight);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: BLACK HEIGHT
+    * The black nodes down the left spine, p included
+    ****************************************************/
+   template <typename T>
+   size_t PersistentBST<T>::blackHeight(const Ptr& p)
+   {
+      size_t height = 0;
+      for (const BNode* pNode = p.get(); pNode; pNode = pNode->pLeft.get())
+         height += pNode->isRed ? 0 : 1;
+      return height;
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: BLACKEN
+    * The same subtree with a black root, which join() needs.
+    * A red root is cloned black and the height grows by one
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::blacken(const Ptr& p, size_t& height)
+   {
+      if (!isRed(p))
+         return p;
+      height++;
+      return black(p->pLeft, p->data, p->pRight);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: JOIN
+    * One subtree of everything in pLeft, then t, then everything
+    * in pRight. Both have black roots. t goes down the spine of
+    * the taller one to where the black heights match; the path
+    * above it is copied and rebalanced as insert() would, so the
+    * cost is the difference in heights, O(log n)
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::join(const Ptr& pLeft, size_t hLeft, const T& t,
+                                                         const Ptr& pRight, size_t hRight, size_t& height)
+   {
+      assert(!isRed(pLeft) && !isRed(pRight));
+      Ptr p = hLeft >= hRight ? joinRight(pLeft, hLeft, t, pRight, hRight)
+                              : joinLeft (pLeft, hLeft, t, pRight, hRight);
+      height = hLeft >= hRight ? hLeft : hRight;
+      return blacken(p, height);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: JOIN RIGHT / JOIN LEFT
+    * Down the right spine of the taller pLeft (or the left spine
+    * of the taller pRight) to a black node as tall as the other
+    * side, which becomes t's sibling under a new red node. A red
+    * node may come back with a red child; the black node above
+    * fixes it with balance()
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::joinRight(const Ptr& pLeft, size_t hLeft, const T& t,
+                                                              const Ptr& pRight, size_t hRight)
+   {
+      if (hLeft == hRight && !isRed(pLeft))
+         return red(pLeft, t, pRight);
+      if (pLeft->isRed)
+         return red(pLeft->pLeft, pLeft->data, joinRight(pLeft->pRight, hLeft, t, pRight, hRight));
+      return balance(pLeft->pLeft, pLeft->data, joinRight(pLeft->pRight, hLeft - 1, t, pRight, hRight));
+   }
+
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::joinLeft(const Ptr& pLeft, size_t hLeft, const T& t,
+                                                             const Ptr& pRight, size_t hRight)
+   {
+      if (hLeft == hRight && !isRed(pRight))
+         return red(pLeft, t, pRight);
+      if (pRight->isRed)
+         return red(joinLeft(pLeft, hLeft, t, pRight->pLeft, hRight), pRight->data, pRight->pRight);
+      return balance(joinLeft(pLeft, hLeft, t, pRight->pLeft, hRight - 1), pRight->data, pRight->pRight);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: CONCAT
+    * join() with no element between: the first element of
+    * pRight is split off to stand in the middle
+    ****************************************************/
+   template <typename T>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::concat(const Ptr& pLeft, size_t hLeft,
+                                                           const Ptr& pRight, size_t hRight, size_t& height)
+   {
+      if (!pRight)
+      {
+         height = hLeft;
+         return pLeft;
+      }
+      if (!pLeft)
+      {
+         height = hRight;
+         return pRight;
+      }
+
+      std::vector<const BNode*> path;
+      for (const BNode* p = pRight.get(); p; p = p->pLeft.get())
+         path.push_back(p);
+      Ptr pNone;
+      Ptr pRest;
+      size_t hNone;
+      size_t hRest;
+      split(pRight, hRight, path, 0, pNone, hNone, pRest, hRest);
+      return join(pLeft, hLeft, path.back()->data, pRest, hRest, height);
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: SPLIT
+    * Cut the subtree p at the node path ends at: pLeft gets
+    * everything before it and pRight everything after, both
+    * with black roots. path[depth] is p. Each subtree hanging
+    * off the path is joined onto its side on the way back up
+    * without being copied, O(log n) in all
+    ****************************************************/
+   template <typename T>
+   void PersistentBST<T>::split(const Ptr& p, size_t height, const std::vector<const BNode*>& path, size_t depth,
+                                Ptr& pLeft, size_t& hLeft, Ptr& pRight, size_t& hRight)
+   {
+      assert(p.get() == path[depth]);
+      size_t hChild = height - (p->isRed ? 0 : 1);
+      if (depth + 1 == path.size())
+      {
+         hLeft = hRight = hChild;
+         pLeft  = blacken(p->pLeft,  hLeft);
+         pRight = blacken(p->pRight, hRight);
+      }
+      else if (path[depth + 1] == p->pLeft.get())
+      {
+         Ptr pMiddle;
+         size_t hMiddle;
+         split(p->pLeft, hChild, path, depth + 1, pLeft, hLeft, pMiddle, hMiddle);
+         size_t hOther = hChild;
+         Ptr pOther = blacken(p->pRight, hOther);
+         pRight = join(pMiddle, hMiddle, p->data, pOther, hOther, hRight);
+      }
+      else
+      {
+         Ptr pMiddle;
+         size_t hMiddle;
+         split(p->pRight, hChild, path, depth + 1, pMiddle, hMiddle, pRight, hRight);
+         size_t hOther = hChild;
+         Ptr pOther = blacken(p->pLeft, hOther);
+         pLeft = join(pOther, hOther, p->data, pMiddle, hMiddle, hLeft);
+      }
+   }
+
+   /*****************************************************
+    * PERSISTENT BST :: FILTER
+    * The subtree p without the elements doomed() is true for,
+    * asked of each element in order. A subtree that loses
+    * nothing comes back as it was, shared; only the paths to
+    * the doomed nodes are rebuilt, with join() and concat()
+    ****************************************************/
+   template <typename T>
+   template <typename Doomed>
+   typename PersistentBST<T>::Ptr PersistentBST<T>::filter(const Ptr& p, size_t height, Doomed& doomed, size_t& hNew)
+   {
+      if (!p)
+      {
+         hNew = 0;
+         return p;
+      }
+
+      size_t hChild = height - (p->isRed ? 0 : 1);
+      size_t hLeft;
+      size_t hRight;
+      Ptr pLeft = filter(p->pLeft, hChild, doomed, hLeft);
+      bool isDoomed = doomed(p->data);
+      Ptr pRight = filter(p->pRight, hChild, doomed, hRight);
+      if (!isDoomed && pLeft == p->pLeft && pRight == p->pRight)
+      {
+         hNew = height;
+         return p;
+      }
+
+      pLeft  = blacken(pLeft,  hLeft);
+      pRight = blacken(pRight, hRight);
+      if (isDoomed)
+         return concat(pLeft, hLeft, pRight, hRight, hNew);
+      return join(pLeft, hLeft, p->data, pRight, hRight, hNew);
+   }
+
+} // namespace custom
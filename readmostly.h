@@ -0,0 +1,637 @@
+/***********************************************************************
+ * Header:
+ *    READ MOSTLY
+ * Summary:
+ *    A red-black tree for many readers and few writers. Readers take no
+ *    lock at all: find() and the bounds walk down child pointers that
+ *    writers publish atomically, so read throughput grows with the
+ *    number of cores instead of queuing on a lock.
+ *
+ *    Writers take turns on a mutex. Two things keep readers safe while
+ *    a writer works:
+ *    - A version number, odd while a write is under way. A reader
+ *      that saw it change (a rotation may have hidden a node from it)
+ *      throws its answer away and tries again. After a few failed tries
+ *      it waits on the writers' mutex so it cannot starve.
+ *    - Epoch-based reclamation (see epoch.h). Erased nodes are retired,
+ *      not deleted, until every reader that might hold one has left.
+ *    Rotations only move nodes, so only erase() and clear() retire any.
+ *
+ *    A node's element is never changed after it is linked in, so a
+ *    reader can copy it safely.
+ *
+ *    This will contain the class definition of:
+ *        concurrent::ReadMostlyBST : A tree with lock-free reads
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <atomic>       // for std::atomic
+#include <mutex>        // for std::mutex and std::lock_guard
+#include <optional>     // for std::optional
+#include <thread>       // for std::this_thread::yield
+#include <vector>       // for std::vector
+#include "epoch.h"      // for epoch::Guard and epoch::Retired
+
+class TestReadMostly; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace concurrent
+   {
+
+   /*****************************************************************
+    * READ MOSTLY BST
+    * A red-black tree whose reads never lock
+    *****************************************************************/
+   template <typename T>
+   class ReadMostlyBST
+   {
+      friend class ::TestReadMostly; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      ReadMostlyBST() : root(nullptr), numElements(0), version(0) {}
+      ReadMostlyBST(const ReadMostlyBST& rhs) = delete;
+      ReadMostlyBST& operator =(const ReadMostlyBST& rhs) = delete;
+      ~ReadMostlyBST();
+
+      //
+      // Read: lock-free
+      //
+
+      bool             contains(const T& t) const;
+      std::optional<T> find(const T& t) const;
+      std::optional<T> lower_bound(const T& t) const;
+      std::optional<T> upper_bound(const T& t) const;
+      std::vector<T>   snapshot() const;
+      size_t           size() const { return numElements.load(std::memory_order_relaxed); }
+      bool             empty() const { return size() == 0; }
+
+      //
+      // Write: one writer at a time
+      //
+
+      bool   insert(const T& t, bool keepUnique = false);
+      size_t erase(const T& t);
+      void   clear();
+
+   private:
+
+      class BNode;
+
+      // tries before a reader gives up and waits for the writers
+      static const int maxOptimisticReads = 8;
+
+      template <class Function>
+      auto optimisticRead(Function f) const;
+      template <typename GoRight>
+      const BNode* descend(GoRight goRight) const;
+
+      void beginWrite();
+      void endWrite();
+
+      // writer-side navigation: only writers change links, so relaxed loads
+      static BNode* left (const BNode* p) { return p->pLeft.load(std::memory_order_relaxed); }
+      static BNode* right(const BNode* p) { return p->pRight.load(std::memory_order_relaxed); }
+      static bool   isRed(const BNode* p) { return p && p->isRed; }
+      static void   setLeft (BNode* p, BNode* pChild);
+      static void   setRight(BNode* p, BNode* pChild);
+      void replaceChild(BNode* pParent, BNode* pOld, BNode* pNew);
+      void rotateLeft (BNode* p);
+      void rotateRight(BNode* p);
+      void insertFixup(BNode* p);
+      void eraseNode(BNode* p);
+      void eraseFixup(BNode* p, BNode* pParent);
+      void retireAll(BNode* p);
+
+      std::atomic<BNode*> root;            // published root
+      std::atomic<size_t> numElements;     // number of elements
+      std::atomic<size_t> version;         // odd while a write is under way
+      mutable std::mutex writerMutex;      // serializes writers, and starved readers
+      epoch::Retired<BNode> retired;       // erased nodes readers may still hold
+   };
+
+   /*****************************************************************
+    * READ MOSTLY BST NODE
+    * Children are atomic because readers follow them without a lock.
+    * The parent and color are for writers only
+    *****************************************************************/
+   template <typename T>
+   class ReadMostlyBST<T>::BNode
+   {
+   public:
+      BNode(const T& t) : data(t), pLeft(nullptr), pRight(nullptr), pParent(nullptr), isRed(true)
+      {}
+
+      const T data;                       // never changes once linked in
+      std::atomic<BNode*> pLeft;          // left child
+      std::atomic<BNode*> pRight;         // right child
+      BNode* pParent;                     // parent, or nullptr for the root
+      bool isRed;                         // red-black coloring
+   };
+
+   /*********************************************
+    * READ MOSTLY BST :: DESTRUCTOR
+    * No reader may still be using the tree
+    ********************************************/
+   template <typename T>
+   ReadMostlyBST<T>::~ReadMostlyBST()
+   {
+      std::vector<BNode*> stack;
+      if (BNode* p = root.load())
+         stack.push_back(p);
+      while (!stack.empty())
+      {
+         BNode* p = stack.back();
+         stack.pop_back();
+         if (left(p))
+            stack.push_back(left(p));
+         if (right(p))
+            stack.push_back(right(p));
+         delete p;
+      }
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: OPTIMISTIC READ
+    * Run f() while pinned, keeping its answer only if no write
+    * began or ended meanwhile. Readers that keep losing to
+    * writers wait for them on the writers' mutex
+    ****************************************************/
+   template <typename T>
+   template <class Function>
+   auto ReadMostlyBST<T>::optimisticRead(Function f) const
+   {
+      epoch::Guard guard;
+      for (int attempt = 0; attempt < maxOptimisticReads; attempt++)
+      {
+         size_t before = version.load(std::memory_order_acquire);
+         if (before & 1)
+         {
+            std::this_thread::yield();
+            continue;
+         }
+         auto result = f();
+         std::atomic_thread_fence(std::memory_order_acquire);
+         if (version.load(std::memory_order_relaxed) == before)
+            return result;
+      }
+
+      std::lock_guard<std::mutex> lock(writerMutex);
+      return f();
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: DESCEND
+    * Walk from the root: right when goRight() is true, left
+    * otherwise. Return the last node where we went left
+    ****************************************************/
+   template <typename T>
+   template <typename GoRight>
+   const typename ReadMostlyBST<T>::BNode* ReadMostlyBST<T>::descend(GoRight goRight) const
+   {
+      const BNode* pResult = nullptr;
+      const BNode* p = root.load(std::memory_order_acquire);
+      while (p)
+      {
+         if (goRight(p->data))
+            p = p->pRight.load(std::memory_order_acquire);
+         else
+         {
+            pResult = p;
+            p = p->pLeft.load(std::memory_order_acquire);
+         }
+      }
+      return pResult;
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: CONTAINS
+    ****************************************************/
+   template <typename T>
+   bool ReadMostlyBST<T>::contains(const T& t) const
+   {
+      return find(t).has_value();
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: FIND
+    * A copy of an element equivalent to t, if there is one
+    ****************************************************/
+   template <typename T>
+   std::optional<T> ReadMostlyBST<T>::find(const T& t) const
+   {
+      return optimisticRead([this, &t]() -> std::optional<T>
+         {
+            const BNode* p = descend([&t](const T& data) { return data < t; });
+            if (p && !(t < p->data))
+               return p->data;
+            return std::nullopt;
+         });
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: LOWER BOUND
+    * A copy of the first element not less than t
+    ****************************************************/
+   template <typename T>
+   std::optional<T> ReadMostlyBST<T>::lower_bound(const T& t) const
+   {
+      return optimisticRead([this, &t]() -> std::optional<T>
+         {
+            const BNode* p = descend([&t](const T& data) { return data < t; });
+            if (p)
+               return p->data;
+            return std::nullopt;
+         });
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: UPPER BOUND
+    * A copy of the first element greater than t
+    ****************************************************/
+   template <typename T>
+   std::optional<T> ReadMostlyBST<T>::upper_bound(const T& t) const
+   {
+      return optimisticRead([this, &t]() -> std::optional<T>
+         {
+            const BNode* p = descend([&t](const T& data) { return !(t < data); });
+            if (p)
+               return p->data;
+            return std::nullopt;
+         });
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: SNAPSHOT
+    * Every element, in order, as of one moment
+    ****************************************************/
+   template <typename T>
+   std::vector<T> ReadMostlyBST<T>::snapshot() const
+   {
+      return optimisticRead([this]()
+         {
+            std::vector<T> elements;
+            std::vector<const BNode*> stack;
+            const BNode* p = root.load(std::memory_order_acquire);
+            while (p || !stack.empty())
+            {
+               for (; p; p = p->pLeft.load(std::memory_order_acquire))
+                  stack.push_back(p);
+               p = stack.back();
+               stack.pop_back();
+               elements.push_back(p->data);
+               p = p->pRight.load(std::memory_order_acquire);
+            }
+            return elements;
+         });
+   }
+
+   /****************************************************
+    * READ MOSTLY BST :: BEGIN WRITE / END WRITE
+    * Bracket every change to the links with an odd version
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::beginWrite()
+   {
+      version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+   }
+
+   template <typename T>
+   void ReadMostlyBST<T>::endWrite()
+   {
+      version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: INSERT
+    * Insert after any equal elements. Returns false if
+    * keepUnique turned the element away
+    ****************************************************/
+   template <typename T>
+   bool ReadMostlyBST<T>::insert(const T& t, bool keepUnique)
+   {
+      std::lock_guard<std::mutex> lock(writerMutex);
+
+      BNode* pParent = nullptr;
+      for (BNode* p = root.load(std::memory_order_relaxed); p; p = t < p->data ? left(p) : right(p))
+      {
+         if (keepUnique && !(t < p->data) && !(p->data < t))
+            return false;
+         pParent = p;
+      }
+
+      // build the node completely before anyone can see it
+      BNode* pNew = new BNode(t);
+
+      beginWrite();
+      if (!pParent)
+         replaceChild(nullptr, nullptr, pNew);
+      else if (t < pParent->data)
+         setLeft(pParent, pNew);
+      else
+         setRight(pParent, pNew);
+      insertFixup(pNew);
+      endWrite();
+
+      numElements.fetch_add(1, std::memory_order_relaxed);
+      return true;
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: ERASE
+    * Remove every element equivalent to t
+    ****************************************************/
+   template <typename T>
+   size_t ReadMostlyBST<T>::erase(const T& t)
+   {
+      std::lock_guard<std::mutex> lock(writerMutex);
+
+      size_t num = 0;
+      while (true)
+      {
+         BNode* p = root.load(std::memory_order_relaxed);
+         while (p && ((t < p->data) || (p->data < t)))
+            p = t < p->data ? left(p) : right(p);
+         if (!p)
+            break;
+
+         beginWrite();
+         eraseNode(p);
+         endWrite();
+         retired.retire(p);
+         num++;
+      }
+
+      numElements.fetch_sub(num, std::memory_order_relaxed);
+      retired.reclaim();
+      return num;
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: CLEAR
+    * Unhook the whole tree at once, then retire every node
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::clear()
+   {
+      std::lock_guard<std::mutex> lock(writerMutex);
+
+      BNode* pOld = root.load(std::memory_order_relaxed);
+      beginWrite();
+      root.store(nullptr, std::memory_order_release);
+      endWrite();
+      numElements.store(0, std::memory_order_relaxed);
+
+      retireAll(pOld);
+      retired.reclaim();
+   }
+
+   template <typename T>
+   void ReadMostlyBST<T>::retireAll(BNode* p)
+   {
+      if (!p)
+         return;
+      retireAll(left(p));
+      retireAll(right(p));
+      retired.retire(p);
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: SET LEFT / SET RIGHT
+    * Publish a child. Release so a reader that finds the
+    * child also sees everything written into it
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::setLeft(BNode* p, BNode* pChild)
+   {
+      p->pLeft.store(pChild, std::memory_order_release);
+      if (pChild)
+         pChild->pParent = p;
+   }
+
+   template <typename T>
+   void ReadMostlyBST<T>::setRight(BNode* p, BNode* pChild)
+   {
+      p->pRight.store(pChild, std::memory_order_release);
+      if (pChild)
+         pChild->pParent = p;
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: REPLACE CHILD
+    * Put pNew where pOld hangs from pParent (or the root)
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::replaceChild(BNode* pParent, BNode* pOld, BNode* pNew)
+   {
+      if (!pParent)
+      {
+         root.store(pNew, std::memory_order_release);
+         if (pNew)
+            pNew->pParent = nullptr;
+      }
+      else if (left(pParent) == pOld)
+         setLeft(pParent, pNew);
+      else
+         setRight(pParent, pNew);
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: ROTATE LEFT
+    *        p                 r
+    *       / \               / \
+    *      a   r     =>      p   c
+    *         / \           / \
+    *        b   c         a   b
+    * The links change bottom-up, so a reader part way down
+    * never finds a loop
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::rotateLeft(BNode* p)
+   {
+      BNode* pRight  = right(p);
+      BNode* pParent = p->pParent;
+      setRight(p, left(pRight));
+      setLeft(pRight, p);
+      replaceChild(pParent, p, pRight);
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: ROTATE RIGHT
+    * The mirror image of rotateLeft()
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::rotateRight(BNode* p)
+   {
+      BNode* pLeft   = left(p);
+      BNode* pParent = p->pParent;
+      setLeft(p, right(pLeft));
+      setRight(pLeft, p);
+      replaceChild(pParent, p, pLeft);
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: INSERT FIXUP
+    * Restore the red-black rules after adding red node p
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::insertFixup(BNode* p)
+   {
+      while (isRed(p->pParent))
+      {
+         BNode* pParent = p->pParent;
+         BNode* pGranny = pParent->pParent;     // a red parent is never the root
+         bool parentIsLeft = (pParent == left(pGranny));
+         BNode* pAunt = parentIsLeft ? right(pGranny) : left(pGranny);
+
+         // Case 1: Red aunt. Recolor and continue from the grandparent
+         if (isRed(pAunt))
+         {
+            pParent->isRed = false;
+            pAunt->isRed = false;
+            pGranny->isRed = true;
+            p = pGranny;
+            continue;
+         }
+
+         // Case 2: Black aunt, p on the inside. Rotate it to the outside
+         if (parentIsLeft && p == right(pParent))
+         {
+            rotateLeft(pParent);
+            p = pParent;
+            pParent = p->pParent;
+         }
+         else if (!parentIsLeft && p == left(pParent))
+         {
+            rotateRight(pParent);
+            p = pParent;
+            pParent = p->pParent;
+         }
+
+         // Case 3: Black aunt, p on the outside. Rotate the grandparent
+         pParent->isRed = false;
+         pGranny->isRed = true;
+         if (parentIsLeft)
+            rotateRight(pGranny);
+         else
+            rotateLeft(pGranny);
+      }
+      root.load(std::memory_order_relaxed)->isRed = false;
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: ERASE NODE
+    * Unlink p. A node with two children trades places with its
+    * successor by relinking, never by copying the element,
+    * since readers may be reading it
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::eraseNode(BNode* p)
+   {
+      BNode* pChild;              // what takes the place of the removed node
+      BNode* pChildParent;        // and where it now hangs
+      bool removedRed = p->isRed;
+
+      if (!left(p) || !right(p))
+      {
+         pChild = left(p) ? left(p) : right(p);
+         pChildParent = p->pParent;
+         replaceChild(p->pParent, p, pChild);
+      }
+      else
+      {
+         BNode* pNext = right(p);
+         while (left(pNext))
+            pNext = left(pNext);
+         removedRed = pNext->isRed;
+         pChild = right(pNext);
+
+         if (pNext->pParent == p)
+            pChildParent = pNext;
+         else
+         {
+            pChildParent = pNext->pParent;
+            replaceChild(pNext->pParent, pNext, pChild);
+            setRight(pNext, right(p));
+         }
+         replaceChild(p->pParent, p, pNext);
+         setLeft(pNext, left(p));
+         pNext->isRed = p->isRed;
+      }
+
+      if (!removedRed)
+         eraseFixup(pChild, pChildParent);
+   }
+
+   /*****************************************************
+    * READ MOSTLY BST :: ERASE FIXUP
+    * p (possibly null) under pParent is short one black
+    ****************************************************/
+   template <typename T>
+   void ReadMostlyBST<T>::eraseFixup(BNode* p, BNode* pParent)
+   {
+      while (p != root.load(std::memory_order_relaxed) && !isRed(p))
+      {
+         bool isLeft = (p == left(pParent));
+         BNode* pSibling = isLeft ? right(pParent) : left(pParent);
+
+         // Case 1: Red sibling. Rotate so the sibling is black
+         if (isRed(pSibling))
+         {
+            pSibling->isRed = false;
+            pParent->isRed = true;
+            if (isLeft)
+               rotateLeft(pParent);
+            else
+               rotateRight(pParent);
+            pSibling = isLeft ? right(pParent) : left(pParent);
+         }
+
+         BNode* pNear = isLeft ? left(pSibling) : right(pSibling);
+         BNode* pFar  = isLeft ? right(pSibling) : left(pSibling);
+
+         // Case 2: Black sibling with black children. Push the problem up
+         if (!isRed(pNear) && !isRed(pFar))
+         {
+            pSibling->isRed = true;
+            p = pParent;
+            pParent = p->pParent;
+            continue;
+         }
+
+         // Case 3: Only the near nephew is red. Rotate it to the outside
+         if (!isRed(pFar))
+         {
+            pNear->isRed = false;
+            pSibling->isRed = true;
+            if (isLeft)
+               rotateRight(pSibling);
+            else
+               rotateLeft(pSibling);
+            pFar = pSibling;
+            pSibling = isLeft ? right(pParent) : left(pParent);
+         }
+
+         // Case 4: The far nephew is red. Rotate the parent and stop
+         pSibling->isRed = pParent->isRed;
+         pParent->isRed = false;
+         pFar->isRed = false;
+         if (isLeft)
+            rotateLeft(pParent);
+         else
+            rotateRight(pParent);
+         p = root.load(std::memory_order_relaxed);
+      }
+      if (p)
+         p->isRed = false;
+   }
+
+   } // namespace concurrent
+} // namespace custom
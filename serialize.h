@@ -0,0 +1,187 @@
+/***********************************************************************
+ * Header:
+ *    SERIALIZE
+ * Summary:
+ *    Save the contents of a BST to a stream and load them back in O(n).
+ *
+ *    The format is a small header and then the elements in sorted
+ *    order:
+ *        magic   4 bytes   "BST" and a format version
+ *        width   uint32    bytes per element, or 0 if each element
+ *                          was written by a codec of its own length
+ *        count   uint64    number of elements
+ *        elements
+ *    Numbers are in the byte order of the machine that wrote them.
+ *
+ *    Since the elements arrive sorted, loading links them straight into
+ *    a balanced tree colored by depth, as erase_if() does: no insert(),
+ *    no comparisons beyond checking the order, and no balance().
+ *
+ *    A codec turns one element into bytes and back. BitwiseCodec, the
+ *    default, copies the bytes of a trivially copyable T and works in
+ *    blocks; any other type brings a codec with
+ *        bool write(std::ostream& out, const T& t);
+ *        bool read (std::istream& in, T& t);
+ *
+ *    This will contain the definitions of:
+ *        BitwiseCodec           : The codec for trivially copyable types
+ *        BST::serialize()       : Write the elements to a stream
+ *        BST::deserialize()     : Replace the elements with a stream's
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <algorithm>   // for std::equal
+#include <cstdint>     // for uint32_t and uint64_t
+#include <istream>     // for std::istream
+#include <ostream>     // for std::ostream
+#include <type_traits> // for std::is_trivially_copyable_v
+#include <utility>     // for std::forward and std::move
+#include <vector>      // for std::vector
+#include "bst.h"
+
+namespace custom
+{
+
+   namespace serial
+   {
+      inline constexpr char magic[4] = { 'B', 'S', 'T', 1 };
+      inline constexpr size_t blockSize = 4096;   // elements a BitwiseCodec moves at once
+   } // namespace serial
+
+   /*****************************************************************
+    * BITWISE CODEC
+    * An element is its bytes
+    *****************************************************************/
+   template <typename T>
+   struct BitwiseCodec
+   {
+      static_assert(std::is_trivially_copyable_v<T>,
+                    "BitwiseCodec needs a trivially copyable type; pass a codec for this one");
+
+      bool write(std::ostream& out, const T& t)
+      {
+         return bool(out.write(reinterpret_cast<const char*>(&t), sizeof(T)));
+      }
+      bool read(std::istream& in, T& t)
+      {
+         return bool(in.read(reinterpret_cast<char*>(&t), sizeof(T)));
+      }
+   };
+
+   /****************************************************
+    * BST :: SERIALIZE
+    * Write the header and every element in order. With
+    * BitwiseCodec the elements go out a block at a time.
+    * False if the stream failed
+    ****************************************************/
+   template <typename T>
+   template <class Codec>
+   bool BST<T>::serialize(std::ostream& out, Codec codec) const
+   {
+      constexpr bool isBitwise = std::is_same_v<Codec, BitwiseCodec<T>>;
+      uint32_t width = isBitwise ? (uint32_t)sizeof(T) : 0;
+      uint64_t count = numElements;
+      out.write(serial::magic, sizeof(serial::magic));
+      out.write(reinterpret_cast<const char*>(&width), sizeof(width));
+      out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+      if constexpr (isBitwise)
+      {
+         std::vector<T> block;
+         block.reserve(serial::blockSize);
+         for (iterator it = begin(); out && it != end(); ++it)
+         {
+            block.push_back(*it);
+            if (block.size() == serial::blockSize)
+            {
+               out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(T));
+               block.clear();
+            }
+         }
+         out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(T));
+      }
+      else
+         for (iterator it = begin(); out && it != end(); ++it)
+            if (!codec.write(out, *it))
+               return false;
+
+      return bool(out);
+   }
+
+   /****************************************************
+    * BST :: DESERIALIZE
+    * Read what serialize() wrote, make a node for each
+    * element, and link the nodes into a balanced tree.
+    * False, leaving the tree as it was, if the stream
+    * fails, the header is wrong, or the elements are not
+    * in order
+    ****************************************************/
+   template <typename T>
+   template <class Codec>
+   bool BST<T>::deserialize(std::istream& in, Codec codec)
+   {
+      constexpr bool isBitwise = std::is_same_v<Codec, BitwiseCodec<T>>;
+      char magic[sizeof(serial::magic)];
+      uint32_t width;
+      uint64_t count;
+      in.read(magic, sizeof(magic));
+      in.read(reinterpret_cast<char*>(&width), sizeof(width));
+      in.read(reinterpret_cast<char*>(&count), sizeof(count));
+      if (!in || !std::equal(magic, magic + sizeof(magic), serial::magic) ||
+          width != (isBitwise ? sizeof(T) : 0))
+         return false;
+
+      std::vector<BNode*> nodes;
+      auto fail = [&nodes]()
+      {
+         discard(nodes);
+         return false;
+      };
+      auto add = [&nodes](auto&& t)
+      {
+         if (!nodes.empty() && t < nodes.back()->data)
+            return false;
+         nodes.push_back(new BNode(std::forward<decltype(t)>(t)));
+         return true;
+      };
+
+      try
+      {
+         if constexpr (isBitwise)
+         {
+            std::vector<T> block(serial::blockSize);
+            for (uint64_t numRead = 0; numRead < count; )
+            {
+               size_t num = count - numRead < serial::blockSize ?
+                            (size_t)(count - numRead) : serial::blockSize;
+               if (!in.read(reinterpret_cast<char*>(block.data()), num * sizeof(T)))
+                  return fail();
+               for (size_t i = 0; i < num; i++)
+                  if (!add(block[i]))
+                     return fail();
+               numRead += num;
+            }
+         }
+         else
+         {
+            T t;
+            for (uint64_t i = 0; i < count; i++)
+               if (!codec.read(in, t) || !add(std::move(t)))
+                  return fail();
+         }
+      }
+      catch (...)
+      {
+         discard(nodes);
+         throw;
+      }
+
+      clear();
+      adoptSorted(nodes);
+      return true;
+   }
+
+} // namespace custom
@@ -0,0 +1,434 @@
+/***********************************************************************
+ * Header:
+ *    SHARDED
+ * Summary:
+ *    A tree split by key range into N independent BSTs, each behind its
+ *    own lock, so writers working in different ranges never wait on one
+ *    another. N-1 splitters mark the boundaries: shard i holds the keys
+ *    from splitter i-1 (inclusive) up to splitter i (exclusive). Since
+ *    the shards are ordered, walking them one after the other visits
+ *    every element in order.
+ *
+ *    A tree that starts without splitters keeps everything in the first
+ *    shard until it has a few elements to look at. From then on, whenever
+ *    one shard holds more than twice its share and the tree has grown
+ *    by half since the last time, the splitters move to the quantiles of
+ *    the keys actually stored and each shard is linked straight from its
+ *    slice of them, O(n). That takes every lock, but the growth rule
+ *    keeps its cost to O(1) per insert over time.
+ *
+ *    The splitters are published through one atomic pointer, and an
+ *    old set is freed by epoch-based reclamation (see epoch.h), so a
+ *    writer touches no lock but its own shard's. Having locked the
+ *    shard, it checks the pointer again: a rebalance swaps it while
+ *    holding every shard's lock, so if it has not changed the shard
+ *    is still the right one.
+ *
+ *    This will contain the class definition of:
+ *        concurrent::ShardedBST           : A range-partitioned tree
+ *        concurrent::ShardedBST::iterator : An in-order walk of all shards
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <algorithm>      // for std::upper_bound and std::lower_bound
+#include <atomic>         // for std::atomic
+#include <cassert>
+#include <mutex>          // for std::mutex, std::lock_guard and std::unique_lock
+#include <optional>       // for std::optional
+#include <shared_mutex>   // for std::shared_mutex and std::shared_lock
+#include <vector>         // for std::vector
+#include "bst.h"
+#include "epoch.h"        // for epoch::Guard and epoch::Retired
+#include "external.h"     // for BST::build_sorted()
+
+class TestSharded; // forward declaration for unit tests
+
+namespace custom
+{
+   namespace concurrent
+   {
+
+   /*****************************************************************
+    * SHARDED BST
+    * N BSTs, each with its own lock, split by key range
+    *****************************************************************/
+   template <typename T, size_t N = 16>
+   class ShardedBST
+   {
+      friend class ::TestSharded; // give unit tests access to private members
+      static_assert(N >= 1, "ShardedBST needs at least one shard");
+   public:
+      //
+      // Construct
+      //
+
+      ShardedBST() : pRouting(new Routing), lastRebalance(0) {}
+      ShardedBST(const std::vector<T>& splitters);
+      ShardedBST(const ShardedBST& rhs) = delete;
+      ShardedBST& operator =(const ShardedBST& rhs) = delete;
+      ~ShardedBST() { delete pRouting.load(); }
+
+      //
+      // Iterator. Walking the tree is not safe while another thread writes
+      //
+
+      class iterator;
+      iterator begin() const;
+      iterator end()   const { return iterator(this, N, typename custom::BST<T>::iterator()); }
+
+      //
+      // Read: locks one shard
+      //
+
+      bool             contains(const T& t) const;
+      std::optional<T> find(const T& t) const;
+      std::vector<T>   snapshot() const;
+      size_t           size() const;
+      bool             empty() const { return size() == 0; }
+
+      //
+      // Write: locks one shard
+      //
+
+      bool   insert(const T& t, bool keepUnique = false);
+      size_t erase(const T& t);
+      void   clear();
+      void   rebalance();
+
+   private:
+
+      // the smallest tree worth choosing splitters for
+      static const size_t minRebalance = 64 * N;
+
+      // Each shard on its own cache lines so that two writers on
+      // neighboring shards do not fight over one line
+      struct alignas(64) Shard
+      {
+         mutable std::shared_mutex mutex;   // guards tree
+         custom::BST<T> tree;               // the keys in this range
+         std::atomic<size_t> numElements{ 0 }; // tree.size(), readable without the lock
+      };
+
+      // N-1 boundaries, or none yet. Never changed once published
+      struct Routing
+      {
+         size_t shardOf(const T& t) const
+         {
+            return std::upper_bound(splitters.begin(), splitters.end(), t) - splitters.begin();
+         }
+         std::vector<T> splitters;
+      };
+
+      // the splitters now; the caller must hold an epoch::Guard or be alone
+      const Routing& routing() const { return *pRouting.load(std::memory_order_acquire); }
+
+      template <class Lock>
+      size_t lockShardOf(const T& t, Lock& lock) const;
+      bool needsRebalance(size_t iShard) const;
+      void rebalanceLocked();
+
+      std::atomic<Routing*> pRouting;         // swapped, never changed, by a rebalance
+      std::mutex rebalanceMutex;              // one rebalance or clear at a time; guards retired
+      epoch::Retired<Routing> retired;        // splitters readers may still hold
+      Shard shards[N];                        // the trees
+      std::atomic<size_t> lastRebalance;      // size() at the last rebalance
+   };
+
+   /**********************************************************
+    * SHARDED BST ITERATOR
+    * Walks each shard in turn
+    *********************************************************/
+   template <typename T, size_t N>
+   class ShardedBST<T, N>::iterator
+   {
+      friend class ShardedBST<T, N>;
+   public:
+      iterator() : pTree(nullptr), iShard(N) {}
+
+      bool operator ==(const iterator& rhs) const { return iShard == rhs.iShard && it == rhs.it; }
+      bool operator !=(const iterator& rhs) const { return !(*this == rhs); }
+
+      const T& operator *() const { return *it; }
+
+      iterator& operator ++()
+      {
+         ++it;
+         skipEmpty();
+         return *this;
+      }
+      iterator  operator ++(int)
+      {
+         iterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+
+   private:
+      iterator(const ShardedBST* pTree, size_t iShard, typename custom::BST<T>::iterator it) :
+         pTree(pTree), iShard(iShard), it(it)
+      {
+         skipEmpty();
+      }
+
+      // move on to the next shard with something in it
+      void skipEmpty()
+      {
+         while (iShard < N && it == pTree->shards[iShard].tree.end())
+            if (++iShard < N)
+               it = pTree->shards[iShard].tree.begin();
+      }
+
+      const ShardedBST* pTree;              // the tree we walk
+      size_t iShard;                        // the shard we are in; N at the end
+      typename custom::BST<T>::iterator it; // where we are in that shard
+   };
+
+   /*********************************************
+    * SHARDED BST :: CONSTRUCTOR with splitters
+    * Start with known boundaries, such as from a previous run
+    ********************************************/
+   template <typename T, size_t N>
+   ShardedBST<T, N>::ShardedBST(const std::vector<T>& splitters) :
+      pRouting(new Routing{ splitters }), lastRebalance(0)
+   {
+      assert(splitters.size() + 1 == N);
+      assert(std::is_sorted(splitters.begin(), splitters.end()));
+   }
+
+   /*****************************************************
+    * SHARDED BST :: BEGIN
+    ****************************************************/
+   template <typename T, size_t N>
+   typename ShardedBST<T, N>::iterator ShardedBST<T, N>::begin() const
+   {
+      return iterator(this, 0, shards[0].tree.begin());
+   }
+
+   /****************************************************
+    * SHARDED BST :: CONTAINS / FIND
+    ****************************************************/
+   template <typename T, size_t N>
+   bool ShardedBST<T, N>::contains(const T& t) const
+   {
+      return find(t).has_value();
+   }
+
+   template <typename T, size_t N>
+   std::optional<T> ShardedBST<T, N>::find(const T& t) const
+   {
+      epoch::Guard guard;
+      std::shared_lock<std::shared_mutex> lock;
+      const Shard& shard = shards[lockShardOf(t, lock)];
+      auto it = shard.tree.find(t);
+      if (it == shard.tree.end())
+         return std::nullopt;
+      return *it;
+   }
+
+   /****************************************************
+    * SHARDED BST :: SNAPSHOT
+    * Every element in order: the shards one after another,
+    * each copied under its own lock. If a rebalance moved
+    * elements between shards meanwhile, start over
+    ****************************************************/
+   template <typename T, size_t N>
+   std::vector<T> ShardedBST<T, N>::snapshot() const
+   {
+      epoch::Guard guard;
+      std::vector<T> elements;
+      for (;;)
+      {
+         const Routing* pStart = pRouting.load(std::memory_order_acquire);
+         elements.clear();
+         elements.reserve(size());
+         for (const Shard& shard : shards)
+         {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto it = shard.tree.begin(); it != shard.tree.end(); ++it)
+               elements.push_back(*it);
+         }
+         if (pRouting.load(std::memory_order_acquire) == pStart)
+            return elements;
+      }
+   }
+
+   /****************************************************
+    * SHARDED BST :: SIZE
+    * The sum of the shards, without taking any lock
+    ****************************************************/
+   template <typename T, size_t N>
+   size_t ShardedBST<T, N>::size() const
+   {
+      size_t num = 0;
+      for (const Shard& shard : shards)
+         num += shard.numElements.load(std::memory_order_relaxed);
+      return num;
+   }
+
+   /*****************************************************
+    * SHARDED BST :: INSERT
+    * Lock only the shard t belongs in. Returns false if
+    * keepUnique turned the element away
+    ****************************************************/
+   template <typename T, size_t N>
+   bool ShardedBST<T, N>::insert(const T& t, bool keepUnique)
+   {
+      size_t iShard;
+      {
+         epoch::Guard guard;
+         std::unique_lock<std::shared_mutex> lock;
+         iShard = lockShardOf(t, lock);
+         Shard& shard = shards[iShard];
+         if (!shard.tree.insert(t, keepUnique).second)
+            return false;
+         shard.numElements.store(shard.tree.size(), std::memory_order_relaxed);
+      }
+
+      // another writer may have rebalanced while we waited
+      if (needsRebalance(iShard))
+      {
+         std::lock_guard<std::mutex> rebalancing(rebalanceMutex);
+         if (needsRebalance(iShard))
+            rebalanceLocked();
+      }
+      return true;
+   }
+
+   /*****************************************************
+    * SHARDED BST :: ERASE
+    * Remove every element equivalent to t
+    ****************************************************/
+   template <typename T, size_t N>
+   size_t ShardedBST<T, N>::erase(const T& t)
+   {
+      epoch::Guard guard;
+      std::unique_lock<std::shared_mutex> lock;
+      Shard& shard = shards[lockShardOf(t, lock)];
+      size_t num = shard.tree.erase(t);
+      shard.numElements.store(shard.tree.size(), std::memory_order_relaxed);
+      return num;
+   }
+
+   /*****************************************************
+    * SHARDED BST :: CLEAR
+    * Empty every shard. The splitters stay
+    ****************************************************/
+   template <typename T, size_t N>
+   void ShardedBST<T, N>::clear()
+   {
+      std::lock_guard<std::mutex> rebalancing(rebalanceMutex);
+      std::vector<std::unique_lock<std::shared_mutex>> locks;
+      locks.reserve(N);
+      for (Shard& shard : shards)
+         locks.emplace_back(shard.mutex);
+      for (Shard& shard : shards)
+      {
+         shard.tree.clear();
+         shard.numElements.store(0, std::memory_order_relaxed);
+      }
+      lastRebalance = 0;
+   }
+
+   /*****************************************************
+    * SHARDED BST :: LOCK SHARD OF
+    * Lock the shard t belongs in and return which it is.
+    * The caller holds an epoch::Guard so the splitters it
+    * routed by cannot be freed. If they were swapped before
+    * the lock was ours, the shard may be the wrong one
+    ****************************************************/
+   template <typename T, size_t N>
+   template <class Lock>
+   size_t ShardedBST<T, N>::lockShardOf(const T& t, Lock& lock) const
+   {
+      for (;;)
+      {
+         const Routing* pRoute = pRouting.load(std::memory_order_acquire);
+         size_t iShard = pRoute->shardOf(t);
+         lock = Lock(shards[iShard].mutex);
+         if (pRouting.load(std::memory_order_acquire) == pRoute)
+            return iShard;
+         lock.unlock();
+      }
+   }
+
+   /*****************************************************
+    * SHARDED BST :: NEEDS REBALANCE
+    * Is this shard more than twice its share, and has the tree
+    * grown by half since the splitters last moved?
+    ****************************************************/
+   template <typename T, size_t N>
+   bool ShardedBST<T, N>::needsRebalance(size_t iShard) const
+   {
+      if (N == 1)
+         return false;
+      size_t total = size();
+      if (total < minRebalance || 2 * total < 3 * lastRebalance.load(std::memory_order_relaxed))
+         return false;
+      return shards[iShard].numElements.load(std::memory_order_relaxed) > 2 * total / N;
+   }
+
+   /*****************************************************
+    * SHARDED BST :: REBALANCE
+    * Move the splitters to the quantiles of the stored keys
+    ****************************************************/
+   template <typename T, size_t N>
+   void ShardedBST<T, N>::rebalance()
+   {
+      std::lock_guard<std::mutex> rebalancing(rebalanceMutex);
+      rebalanceLocked();
+   }
+
+   /*****************************************************
+    * SHARDED BST :: REBALANCE LOCKED
+    * With rebalanceMutex held, lock every shard in order so
+    * no one else is in any of them. Gather the elements in
+    * order, choose N-1 evenly spaced ones as splitters, and
+    * link each shard's slice straight into a tree, O(n) in
+    * all. The new splitters go out before the locks do
+    ****************************************************/
+   template <typename T, size_t N>
+   void ShardedBST<T, N>::rebalanceLocked()
+   {
+      std::vector<std::unique_lock<std::shared_mutex>> locks;
+      locks.reserve(N);
+      for (Shard& shard : shards)
+         locks.emplace_back(shard.mutex);
+
+      std::vector<T> elements;
+      elements.reserve(size());
+      for (Shard& shard : shards)
+         for (auto it = shard.tree.begin(); it != shard.tree.end(); ++it)
+            elements.push_back(*it);
+
+      Routing* pNew = new Routing;
+      std::vector<T>& splitters = pNew->splitters;
+      if (N > 1 && !elements.empty())
+         for (size_t i = 1; i < N; i++)
+            splitters.push_back(elements[i * elements.size() / N]);
+      for (Shard& shard : shards)
+         shard.tree.clear();
+      lastRebalance.store(elements.size(), std::memory_order_relaxed);
+
+      // shardOf() sends a key equal to a splitter to the shard after
+      // it, so each slice starts at the first element not below its
+      // splitter
+      auto first = elements.begin();
+      for (size_t i = 0; i < N; i++)
+      {
+         auto last = (i < splitters.size()) ?
+            std::lower_bound(first, elements.end(), splitters[i]) : elements.end();
+         shards[i].tree.build_sorted(first, last);
+         shards[i].numElements.store(shards[i].tree.size(), std::memory_order_relaxed);
+         first = last;
+      }
+
+      retired.retire(pRouting.exchange(pNew, std::memory_order_release));
+      locks.clear();
+      retired.reclaim();
+   }
+
+   } // namespace concurrent
+} // namespace custom
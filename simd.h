@@ -0,0 +1,288 @@
+/***********************************************************************
+ * Header:
+ *    SIMD
+ * Summary:
+ *    Search a short sorted run of keys, such as one B-tree node, for
+ *    the position of a probe. For arithmetic keys every key in the run
+ *    is compared against the probe at once, eight or four at a time,
+ *    and the matches are counted with movemask and popcount: in a
+ *    sorted run, the number of keys less than the probe IS the lower
+ *    bound. There are no branches to mispredict.
+ *
+ *    The instruction set is picked at compile time: AVX2 when the
+ *    compiler targets it (/arch:AVX2, -mavx2), SSE4.2 otherwise when
+ *    available (-msse4.2), and a portable branch-free loop that the
+ *    compiler is free to vectorize on its own for everything else.
+ *    Define CUSTOM_NO_SIMD to force the portable loop. Keys that are
+ *    not arithmetic use a plain scalar scan with operator<.
+ *
+ *        lowerBound  : Index of the first key not less than the probe
+ *        upperBound  : Index of the first key greater than the probe
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cstdint>      // for int32_t and int64_t
+#include <type_traits>  // for std::is_arithmetic_v
+
+#if !defined(CUSTOM_NO_SIMD) && defined(__AVX2__)
+#define CUSTOM_SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(CUSTOM_NO_SIMD) && (defined(__SSE4_2__) || defined(__AVX__))
+#define CUSTOM_SIMD_SSE42
+#include <nmmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>     // for __popcnt
+#endif // _MSC_VER
+
+namespace custom
+{
+   namespace simd
+   {
+
+      /******************************************************
+       * POP COUNT
+       * Number of set bits in a movemask
+       ******************************************************/
+      inline int popCount(unsigned x) noexcept
+      {
+#if defined(_MSC_VER)
+         return (int)__popcnt(x);
+#elif defined(__GNUC__) || defined(__clang__)
+         return __builtin_popcount(x);
+#else
+         int count = 0;
+         for (; x; x &= x - 1)
+            count++;
+         return count;
+#endif
+      }
+
+      /******************************************************
+       * COUNT PORTABLE
+       * How many keys are less than t (or greater than t when
+       * Greater). No early exit, so no branch on the data
+       ******************************************************/
+      template <bool Greater, typename T>
+      int countPortable(const T* keys, int num, T t) noexcept
+      {
+         int count = 0;
+         for (int i = 0; i < num; i++)
+            count += Greater ? (t < keys[i]) : (keys[i] < t);
+         return count;
+      }
+
+#if defined(CUSTOM_SIMD_AVX2)
+
+      /******************************************************
+       * COUNT INT32, INT64, FLOAT, DOUBLE : AVX2
+       * Unsigned keys are flipped into signed order by bias
+       ******************************************************/
+      template <bool Greater>
+      int countInt32(const int32_t* keys, int num, int32_t t, int32_t bias) noexcept
+      {
+         const __m256i vBias  = _mm256_set1_epi32(bias);
+         const __m256i vProbe = _mm256_set1_epi32(t ^ bias);
+         int count = 0;
+         int i = 0;
+         for (; i + 8 <= num; i += 8)
+         {
+            __m256i vKeys = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), vBias);
+            __m256i vMask = Greater ? _mm256_cmpgt_epi32(vKeys, vProbe) : _mm256_cmpgt_epi32(vProbe, vKeys);
+            count += popCount((unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(vMask)));
+         }
+         for (; i < num; i++)
+            count += Greater ? ((keys[i] ^ bias) > (t ^ bias)) : ((keys[i] ^ bias) < (t ^ bias));
+         return count;
+      }
+
+      template <bool Greater>
+      int countInt64(const int64_t* keys, int num, int64_t t, int64_t bias) noexcept
+      {
+         const __m256i vBias  = _mm256_set1_epi64x(bias);
+         const __m256i vProbe = _mm256_set1_epi64x(t ^ bias);
+         int count = 0;
+         int i = 0;
+         for (; i + 4 <= num; i += 4)
+         {
+            __m256i vKeys = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), vBias);
+            __m256i vMask = Greater ? _mm256_cmpgt_epi64(vKeys, vProbe) : _mm256_cmpgt_epi64(vProbe, vKeys);
+            count += popCount((unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(vMask)));
+         }
+         for (; i < num; i++)
+            count += Greater ? ((keys[i] ^ bias) > (t ^ bias)) : ((keys[i] ^ bias) < (t ^ bias));
+         return count;
+      }
+
+      template <bool Greater>
+      int countFloat(const float* keys, int num, float t) noexcept
+      {
+         const __m256 vProbe = _mm256_set1_ps(t);
+         int count = 0;
+         int i = 0;
+         for (; i + 8 <= num; i += 8)
+         {
+            __m256 vKeys = _mm256_loadu_ps(keys + i);
+            __m256 vMask = Greater ? _mm256_cmp_ps(vProbe, vKeys, _CMP_LT_OQ) : _mm256_cmp_ps(vKeys, vProbe, _CMP_LT_OQ);
+            count += popCount((unsigned)_mm256_movemask_ps(vMask));
+         }
+         return count + countPortable<Greater>(keys + i, num - i, t);
+      }
+
+      template <bool Greater>
+      int countDouble(const double* keys, int num, double t) noexcept
+      {
+         const __m256d vProbe = _mm256_set1_pd(t);
+         int count = 0;
+         int i = 0;
+         for (; i + 4 <= num; i += 4)
+         {
+            __m256d vKeys = _mm256_loadu_pd(keys + i);
+            __m256d vMask = Greater ? _mm256_cmp_pd(vProbe, vKeys, _CMP_LT_OQ) : _mm256_cmp_pd(vKeys, vProbe, _CMP_LT_OQ);
+            count += popCount((unsigned)_mm256_movemask_pd(vMask));
+         }
+         return count + countPortable<Greater>(keys + i, num - i, t);
+      }
+
+#elif defined(CUSTOM_SIMD_SSE42)
+
+      /******************************************************
+       * COUNT INT32, INT64, FLOAT, DOUBLE : SSE4.2
+       * Half the width of AVX2. The 64-bit compare is SSE4.2
+       ******************************************************/
+      template <bool Greater>
+      int countInt32(const int32_t* keys, int num, int32_t t, int32_t bias) noexcept
+      {
+         const __m128i vBias  = _mm_set1_epi32(bias);
+         const __m128i vProbe = _mm_set1_epi32(t ^ bias);
+         int count = 0;
+         int i = 0;
+         for (; i + 4 <= num; i += 4)
+         {
+            __m128i vKeys = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + i)), vBias);
+            __m128i vMask = Greater ? _mm_cmpgt_epi32(vKeys, vProbe) : _mm_cmpgt_epi32(vProbe, vKeys);
+            count += popCount((unsigned)_mm_movemask_ps(_mm_castsi128_ps(vMask)));
+         }
+         for (; i < num; i++)
+            count += Greater ? ((keys[i] ^ bias) > (t ^ bias)) : ((keys[i] ^ bias) < (t ^ bias));
+         return count;
+      }
+
+      template <bool Greater>
+      int countInt64(const int64_t* keys, int num, int64_t t, int64_t bias) noexcept
+      {
+         const __m128i vBias  = _mm_set1_epi64x(bias);
+         const __m128i vProbe = _mm_set1_epi64x(t ^ bias);
+         int count = 0;
+         int i = 0;
+         for (; i + 2 <= num; i += 2)
+         {
+            __m128i vKeys = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + i)), vBias);
+            __m128i vMask = Greater ? _mm_cmpgt_epi64(vKeys, vProbe) : _mm_cmpgt_epi64(vProbe, vKeys);
+            count += popCount((unsigned)_mm_movemask_pd(_mm_castsi128_pd(vMask)));
+         }
+         for (; i < num; i++)
+            count += Greater ? ((keys[i] ^ bias) > (t ^ bias)) : ((keys[i] ^ bias) < (t ^ bias));
+         return count;
+      }
+
+      template <bool Greater>
+      int countFloat(const float* keys, int num, float t) noexcept
+      {
+         const __m128 vProbe = _mm_set1_ps(t);
+         int count = 0;
+         int i = 0;
+         for (; i + 4 <= num; i += 4)
+         {
+            __m128 vKeys = _mm_loadu_ps(keys + i);
+            __m128 vMask = Greater ? _mm_cmplt_ps(vProbe, vKeys) : _mm_cmplt_ps(vKeys, vProbe);
+            count += popCount((unsigned)_mm_movemask_ps(vMask));
+         }
+         return count + countPortable<Greater>(keys + i, num - i, t);
+      }
+
+      template <bool Greater>
+      int countDouble(const double* keys, int num, double t) noexcept
+      {
+         const __m128d vProbe = _mm_set1_pd(t);
+         int count = 0;
+         int i = 0;
+         for (; i + 2 <= num; i += 2)
+         {
+            __m128d vKeys = _mm_loadu_pd(keys + i);
+            __m128d vMask = Greater ? _mm_cmplt_pd(vProbe, vKeys) : _mm_cmplt_pd(vKeys, vProbe);
+            count += popCount((unsigned)_mm_movemask_pd(vMask));
+         }
+         return count + countPortable<Greater>(keys + i, num - i, t);
+      }
+
+#endif // CUSTOM_SIMD_AVX2 / CUSTOM_SIMD_SSE42
+
+      /******************************************************
+       * COUNT ARITHMETIC
+       * Route an arithmetic key to the kernel for its width.
+       * Keys that no kernel covers (char, short, bool, long
+       * double) take the portable loop
+       ******************************************************/
+      template <bool Greater, typename T>
+      int countArithmetic(const T* keys, int num, T t) noexcept
+      {
+#if defined(CUSTOM_SIMD_AVX2) || defined(CUSTOM_SIMD_SSE42)
+         if constexpr (std::is_integral_v<T> && sizeof(T) == 4 && !std::is_same_v<T, bool>)
+            return countInt32<Greater>(reinterpret_cast<const int32_t*>(keys), num, (int32_t)t,
+                                       std::is_signed_v<T> ? 0 : INT32_MIN);
+         else if constexpr (std::is_integral_v<T> && sizeof(T) == 8)
+            return countInt64<Greater>(reinterpret_cast<const int64_t*>(keys), num, (int64_t)t,
+                                       std::is_signed_v<T> ? 0 : INT64_MIN);
+         else if constexpr (std::is_same_v<T, float>)
+            return countFloat<Greater>(keys, num, t);
+         else if constexpr (std::is_same_v<T, double>)
+            return countDouble<Greater>(keys, num, t);
+         else
+#endif
+            return countPortable<Greater>(keys, num, t);
+      }
+
+   } // namespace simd
+
+   /******************************************************
+    * LOWER BOUND
+    * Index of the first of num sorted keys that is not less than t
+    ******************************************************/
+   template <typename T>
+   int lowerBound(const T* keys, int num, const T& t)
+   {
+      if constexpr (std::is_arithmetic_v<T>)
+         return simd::countArithmetic<false>(keys, num, t);
+      else
+      {
+         int i = 0;
+         while (i < num && keys[i] < t)
+            i++;
+         return i;
+      }
+   }
+
+   /******************************************************
+    * UPPER BOUND
+    * Index of the first of num sorted keys that is greater than t
+    ******************************************************/
+   template <typename T>
+   int upperBound(const T* keys, int num, const T& t)
+   {
+      if constexpr (std::is_arithmetic_v<T>)
+         return num - simd::countArithmetic<true>(keys, num, t);
+      else
+      {
+         int i = 0;
+         while (i < num && !(t < keys[i]))
+            i++;
+         return i;
+      }
+   }
+
+} // namespace custom
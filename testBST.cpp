@@ -11,9 +11,44 @@
 #define DEBUG   
 #endif
  //#undef DEBUG  // Remove this comment to disable unit tests
+// LabBSTPlain defines UNINSTRUMENTED to test bst.h with both compiled out
+#ifndef UNINSTRUMENTED
+#ifndef CHECKED_ITERATORS
+#define CHECKED_ITERATORS // catch iterators used after an erase
+#endif
+#ifndef BST_COUNTERS
+#define BST_COUNTERS      // count what the trees do, for testCounters.h
+#endif
+#endif // !UNINSTRUMENTED
 
 #include "testBST.h"        // for the BST unit tests
 #include "testSpy.h"        // for the spy unit tests
+#include "testEytzinger.h"  // for the frozen snapshot unit tests
+#include "testVanEmdeBoas.h"// for the vEB snapshot unit tests
+#include "testBTree.h"      // for the B-tree unit tests
+#include "testSimd.h"       // for the node search unit tests
+#include "testConcurrent.h" // for the concurrent tree unit tests
+#include "testReadMostly.h" // for the lock-free read unit tests
+#include "testPersistent.h" // for the persistent tree unit tests
+#include "testCow.h"        // for the copy-on-write tree unit tests
+#include "testSharded.h"    // for the sharded tree unit tests
+#include "testOptimistic.h" // for the per-node version unit tests
+#include "testParallel.h"   // for the parallel build unit tests
+#include "testCoro.h"       // for the coroutine lookup unit tests
+#include "testSerialize.h"  // for the save and load unit tests
+#include "testMapped.h"     // for the memory-mapped tree unit tests
+#include "testDurable.h"    // for the write-ahead log unit tests
+#include "testMerge.h"      // for the merged scan unit tests
+#include "testExternal.h"   // for the external sort unit tests
+#include "testLsm.h"        // for the log-structured merge unit tests
+#include "testCounters.h"   // for the instrumentation unit tests
+#include "testComplexity.h" // for the operation count complexity tests
+
+// LabBSTCpp20 is there to run TestCoro, so it must not quietly skip it
+#if defined(REQUIRE_CORO) && !defined(__cpp_impl_coroutine)
+#error "REQUIRE_CORO is defined but the compiler has no coroutines"
+#endif // REQUIRE_CORO
+
 int Spy::counters[] = {};
 
 /**********************************************************************
@@ -26,6 +61,28 @@ int main()
    // unit tests
    TestSpy().run();
    TestBST().run();
+   TestEytzinger().run();
+   TestVanEmdeBoas().run();
+   TestSimd().run();
+   TestBTree().run();
+   TestConcurrent().run();
+   TestReadMostly().run();
+   TestPersistent().run();
+   TestCow().run();
+   TestSharded().run();
+   TestOptimistic().run();
+   TestParallel().run();
+#ifdef __cpp_impl_coroutine
+   TestCoro().run();
+#endif // __cpp_impl_coroutine
+   TestSerialize().run();
+   TestMapped().run();
+   TestDurable().run();
+   TestMerge().run();
+   TestExternal().run();
+   TestLsm().run();
+   TestCounters().run();
+   TestComplexity().run();
 #endif // DEBUG
    
    return 0;
@@ -20,6 +20,11 @@
 #include <iostream>
 #include <string>
 #include <functional> // for std::less and std::greater
+#include <stdexcept>  // for std::logic_error
+#include <algorithm>  // for std::upper_bound and std::equal
+#include <iterator>   // for std::distance
+#include <random>     // for std::mt19937
+#include <vector>
 
 
  /***********************************************
@@ -85,12 +90,16 @@ public:
       test_iterator_decrement_standardToDone();
       test_iterator_decrement_standardEnd();
       test_iterator_dereference_standardRead();
+      test_iterator_traits_standard();
 
       // Find
       test_find_empty();
       test_find_standardBegin();
       test_find_standardLast();
       test_find_standardMissing();
+      test_lowerBound_standardMissing();
+      test_lowerBound_standardPastEnd();
+      test_upperBound_standardPresent();
 
       // Insert
       test_insert_oneLeft();
@@ -120,6 +129,21 @@ public:
       test_erase_oneChild();
       test_erase_twoChildren();
       test_erase_twoChildrenSpecial();
+      test_erase_rootNoChildren();
+      test_erase_rootOneChild();
+      test_erase_rootTwoChildren();
+      test_erase_rootChurn();
+      test_erase_blackLeaf();
+      test_erase_churnBalanced();
+      test_eraseKey_oneAtATimeBalanced();
+      test_eraseRange_empty();
+      test_eraseRange_standardAll();
+      test_eraseRange_standardSmall();
+      test_eraseRange_standardLarge();
+      test_eraseRange_randomSmall();
+      test_eraseKey_standardMissing();
+      test_eraseKey_duplicates();
+      test_eraseIf_standard();
       test_clear_empty();
       test_clear_standard();
 
@@ -129,6 +153,31 @@ public:
       test_size_empty();
       test_size_standard();
 
+      // Shape
+      test_stats_empty();
+      test_stats_standard();
+      test_stats_ascending();
+      test_stats_blackUnbalanced();
+      test_statsScan_steps();
+      test_statsScan_duplicates();
+      test_statsScan_duplicatesLinear();
+      test_statsScan_eraseBetween();
+
+#ifdef CHECKED_ITERATORS
+      // Checked Iterator
+      test_checked_eraseStrandsOthers();
+      test_checked_eraseStrands();
+      test_checked_reusedAddressStrands();
+      test_checked_assignStrands();
+      test_checked_eraseReturnsFresh();
+      test_checked_insertKeeps();
+      test_checked_clearStrands();
+      test_checked_compareNeverThrows();
+#else // !CHECKED_ITERATORS
+      // Unchecked Iterator
+      test_unchecked_barePointer();
+#endif // !CHECKED_ITERATORS
+
       report("BST");
    }
    
@@ -146,7 +195,7 @@ public:
       bst.root = (custom::BST<Spy>::BNode *)0xBAADF00D;
       Spy::reset();
       // exercise
-      alloc.construct(&bst);  // just call the constructor by itself
+      std::allocator_traits<std::allocator<custom::BST<Spy>>>::construct(alloc, &bst);  // just call the constructor by itself
       // verify
       assertUnit(Spy::numDefault() == 0);    
       assertUnit(Spy::numAlloc() == 0);
@@ -171,7 +220,7 @@ public:
       bstDest.root = (custom::BST<Spy>::BNode*)0xBAADF00D;
       Spy::reset();
       // exercise
-      alloc.construct(&bstDest, bstSrc);  // just call the constructor by itself
+      std::allocator_traits<std::allocator<custom::BST<Spy>>>::construct(alloc, &bstDest, bstSrc);  // just call the constructor by itself
       // verify
       assertUnit(Spy::numDefault() == 0);
       assertUnit(Spy::numAlloc() == 0);
@@ -601,6 +650,177 @@ public:
       teardownStandardFixture(bst);
    }
 
+   /***************************************
+    * SHAPE
+    *    BST::stats()
+    *    BST::StatsScan
+    ***************************************/
+
+   // stats of an empty tree
+   void test_stats_empty()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise
+      custom::ShapeStats stats = bst.stats();
+      // verify
+      assertUnit(stats.size == 0);
+      assertUnit(stats.height == 0);
+      assertUnit(stats.blackHeight == 0);
+      assertUnit(stats.blackBalanced);
+      assertUnit(stats.levels.empty());
+      assertUnit(stats.averageDepth() == 0.0);
+      assertUnit(stats.percentileDepth(99) == 0);
+      assertUnit(stats.minHeight() == 0);
+   }  // teardown
+
+   // stats of the standard fixture
+   void test_stats_standard()
+   {  // setup
+      //                (50b)
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      //   (20r)     (40r) (60r)     (80r)
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      custom::ShapeStats stats = bst.stats();
+      // verify
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(stats.size == 7);
+      assertUnit(stats.height == 3);
+      assertUnit(stats.blackHeight == 2);
+      assertUnit(stats.blackBalanced);
+      assertUnit(stats.levels == std::vector<size_t>({ 1, 2, 4 }));
+      assertUnit(stats.totalDepth == 10);
+      assertUnit(stats.percentileDepth(10) == 0);
+      assertUnit(stats.percentileDepth(40) == 1);
+      assertUnit(stats.percentileDepth(50) == 2);
+      assertUnit(stats.percentileDepth(100) == 2);
+      assertUnit(stats.minHeight() == 3);
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // ascending inserts stay within the red-black bound
+   void test_stats_ascending()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 1000; i++)
+         bst.insert(i);
+      // exercise
+      custom::ShapeStats stats = bst.stats();
+      // verify
+      assertUnit(stats.size == 1000);
+      assertUnit(stats.minHeight() == 10);
+      assertUnit(stats.height > 10);
+      assertUnit(stats.height <= 2 * stats.minHeight());
+      assertUnit(stats.blackBalanced);
+      assertUnit(stats.blackHeight == size_t(bst.root->findDepth()));
+      size_t total = 0;
+      for (size_t num : stats.levels)
+         total += num;
+      assertUnit(total == 1000);
+   }  // teardown
+
+   // a recolored node shows up as paths that disagree
+   void test_stats_blackUnbalanced()
+   {  // setup
+      //                (50b)
+      //          +-------+-------+
+      //        (30r)           (70b)
+      //     +----+----+     +----+----+
+      //   (20r)     (40r) (60r)     (80r)
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      bst.root->pLeft->isRed = true;
+      // exercise
+      custom::ShapeStats stats = bst.stats();
+      // verify
+      assertUnit(stats.blackHeight == 1);
+      assertUnit(!stats.blackBalanced);
+      // teardown
+      bst.root->pLeft->isRed = false;
+      teardownStandardFixture(bst);
+   }
+
+   // a few nodes per step comes to the same as all at once
+   void test_statsScan_steps()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 100; i++)
+         bst.insert((i * 37) % 100);
+      custom::BST <int>::StatsScan scan(bst);
+      int numSteps = 0;
+      // exercise
+      while (!scan.step(7))
+         numSteps++;
+      // verify
+      custom::ShapeStats stats = bst.stats();
+      assertUnit(numSteps == 14);
+      assertUnit(scan.isDone());
+      assertUnit(scan.stats().size == 100);
+      assertUnit(scan.stats().levels == stats.levels);
+      assertUnit(scan.stats().totalDepth == stats.totalDepth);
+      assertUnit(scan.stats().blackHeight == stats.blackHeight);
+      assertUnit(scan.stats().blackBalanced);
+      scan.restart();
+      assertUnit(!scan.isDone());
+      assertUnit(scan.stats().size == 0);
+   }  // teardown
+
+   // equal keys split across steps are each visited once
+   void test_statsScan_duplicates()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 30; i++)
+         bst.insert(i % 3);
+      custom::BST <int>::StatsScan scan(bst);
+      // exercise
+      while (!scan.step(1))
+         ;
+      // verify
+      assertUnit(scan.stats().size == 30);
+      assertUnit(scan.stats().totalDepth == bst.stats().totalDepth);
+   }  // teardown
+
+   // a step picks up where the last stopped, however many keys are equal
+   void test_statsScan_duplicatesLinear()
+   {  // setup
+      custom::BST <Spy> bst;
+      for (int i = 0; i < 100; i++)
+         bst.insert(Spy(7));
+      custom::BST <Spy>::StatsScan scan(bst);
+      Spy::reset();
+      // exercise
+      while (!scan.step(10))
+         ;
+      // verify
+      assertUnit(scan.stats().size == 100);
+      assertUnit(Spy::numLessthan() == 99);
+      assertUnit(Spy::numCopy() + Spy::numAssign() == 9);
+   }  // teardown
+
+   // the tree may change between steps
+   void test_statsScan_eraseBetween()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 100; i++)
+         bst.insert(i);
+      custom::BST <int>::StatsScan scan(bst);
+      scan.step(50);
+      // exercise
+      for (int i = 40; i < 70; i++)
+         bst.erase(i);
+      while (!scan.step(50))
+         ;
+      // verify
+      assertUnit(scan.stats().size == 50 + 30);
+      assertUnit(bst.stats().size == 70);
+   }  // teardown
+
    /***************************************
     * Assignment
     *    BST::operator=(const BST &)
@@ -1961,6 +2181,19 @@ public:
       teardownStandardFixture(bst);
    }
 
+   // the standard algorithms and containers take our iterators
+   void test_iterator_traits_standard()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      // exercise
+      std::vector<int> v(bst.begin(), bst.end());
+      // verify
+      assertUnit(v == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(std::distance(bst.begin(), bst.end()) == 7);
+      assertUnit((std::is_same_v<std::iterator_traits<custom::BST<int>::iterator>::iterator_category,
+                                 std::bidirectional_iterator_tag>));
+   }  // teardown
+
    /***************************************
     * Find
     *    BST::find(const T &)
@@ -2110,7 +2343,87 @@ public:
       teardownStandardFixture(bst);
    }
 
+   /***************************************
+    * LOWER BOUND and UPPER BOUND
+    *    BST::lower_bound(const T &)
+    *    BST::upper_bound(const T &)
+    ***************************************/
 
+   // lower bound of something that is not there
+   void test_lowerBound_standardMissing()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST<Spy>::iterator it;
+      Spy s(42);
+      Spy::reset();
+      // exercise
+      it = bst.lower_bound(s);
+      // verify
+      assertUnit(Spy::numLessthan() == 3);    // compare [50][30][40]
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(it == custom::BST<Spy>::iterator(bst.root));
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // lower bound of something larger than everything
+   void test_lowerBound_standardPastEnd()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST<Spy>::iterator it;
+      Spy s(99);
+      Spy::reset();
+      // exercise
+      it = bst.lower_bound(s);
+      // verify
+      assertUnit(Spy::numLessthan() == 3);    // compare [50][70][80]
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(it == bst.end());
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // upper bound of something that is there
+   void test_upperBound_standardPresent()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST<Spy>::iterator it;
+      Spy s(40);
+      Spy::reset();
+      // exercise
+      it = bst.upper_bound(s);
+      // verify
+      assertUnit(Spy::numLessthan() == 3);    // compare [50][30][40]
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(it == custom::BST<Spy>::iterator(bst.root));
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
 
    /***************************************
     * Insert
@@ -3895,6 +4208,197 @@ public:
       bst.root = nullptr;
    }
 
+   // erase the only node
+   void test_erase_rootNoChildren()
+   {  // setup
+      //   [[50]]
+      custom::BST <int> bst;
+      bst.insert(50);
+      auto it = bst.begin();
+      // exercise
+      auto itReturn = bst.erase(it);
+      // verify
+      assertUnit(itReturn == bst.end());
+      assertUnit(bst.root == nullptr);
+      assertUnit(bst.numElements == 0);
+      bst.insert(60);
+      assertUnit(bst.root != nullptr);
+      assertUnit(bst.numElements == 1);
+   }  // teardown
+
+   // erase a root with one child: the child becomes a black root
+   void test_erase_rootOneChild()
+   {  // setup
+      //   [[50b]]
+      //      +----+
+      //          60r
+      custom::BST <int> bst;
+      bst.insert(50);
+      bst.insert(60);
+      auto it = bst.begin();
+      // exercise
+      auto itReturn = bst.erase(it);
+      // verify
+      //   60b
+      assertUnit(bst.numElements == 1);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         assertUnit(itReturn.pNode == bst.root);
+         assertUnit(bst.root->data == 60);
+         assertUnit(bst.root->pParent == nullptr);
+         assertUnit(bst.root->isRed == false);
+      }
+   }  // teardown
+
+   // erase a root with two children: the red successor takes over as a black root
+   void test_erase_rootTwoChildren()
+   {  // setup
+      //      [[50b]]
+      //     +---+---+
+      //    30r     60r
+      custom::BST <int> bst;
+      for (int i : { 50, 30, 60 })
+         bst.insert(i);
+      auto it = bst.begin();
+      ++it;
+      // exercise
+      auto itReturn = bst.erase(it);
+      bst.insert(70);
+      bst.insert(80);
+      // verify
+      //        60b
+      //     +---+---+
+      //    30b     70b
+      //             +---+
+      //                80r
+      assertUnit(bst.numElements == 4);
+      assertUnit(itReturn != bst.end() && *itReturn == 60);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         assertUnit(bst.root->data == 60);
+         assertUnit(bst.root->isRed == false);
+         assertUnit(bst.root->pParent == nullptr);
+      }
+      assertUnit(bst.stats().blackBalanced);
+   }  // teardown
+
+   // the root is replaced many times over and stays black
+   void test_erase_rootChurn()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 1024; i++)
+         bst.insert(i);
+      std::mt19937 random(1);
+      bool blackRoot = true;
+      // exercise
+      for (int op = 0; op < 10000; op++)
+      {
+         int key = int(random() % 4096);
+         auto it = bst.find(key);
+         if (it != bst.end())
+            bst.erase(it);
+         else
+            bst.insert(key);
+         blackRoot = blackRoot && (!bst.root || bst.root->isRed == false);
+      }
+      // verify
+      assertUnit(blackRoot);
+      assertUnit(bst.stats().blackBalanced);
+   }  // teardown
+
+   // erase a black leaf: its red nephew rotates up to fill the gap
+   void test_erase_blackLeaf()
+   {  // setup
+      //                50b
+      //          +------+------+
+      //       [[30b]]         70b
+      //                        +----+
+      //                            80r
+      custom::BST <int> bst;
+      for (int i : { 50, 30, 70, 80 })
+         bst.insert(i);
+      auto it = bst.find(30);
+      // exercise
+      auto itReturn = bst.erase(it);
+      // verify
+      //                70b
+      //          +------+------+
+      //         50b           80b
+      assertUnit(bst.numElements == 3);
+      assertUnit(itReturn != bst.end() && *itReturn == 50);
+      assertUnit(bst.root != nullptr);
+      if (bst.root && bst.root->pLeft && bst.root->pRight)
+      {
+         assertUnit(bst.root->data == 70);
+         assertUnit(bst.root->isRed == false);
+         assertUnit(bst.root->pLeft->data == 50);
+         assertUnit(bst.root->pLeft->isRed == false);
+         assertUnit(bst.root->pLeft->pLeft == nullptr);
+         assertUnit(bst.root->pLeft->pRight == nullptr);
+         assertUnit(bst.root->pRight->data == 80);
+         assertUnit(bst.root->pRight->isRed == false);
+      }
+      assertUnit(bst.stats().blackBalanced);
+   }  // teardown
+
+   // erase and insert at random: every path keeps the same black count
+   void test_erase_churnBalanced()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 512; i++)
+         bst.insert(i);
+      bool balanced = true;
+      size_t numElements = 512;
+      unsigned int seed = 1;
+      // exercise
+      for (int op = 0; op < 4000; op++)
+      {
+         seed = seed * 1103515245u + 12345u;
+         int key = int((seed >> 16) % 1024);
+         auto it = bst.find(key);
+         if (it != bst.end())
+         {
+            bst.erase(it);
+            numElements--;
+         }
+         else
+         {
+            bst.insert(key);
+            numElements++;
+         }
+         custom::ShapeStats stats = bst.stats();
+         balanced = balanced && stats.blackBalanced &&
+                    (!bst.root || bst.root->isRed == false);
+      }
+      // verify
+      assertUnit(balanced);
+      assertUnit(bst.numElements == numElements);
+      assertUnit(bst.root == nullptr ||
+                 bst.root->verifyRedBlack(bst.root->findDepth()));
+   }  // teardown
+
+   // erasing keys one at a time keeps every path's black count
+   void test_eraseKey_oneAtATimeBalanced()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 256; i++)
+         bst.insert((i * 37) % 256);
+      bool balanced = true;
+      // exercise
+      for (int i = 0; i < 256; i += 3)
+      {
+         bst.erase((i * 101) % 256);
+         balanced = balanced && bst.stats().blackBalanced;
+      }
+      // verify
+      assertUnit(balanced);
+      assertUnit(bst.numElements == 256 - 86);
+      custom::ShapeStats stats = bst.stats();
+      assertUnit(stats.height <= 2 * stats.minHeight());
+   }  // teardown
+
    void test_erase_twoChildrenSpecial()
    {  // setup
       //                 50 
@@ -3976,6 +4480,441 @@ public:
    }
 
 
+   /***************************************
+    * Erase Range
+    *    BST::erase(first, last)
+    *    BST::erase(const T &)
+    *    BST::erase_if(pred)
+    ***************************************/
+
+   // erase an empty range from an empty BST
+   void test_eraseRange_empty()
+   {  // setup
+      custom::BST <Spy> bst;
+      Spy::reset();
+      // exercise
+      auto itReturn = bst.erase(bst.begin(), bst.end());
+      // verify
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(itReturn == bst.end());
+      assertEmptyFixture(bst);
+   }  // teardown
+
+   // erase everything from the standard fixture
+   void test_eraseRange_standardAll()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      auto itReturn = bst.erase(bst.begin(), bst.end());
+      // verify
+      assertUnit(Spy::numDestructor() == 7);  // destroy  [20][30][40][50][60][70][80]
+      assertUnit(Spy::numDelete() == 7);      // delete   [20][30][40][50][60][70][80]
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(itReturn == bst.end());
+      assertEmptyFixture(bst);
+   }  // teardown
+
+   // erase a single leaf through a range: cut out with a split and a join
+   void test_eraseRange_standardSmall()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40  [[60]]      80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      auto p70 = bst.root->pRight;
+      auto itFirst = custom::BST <Spy> ::iterator(bst.root->pRight->pLeft);
+      auto itLast  = custom::BST <Spy> ::iterator(p70);
+      Spy::reset();
+      // exercise
+      auto itReturn = bst.erase(itFirst, itLast);
+      // verify
+      assertUnit(Spy::numDestructor() == 1);  // destroy [60]
+      assertUnit(Spy::numDelete() == 1);      // delete  [60]
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(itReturn == custom::BST <Spy> ::iterator(p70));
+      assertUnit(bst.numElements == 6);
+      assertUnit(bst.root->pParent == nullptr);
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      auto it = bst.begin();
+      for (int i : { 20, 30, 40, 50, 70, 80 })
+      {
+         assertUnit(it != bst.end());
+         if (it != bst.end())
+            assertUnit(*it++ == Spy(i));
+      }
+      assertUnit(it == bst.end());
+      // teardown
+      bst.clear();
+   }
+
+   // erase most of the tree: the survivors are relinked
+   void test_eraseRange_standardLarge()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //       [[30]]            70  
+      //     +----+----+     +----+----+
+      //    20      [[40]][[60]]      80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      auto p20 = bst.root->pLeft->pLeft;
+      auto p60 = bst.root->pRight->pLeft;
+      auto p70 = bst.root->pRight;
+      auto p80 = bst.root->pRight->pRight;
+      auto itFirst = custom::BST <Spy> ::iterator(bst.root->pLeft);
+      auto itLast  = custom::BST <Spy> ::iterator(p60);
+      Spy::reset();
+      // exercise
+      auto itReturn = bst.erase(itFirst, itLast);
+      // verify
+      assertUnit(Spy::numDestructor() == 3);  // destroy [30][40][50]
+      assertUnit(Spy::numDelete() == 3);      // delete  [30][40][50]
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      //                (70b)
+      //          +-------+-------+
+      //        (60b)           (80b)
+      //     +----+
+      //   (20r)
+      assertUnit(itReturn == custom::BST <Spy> ::iterator(p60));
+      assertUnit(bst.numElements == 4);
+      assertUnit(bst.root == p70);
+      assertUnit(p70->pParent == nullptr);
+      assertUnit(p70->isRed == false);
+      assertUnit(p70->pLeft == p60);
+      assertUnit(p70->pRight == p80);
+      assertUnit(p60->pParent == p70);
+      assertUnit(p60->isRed == false);
+      assertUnit(p60->pLeft == p20);
+      assertUnit(p60->pRight == nullptr);
+      assertUnit(p80->pParent == p70);
+      assertUnit(p80->isRed == false);
+      assertUnit(p80->pLeft == nullptr);
+      assertUnit(p80->pRight == nullptr);
+      assertUnit(p20->pParent == p60);
+      assertUnit(p20->isRed == true);
+      assertUnit(p20->pLeft == nullptr);
+      assertUnit(p20->pRight == nullptr);
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      // teardown
+      bst.clear();
+   }
+
+   // cut runs from the front, the back and the middle, across
+   // duplicates: the rest stays in order and red-black every time
+   void test_eraseRange_randomSmall()
+   {  // setup
+      std::mt19937 random(7);
+      std::vector<int> expected;
+      custom::BST <int> bst;
+      for (int i = 0; i < 2000; i++)
+      {
+         int key = int(random() % 700);
+         bst.insert(key);
+         expected.insert(std::upper_bound(expected.begin(), expected.end(), key), key);
+      }
+      bool same = true;
+      bool redBlack = true;
+      // exercise
+      while (expected.size() > 100)
+      {
+         size_t numErase = 1 + random() % (expected.size() / 5);
+         size_t iFirst = 0;
+         switch (random() % 3)
+         {
+            case 0: iFirst = 0; break;                              // prefix
+            case 1: iFirst = expected.size() - numErase; break;     // suffix
+            case 2: iFirst = random() % (expected.size() - numErase); break;
+         }
+         auto first = bst.begin();
+         std::advance(first, iFirst);
+         auto last = first;
+         std::advance(last, numErase);
+         bst.erase(first, last);
+         expected.erase(expected.begin() + iFirst, expected.begin() + iFirst + numErase);
+         same = same && bst.size() == expected.size() &&
+                std::equal(expected.begin(), expected.end(), bst.begin());
+         redBlack = redBlack && bst.root->pParent == nullptr &&
+                    bst.root->verifyRedBlack(bst.root->findDepth());
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(redBlack);
+   }  // teardown
+
+   // erase a key that is not there
+   void test_eraseKey_standardMissing()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy s(42);
+      Spy::reset();
+      // exercise
+      size_t numErased = bst.erase(s);
+      // verify
+      assertUnit(numErased == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // erase every copy of a duplicated key
+   void test_eraseKey_duplicates()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i : { 50, 30, 70, 30, 20, 30, 40, 60, 80 })
+         bst.insert(i);
+      // exercise
+      size_t numErased = bst.erase(30);
+      // verify
+      assertUnit(numErased == 3);
+      assertUnit(bst.size() == 6);
+      assertUnit(bst.find(30) == bst.end());
+      auto it = bst.begin();
+      for (int i : { 20, 40, 50, 60, 70, 80 })
+      {
+         assertUnit(it != bst.end());
+         if (it != bst.end())
+            assertUnit(*it++ == i);
+      }
+      assertUnit(it == bst.end());
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+   }  // teardown
+
+   // erase everything that matches a predicate
+   void test_eraseIf_standard()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      size_t numErased = bst.erase_if([](const Spy& s) { return s.get() % 40 == 0; });
+      // verify
+      assertUnit(numErased == 2);
+      assertUnit(Spy::numDestructor() == 2);  // destroy [40][80]
+      assertUnit(Spy::numDelete() == 2);      // delete  [40][80]
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(bst.numElements == 5);
+      auto it = bst.begin();
+      for (int i : { 20, 30, 50, 60, 70 })
+      {
+         assertUnit(it != bst.end());
+         if (it != bst.end())
+            assertUnit((*it++).get() == i);
+      }
+      assertUnit(it == bst.end());
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      // teardown
+      bst.clear();
+   }
+
+
+#ifdef CHECKED_ITERATORS
+   /***************************************
+    * CHECKED ITERATOR
+    *     BST::iterator::check()
+    ***************************************/
+
+   // an erase anywhere strands the iterators made before it, since
+   // telling which node went would mean reading nodes that may be freed
+   void test_checked_eraseStrandsOthers()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      custom::BST<int>::iterator it = bst.find(40);
+      bool threw = false;
+      // exercise
+      bst.erase(60);
+      try
+      {
+         *it;
+      }
+      catch (const std::logic_error&)
+      {
+         threw = true;
+      }
+      // verify
+      assertUnit(threw);
+      assertUnit(*bst.find(40) == 40);
+   }  // teardown
+
+   // an iterator to the erased node is stranded
+   void test_checked_eraseStrands()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      custom::BST<int>::iterator it = bst.find(60);
+      bool threw = false;
+      // exercise
+      bst.erase(60);
+      try
+      {
+         *it;
+      }
+      catch (const std::logic_error&)
+      {
+         threw = true;
+      }
+      // verify
+      assertUnit(threw);
+   }  // teardown
+
+   // a node made where an erased one was is not the node we had
+   void test_checked_reusedAddressStrands()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      custom::BST<int>::iterator it = bst.find(30);
+      bool threw = false;
+      // exercise
+      bst.erase(30);
+      for (int i = 0; i < 20; i++)
+         bst.insert(i);              // likely to land on 30's old address
+      try
+      {
+         ++it;
+      }
+      catch (const std::logic_error&)
+      {
+         threw = true;
+      }
+      // verify
+      assertUnit(threw);
+   }  // teardown
+
+   // assignment writes a new element over each reused node
+   void test_checked_assignStrands()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      custom::BST<int> other{ 1, 2, 3 };
+      custom::BST<int>::iterator it = bst.find(50);
+      bool threw = false;
+      // exercise
+      bst = other;
+      try
+      {
+         *it;
+      }
+      catch (const std::logic_error&)
+      {
+         threw = true;
+      }
+      // verify
+      assertUnit(threw);
+   }  // teardown
+
+   // the iterator erase() returns is good to use
+   void test_checked_eraseReturnsFresh()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      custom::BST<int>::iterator it = bst.begin();
+      // exercise
+      while (it != bst.end() && *it < 50)
+         it = bst.erase(it);
+      // verify
+      assertUnit(it != bst.end() && *it == 50);
+      assertUnit(*++it == 60);
+      assertUnit(bst.size() == 4);
+   }  // teardown
+
+   // insert frees nothing, so iterators made before it stay good
+   void test_checked_insertKeeps()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      custom::BST<int>::iterator it = bst.find(30);
+      // exercise
+      for (int i = 0; i < 20; i++)
+         bst.insert(i * 5 + 1);
+      // verify
+      assertUnit(*it == 30);
+      assertUnit(*++it == 31);
+   }  // teardown
+
+   // stepping a stranded iterator throws too
+   void test_checked_clearStrands()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      custom::BST<int>::iterator it = bst.begin();
+      bool threw = false;
+      // exercise
+      bst.clear();
+      try
+      {
+         ++it;
+      }
+      catch (const std::logic_error&)
+      {
+         threw = true;
+      }
+      // verify
+      assertUnit(threw);
+   }  // teardown
+
+   // comparing, even a stranded iterator, is always allowed
+   void test_checked_compareNeverThrows()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      custom::BST<int>::iterator it = bst.find(70);
+      // exercise
+      bst.erase(30);
+      // verify
+      assertUnit(it != bst.end());
+      assertUnit(bst.find(99) == bst.end());
+   }  // teardown
+#else // !CHECKED_ITERATORS
+   /***************************************
+    * UNCHECKED ITERATOR
+    *     BST::iterator
+    ***************************************/
+
+   // without CHECKED_ITERATORS the checks compile away, down to the storage
+   void test_unchecked_barePointer()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      // exercise
+      custom::BST<int>::iterator it = bst.find(30);
+      // verify
+      assertUnit(sizeof(custom::BST<int>::iterator) == sizeof(void*));
+      assertUnit(*it == 30);
+      assertUnit(*++it == 50);
+   }  // teardown
+#endif // !CHECKED_ITERATORS
+
    /**************************************************************
     * SETUP STANDARD FIXTURE
     *                (50b)
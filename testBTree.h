@@ -0,0 +1,625 @@
+/***********************************************************************
+ * Header:
+ *    TEST B-TREE
+ * Summary:
+ *    Unit tests for the B-tree
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "btree.h"      // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <set>          // for std::multiset to compare against
+#include <vector>
+
+/***********************************************
+ * TEST B-TREE
+ * Unit tests for the BTree class. Most use 32-byte
+ * nodes of three ints so a few keys make a tall tree
+ ***********************************************/
+class TestBTree : public UnitTest
+{
+   typedef custom::BTree<int, 32> Small;
+   typedef custom::BTree<int, 32>::BNode SmallNode;
+
+   // a key with no default constructor that counts its comparisons
+   struct Key
+   {
+      explicit Key(int value) : value(value) {}
+      bool operator <(const Key& rhs) const
+      {
+         numCompares++;
+         return value < rhs.value;
+      }
+      int value;
+      static inline size_t numCompares = 0;
+   };
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_construct_nodeSize();
+      test_construct_initializerList();
+      test_construct_noDefaultKey();
+      test_constructCopy_standard();
+      test_constructMove_standard();
+      test_swap_standard();
+
+      // Insert
+      test_insert_empty();
+      test_insert_splitRoot();
+      test_insert_keepUnique();
+      test_insert_duplicates();
+      test_insert_ascending();
+
+      // Access
+      test_find_standardHit();
+      test_find_standardMissing();
+      test_bounds_standard();
+
+      // Iterator
+      test_iterator_increment_standard();
+      test_iterator_decrement_standard();
+
+      // Remove
+      test_erase_returnsNext();
+      test_erase_duplicates();
+      test_erase_all();
+      test_eraseRange_standard();
+      test_eraseRange_duplicatesLinear();
+      test_eraseKey_duplicates();
+      test_eraseIf_standard();
+      test_eraseIf_throwsUntouched();
+      test_random_againstMultiset();
+
+      report("BTree");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // default constructor
+   void test_construct_default()
+   {  // exercise
+      Small tree;
+      // verify
+      assertUnit(tree.root == nullptr);
+      assertUnit(tree.numElements == 0);
+      assertUnit(tree.empty());
+      assertUnit(tree.begin() == tree.end());
+   }  // teardown
+
+   // nodes hold an odd number of keys that fit the requested size
+   void test_construct_nodeSize()
+   {  // verify
+      assertUnit(SmallNode::maxKeys == 3);
+      assertUnit(SmallNode::minKeys == 1);
+      assertUnit((custom::BTree<int, 256>::BNode::maxKeys) == 59);
+      assertUnit(sizeof(custom::BTree<int, 256>::BNode) <= 256);
+      assertUnit(sizeof(custom::BTree<double, 4096>::BNode) <= 4096);
+   }  // teardown
+
+   // initializer list
+   void test_construct_initializerList()
+   {  // exercise
+      Small tree{ 50, 30, 70, 20, 40, 60, 80 };
+      // verify
+      assertUnit(tree.size() == 7);
+      assertUnit(isValid(tree));
+      assertUnit(contents(tree) == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+   }  // teardown
+
+   // copy is deep: the nodes are new and the source is untouched
+   void test_constructCopy_standard()
+   {  // setup
+      Small src;
+      setupStandardFixture(src);
+      // exercise
+      Small dest(src);
+      // verify
+      assertUnit(dest.size() == src.size());
+      assertUnit(dest.root != src.root);
+      assertUnit(isValid(dest));
+      assertUnit(contents(dest) == contents(src));
+      dest.insert(55);
+      assertUnit(src.find(55) == src.end());
+   }  // teardown
+
+   // move steals the nodes
+   void test_constructMove_standard()
+   {  // setup
+      Small src;
+      setupStandardFixture(src);
+      SmallNode* pRoot = src.root;
+      // exercise
+      Small dest(std::move(src));
+      // verify
+      assertUnit(dest.root == pRoot);
+      assertUnit(dest.size() == 7);
+      assertUnit(src.root == nullptr);
+      assertUnit(src.size() == 0);
+   }  // teardown
+
+   // swap exchanges the nodes
+   void test_swap_standard()
+   {  // setup
+      Small tree1{ 1, 2, 3, 4, 5 };
+      Small tree2{ 9 };
+      SmallNode* pRoot1 = tree1.root;
+      SmallNode* pRoot2 = tree2.root;
+      // exercise
+      tree1.swap(tree2);
+      // verify
+      assertUnit(tree1.root == pRoot2);
+      assertUnit(tree2.root == pRoot1);
+      assertUnit(tree1.size() == 1);
+      assertUnit(tree2.size() == 5);
+   }  // teardown
+
+   // keys need not be default-constructible
+   void test_construct_noDefaultKey()
+   {  // setup
+      custom::BTree<Key, 32> tree;
+      for (int i = 0; i < 100; i++)
+         tree.insert(Key((i * 37) % 100));
+      // exercise
+      custom::BTree<Key, 32> copy(tree);
+      auto it = tree.find(Key(50));
+      tree.erase(it);
+      tree.erase(tree.find(Key(10)), tree.find(Key(20)));
+      tree.erase_if([](const Key& key) { return key.value % 2 == 0; });
+      // verify
+      assertUnit(copy.size() == 100);
+      assertUnit(isValid(copy));
+      assertUnit(tree.size() == 45);
+      assertUnit(isValid(tree));
+      int expected = 1;
+      for (auto itKey = tree.begin(); itKey != tree.end(); ++itKey, expected += 2)
+      {
+         if (expected == 11)
+            expected = 21;
+         assertUnit((*itKey).value == expected);
+      }
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // the first key makes a leaf root
+   void test_insert_empty()
+   {  // setup
+      Small tree;
+      // exercise
+      auto pib = tree.insert(10);
+      // verify
+      assertUnit(pib.second);
+      assertUnit(pib.first != tree.end() && *pib.first == 10);
+      assertUnit(tree.root != nullptr && tree.root->isLeaf);
+      assertUnit(tree.size() == 1);
+   }  // teardown
+
+   // the fourth key splits a full root around its median
+   void test_insert_splitRoot()
+   {  // setup
+      Small tree{ 10, 20, 30 };
+      // exercise
+      auto pib = tree.insert(40);
+      // verify
+      //          [20]
+      //     +------+------+
+      //   [10]        [30 40]
+      assertUnit(pib.second);
+      assertUnit(pib.first != tree.end() && *pib.first == 40);
+      assertUnit(!tree.root->isLeaf);
+      assertUnit(tree.root->numKeys == 1);
+      assertUnit(tree.root->keys[0] == 20);
+      assertUnit(tree.root->child(0)->numKeys == 1);
+      assertUnit(tree.root->child(1)->numKeys == 2);
+      assertUnit(isValid(tree));
+   }  // teardown
+
+   // keepUnique refuses a second copy
+   void test_insert_keepUnique()
+   {  // setup
+      Small tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto pib = tree.insert(40, true /*keepUnique*/);
+      // verify
+      assertUnit(!pib.second);
+      assertUnit(pib.first != tree.end() && *pib.first == 40);
+      assertUnit(tree.size() == 7);
+   }  // teardown
+
+   // duplicates are allowed by default and sit next to each other
+   void test_insert_duplicates()
+   {  // setup
+      Small tree;
+      // exercise
+      for (int i = 0; i < 20; i++)
+         tree.insert(i % 2 ? 5 : 7);
+      // verify
+      assertUnit(tree.size() == 20);
+      assertUnit(isValid(tree));
+      auto it = tree.lower_bound(7);
+      int count = 0;
+      for (; it != tree.end(); ++it, ++count)
+         assertUnit(*it == 7);
+      assertUnit(count == 10);
+   }  // teardown
+
+   // sorted input is the worst case for splitting
+   void test_insert_ascending()
+   {  // setup
+      Small tree;
+      std::vector<int> expected;
+      // exercise
+      for (int i = 0; i < 500; i++)
+      {
+         tree.insert(i);
+         expected.push_back(i);
+      }
+      // verify
+      assertUnit(tree.size() == 500);
+      assertUnit(isValid(tree));
+      assertUnit(contents(tree) == expected);
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   // find something that is there
+   void test_find_standardHit()
+   {  // setup
+      Small tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto it = tree.find(60);
+      // verify
+      assertUnit(it != tree.end() && *it == 60);
+   }  // teardown
+
+   // find something that is not there
+   void test_find_standardMissing()
+   {  // setup
+      Small tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto it = tree.find(65);
+      // verify
+      assertUnit(it == tree.end());
+   }  // teardown
+
+   // lower and upper bound, including past the end
+   void test_bounds_standard()
+   {  // setup
+      Small tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto itLower   = tree.lower_bound(40);
+      auto itUpper   = tree.upper_bound(40);
+      auto itBetween = tree.lower_bound(45);
+      auto itPast    = tree.upper_bound(80);
+      // verify
+      assertUnit(itLower   != tree.end() && *itLower   == 40);
+      assertUnit(itUpper   != tree.end() && *itUpper   == 50);
+      assertUnit(itBetween != tree.end() && *itBetween == 50);
+      assertUnit(itPast    == tree.end());
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    ***************************************/
+
+   // walk forward through leaves and internal nodes
+   void test_iterator_increment_standard()
+   {  // setup
+      Small tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto it = tree.begin();
+      // verify
+      for (int i : { 20, 30, 40, 50, 60, 70, 80 })
+      {
+         assertUnit(it != tree.end());
+         if (it != tree.end())
+            assertUnit(*it++ == i);
+      }
+      assertUnit(it == tree.end());
+   }  // teardown
+
+   // walk backward from the last element
+   void test_iterator_decrement_standard()
+   {  // setup
+      Small tree;
+      setupStandardFixture(tree);
+      auto it = tree.lower_bound(80);
+      // exercise and verify
+      for (int i : { 80, 70, 60, 50, 40, 30, 20 })
+      {
+         assertUnit(it != tree.end());
+         if (it != tree.end())
+            assertUnit(*it-- == i);
+      }
+      assertUnit(it == tree.end());
+   }  // teardown
+
+   /***************************************
+    * REMOVE
+    ***************************************/
+
+   // erase hands back the element that followed, even after a merge
+   void test_erase_returnsNext()
+   {  // setup
+      Small tree;
+      for (int i = 1; i <= 30; i++)
+         tree.insert(i);
+      // exercise
+      auto it = tree.find(10);
+      auto itNext = tree.erase(it);
+      // verify
+      assertUnit(itNext != tree.end() && *itNext == 11);
+      assertUnit(tree.size() == 29);
+      assertUnit(tree.find(10) == tree.end());
+      assertUnit(isValid(tree));
+      it = tree.find(30);
+      assertUnit(tree.erase(it) == tree.end());
+   }  // teardown
+
+   // erasing one of several equal keys returns the next one of them
+   void test_erase_duplicates()
+   {  // setup
+      Small tree;
+      for (int i = 0; i < 9; i++)
+         tree.insert(5);
+      auto it = tree.begin();
+      ++it;
+      ++it;
+      // exercise
+      auto itNext = tree.erase(it);
+      // verify
+      assertUnit(tree.size() == 8);
+      int count = 0;
+      for (auto itCount = tree.begin(); itCount != itNext; ++itCount)
+         count++;
+      assertUnit(count == 2);
+      assertUnit(isValid(tree));
+   }  // teardown
+
+   // erase every element from the front, one at a time
+   void test_erase_all()
+   {  // setup
+      Small tree;
+      for (int i = 0; i < 100; i++)
+         tree.insert((i * 37) % 100);
+      // exercise
+      auto it = tree.begin();
+      for (int i = 0; i < 100; i++)
+      {
+         assertUnit(it != tree.end() && *it == i);
+         it = tree.erase(it);
+         assertUnit(isValid(tree));
+      }
+      // verify
+      assertUnit(it == tree.end());
+      assertUnit(tree.empty());
+      assertUnit(tree.root == nullptr);
+   }  // teardown
+
+   // erase a range in the middle
+   void test_eraseRange_standard()
+   {  // setup
+      Small tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto it = tree.erase(tree.find(30), tree.find(70));
+      // verify
+      assertUnit(it != tree.end() && *it == 70);
+      assertUnit(contents(tree) == std::vector<int>({ 20, 70, 80 }));
+      assertUnit(isValid(tree));
+   }  // teardown
+
+   // a range inside a long run of equal keys is erased in linear time
+   void test_eraseRange_duplicatesLinear()
+   {  // setup
+      custom::BTree<Key, 48> tree;
+      for (int i = 0; i < 1000; i++)
+         tree.insert(Key(7));
+      auto first = tree.begin();
+      for (int i = 0; i < 300; i++)
+         ++first;
+      auto last = first;
+      for (int i = 0; i < 400; i++)
+         ++last;
+      Key::numCompares = 0;
+      // exercise
+      auto it = tree.erase(first, last);
+      // verify
+      assertUnit(tree.size() == 600);
+      assertUnit(isValid(tree));
+      assertUnit(Key::numCompares < 1000);
+      size_t numBefore = 0;
+      for (auto itCount = tree.begin(); itCount != it; ++itCount)
+         numBefore++;
+      assertUnit(numBefore == 300);
+   }  // teardown
+
+   // erase by key removes every copy
+   void test_eraseKey_duplicates()
+   {  // setup
+      Small tree{ 1, 4, 2, 4, 3, 4, 5 };
+      // exercise
+      size_t num = tree.erase(4);
+      // verify
+      assertUnit(num == 3);
+      assertUnit(contents(tree) == std::vector<int>({ 1, 2, 3, 5 }));
+      assertUnit(tree.erase(4) == 0);
+      assertUnit(isValid(tree));
+   }  // teardown
+
+   // erase_if rebuilds from the survivors
+   void test_eraseIf_standard()
+   {  // setup
+      Small tree;
+      std::vector<int> expected;
+      for (int i = 0; i < 200; i++)
+      {
+         tree.insert(i);
+         if (i % 3)
+            expected.push_back(i);
+      }
+      // exercise
+      size_t num = tree.erase_if([](int i) { return i % 3 == 0; });
+      // verify
+      assertUnit(num == 67);
+      assertUnit(tree.size() == 133);
+      assertUnit(isValid(tree));
+      assertUnit(contents(tree) == expected);
+      assertUnit(tree.erase_if([](int) { return false; }) == 0);
+      assertUnit(contents(tree) == expected);
+   }  // teardown
+
+   // a predicate that throws leaves every key in place
+   void test_eraseIf_throwsUntouched()
+   {  // setup
+      Small tree;
+      std::vector<int> expected;
+      for (int i = 0; i < 200; i++)
+      {
+         tree.insert(i);
+         expected.push_back(i);
+      }
+      bool thrown = false;
+      // exercise
+      try
+      {
+         tree.erase_if([](int i)
+            {
+               if (i == 150)
+                  throw i;
+               return i % 3 == 0;
+            });
+      }
+      catch (int)
+      {
+         thrown = true;
+      }
+      // verify
+      assertUnit(thrown);
+      assertUnit(tree.size() == 200);
+      assertUnit(isValid(tree));
+      assertUnit(contents(tree) == expected);
+   }  // teardown
+
+   // a long mix of inserts and erases agrees with std::multiset
+   void test_random_againstMultiset()
+   {  // setup
+      custom::BTree<int, 48> tree;   // five keys per node
+      std::multiset<int> expected;
+      unsigned int seed = 2024;
+      // exercise
+      for (int i = 0; i < 4000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         int value = (int)((seed >> 8) % 300);
+         if ((seed >> 20) % 3)
+         {
+            tree.insert(value);
+            expected.insert(value);
+         }
+         else
+         {
+            auto it = tree.find(value);
+            if (it != tree.end())
+               tree.erase(it);
+            auto itExpected = expected.find(value);
+            if (itExpected != expected.end())
+               expected.erase(itExpected);
+         }
+      }
+      // verify
+      assertUnit(tree.size() == expected.size());
+      assertUnit(isValid(tree));
+      assertUnit(contents(tree) == std::vector<int>(expected.begin(), expected.end()));
+   }  // teardown
+
+   /**************************************************************
+    * SETUP STANDARD FIXTURE
+    *                 [50]
+    *          +-------+-------+
+    *     [20 30 40]      [60 70 80]
+    *************************************************************/
+   void setupStandardFixture(Small& tree)
+   {
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         tree.insert(i);
+   }
+
+   // every key in order
+   template <class Tree>
+   std::vector<int> contents(const Tree& tree)
+   {
+      std::vector<int> v;
+      for (auto it = tree.begin(); it != tree.end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+
+   // sorted, full enough, parents right, and all leaves at one depth
+   template <class Tree>
+   bool isValid(const Tree& tree)
+   {
+      size_t num = 0;
+      int leafDepth = -1;
+      if (tree.root && tree.root->pParent)
+         return false;
+      return isValid(tree.root, true, 0, leafDepth, num) && num == tree.size();
+   }
+
+   template <class Node>
+   bool isValid(const Node* pNode, bool isRoot, int depth, int& leafDepth, size_t& num)
+   {
+      if (!pNode)
+         return isRoot;
+      if (pNode->numKeys > Node::maxKeys || pNode->numKeys < (isRoot ? 1 : Node::minKeys))
+         return false;
+      for (int i = 1; i < pNode->numKeys; i++)
+         if (pNode->keys[i] < pNode->keys[i - 1])
+            return false;
+      num += pNode->numKeys;
+
+      if (pNode->isLeaf)
+      {
+         if (leafDepth == -1)
+            leafDepth = depth;
+         return leafDepth == depth;
+      }
+      for (int i = 0; i <= pNode->numKeys; i++)
+      {
+         const Node* pChild = pNode->child(i);
+         if (!pChild || pChild->pParent != pNode)
+            return false;
+         if (i > 0 && pChild->keys[0] < pNode->keys[i - 1])
+            return false;
+         if (i < pNode->numKeys && pNode->keys[i] < pChild->keys[pChild->numKeys - 1])
+            return false;
+         if (!isValid(pChild, false, depth + 1, leafDepth, num))
+            return false;
+      }
+      return true;
+   }
+};
+
+#endif // DEBUG
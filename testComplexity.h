@@ -0,0 +1,396 @@
+/***********************************************************************
+ * Header:
+ *    TEST COMPLEXITY
+ * Summary:
+ *    Complexity tests for the BST: build trees of Spy at several sizes
+ *    and check that the comparisons, copies, and allocations grow the
+ *    way they should. Counting instead of timing means a change that
+ *    slows the tree down asymptotically fails every time, with no noise
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "bst.h"        // class under test
+#include "external.h"   // for BST::build_sorted()
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // for counting what the tree does
+
+#include <algorithm>    // for std::min_element and std::max_element
+#include <cmath>        // for std::log2
+#include <vector>
+
+/***********************************************
+ * TEST COMPLEXITY
+ * Operation counts of BST against the expected curves
+ ***********************************************/
+class TestComplexity : public UnitTest
+{
+   // each size is sixteen times the last, so log n grows by 1.8 from the
+   // first to the last: a count that grows as log^2 n is 1.8 times off
+   // the log n curve, and the tolerance below is far tighter than that
+   const std::vector<size_t> sizes{ 1024, 16384, 262144 };
+   static constexpr double tolerance = 1.25;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Logarithmic
+      test_find_logarithmic();
+      test_insert_randomLogarithmic();
+      test_insert_ascendingLogarithmic();
+      test_erase_logarithmic();
+      test_find_afterEraseLogarithmic();
+      test_churn_balanced();
+#ifdef BST_COUNTERS
+      test_eraseRange_prefixLogarithmic();
+#endif // BST_COUNTERS
+
+      // Constant
+      test_insert_oneCopyEach();
+
+      // Linear
+      test_copy_linear();
+      test_buildSorted_linear();
+      test_clear_linear();
+
+      report("Complexity");
+   }
+
+   /***************************************
+    * LOGARITHMIC
+    ***************************************/
+
+   // a find, hit or miss, costs at most 2 comparisons a level of a red-black tree
+   void test_find_logarithmic()
+   {  // setup
+      std::vector<double> perFind;
+      bool withinBound = true;
+      for (size_t n : sizes)
+      {
+         custom::BST<Spy> bst;
+         fill(bst, n);
+         std::vector<Spy> probes;
+         for (size_t i = 0; i < n; i++)
+            probes.push_back(Spy(int(i)));   // even hit, odd miss
+         Spy::reset();
+         // exercise
+         for (const Spy& probe : probes)
+            bst.find(probe);
+         double num = numCompared() / double(n);
+         perFind.push_back(num);
+         withinBound = withinBound && num <= 4.0 * logOf(n);
+      }
+      // verify
+      assertUnit(withinBound);
+      assertUnit(fits(perFind, logOf, tolerance));
+      assertUnit(!fits(perFind, logSquaredOf, tolerance));   // the sizes tell the two apart
+   }  // teardown
+
+   // each insert in random order descends once
+   void test_insert_randomLogarithmic()
+   {  // setup
+      std::vector<double> perInsert;
+      bool withinBound = true;
+      for (size_t n : sizes)
+      {
+         std::vector<Spy> keys = scrambled(n);
+         custom::BST<Spy> bst;
+         Spy::reset();
+         // exercise
+         for (const Spy& key : keys)
+            bst.insert(key);
+         double num = numCompared() / double(n);
+         perInsert.push_back(num);
+         withinBound = withinBound && num <= 2.0 * logOf(n);
+      }
+      // verify
+      assertUnit(withinBound);
+      assertUnit(fits(perInsert, logOf, tolerance));
+   }  // teardown
+
+   // ascending keys are the worst case for a tree that does not balance
+   void test_insert_ascendingLogarithmic()
+   {  // setup
+      std::vector<double> perInsert;
+      bool withinBound = true;
+      for (size_t n : sizes)
+      {
+         std::vector<Spy> keys;
+         for (size_t i = 0; i < n; i++)
+            keys.push_back(Spy(int(i)));
+         custom::BST<Spy> bst;
+         Spy::reset();
+         // exercise
+         for (const Spy& key : keys)
+            bst.insert(key);
+         double num = numCompared() / double(n);
+         perInsert.push_back(num);
+         withinBound = withinBound && num <= 2.0 * logOf(n);
+      }
+      // verify
+      assertUnit(withinBound);
+      assertUnit(fits(perInsert, logOf, tolerance));
+   }  // teardown
+
+   // erasing one key costs a lower and an upper bound
+   void test_erase_logarithmic()
+   {  // setup
+      std::vector<double> perErase;
+      bool withinBound = true;
+      for (size_t n : sizes)
+      {
+         custom::BST<Spy> bst;
+         fill(bst, n);
+         std::vector<Spy> keys = evens(n);
+         keys.resize(n / 2);                // half of the tree's elements
+         Spy::reset();
+         // exercise
+         for (const Spy& key : keys)
+            bst.erase(key);
+         double num = numCompared() / double(keys.size());
+         perErase.push_back(num);
+         withinBound = withinBound && num <= 4.0 * logOf(n);
+      }
+      // verify
+      assertUnit(withinBound);
+      assertUnit(fits(perErase, logOf, tolerance));
+   }  // teardown
+
+#ifdef BST_COUNTERS
+   // a purge of the oldest eighth is cut out with a split and a join:
+   // the rebalancing it does grows with log n, not with the k erased
+   void test_eraseRange_prefixLogarithmic()
+   {  // setup
+      bool withinBound = true;
+      for (size_t n : sizes)
+      {
+         custom::BST<Spy> bst;
+         fill(bst, n);
+         custom::BST<Spy>::iterator last = bst.begin();
+         for (size_t i = 0; i < n / 8; i++)
+            ++last;
+         custom::counters::reset();
+         Spy::reset();
+         // exercise
+         bst.erase(bst.begin(), last);
+         custom::counters::Counts counts = custom::counters::snapshot();
+         withinBound = withinBound &&
+                       double(counts.rotations + counts.recolors) <= 4.0 * logOf(n) &&
+                       numCompared() == 0 &&
+                       size_t(Spy::numDelete()) == n / 8 &&
+                       bst.size() == n - n / 8;
+      }
+      // verify
+      assertUnit(withinBound);
+   }  // teardown
+#endif // BST_COUNTERS
+
+   // erasing never leaves a path longer than the tree had before
+   void test_find_afterEraseLogarithmic()
+   {  // setup
+      std::vector<double> perFind;
+      bool withinBound = true;
+      for (size_t n : sizes)
+      {
+         custom::BST<Spy> bst;
+         fill(bst, n);
+         std::vector<Spy> keys = evens(n);
+         for (size_t i = 0; i < n; i++)
+            if (i % 4 != 0)
+               bst.erase(keys[i]);          // one at a time, three in four
+         Spy::reset();
+         // exercise
+         for (const Spy& key : keys)
+            bst.find(key);
+         double num = numCompared() / double(n);
+         perFind.push_back(num);
+         withinBound = withinBound && num <= 4.0 * logOf(n);
+         assertUnit(bst.size() == n / 4);
+      }
+      // verify
+      assertUnit(withinBound);
+      assertUnit(fits(perFind, logOf, tolerance));
+   }  // teardown
+
+   // erasing and inserting at random for as long as it took to fill the
+   // tree keeps it red-black, and so no taller than 2 log(n + 1)
+   void test_churn_balanced()
+   {  // setup
+      std::vector<double> perOp;
+      bool balanced = true;
+      for (size_t n : sizes)
+      {
+         custom::BST<Spy> bst;
+         fill(bst, n);
+         std::vector<Spy> keys = evens(n);
+         Spy::reset();
+         // exercise
+         for (size_t i = 0; i < n; i++)
+         {
+            bst.erase(keys[(i * 7) % n]);                      // an even key, or already gone
+            bst.insert(Spy(int(((i * 7919) % n) * 2 + 1)));    // an odd key, new
+         }
+         double num = numCompared() / double(n);
+         perOp.push_back(num);
+         custom::ShapeStats stats = bst.stats();
+         balanced = balanced && stats.blackBalanced &&
+                    double(stats.height) <= 2.0 * logOf(double(stats.size));
+      }
+      // verify
+      assertUnit(balanced);
+      assertUnit(fits(perOp, logOf, tolerance));
+   }  // teardown
+
+   /***************************************
+    * CONSTANT
+    ***************************************/
+
+   // an insert copies its element once and allocates once, whatever the size
+   void test_insert_oneCopyEach()
+   {  // setup
+      bool oneEach = true;
+      for (size_t n : sizes)
+      {
+         std::vector<Spy> keys = scrambled(n);
+         custom::BST<Spy> bst;
+         Spy::reset();
+         // exercise
+         for (const Spy& key : keys)
+            bst.insert(key);
+         // verify
+         oneEach = oneEach &&
+                   size_t(Spy::numCopy()) == n &&
+                   size_t(Spy::numAlloc()) == n &&
+                   Spy::numAssign() == 0 &&
+                   Spy::numDelete() == 0;
+      }
+      assertUnit(oneEach);
+   }  // teardown
+
+   /***************************************
+    * LINEAR
+    ***************************************/
+
+   // a copy makes each element once and compares none
+   void test_copy_linear()
+   {  // setup
+      std::vector<double> perElement;
+      bool exact = true;
+      for (size_t n : sizes)
+      {
+         custom::BST<Spy> bst;
+         fill(bst, n);
+         Spy::reset();
+         // exercise
+         custom::BST<Spy> copy(bst);
+         exact = exact &&
+                 size_t(Spy::numCopy()) == n &&
+                 size_t(Spy::numAlloc()) == n &&
+                 numCompared() == 0;
+         perElement.push_back(Spy::numCopy() / double(n));
+      }
+      // verify
+      assertUnit(exact);
+      assertUnit(fits(perElement, constant, 1.0));
+   }  // teardown
+
+   // building from sorted input checks each neighbor once
+   void test_buildSorted_linear()
+   {  // setup
+      bool exact = true;
+      for (size_t n : sizes)
+      {
+         std::vector<Spy> keys;
+         for (size_t i = 0; i < n; i++)
+            keys.push_back(Spy(int(i)));
+         custom::BST<Spy> bst;
+         Spy::reset();
+         // exercise
+         bst.build_sorted(keys.begin(), keys.end());
+         exact = exact &&
+                 numCompared() == n - 1 &&
+                 size_t(Spy::numAlloc()) == n &&
+                 bst.size() == n;
+      }
+      // verify
+      assertUnit(exact);
+   }  // teardown
+
+   // clearing destroys each element once and compares none
+   void test_clear_linear()
+   {  // setup
+      bool exact = true;
+      for (size_t n : sizes)
+      {
+         custom::BST<Spy> bst;
+         fill(bst, n);
+         Spy::reset();
+         // exercise
+         bst.clear();
+         exact = exact &&
+                 size_t(Spy::numDelete()) == n &&
+                 size_t(Spy::numDestructor()) == n &&
+                 numCompared() == 0;
+      }
+      // verify
+      assertUnit(exact);
+   }  // teardown
+
+   /**************************************************************
+    * HELPERS
+    *************************************************************/
+
+   // the even numbers 0 .. 2(n-1), inserted in a scrambled order
+   static void fill(custom::BST<Spy>& bst, size_t n)
+   {
+      for (const Spy& key : evens(n))
+         bst.insert(key);
+   }
+
+   // the keys fill() uses, in the order it uses them
+   static std::vector<Spy> evens(size_t n)
+   {
+      std::vector<Spy> keys = scrambled(n);
+      for (Spy& key : keys)
+         key.set(key.get() * 2);
+      return keys;
+   }
+
+   // 0 .. n-1 in a fixed scrambled order; n is a power of two
+   static std::vector<Spy> scrambled(size_t n)
+   {
+      std::vector<Spy> keys;
+      for (size_t i = 0; i < n; i++)
+         keys.push_back(Spy(int((i * 7919) % n)));
+      return keys;
+   }
+
+   static size_t numCompared()
+   {
+      return size_t(Spy::numLessthan() + Spy::numEquals());
+   }
+
+   static double logOf(double n)        { return std::log2(n + 1.0); }
+   static double logSquaredOf(double n) { return logOf(n) * logOf(n); }
+   static double constant(double)       { return 1.0; }
+
+   // the counts follow the curve when count / curve(n) stays about the
+   // same at every size: the largest within tolerance of the smallest
+   bool fits(const std::vector<double>& counts, double (*curve)(double), double tolerance) const
+   {
+      std::vector<double> ratios;
+      for (size_t i = 0; i < counts.size(); i++)
+         ratios.push_back(counts[i] / curve(double(sizes[i])));
+      double lo = *std::min_element(ratios.begin(), ratios.end());
+      double hi = *std::max_element(ratios.begin(), ratios.end());
+      return lo > 0.0 && hi <= lo * tolerance;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,238 @@
+/***********************************************************************
+ * Header:
+ *    TEST CONCURRENT
+ * Summary:
+ *    Unit tests for the reader-writer concurrent tree
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "concurrent.h" // class under test
+#include "btree.h"      // a second tree to wrap
+#include "unitTest.h"   // unit test baseclass
+
+#include <atomic>       // for std::atomic
+#include <thread>       // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST CONCURRENT
+ * Unit tests for the concurrent::BST class
+ ***********************************************/
+class TestConcurrent : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Read
+      test_find_standard();
+      test_bounds_standard();
+      test_snapshot_standard();
+      test_copy_independent();
+
+      // Write
+      test_insert_keepUnique();
+      test_insertRange_batch();
+      test_erase_standard();
+      test_write_batch();
+      test_btree_wrapped();
+
+      // Threads
+      test_threads_writers();
+      test_threads_readersAndWriters();
+
+      report("Concurrent");
+   }
+
+   /***************************************
+    * READ
+    ***************************************/
+
+   // find returns a copy, or nothing
+   void test_find_standard()
+   {  // setup
+      custom::concurrent::BST<int> tree{ 50, 30, 70, 20, 40, 60, 80 };
+      // exercise
+      std::optional<int> hit  = tree.find(40);
+      std::optional<int> miss = tree.find(45);
+      // verify
+      assertUnit(hit.has_value() && *hit == 40);
+      assertUnit(!miss.has_value());
+      assertUnit(tree.contains(80));
+      assertUnit(!tree.contains(85));
+   }  // teardown
+
+   // bounds return copies, or nothing past the end
+   void test_bounds_standard()
+   {  // setup
+      custom::concurrent::BST<int> tree{ 50, 30, 70, 20, 40, 60, 80 };
+      // exercise and verify
+      assertUnit(tree.lower_bound(45) == std::optional<int>(50));
+      assertUnit(tree.upper_bound(50) == std::optional<int>(60));
+      assertUnit(!tree.upper_bound(80).has_value());
+   }  // teardown
+
+   // snapshot is every element in order
+   void test_snapshot_standard()
+   {  // setup
+      custom::concurrent::BST<int> tree{ 50, 30, 70, 20, 40, 60, 80 };
+      // exercise
+      std::vector<int> elements = tree.snapshot();
+      // verify
+      assertUnit(elements == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(tree.size() == 7);
+   }  // teardown
+
+   // a copy does not change with the shared tree
+   void test_copy_independent()
+   {  // setup
+      custom::concurrent::BST<int> tree{ 1, 2, 3 };
+      // exercise
+      custom::BST<int> copy = tree.copy();
+      tree.insert(4);
+      // verify
+      assertUnit(copy.size() == 3);
+      assertUnit(copy.find(4) == copy.end());
+      assertUnit(tree.size() == 4);
+   }  // teardown
+
+   /***************************************
+    * WRITE
+    ***************************************/
+
+   // keepUnique turns away a duplicate
+   void test_insert_keepUnique()
+   {  // setup
+      custom::concurrent::BST<int> tree{ 1, 2, 3 };
+      // exercise and verify
+      assertUnit(!tree.insert(2, true /*keepUnique*/));
+      assertUnit(tree.insert(2));
+      assertUnit(tree.size() == 4);
+   }  // teardown
+
+   // a range goes in under one lock
+   void test_insertRange_batch()
+   {  // setup
+      custom::concurrent::BST<int> tree{ 5 };
+      std::vector<int> batch = { 1, 5, 9, 3 };
+      // exercise
+      size_t num = tree.insert(batch.begin(), batch.end(), true /*keepUnique*/);
+      // verify
+      assertUnit(num == 3);
+      assertUnit(tree.snapshot() == std::vector<int>({ 1, 3, 5, 9 }));
+   }  // teardown
+
+   // erase and erase_if
+   void test_erase_standard()
+   {  // setup
+      custom::concurrent::BST<int> tree{ 1, 2, 2, 3, 4, 5, 6 };
+      // exercise
+      size_t numKey = tree.erase(2);
+      size_t numIf  = tree.erase_if([](int i) { return i % 3 == 0; });
+      // verify
+      assertUnit(numKey == 2);
+      assertUnit(numIf == 2);
+      assertUnit(tree.snapshot() == std::vector<int>({ 1, 4, 5 }));
+      tree.clear();
+      assertUnit(tree.empty());
+   }  // teardown
+
+   // write() runs a whole batch and passes its result back
+   void test_write_batch()
+   {  // setup
+      custom::concurrent::BST<int> tree;
+      // exercise
+      size_t size = tree.write([](custom::BST<int>& bst)
+         {
+            for (int i = 0; i < 100; i++)
+               bst.insert(i);
+            return bst.size();
+         });
+      int sum = tree.read([](const custom::BST<int>& bst)
+         {
+            int sum = 0;
+            for (auto it = bst.begin(); it != bst.end(); ++it)
+               sum += *it;
+            return sum;
+         });
+      // verify
+      assertUnit(size == 100);
+      assertUnit(sum == 4950);
+   }  // teardown
+
+   // anything with the BST interface can be wrapped
+   void test_btree_wrapped()
+   {  // setup
+      custom::concurrent::BST<int, custom::BTree<int>> tree{ 3, 1, 2 };
+      // exercise
+      tree.insert(0);
+      // verify
+      assertUnit(tree.snapshot() == std::vector<int>({ 0, 1, 2, 3 }));
+      assertUnit(tree.contains(2));
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // writers on several threads lose nothing
+   void test_threads_writers()
+   {  // setup
+      custom::concurrent::BST<int> tree;
+      std::vector<std::thread> threads;
+      // exercise
+      for (int t = 0; t < 4; t++)
+         threads.emplace_back([&tree, t]()
+            {
+               for (int i = 0; i < 500; i++)
+                  tree.insert(t * 500 + i);
+            });
+      for (std::thread& thread : threads)
+         thread.join();
+      // verify
+      std::vector<int> elements = tree.snapshot();
+      assertUnit(elements.size() == 2000);
+      bool inOrder = true;
+      for (size_t i = 0; i < elements.size(); i++)
+         inOrder = inOrder && elements[i] == (int)i;
+      assertUnit(inOrder);
+   }  // teardown
+
+   // readers always see whole batches
+   void test_threads_readersAndWriters()
+   {  // setup
+      custom::concurrent::BST<int> tree;
+      std::atomic<bool> done(false);
+      std::atomic<int> numTorn(0);
+      // exercise
+      std::thread writer([&]()
+         {
+            for (int batch = 0; batch < 200; batch++)
+               tree.write([batch](custom::BST<int>& bst)
+                  {
+                     for (int i = 0; i < 10; i++)
+                        bst.insert(batch * 10 + i);
+                  });
+            done = true;
+         });
+      std::thread reader([&]()
+         {
+            while (!done)
+               if (tree.size() % 10 != 0)
+                  numTorn++;
+         });
+      writer.join();
+      reader.join();
+      // verify
+      assertUnit(numTorn == 0);
+      assertUnit(tree.size() == 2000);
+   }  // teardown
+};
+
+#endif // DEBUG
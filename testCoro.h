@@ -0,0 +1,193 @@
+/***********************************************************************
+ * Header:
+ *    TEST CORO
+ * Summary:
+ *    Unit tests for the interleaved coroutine lookups
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "coro.h"       // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#ifdef __cpp_impl_coroutine
+
+#include <vector>
+
+/***********************************************
+ * TEST CORO
+ * Unit tests for coro.h
+ ***********************************************/
+class TestCoro : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Lookup
+      test_coFind_empty();
+      test_coFind_lazy();
+      test_coFind_stepsPerLevel();
+      test_coFind_missing();
+      test_coFind_framesReused();
+
+      // Scheduler
+      test_interleave_everyKeyOnce();
+      test_findAll_matchesFind();
+      test_findAll_widthOne();
+
+      report("Coro");
+   }
+
+   /***************************************
+    * LOOKUP
+    ***************************************/
+
+   // nothing to find, and done at the first step
+   void test_coFind_empty()
+   {  // setup
+      custom::BST<int> bst;
+      // exercise
+      custom::coro::Lookup<int> lookup = bst.co_find(5);
+      // verify
+      assertUnit(lookup.wait() == bst.end());
+   }  // teardown
+
+   // nothing runs until the first resume
+   void test_coFind_lazy()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      // exercise
+      custom::coro::Lookup<int> lookup = bst.co_find(50);
+      // verify
+      assertUnit(!lookup.done());
+      lookup.resume();
+      assertUnit(lookup.done());
+      assertUnit(lookup.get() == bst.find(50));
+   }  // teardown
+
+   // one suspension for each step down to a child
+   void test_coFind_stepsPerLevel()
+   {  // setup
+      //                (50b)
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      //   (20r)     (40r) (60r)     (80r)
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      custom::coro::Lookup<int> lookup = bst.co_find(60);
+      int numResumes = 0;
+      // exercise
+      while (!lookup.done())
+      {
+         lookup.resume();
+         numResumes++;
+      }
+      // verify
+      assertUnit(numResumes == 3);   // start, 70, 60
+      assertUnit(lookup.get() == bst.find(60));
+      assertUnit(*lookup.get() == 60);
+   }  // teardown
+
+   // a miss walks down to a leaf and ends at end()
+   void test_coFind_missing()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      // exercise
+      custom::coro::Lookup<int> lookup = bst.co_find(45);
+      // verify
+      assertUnit(lookup.wait() == bst.end());
+   }  // teardown
+
+   // a finished lookup's frame is handed to the next one
+   void test_coFind_framesReused()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70 };
+      void* pFrame = nullptr;
+      {
+         custom::coro::Lookup<int> lookup = bst.co_find(30);
+         lookup.wait();
+         pFrame = lookup.handle.address();
+      }
+      // exercise
+      custom::coro::Lookup<int> lookup = bst.co_find(70);
+      // verify
+      assertUnit(lookup.handle.address() == pFrame);
+      assertUnit(*lookup.wait() == 70);
+   }  // teardown
+
+   /***************************************
+    * SCHEDULER
+    ***************************************/
+
+   // every key is reported once, with its own position
+   void test_interleave_everyKeyOnce()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 1000; i += 2)
+         bst.insert(i);
+      std::vector<int> keys;
+      for (int i = 0; i < 300; i++)
+         keys.push_back((i * 37) % 1000);
+      std::vector<int> numCalls(keys.size(), 0);
+      bool allRight = true;
+      // exercise
+      custom::coro::interleave(bst, keys.begin(), keys.end(), [&](size_t i, custom::BST<int>::iterator it)
+         {
+            numCalls[i]++;
+            allRight = allRight && it == bst.find(keys[i]);
+         }, 8);
+      // verify
+      bool once = true;
+      for (int n : numCalls)
+         once = once && n == 1;
+      assertUnit(once);
+      assertUnit(allRight);
+   }  // teardown
+
+   // the results come back in the keys' order
+   void test_findAll_matchesFind()
+   {  // setup
+      custom::BST<int> bst;
+      unsigned int seed = 9;
+      for (int i = 0; i < 5000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         bst.insert((int)((seed >> 8) % 20000));
+      }
+      std::vector<int> keys;
+      for (int i = 0; i < 2000; i++)
+         keys.push_back(i * 10);
+      // exercise
+      std::vector<custom::BST<int>::iterator> results = custom::coro::findAll(bst, keys.begin(), keys.end(), 16);
+      // verify
+      bool same = results.size() == keys.size();
+      for (size_t i = 0; same && i < keys.size(); i++)
+         same = results[i] == bst.find(keys[i]);
+      assertUnit(same);
+   }  // teardown
+
+   // one lookup at a time is just find()
+   void test_findAll_widthOne()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      std::vector<int> keys = { 80, 10, 20, 50 };
+      // exercise
+      std::vector<custom::BST<int>::iterator> results = custom::coro::findAll(bst, keys.begin(), keys.end(), 1);
+      // verify
+      assertUnit(results.size() == 4);
+      assertUnit(*results[0] == 80);
+      assertUnit(results[1] == bst.end());
+      assertUnit(*results[2] == 20);
+      assertUnit(*results[3] == 50);
+   }  // teardown
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // DEBUG
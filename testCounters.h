@@ -0,0 +1,317 @@
+/***********************************************************************
+ * Header:
+ *    TEST COUNTERS
+ * Summary:
+ *    Unit tests for the counters bst.h keeps when BST_COUNTERS is defined
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "bst.h"        // class under test
+#include "counters.h"   // the counters it keeps
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // for counting comparisons another way
+
+#include <string>
+#include <thread>       // for std::thread
+
+/***********************************************
+ * TEST COUNTERS
+ * Unit tests for counters.h
+ ***********************************************/
+class TestCounters : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+#ifdef BST_COUNTERS
+      // Allocations
+      test_allocations_insertAndClear();
+      test_allocations_copy();
+
+      // Comparisons and depth
+      test_comparisons_matchSpy();
+      test_find_depth();
+      test_insert_depth();
+
+      // Balancing
+      test_balance_case4();
+      test_balance_case3();
+      test_fixup_cases();
+
+      // Export
+      test_forEach_names();
+      test_threads_retired();
+#else // !BST_COUNTERS
+      // Compiled out
+      test_disabled_countsNothing();
+#endif // !BST_COUNTERS
+
+      report("Counters");
+   }
+
+   /***************************************
+    * ALLOCATIONS
+    ***************************************/
+
+   // every node made is counted, and so is every node freed
+   void test_allocations_insertAndClear()
+   {  // setup
+      custom::counters::reset();
+      // exercise
+      {
+         custom::BST<int> bst;
+         for (int i = 0; i < 10; i++)
+            bst.insert(i);
+      }
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.allocations == 10);
+      assertUnit(counts.frees == 10);
+      assertUnit(counts.inserts == 10);
+   }  // teardown
+
+   // a copy makes a node for each of the source
+   void test_allocations_copy()
+   {  // setup
+      custom::BST<int> src{ 5, 3, 8, 1, 4 };
+      custom::counters::reset();
+      // exercise
+      custom::BST<int> copy(src);
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.allocations == 5);
+      assertUnit(counts.frees == 0);
+      assertUnit(counts.inserts == 0);
+   }  // teardown
+
+   /***************************************
+    * COMPARISONS AND DEPTH
+    ***************************************/
+
+   // what we count is what the elements saw
+   void test_comparisons_matchSpy()
+   {  // setup
+      custom::counters::reset();
+      Spy::reset();
+      // exercise
+      {
+         custom::BST<Spy> bst;
+         for (int i = 0; i < 200; i++)
+            bst.insert(Spy((i * 37) % 101));   // repeats too
+         for (int i = 0; i < 120; i++)
+         {
+            bst.find(Spy(i));
+            bst.lower_bound(Spy(i));
+            bst.upper_bound(Spy(i));
+         }
+      }
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.comparisons == uint64_t(Spy::numLessthan() + Spy::numEquals()));
+      assertUnit(counts.finds == 120);
+   }  // teardown
+
+   // a hit visits down to the node; a miss visits down to a leaf
+   void test_find_depth()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i : { 2, 1, 3 })
+         bst.insert(i);
+      custom::counters::reset();
+      // exercise
+      bst.find(2);
+      bst.find(1);
+      bst.find(4);
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.finds == 3);
+      assertUnit(counts.findDepth == 5);
+      assertUnit(counts.findDepths[1] == 1);
+      assertUnit(counts.findDepths[2] == 2);
+      assertUnit(counts.comparisons == 1 + 3 + 4);
+   }  // teardown
+
+   // the depth of each new node, in total and by depth
+   void test_insert_depth()
+   {  // setup
+      custom::BST<int> bst;
+      custom::counters::reset();
+      // exercise
+      for (int i : { 4, 2, 6, 1, 3, 5, 7 })
+         bst.insert(i);
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.inserts == 7);
+      assertUnit(counts.insertDepth == 0 + 1 + 1 + 2 + 2 + 2 + 2);
+      assertUnit(counts.insertDepths[0] == 1);
+      assertUnit(counts.insertDepths[1] == 2);
+      assertUnit(counts.insertDepths[2] == 4);
+      assertUnit(counts.comparisons == 10);
+   }  // teardown
+
+   /***************************************
+    * BALANCING
+    ***************************************/
+
+   // each shape of three in a line takes its own rotation case
+   void test_balance_case4()
+   {  // setup
+      using custom::counters::Case;
+      struct Shape { int a, b, c; Case expected; uint64_t rotations; };
+      const Shape shapes[] =
+      {
+         { 3, 2, 1, custom::counters::case4a, 1 },
+         { 1, 2, 3, custom::counters::case4b, 1 },
+         { 3, 1, 2, custom::counters::case4c, 2 },
+         { 1, 3, 2, custom::counters::case4d, 2 },
+      };
+      for (const Shape& shape : shapes)
+      {
+         custom::BST<int> bst;
+         custom::counters::reset();
+         // exercise
+         bst.insert(shape.a);
+         bst.insert(shape.b);
+         bst.insert(shape.c);
+         // verify
+         custom::counters::Counts counts = custom::counters::snapshot();
+         assertUnit(counts.cases[custom::counters::case1] == 1);
+         assertUnit(counts.cases[custom::counters::case2] == 1);
+         assertUnit(counts.cases[shape.expected] == 1);
+         assertUnit(counts.rotations == shape.rotations);
+         assertUnit(counts.recolors == 1 + 2);
+      }
+   }  // teardown
+
+   // a red aunt means recoloring, then balancing from granny up
+   void test_balance_case3()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i : { 2, 1, 3 })
+         bst.insert(i);
+      custom::counters::reset();
+      // exercise
+      bst.insert(4);
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.cases[custom::counters::case3] == 1);
+      assertUnit(counts.cases[custom::counters::case1] == 1);
+      assertUnit(counts.rotations == 0);
+      assertUnit(counts.recolors == 3 + 1);
+   }  // teardown
+
+   // erasing a black leaf rebalances too: a red far nephew rotates
+   // up, and a black sibling with black children only turns red
+   void test_fixup_cases()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i : { 1, 2, 3, 4 })
+         bst.insert(i);
+      custom::BST<int>::iterator it = bst.find(1);
+      custom::counters::reset();
+      // exercise
+      bst.erase(it);
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.cases[custom::counters::erase4] == 1);
+      assertUnit(counts.rotations == 1);
+      assertUnit(counts.recolors == 3);
+      it = bst.find(4);
+      custom::counters::reset();
+      // exercise
+      bst.erase(it);
+      // verify
+      counts = custom::counters::snapshot();
+      assertUnit(counts.cases[custom::counters::erase2] == 1);
+      assertUnit(counts.rotations == 0);
+      assertUnit(counts.recolors == 1);
+   }  // teardown
+
+   /***************************************
+    * EXPORT
+    ***************************************/
+
+   // every counter and histogram bucket by name, for a metrics system
+   void test_forEach_names()
+   {  // setup
+      custom::counters::reset();
+      {
+         custom::BST<int> bst{ 1, 2, 3 };
+      }
+      custom::counters::Counts counts = custom::counters::snapshot();
+      int numNames = 0;
+      uint64_t allocations = 0;
+      uint64_t case4b = 0;
+      uint64_t insertDepth2 = 0;
+      uint64_t findDepthLast = 1;
+      // exercise
+      counts.forEach([&](const char* name, uint64_t value)
+         {
+            numNames++;
+            if (std::string(name) == "allocations")
+               allocations = value;
+            if (std::string(name) == "case4b")
+               case4b = value;
+            if (std::string(name) == "insertDepth.2")
+               insertDepth2 = value;
+            if (std::string(name) == "findDepth.63")
+               findDepthLast = value;
+         });
+      // verify
+      assertUnit(numNames == 20 + 2 * int(custom::counters::maxDepth));
+      assertUnit(allocations == 3);
+      assertUnit(case4b == 1);
+      assertUnit(insertDepth2 == 1);
+      assertUnit(findDepthLast == 0);
+   }  // teardown
+
+   // what a thread counted is still there after it is gone
+   void test_threads_retired()
+   {  // setup
+      custom::counters::reset();
+      // exercise
+      std::thread thread([]()
+         {
+            custom::BST<int> bst;
+            for (int i = 0; i < 50; i++)
+               bst.insert(i);
+         });
+      thread.join();
+      // verify
+      custom::counters::Counts counts = custom::counters::snapshot();
+      assertUnit(counts.allocations == 50);
+      assertUnit(counts.frees == 50);
+      assertUnit(counts.inserts == 50);
+   }  // teardown
+
+   /***************************************
+    * COMPILED OUT
+    ***************************************/
+
+   // without BST_COUNTERS the trees never touch the counters
+   void test_disabled_countsNothing()
+   {  // setup
+      custom::counters::reset();
+      // exercise
+      {
+         custom::BST<int> bst;
+         for (int i = 0; i < 50; i++)
+            bst.insert(i);
+         bst.find(7);
+         bst.erase(7);
+      }
+      // verify
+      uint64_t total = 0;
+      custom::counters::snapshot().forEach([&](const char*, uint64_t value) { total += value; });
+      assertUnit(total == 0);
+   }  // teardown
+};
+
+#endif // DEBUG
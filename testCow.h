@@ -0,0 +1,380 @@
+/***********************************************************************
+ * Header:
+ *    TEST COW
+ * Summary:
+ *    Unit tests for the copy-on-write tree
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "cow.h"        // class under test
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // for counting what a bulk erase does
+
+#include <unordered_set>
+#include <vector>
+
+/***********************************************
+ * TEST COW
+ * Unit tests for the CowBST class
+ ***********************************************/
+class TestCow : public UnitTest
+{
+   typedef custom::CowBST<int> Tree;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Copy
+      test_constructCopy_shares();
+      test_assign_shares();
+      test_write_copyUnchanged();
+      test_write_originalUnchanged();
+      test_write_clonesPathOnly();
+
+      // Insert
+      test_insert_returnsNew();
+      test_insert_keepUnique();
+
+      // Remove
+      test_erase_returnsNext();
+      test_erase_duplicates();
+      test_eraseRange_standard();
+      test_eraseRange_sharesRest();
+      test_eraseIf_standard();
+      test_eraseIf_sharesRest();
+      test_eraseRange_equalRun();
+      test_eraseIf_equalRun();
+      test_eraseIf_everySize();
+
+      report("Cow");
+   }
+
+   /***************************************
+    * COPY
+    ***************************************/
+
+   // a copy shares the root: nothing is allocated
+   void test_constructCopy_shares()
+   {  // setup
+      Tree src = standardTree();
+      // exercise
+      Tree dest(src);
+      // verify
+      assertUnit(dest.version.root == src.version.root);
+      assertUnit(dest.size() == 7);
+   }  // teardown
+
+   // so does an assignment
+   void test_assign_shares()
+   {  // setup
+      Tree src = standardTree();
+      Tree dest{ 1, 2, 3 };
+      // exercise
+      dest = src;
+      // verify
+      assertUnit(dest.version.root == src.version.root);
+      assertUnit(contents(dest) == contents(src));
+   }  // teardown
+
+   // writing to the original leaves the copy as it was
+   void test_write_copyUnchanged()
+   {  // setup
+      Tree src = standardTree();
+      Tree copy(src);
+      // exercise
+      src.insert(55);
+      src.erase(20);
+      // verify
+      assertUnit(contents(copy) == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(contents(src)  == std::vector<int>({ 30, 40, 50, 55, 60, 70, 80 }));
+   }  // teardown
+
+   // writing to the copy leaves the original as it was
+   void test_write_originalUnchanged()
+   {  // setup
+      Tree src = standardTree();
+      Tree copy(src);
+      // exercise
+      copy.clear();
+      // verify
+      assertUnit(src.size() == 7);
+      assertUnit(copy.empty());
+   }  // teardown
+
+   // after a write the two still share all but the path
+   void test_write_clonesPathOnly()
+   {  // setup
+      Tree src;
+      for (int i = 0; i < 1000; i++)
+         src.insert(i);
+      Tree copy(src);
+      // exercise
+      copy.insert(2000);
+      // verify
+      assertUnit(copy.size() == 1001);
+      assertUnit(numShared(src, copy) >= 1001 - 2 * 20);
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // the iterator refers to the new element, even among duplicates
+   void test_insert_returnsNew()
+   {  // setup
+      Tree tree{ 10, 20, 20 };
+      // exercise
+      auto pibMiddle = tree.insert(20);
+      auto pibLast   = tree.insert(30);
+      // verify
+      assertUnit(pibMiddle.second && pibLast.second);
+      assertUnit(pibLast.first != tree.end() && *pibLast.first == 30);
+      auto it = pibLast.first;
+      assertUnit(++it == tree.end());
+      assertUnit(*--pibLast.first == 20);
+   }  // teardown
+
+   // keepUnique turns away a duplicate
+   void test_insert_keepUnique()
+   {  // setup
+      Tree tree = standardTree();
+      // exercise
+      auto pib = tree.insert(40, true /*keepUnique*/);
+      // verify
+      assertUnit(!pib.second);
+      assertUnit(pib.first != tree.end() && *pib.first == 40);
+      assertUnit(tree.size() == 7);
+   }  // teardown
+
+   /***************************************
+    * REMOVE
+    ***************************************/
+
+   // erase hands back the element that followed
+   void test_erase_returnsNext()
+   {  // setup
+      Tree tree = standardTree();
+      auto it = tree.find(50);
+      // exercise
+      auto itNext = tree.erase(it);
+      // verify
+      assertUnit(itNext != tree.end() && *itNext == 60);
+      assertUnit(contents(tree) == std::vector<int>({ 20, 30, 40, 60, 70, 80 }));
+      it = tree.find(80);
+      assertUnit(tree.erase(it) == tree.end());
+   }  // teardown
+
+   // erase by key takes every copy; by iterator only the one
+   void test_erase_duplicates()
+   {  // setup
+      Tree tree{ 5, 3, 5, 8, 5 };
+      // exercise
+      auto it = tree.find(5);
+      tree.erase(it);
+      size_t num = tree.erase(5);
+      // verify
+      assertUnit(num == 2);
+      assertUnit(contents(tree) == std::vector<int>({ 3, 8 }));
+   }  // teardown
+
+   // erase a range in the middle
+   void test_eraseRange_standard()
+   {  // setup
+      Tree tree = standardTree();
+      // exercise
+      auto it = tree.erase(tree.find(30), tree.find(70));
+      // verify
+      assertUnit(it != tree.end() && *it == 70);
+      assertUnit(contents(tree) == std::vector<int>({ 20, 70, 80 }));
+   }  // teardown
+
+   // a range erase copies only the paths it splits along
+   void test_eraseRange_sharesRest()
+   {  // setup
+      Tree src;
+      for (int i = 0; i < 1000; i++)
+         src.insert(i);
+      Tree copy(src);
+      // exercise
+      auto it = copy.erase(copy.find(400), copy.find(600));
+      // verify
+      assertUnit(it != copy.end() && *it == 600);
+      assertUnit(copy.size() == 800);
+      assertUnit(src.size() == 1000);
+      assertUnit(isRedBlack(copy));
+      assertUnit(numShared(src, copy) >= 800 - 4 * 20);
+   }  // teardown
+
+   // erase_if of a few elements copies only the paths to them
+   void test_eraseIf_sharesRest()
+   {  // setup
+      Tree src;
+      for (int i = 0; i < 1000; i++)
+         src.insert(i);
+      Tree copy(src);
+      // exercise
+      size_t num = copy.erase_if([](int i) { return i % 100 == 50; });
+      // verify
+      assertUnit(num == 10);
+      assertUnit(copy.size() == 990);
+      assertUnit(copy.find(450) == copy.end());
+      assertUnit(copy.find(451) != copy.end());
+      assertUnit(src.size() == 1000);
+      assertUnit(isRedBlack(copy));
+      assertUnit(numShared(src, copy) >= 990 - 10 * 2 * 20);
+   }  // teardown
+
+   // erase_if takes what matches
+   void test_eraseIf_standard()
+   {  // setup
+      Tree tree = standardTree();
+      Tree copy(tree);
+      // exercise
+      size_t num = tree.erase_if([](int i) { return i % 20 == 0; });
+      // verify
+      assertUnit(num == 4);
+      assertUnit(contents(tree) == std::vector<int>({ 30, 50, 70 }));
+      assertUnit(copy.size() == 7);
+   }  // teardown
+
+   // a range across a run of equal keys lands on the right one of them
+   void test_eraseRange_equalRun()
+   {  // setup
+      custom::CowBST<Spy> tree;
+      for (int i = 0; i < 10; i++)
+         tree.insert(Spy(i < 3 ? 1 : 5));   // 1 1 1 5 5 5 5 5 5 5
+      auto first = tree.begin();
+      for (int i = 0; i < 4; i++)
+         ++first;                           // the second 5
+      auto last = first;
+      for (int i = 0; i < 3; i++)
+         ++last;                            // the fifth 5
+      Spy::reset();
+      // exercise
+      auto it = tree.erase(first, last);
+      // verify
+      assertUnit(tree.size() == 7);
+      size_t numBefore = 0;
+      for (auto itBefore = tree.begin(); itBefore != it && itBefore != tree.end(); ++itBefore)
+         numBefore++;
+      assertUnit(numBefore == 4);           // 1 1 1 5, then it
+      assertUnit(it != tree.end() && (*it).get() == 5);
+      assertUnit(isRedBlack(tree));
+   }  // teardown
+
+   // erasing from a long run of equal keys walks the tree once and
+   // builds one version: each survivor is copied once, nothing compared
+   void test_eraseIf_equalRun()
+   {  // setup
+      custom::CowBST<Spy> tree;
+      for (int i = 0; i < 2000; i++)
+         tree.insert(Spy(i < 1000 ? 7 : i));
+      custom::CowBST<Spy> copy(tree);
+      int i = 0;
+      Spy::reset();
+      // exercise
+      size_t num = tree.erase_if([&i](const Spy& spy) { return spy.get() == 7 && i++ % 2 == 0; });
+      // verify
+      assertUnit(num == 500);
+      assertUnit(tree.size() == 1500);
+      assertUnit(Spy::numCopy() == 1500);
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(copy.size() == 2000);
+      assertUnit(isRedBlack(tree));
+   }  // teardown
+
+   // the rebuilt version is red-black whatever is left
+   void test_eraseIf_everySize()
+   {
+      for (int num = 1; num <= 40; num++)
+      {  // setup
+         Tree tree;
+         for (int i = 0; i < 40; i++)
+            tree.insert(i);
+         // exercise
+         tree.erase_if([num](int i) { return i >= num; });
+         // verify
+         assertUnit(tree.size() == size_t(num));
+         assertUnit(isRedBlack(tree));
+         assertUnit(tree.find(num - 1) != tree.end());
+      }  // teardown
+   }
+
+   /**************************************************************
+    * STANDARD TREE
+    *************************************************************/
+   Tree standardTree()
+   {
+      return Tree{ 50, 30, 70, 20, 40, 60, 80 };
+   }
+
+   // every element in order
+   std::vector<int> contents(const Tree& tree)
+   {
+      std::vector<int> v;
+      for (auto it = tree.begin(); it != tree.end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+
+   // ordered, black root, no red-red, equal black heights
+   template <class Cow>
+   bool isRedBlack(const Cow& tree)
+   {
+      if (tree.version.root && tree.version.root->isRed)
+         return false;
+      size_t num = 0;
+      return blackHeight(tree.version.root.get(), num) >= 0 && num == tree.size();
+   }
+
+   template <class Node>
+   int blackHeight(const Node* p, size_t& num)
+   {
+      if (!p)
+         return 0;
+      num++;
+      const Node* pLeft  = p->pLeft.get();
+      const Node* pRight = p->pRight.get();
+      if ((pLeft && p->data < pLeft->data) || (pRight && pRight->data < p->data))
+         return -1;
+      if (p->isRed && ((pLeft && pLeft->isRed) || (pRight && pRight->isRed)))
+         return -1;
+      int hLeft  = blackHeight(pLeft, num);
+      int hRight = blackHeight(pRight, num);
+      if (hLeft < 0 || hLeft != hRight)
+         return -1;
+      return hLeft + (p->isRed ? 0 : 1);
+   }
+
+   // how many of copy's nodes are also src's
+   size_t numShared(const Tree& src, const Tree& copy)
+   {
+      std::unordered_set<const void*> srcNodes;
+      collect(src.version.root.get(), srcNodes);
+      std::unordered_set<const void*> copyNodes;
+      collect(copy.version.root.get(), copyNodes);
+      size_t num = 0;
+      for (const void* p : copyNodes)
+         num += srcNodes.count(p);
+      return num;
+   }
+
+   template <class Node>
+   void collect(const Node* p, std::unordered_set<const void*>& nodes)
+   {
+      if (!p)
+         return;
+      nodes.insert(p);
+      collect(p->pLeft.get(), nodes);
+      collect(p->pRight.get(), nodes);
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,426 @@
+/***********************************************************************
+ * Header:
+ *    TEST DURABLE
+ * Summary:
+ *    Unit tests for the tree with a write-ahead log
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "durable.h"    // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <cstdio>       // for std::remove
+#include <fstream>
+#include <iterator>     // for std::istreambuf_iterator
+#include <sstream>
+#include <string>
+#include <thread>       // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST DURABLE
+ * Unit tests for the DurableBST class
+ ***********************************************/
+class TestDurable : public UnitTest
+{
+   const std::string path = "testDurable";
+
+   // a string is its length and then its characters
+   struct StringCodec
+   {
+      bool write(std::ostream& out, const std::string& s)
+      {
+         uint32_t length = (uint32_t)s.size();
+         out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+         return bool(out.write(s.data(), length));
+      }
+      bool read(std::istream& in, std::string& s)
+      {
+         uint32_t length;
+         if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)))
+            return false;
+         s.resize(length);
+         return bool(in.read(&s[0], length));
+      }
+   };
+
+public:
+   void run()
+   {
+      reset();
+
+      // Recovery
+      test_open_fresh();
+      test_reopen_logOnly();
+      test_reopen_closeCommits();
+      test_insert_refusedNotLogged();
+      test_checkpoint_emptiesLog();
+      test_checkpoint_thenTail();
+      test_recover_tornTail();
+      test_recover_badChecksum();
+      test_recover_staleLog();
+      test_reopen_codec();
+      test_replay_erases();
+
+      // Group commit
+      test_commit_everyGroup();
+      test_commit_threads();
+      test_commit_failedRefuses();
+
+      removeFiles();
+      report("Durable");
+   }
+
+   /***************************************
+    * RECOVERY
+    ***************************************/
+
+   // a new tree makes an empty log
+   void test_open_fresh()
+   {  // setup
+      removeFiles();
+      custom::DurableBST<int> tree;
+      // exercise
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(opened);
+      assertUnit(tree.isOpen());
+      assertUnit(tree.empty());
+      assertUnit(read(path + ".wal").size() == custom::durable::headerSize);
+      assertUnit(!std::ifstream(path + ".ckpt"));
+   }  // teardown
+
+   // inserts and erases come back from the log alone
+   void test_reopen_logOnly()
+   {  // setup
+      removeFiles();
+      {
+         custom::DurableBST<int> tree;
+         tree.open(path);
+         tree.insert(30);
+         tree.insert(10);
+         tree.insert(20);
+         tree.erase(10);
+         tree.sync();
+      }
+      custom::DurableBST<int> tree;
+      // exercise
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(opened);
+      assertUnit(contents(tree) == std::vector<int>({ 20, 30 }));
+      assertUnit(tree.lsnAppended == 4);
+      assertUnit(tree.tree().root->verifyRedBlack(tree.tree().root->findDepth()));
+   }  // teardown
+
+   // records still waiting for a commit are written on close
+   void test_reopen_closeCommits()
+   {  // setup
+      removeFiles();
+      custom::DurableBST<int> tree;
+      tree.open(path);
+      tree.insert(1);
+      tree.insert(2);
+      assertUnit(tree.lsnDurable == 0);
+      // exercise
+      bool closed = tree.close();
+      tree.open(path);
+      // verify
+      assertUnit(closed);
+      assertUnit(contents(tree) == std::vector<int>({ 1, 2 }));
+   }  // teardown
+
+   // an insert keepUnique turns away leaves no record
+   void test_insert_refusedNotLogged()
+   {  // setup
+      removeFiles();
+      custom::DurableBST<int> tree;
+      tree.open(path);
+      tree.insert(5);
+      // exercise
+      bool inserted = tree.insert(5, true);
+      size_t numErased = tree.erase(6);
+      // verify
+      assertUnit(!inserted);
+      assertUnit(numErased == 0);
+      assertUnit(tree.lsnAppended == 1);
+   }  // teardown
+
+   // a checkpoint holds everything and the log starts over
+   void test_checkpoint_emptiesLog()
+   {  // setup
+      removeFiles();
+      custom::DurableBST<int> tree;
+      tree.open(path);
+      for (int i = 0; i < 100; i++)
+         tree.insert(i);
+      // exercise
+      bool saved = tree.checkpoint();
+      // verify
+      assertUnit(saved);
+      assertUnit(tree.generation == 1);
+      assertUnit(read(path + ".wal").size() == custom::durable::headerSize);
+      tree.close();
+      tree.open(path);
+      assertUnit(tree.size() == 100);
+      assertUnit(tree.lsnAppended == 0);
+   }  // teardown
+
+   // recovery is the checkpoint and then what the log adds
+   void test_checkpoint_thenTail()
+   {  // setup
+      removeFiles();
+      {
+         custom::DurableBST<int> tree;
+         tree.open(path);
+         for (int i = 1; i <= 10; i++)
+            tree.insert(i);
+         tree.checkpoint();
+         tree.insert(11);
+         tree.erase(1);
+      }
+      custom::DurableBST<int> tree;
+      // exercise
+      tree.open(path);
+      // verify
+      assertUnit(tree.size() == 10);
+      assertUnit(tree.contains(11));
+      assertUnit(!tree.contains(1));
+      assertUnit(tree.lsnAppended == 2);
+   }  // teardown
+
+   // a half-written last record is cut off, and writing goes on after the good ones
+   void test_recover_tornTail()
+   {  // setup
+      removeFiles();
+      {
+         custom::DurableBST<int> tree;
+         tree.open(path);
+         tree.insert(1);
+         tree.insert(2);
+         tree.insert(3);
+      }
+      std::ofstream(path + ".wal", std::ios::binary | std::ios::app).write("\x04\0\0\0\x7f", 5);
+      custom::DurableBST<int> tree;
+      // exercise
+      bool opened = tree.open(path);
+      tree.insert(4);
+      tree.close();
+      tree.open(path);
+      // verify
+      assertUnit(opened);
+      assertUnit(contents(tree) == std::vector<int>({ 1, 2, 3, 4 }));
+   }  // teardown
+
+   // replay stops at a record that fails its checksum
+   void test_recover_badChecksum()
+   {  // setup
+      removeFiles();
+      {
+         custom::DurableBST<int> tree;
+         tree.open(path);
+         tree.insert(1);
+         tree.insert(2);
+         tree.insert(3);
+      }
+      std::string bytes = read(path + ".wal");
+      size_t iSecond = custom::durable::headerSize + custom::durable::recordSize + sizeof(int);
+      bytes[iSecond + custom::durable::recordSize] ^= 0x40;   // 2 is now 66
+      std::ofstream(path + ".wal", std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+      custom::DurableBST<int> tree;
+      // exercise
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(opened);
+      assertUnit(contents(tree) == std::vector<int>({ 1 }));
+      assertUnit(read(path + ".wal").size() == iSecond);
+   }  // teardown
+
+   // a crash after the checkpoint but before the new log leaves an old
+   // log behind, which must not be replayed on top of the checkpoint
+   void test_recover_staleLog()
+   {  // setup
+      removeFiles();
+      std::string oldLog;
+      {
+         custom::DurableBST<int> tree;
+         tree.open(path);
+         tree.insert(1);
+         tree.insert(2);
+         tree.sync();
+         oldLog = read(path + ".wal");
+         tree.checkpoint();
+      }
+      std::ofstream(path + ".wal", std::ios::binary | std::ios::trunc).write(oldLog.data(), oldLog.size());
+      custom::DurableBST<int> tree;
+      // exercise
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(opened);
+      assertUnit(contents(tree) == std::vector<int>({ 1, 2 }));
+      assertUnit(read(path + ".wal").size() == custom::durable::headerSize);
+   }  // teardown
+
+   // a type that is not trivially copyable logs through its codec
+   void test_reopen_codec()
+   {  // setup
+      removeFiles();
+      {
+         custom::DurableBST<std::string, StringCodec> tree;
+         tree.open(path);
+         tree.insert("pear");
+         tree.insert("apple");
+         tree.checkpoint();
+         tree.insert("fig");
+         tree.erase("pear");
+      }
+      custom::DurableBST<std::string, StringCodec> tree;
+      // exercise
+      tree.open(path);
+      // verify
+      std::vector<std::string> elements;
+      for (auto it = tree.tree().begin(); it != tree.tree().end(); ++it)
+         elements.push_back(*it);
+      assertUnit(elements == std::vector<std::string>({ "apple", "fig" }));
+   }  // teardown
+
+   // replaying erases rebalances as it goes, roots with two children and all
+   void test_replay_erases()
+   {  // setup
+      removeFiles();
+      std::vector<int> expected;
+      {
+         custom::DurableBST<int> tree(8);
+         tree.open(path);
+         for (int i = 0; i < 200; i++)
+            tree.insert(i);
+         for (int i = 0; i < 200; i += 3)
+            tree.erase((i * 7) % 200);
+         for (int i = 0; i < 40; i++)
+         {
+            int root = tree.tree().root->data;     // the root, with two children
+            tree.erase(root);
+         }
+         expected = contents(tree);
+      }
+      custom::DurableBST<int> tree;
+      // exercise
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(opened);
+      assertUnit(contents(tree) == expected);
+      assertUnit(tree.size() == expected.size());
+      assertUnit(tree.tree().stats().blackBalanced);
+   }  // teardown
+
+   /***************************************
+    * GROUP COMMIT
+    ***************************************/
+
+   // one write and sync for each full group
+   void test_commit_everyGroup()
+   {  // setup
+      removeFiles();
+      custom::DurableBST<int> tree(4);
+      tree.open(path);
+      // exercise
+      for (int i = 0; i < 10; i++)
+         tree.insert(i);
+      // verify
+      assertUnit(tree.numCommits == 2);
+      assertUnit(tree.lsnDurable == 8);
+      assertUnit(tree.numPending == 2);
+      tree.sync();
+      assertUnit(tree.numCommits == 3);
+      assertUnit(tree.lsnDurable == 10);
+      assertUnit(tree.sync());
+      assertUnit(tree.numCommits == 3);   // nothing new to commit
+   }  // teardown
+
+   // threads that sync after every insert share commits, and lose nothing
+   void test_commit_threads()
+   {  // setup
+      removeFiles();
+      custom::DurableBST<int> tree;
+      tree.open(path);
+      std::vector<std::thread> threads;
+      // exercise
+      for (int iThread = 0; iThread < 4; iThread++)
+         threads.emplace_back([&tree, iThread]()
+            {
+               for (int i = 0; i < 100; i++)
+               {
+                  tree.insert(iThread * 100 + i);
+                  tree.sync();
+               }
+            });
+      for (std::thread& thread : threads)
+         thread.join();
+      // verify
+      assertUnit(tree.numCommits <= 400);
+      assertUnit(tree.lsnDurable == 400);
+      tree.close();
+      tree.open(path);
+      assertUnit(tree.size() == 400);
+      assertUnit(tree.tree().root->verifyRedBlack(tree.tree().root->findDepth()));
+   }  // teardown
+
+   // once the log has failed, nothing more is taken, logged, or held
+   void test_commit_failedRefuses()
+   {  // setup
+      removeFiles();
+      custom::DurableBST<int> tree(4);
+      tree.open(path);
+      for (int i = 0; i < 6; i++)
+         tree.insert(i);
+      tree.failed = true;                 // as if the last commit could not write
+      uint64_t lsnAppended = tree.lsnAppended;
+      size_t numPending = tree.numPending;
+      // exercise
+      bool inserted = tree.insert(10);
+      size_t numErased = tree.erase(3);
+      for (int i = 20; i < 100; i++)
+         tree.insert(i);
+      // verify
+      assertUnit(!inserted);
+      assertUnit(numErased == 0);
+      assertUnit(tree.lsnAppended == lsnAppended);
+      assertUnit(tree.numPending == numPending);
+      assertUnit(contents(tree) == std::vector<int>({ 0, 1, 2, 3, 4, 5 }));
+      assertUnit(!tree.sync());
+      assertUnit(!tree.good());
+      // teardown
+      tree.failed = false;
+   }
+
+   /**************************************************************
+    * HELPERS
+    *************************************************************/
+
+   void removeFiles()
+   {
+      for (const char* extension : { ".ckpt", ".wal", ".ckpt.tmp", ".wal.tmp" })
+         std::remove((path + extension).c_str());
+   }
+
+   static std::string read(const std::string& file)
+   {
+      std::ifstream in(file, std::ios::binary);
+      return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+   }
+
+   static std::vector<int> contents(const custom::DurableBST<int>& tree)
+   {
+      std::vector<int> v;
+      for (auto it = tree.tree().begin(); it != tree.tree().end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,262 @@
+/***********************************************************************
+ * Header:
+ *    TEST EXTERNAL
+ * Summary:
+ *    Unit tests for loading a tree from a file sorted on disk
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "external.h"   // class under test
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // for counting comparisons
+
+#include <algorithm>    // for std::sort and std::is_sorted
+#include <cstdio>       // for std::remove
+#include <fstream>
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST EXTERNAL
+ * Unit tests for external.h
+ ***********************************************/
+class TestExternal : public UnitTest
+{
+   const std::string inPath = "testExternal.keys";
+   const std::string outPath = "testExternal.mapped";
+
+public:
+   void run()
+   {
+      reset();
+
+      // Build sorted
+      test_buildSorted_standard();
+      test_buildSorted_outOfOrder();
+      test_buildSorted_unique();
+
+      // Sort
+      test_sort_budget();
+      test_sort_manyPasses();
+      test_sort_removesRuns();
+
+      // Load
+      test_load_standard();
+      test_load_unique();
+      test_load_empty();
+      test_load_missing();
+      test_load_partialKey();
+      test_writeMapped_standard();
+
+      std::remove(inPath.c_str());
+      std::remove(outPath.c_str());
+      report("External");
+   }
+
+   /***************************************
+    * BUILD SORTED
+    ***************************************/
+
+   // one comparison per element to check the order, and a valid tree
+   void test_buildSorted_standard()
+   {  // setup
+      std::vector<Spy> values;
+      for (int i = 0; i < 100; i++)
+         values.push_back(Spy(i));
+      custom::BST<Spy> bst{ Spy(500) };
+      Spy::reset();
+      // exercise
+      bool built = bst.build_sorted(values.begin(), values.end());
+      // verify
+      assertUnit(built);
+      assertUnit(Spy::numLessthan() == 99);
+      assertUnit(bst.size() == 100);
+      assertUnit(*bst.begin() == Spy(0));
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      assertUnit(bst.root->computeSize() == 100);
+   }  // teardown
+
+   // unsorted input is refused and the tree stays
+   void test_buildSorted_outOfOrder()
+   {  // setup
+      std::vector<int> values{ 1, 2, 5, 4 };
+      custom::BST<int> bst{ 9 };
+      // exercise
+      bool built = bst.build_sorted(values.begin(), values.end());
+      // verify
+      assertUnit(!built);
+      assertUnit(contents(bst) == std::vector<int>({ 9 }));
+   }  // teardown
+
+   // repeats dropped on request
+   void test_buildSorted_unique()
+   {  // setup
+      std::vector<int> values{ 1, 1, 2, 3, 3, 3 };
+      custom::BST<int> bst;
+      // exercise
+      bst.build_sorted(values.begin(), values.end(), true);
+      // verify
+      assertUnit(contents(bst) == std::vector<int>({ 1, 2, 3 }));
+   }  // teardown
+
+   /***************************************
+    * SORT
+    ***************************************/
+
+   // the blocks of a merge fit in the budget
+   void test_sort_budget()
+   {  // setup
+      // exercise
+      custom::external::Sorter<int> small(1024);
+      custom::external::Sorter<int> large(64 << 20);
+      // verify
+      assertUnit(small.budget == 256);
+      assertUnit(small.blockSize * (small.fanIn + 1) <= small.budget);
+      assertUnit(small.fanIn >= 2);
+      assertUnit(large.blockSize * sizeof(int) == custom::external::maxBlockBytes);
+      assertUnit(large.blockSize * (large.fanIn + 1) <= large.budget);
+   }  // teardown
+
+   // a small budget makes many runs and several merges, still in order
+   void test_sort_manyPasses()
+   {  // setup
+      std::vector<int> keys = writeKeys(10000);
+      custom::external::Sorter<int> sorter(256, inPath + ".sort");
+      // exercise
+      bool sorted = sorter.sort(inPath);
+      std::vector<int> v(sorter.begin(), sorter.end());
+      // verify
+      assertUnit(sorted);
+      assertUnit(sorter.good());
+      assertUnit(sorter.numRunsMade > 10000 / 64);
+      assertUnit(sorter.numPasses > 1);
+      assertUnit(sorter.runs.size() <= sorter.fanIn);
+      std::sort(keys.begin(), keys.end());
+      assertUnit(v == keys);
+   }  // teardown
+
+   // nothing is left on disk afterwards
+   void test_sort_removesRuns()
+   {  // setup
+      writeKeys(1000);
+      {
+         custom::external::Sorter<int> sorter(256, inPath + ".sort");
+         sorter.sort(inPath);
+         // exercise
+      }
+      // verify
+      bool anyLeft = false;
+      for (int i = 0; i < 100; i++)
+         anyLeft = anyLeft || bool(std::ifstream(inPath + ".sort.run" + std::to_string(i)));
+      assertUnit(!anyLeft);
+   }  // teardown
+
+   /***************************************
+    * LOAD
+    ***************************************/
+
+   // every key of the file, in a balanced tree
+   void test_load_standard()
+   {  // setup
+      std::vector<int> keys = writeKeys(5000);
+      custom::BST<int> bst;
+      // exercise
+      bool loaded = custom::external::load(bst, inPath, 4096);
+      // verify
+      assertUnit(loaded);
+      std::sort(keys.begin(), keys.end());
+      assertUnit(contents(bst) == keys);
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+   }  // teardown
+
+   // each key once
+   void test_load_unique()
+   {  // setup
+      std::vector<int> keys = writeKeys(5000);
+      custom::BST<int> bst;
+      // exercise
+      custom::external::load(bst, inPath, 4096, true);
+      // verify
+      std::sort(keys.begin(), keys.end());
+      keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+      assertUnit(contents(bst) == keys);
+   }  // teardown
+
+   // an empty file is an empty tree
+   void test_load_empty()
+   {  // setup
+      writeKeys(0);
+      custom::BST<int> bst{ 1, 2 };
+      // exercise
+      bool loaded = custom::external::load(bst, inPath);
+      // verify
+      assertUnit(loaded);
+      assertUnit(bst.empty());
+   }  // teardown
+
+   // no file, no change
+   void test_load_missing()
+   {  // setup
+      custom::BST<int> bst{ 1, 2 };
+      // exercise
+      bool loaded = custom::external::load(bst, "testExternal.missing");
+      // verify
+      assertUnit(!loaded);
+      assertUnit(contents(bst) == std::vector<int>({ 1, 2 }));
+   }  // teardown
+
+   // a file that ends partway through a key is refused
+   void test_load_partialKey()
+   {  // setup
+      writeKeys(100);
+      std::ofstream(inPath, std::ios::binary | std::ios::app).write("\x01\x02", 2);
+      custom::BST<int> bst{ 1, 2 };
+      // exercise
+      bool loaded = custom::external::load(bst, inPath, 256);
+      // verify
+      assertUnit(!loaded);
+      assertUnit(contents(bst) == std::vector<int>({ 1, 2 }));
+   }  // teardown
+
+   // straight into the on-disk tree
+   void test_writeMapped_standard()
+   {  // setup
+      std::vector<int> keys = writeKeys(5000);
+      custom::MappedBST<int> tree;
+      // exercise
+      bool written = custom::external::writeMapped<int>(inPath, outPath, 4096);
+      bool opened = tree.open(outPath);
+      // verify
+      assertUnit(written);
+      assertUnit(opened);
+      std::sort(keys.begin(), keys.end());
+      assertUnit(std::vector<int>(tree.begin(), tree.end()) == keys);
+   }  // teardown
+
+   /**************************************************************
+    * HELPERS
+    *************************************************************/
+
+   // num scrambled keys, with repeats, written to inPath
+   std::vector<int> writeKeys(int num)
+   {
+      std::vector<int> keys;
+      for (int i = 0; i < num; i++)
+         keys.push_back((i * 7919) % 3001);
+      std::ofstream out(inPath, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(int));
+      return keys;
+   }
+
+   static std::vector<int> contents(const custom::BST<int>& bst)
+   {
+      return std::vector<int>(bst.begin(), bst.end());
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,276 @@
+/***********************************************************************
+ * Header:
+ *    TEST EYTZINGER
+ * Summary:
+ *    Unit tests for the frozen Eytzinger snapshot
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "eytzinger.h"  // class under test
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"
+
+#include <set>          // for std::set to compare against
+
+/***********************************************
+ * TEST EYTZINGER
+ * Unit tests for the Eytzinger class
+ ***********************************************/
+class TestEytzinger : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_freeze_empty();
+      test_freeze_standard();
+      test_freeze_uneven();
+
+      // Access
+      test_find_standardHit();
+      test_find_standardMissing();
+      test_lowerBound_standard();
+      test_upperBound_duplicates();
+      test_lowerBound_random();
+
+      // Iterator
+      test_iterator_increment_standard();
+      test_iterator_decrement_standard();
+
+      report("Eytzinger");
+   }
+
+   /***************************************
+    * FREEZE
+    *    BST::freeze()
+    ***************************************/
+
+   // freeze an empty tree
+   void test_freeze_empty()
+   {  // setup
+      custom::BST<Spy> bst;
+      Spy::reset();
+      // exercise
+      custom::Eytzinger<Spy> frozen = bst.freeze();
+      // verify
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(frozen.empty());
+      assertUnit(frozen.size() == 0);
+      assertUnit(frozen.begin() == frozen.end());
+   }  // teardown
+
+   // freeze the standard fixture: the array is the breadth-first order
+   void test_freeze_standard()
+   {  // setup
+      //                 50
+      //          +-------+-------+
+      //         30              70
+      //     +----+----+     +----+----+
+      //    20        40    60        80
+      custom::BST<Spy> bst;
+      setupStandardFixture(bst);
+      Spy::reset();
+      // exercise
+      custom::Eytzinger<Spy> frozen = bst.freeze();
+      // verify
+      assertUnit(Spy::numLessthan() == 0);  // the tree is already sorted
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numAssign() == 7);    // assign [50][30][70][20][40][60][80]
+      assertUnit(frozen.size() == 7);
+      int expected[] = { 50, 30, 70, 20, 40, 60, 80 };
+      for (size_t i = 0; i < 7 && i < frozen.keys.size(); i++)
+         assertUnit(frozen.keys[i].get() == expected[i]);
+   }  // teardown
+
+   // a size that does not fill the bottom level
+   void test_freeze_uneven()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 1; i <= 10; i++)
+         bst.insert(i * 10);
+      // exercise
+      custom::Eytzinger<int> frozen = bst.freeze();
+      // verify
+      //                    70
+      //            +--------+--------+
+      //           40                 90
+      //       +----+----+        +----+----+
+      //      20        60       80        100
+      //    +--+--+   +--+
+      //   10    30  50
+      assertUnit(frozen.size() == 10);
+      int expected[] = { 70, 40, 90, 20, 60, 80, 100, 10, 30, 50 };
+      for (size_t i = 0; i < 10 && i < frozen.keys.size(); i++)
+         assertUnit(frozen.keys[i] == expected[i]);
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    *    Eytzinger::find()
+    *    Eytzinger::lower_bound()
+    *    Eytzinger::upper_bound()
+    ***************************************/
+
+   // find something that is there
+   void test_find_standardHit()
+   {  // setup
+      custom::Eytzinger<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.find(60);
+      // verify
+      assertUnit(it != frozen.end());
+      if (it != frozen.end())
+         assertUnit(*it == 60);
+   }  // teardown
+
+   // find something that is not there
+   void test_find_standardMissing()
+   {  // setup
+      custom::Eytzinger<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.find(65);
+      // verify
+      assertUnit(it == frozen.end());
+   }  // teardown
+
+   // lower bound between, before, and after the keys
+   void test_lowerBound_standard()
+   {  // setup
+      custom::Eytzinger<int> frozen = standardFrozen();
+      // exercise
+      auto itBetween = frozen.lower_bound(45);
+      auto itBefore  = frozen.lower_bound(5);
+      auto itAfter   = frozen.lower_bound(85);
+      auto itExact   = frozen.lower_bound(80);
+      // verify
+      assertUnit(itBetween != frozen.end() && *itBetween == 50);
+      assertUnit(itBefore  != frozen.end() && *itBefore  == 20);
+      assertUnit(itAfter   == frozen.end());
+      assertUnit(itExact   != frozen.end() && *itExact   == 80);
+   }  // teardown
+
+   // upper bound skips every duplicate
+   void test_upperBound_duplicates()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i : { 10, 20, 20, 20, 30 })
+         bst.insert(i);
+      custom::Eytzinger<int> frozen = bst.freeze();
+      // exercise
+      auto itLower = frozen.lower_bound(20);
+      auto itUpper = frozen.upper_bound(20);
+      // verify
+      int count = 0;
+      for (auto it = itLower; it != itUpper; ++it, ++count)
+         assertUnit(*it == 20);
+      assertUnit(count == 3);
+      assertUnit(itUpper != frozen.end() && *itUpper == 30);
+   }  // teardown
+
+   // lower bound agrees with std::set over many sizes
+   void test_lowerBound_random()
+   {  // setup
+      unsigned int seed = 12345;
+      for (int num = 0; num < 70; num++)
+      {
+         custom::BST<int> bst;
+         std::set<int> expected;
+         for (int i = 0; i < num; i++)
+         {
+            seed = seed * 1103515245 + 12345;
+            int value = (int)((seed >> 8) % 200) * 2;
+            if (bst.insert(value, true /*keepUnique*/).second)
+               expected.insert(value);
+         }
+         // exercise
+         custom::Eytzinger<int> frozen = bst.freeze();
+         // verify
+         assertUnit(frozen.size() == expected.size());
+         for (int probe = -1; probe <= 401; probe++)
+         {
+            auto itExpected = expected.lower_bound(probe);
+            auto it = frozen.lower_bound(probe);
+            if (itExpected == expected.end())
+               assertUnit(it == frozen.end());
+            else
+               assertUnit(it != frozen.end() && *it == *itExpected);
+         }
+      }
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    *    Eytzinger::iterator::operator++()
+    *    Eytzinger::iterator::operator--()
+    ***************************************/
+
+   // walk forward in order
+   void test_iterator_increment_standard()
+   {  // setup
+      custom::Eytzinger<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.begin();
+      // verify
+      for (int i : { 20, 30, 40, 50, 60, 70, 80 })
+      {
+         assertUnit(it != frozen.end());
+         if (it != frozen.end())
+            assertUnit(*it++ == i);
+      }
+      assertUnit(it == frozen.end());
+   }  // teardown
+
+   // walk backward in order starting from the end
+   void test_iterator_decrement_standard()
+   {  // setup
+      custom::Eytzinger<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.end();
+      // verify
+      for (int i : { 80, 70, 60, 50, 40, 30, 20 })
+      {
+         --it;
+         assertUnit(it != frozen.end());
+         if (it != frozen.end())
+            assertUnit(*it == i);
+      }
+      --it;
+      assertUnit(it == frozen.end());
+   }  // teardown
+
+   /**************************************************************
+    * STANDARD FROZEN
+    *                 50
+    *          +-------+-------+
+    *         30              70
+    *     +----+----+     +----+----+
+    *    20        40    60        80
+    *************************************************************/
+   custom::Eytzinger<int> standardFrozen()
+   {
+      custom::BST<int> bst;
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         bst.insert(i);
+      return bst.freeze();
+   }
+
+   /**************************************************************
+    * SETUP STANDARD FIXTURE
+    * Same shape as TestBST's fixture, built through insert()
+    *************************************************************/
+   void setupStandardFixture(custom::BST<Spy>& bst)
+   {
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         bst.insert(Spy(i));
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,362 @@
+/***********************************************************************
+ * Header:
+ *    TEST LSM
+ * Summary:
+ *    Unit tests for the log-structured merge index
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "lsm.h"        // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <chrono>       // for std::chrono::milliseconds
+#include <shared_mutex> // for std::shared_lock
+#include <thread>       // for std::thread and std::this_thread
+#include <vector>
+
+/***********************************************
+ * TEST LSM
+ * Unit tests for the LsmBST class
+ ***********************************************/
+class TestLsm : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Write and look up
+      test_contains_memtable();
+      test_write_inPlace();
+      test_insert_freezes();
+      test_erase_hidesOlder();
+      test_insert_afterErase();
+      test_bloom_noFalseNo();
+
+      // Scan
+      test_scan_newestWins();
+      test_scan_lowerBound();
+      test_scan_snapshot();
+
+      // Compaction
+      test_compact_dropsTombstones();
+      test_compact_inline();
+      test_compact_tiered();
+      test_compact_keepsTombstones();
+      test_compact_background();
+      test_threads_writeAndRead();
+
+      report("Lsm");
+   }
+
+   /***************************************
+    * WRITE AND LOOK UP
+    ***************************************/
+
+   // keys still in the memtable
+   void test_contains_memtable()
+   {  // setup
+      custom::LsmBST<int> index(100, 4, false);
+      // exercise
+      index.insert(5);
+      index.insert(3);
+      // verify
+      assertUnit(index.contains(5));
+      assertUnit(index.contains(3));
+      assertUnit(!index.contains(4));
+      assertUnit(index.numRuns() == 0);
+   }  // teardown
+
+   // a second write to a key in the memtable overwrites the first
+   void test_write_inPlace()
+   {  // setup
+      custom::LsmBST<int> index(100, 4, false);
+      index.insert(5);
+      // exercise
+      index.erase(5);
+      // verify
+      assertUnit(index.memtable.size() == 1);
+      assertUnit(!index.contains(5));
+      index.insert(5);
+      assertUnit(index.memtable.size() == 1);
+      assertUnit(index.contains(5));
+   }  // teardown
+
+   // a full memtable becomes a run, and its keys are still found
+   void test_insert_freezes()
+   {  // setup
+      custom::LsmBST<int> index(10, 4, false);
+      // exercise
+      for (int i = 0; i < 25; i++)
+         index.insert(i);
+      // verify
+      assertUnit(index.numRuns() == 2);
+      assertUnit(index.memtable.size() == 5);
+      assertUnit(index.runs[0]->entries.size() == 10);
+      bool all = true;
+      for (int i = 0; i < 25; i++)
+         all = all && index.contains(i);
+      assertUnit(all);
+      assertUnit(!index.contains(25));
+   }  // teardown
+
+   // a tombstone hides the key in an older run
+   void test_erase_hidesOlder()
+   {  // setup
+      custom::LsmBST<int> index(10, 4, false);
+      for (int i = 0; i < 10; i++)
+         index.insert(i);
+      // exercise
+      index.erase(5);
+      // verify
+      assertUnit(index.numRuns() == 1);
+      assertUnit(index.runs[0]->find(5) != nullptr);
+      assertUnit(!index.contains(5));
+      index.flush();
+      assertUnit(index.numRuns() == 2);
+      assertUnit(!index.contains(5));
+      assertUnit(index.contains(6));
+   }  // teardown
+
+   // the newest word on a key wins
+   void test_insert_afterErase()
+   {  // setup
+      custom::LsmBST<int> index(10, 4, false);
+      index.insert(7);
+      index.flush();
+      index.erase(7);
+      index.flush();
+      // exercise
+      index.insert(7);
+      // verify
+      assertUnit(index.contains(7));
+      index.flush();
+      assertUnit(index.contains(7));
+      assertUnit(index.numRuns() == 3);
+   }  // teardown
+
+   // a key that was added is always there; most that were not are not
+   void test_bloom_noFalseNo()
+   {  // setup
+      custom::lsm::BloomFilter bloom(1000);
+      std::hash<int> hash;
+      // exercise
+      for (int i = 0; i < 1000; i++)
+         bloom.add(hash(i * 2));
+      // verify
+      bool all = true;
+      for (int i = 0; i < 1000; i++)
+         all = all && bloom.mayContain(hash(i * 2));
+      int numFalseYes = 0;
+      for (int i = 0; i < 10000; i++)
+         numFalseYes += bloom.mayContain(hash(i * 2 + 1)) ? 1 : 0;
+      assertUnit(all);
+      assertUnit(numFalseYes < 300);   // about 1%
+   }  // teardown
+
+   /***************************************
+    * SCAN
+    ***************************************/
+
+   // every live key once, in order, across the memtable and runs
+   void test_scan_newestWins()
+   {  // setup
+      custom::LsmBST<int> index(4, 10, false);
+      for (int i : { 8, 2, 6, 4 })          // run 0
+         index.insert(i);
+      for (int i : { 1, 3, 5, 7 })          // run 1
+         index.insert(i);
+      index.erase(2);                        // memtable
+      index.erase(7);
+      index.insert(4);
+      // exercise
+      std::vector<int> v(index.begin(), index.end());
+      // verify
+      assertUnit(v == std::vector<int>({ 1, 3, 4, 5, 6, 8 }));
+   }  // teardown
+
+   // start from the first key not less than the one asked for
+   void test_scan_lowerBound()
+   {  // setup
+      custom::LsmBST<int> index(4, 10, false);
+      for (int i = 0; i < 20; i += 2)
+         index.insert(i);
+      index.erase(10);
+      // exercise
+      std::vector<int> v(index.lower_bound(7), index.end());
+      // verify
+      assertUnit(v == std::vector<int>({ 8, 12, 14, 16, 18 }));
+      assertUnit(index.lower_bound(100) == index.end());
+   }  // teardown
+
+   // writes after the iterator was made do not show up in it
+   void test_scan_snapshot()
+   {  // setup
+      custom::LsmBST<int> index(4, 1, false);
+      for (int i = 0; i < 6; i++)
+         index.insert(i);
+      custom::LsmBST<int>::iterator it = index.begin();
+      // exercise
+      for (int i = 6; i < 20; i++)
+         index.insert(i);
+      index.erase(3);
+      index.compact();
+      // verify
+      assertUnit(std::vector<int>(it, index.end()) == std::vector<int>({ 0, 1, 2, 3, 4, 5 }));
+   }  // teardown
+
+   /***************************************
+    * COMPACTION
+    ***************************************/
+
+   // merging every run leaves one run of live keys
+   void test_compact_dropsTombstones()
+   {  // setup
+      custom::LsmBST<int> index(5, 10, false);
+      for (int i = 0; i < 10; i++)
+         index.insert(i);
+      for (int i = 0; i < 5; i++)
+         index.erase(i * 2);
+      assertUnit(index.numRuns() == 3);
+      // exercise
+      index.compact();
+      // verify
+      assertUnit(index.numRuns() == 1);
+      assertUnit(index.runs[0]->entries.size() == 5);
+      assertUnit(index.numCompactions == 1);
+      assertUnit(std::vector<int>(index.begin(), index.end()) == std::vector<int>({ 1, 3, 5, 7, 9 }));
+      assertUnit(!index.contains(4));
+      assertUnit(index.contains(5));
+   }  // teardown
+
+   // without a background thread, the writer that makes one run too many compacts
+   void test_compact_inline()
+   {  // setup
+      custom::LsmBST<int> index(10, 3, false);
+      // exercise
+      for (int i = 0; i < 40; i++)
+         index.insert(i);
+      // verify
+      assertUnit(index.numCompactions == 1);
+      assertUnit(index.numRuns() == 1);
+      assertUnit(index.runs[0]->entries.size() == 40);
+   }  // teardown
+
+   // runs are merged a tier at a time, so each key is merged once a tier
+   void test_compact_tiered()
+   {  // setup
+      custom::LsmBST<int> index(10, 2, false);
+      const int n = 10 * 3 * 3 * 3 * 3 * 3;   // fills tier 5 exactly
+      // exercise
+      for (int i = 0; i < n; i++)
+         index.insert((i * 7919) % n);
+      // verify
+      assertUnit(index.numRuns() == 1);
+      assertUnit(index.runs[0]->tier == 5);
+      assertUnit(index.runs[0]->entries.size() == size_t(n));
+      assertUnit(index.numMerged == 5 * size_t(n));
+      assertUnit(index.numCompactions == 81 + 27 + 9 + 3 + 1);
+      bool all = true;
+      for (int i = 0; i < n; i += 97)
+         all = all && index.contains(i);
+      assertUnit(all);
+   }  // teardown
+
+   // a merge of newer runs keeps a tombstone for the key in an older one
+   void test_compact_keepsTombstones()
+   {  // setup
+      custom::LsmBST<int> index(2, 2, false);
+      for (int i = 0; i < 6; i++)           // three runs, merged into one of tier 1
+         index.insert(i);
+      assertUnit(index.numRuns() == 1);
+      // exercise
+      index.erase(0);
+      for (int i = 6; i < 11; i++)          // three more, merged after it
+         index.insert(i);
+      // verify
+      assertUnit(index.numRuns() == 2);
+      assertUnit(index.runs[0]->tier == 1);
+      assertUnit(index.runs[1]->tier == 1);
+      const custom::lsm::Entry<int>* pEntry = index.runs[1]->find(0);
+      assertUnit(pEntry != nullptr && pEntry->erased);
+      assertUnit(!index.contains(0));
+      assertUnit(index.contains(1));
+      index.compact();
+      assertUnit(index.numRuns() == 1);
+      assertUnit(index.runs[0]->find(0) == nullptr);
+      assertUnit(std::vector<int>(index.begin(), index.end()).size() == 10);
+   }  // teardown
+
+   // the compactor thread keeps every tier down
+   void test_compact_background()
+   {  // setup
+      custom::LsmBST<int> index(16, 2);
+      // exercise
+      for (int i = 0; i < 1000; i++)
+         index.insert((i * 37) % 1000);
+      for (int i = 0; i < 100 && crowded(index); i++)
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      // verify
+      assertUnit(!crowded(index));
+      std::vector<int> v(index.begin(), index.end());
+      assertUnit(v.size() == 1000);
+      assertUnit(v.front() == 0 && v.back() == 999);
+   }  // teardown
+
+   // writers and readers together, with compactions under them
+   void test_threads_writeAndRead()
+   {  // setup
+      custom::LsmBST<int> index(32, 2);
+      std::vector<std::thread> threads;
+      bool sorted = true;
+      // exercise
+      for (int iThread = 0; iThread < 2; iThread++)
+         threads.emplace_back([&index, iThread]()
+            {
+               for (int i = 0; i < 500; i++)
+                  index.insert(iThread * 500 + i);
+               for (int i = 0; i < 500; i += 2)
+                  index.erase(iThread * 500 + i);
+            });
+      threads.emplace_back([&index, &sorted]()
+         {
+            for (int i = 0; i < 20; i++)
+            {
+               std::vector<int> v(index.begin(), index.end());
+               for (size_t j = 1; j < v.size(); j++)
+                  sorted = sorted && v[j - 1] < v[j];
+               index.contains(i);
+            }
+         });
+      for (std::thread& thread : threads)
+         thread.join();
+      // verify
+      std::vector<int> v(index.begin(), index.end());
+      assertUnit(sorted);
+      assertUnit(v.size() == 500);
+      bool odd = true;
+      for (int i : v)
+         odd = odd && i % 2 == 1;
+      assertUnit(odd);
+   }  // teardown
+
+   /**************************************************************
+    * HELPERS
+    *************************************************************/
+
+   // does some tier hold more runs than it should
+   static bool crowded(custom::LsmBST<int>& index)
+   {
+      std::shared_lock<std::shared_mutex> lock(index.mutex);
+      size_t iFirst;
+      size_t iLast;
+      return index.crowded(iFirst, iLast);
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,185 @@
+/***********************************************************************
+ * Header:
+ *    TEST MAPPED
+ * Summary:
+ *    Unit tests for the tree in a memory-mapped file
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "mapped.h"     // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <algorithm>    // for std::lower_bound and std::upper_bound
+#include <cstdio>       // for std::remove
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST MAPPED
+ * Unit tests for the MappedBST class
+ ***********************************************/
+class TestMapped : public UnitTest
+{
+   const std::string path = "testMapped.tmp";
+
+public:
+   void run()
+   {
+      reset();
+
+      // Files
+      test_open_missing();
+      test_open_wrongType();
+      test_write_outOfOrder();
+      test_write_empty();
+      test_move_keepsMapping();
+
+      // Access
+      test_roundTrip_standard();
+      test_find_standard();
+      test_bounds_acrossPages();
+
+      std::remove(path.c_str());
+      report("Mapped");
+   }
+
+   /***************************************
+    * FILES
+    ***************************************/
+
+   // no file, nothing open
+   void test_open_missing()
+   {  // setup
+      custom::MappedBST<int> tree;
+      // exercise
+      bool opened = tree.open("testMapped.missing");
+      // verify
+      assertUnit(!opened);
+      assertUnit(!tree.isOpen());
+      assertUnit(tree.empty());
+   }  // teardown
+
+   // written for ints, opened for doubles
+   void test_open_wrongType()
+   {  // setup
+      custom::BST<int> bst{ 1, 2, 3 };
+      custom::MappedBST<int>::write(bst, path);
+      custom::MappedBST<double> tree;
+      // exercise
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(!opened);
+      assertUnit(!tree.isOpen());
+   }  // teardown
+
+   // unsorted keys are refused
+   void test_write_outOfOrder()
+   {  // setup
+      std::vector<int> keys;
+      for (int i = 0; i < 3000; i++)
+         keys.push_back(i);
+      keys[2000] = 5;               // in a later page than 5 belongs
+      // exercise
+      bool written = custom::MappedBST<int>::write(keys.begin(), keys.end(), path);
+      // verify
+      assertUnit(!written);
+   }  // teardown
+
+   // an empty tree makes a file with only a header
+   void test_write_empty()
+   {  // setup
+      custom::BST<int> bst;
+      custom::MappedBST<int> tree;
+      // exercise
+      bool written = custom::MappedBST<int>::write(bst, path);
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(written);
+      assertUnit(opened);
+      assertUnit(tree.empty());
+      assertUnit(tree.begin() == tree.end());
+      assertUnit(tree.find(3) == tree.end());
+      assertUnit(tree.lower_bound(3) == tree.end());
+   }  // teardown
+
+   // moving hands over the mapping
+   void test_move_keepsMapping()
+   {  // setup
+      custom::BST<int> bst{ 4, 5, 6 };
+      custom::MappedBST<int>::write(bst, path);
+      custom::MappedBST<int> src;
+      src.open(path);
+      // exercise
+      custom::MappedBST<int> dest(std::move(src));
+      // verify
+      assertUnit(!src.isOpen());
+      assertUnit(dest.isOpen());
+      assertUnit(dest.size() == 3);
+      assertUnit(*dest.find(5) == 5);
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   // iterating the file gives the tree's elements in order
+   void test_roundTrip_standard()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      custom::MappedBST<int> tree;
+      // exercise
+      custom::MappedBST<int>::write(bst, path);
+      bool opened = tree.open(path);
+      // verify
+      assertUnit(opened);
+      assertUnit(tree.size() == 7);
+      assertUnit(std::vector<int>(tree.begin(), tree.end()) ==
+                 std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(tree.numPages == 1);
+   }  // teardown
+
+   // hit and miss
+   void test_find_standard()
+   {  // setup
+      custom::BST<int> bst{ 50, 30, 70, 20, 40, 60, 80 };
+      custom::MappedBST<int>::write(bst, path);
+      custom::MappedBST<int> tree;
+      tree.open(path);
+      // exercise and verify
+      assertUnit(tree.find(60) != tree.end() && *tree.find(60) == 60);
+      assertUnit(tree.find(20) == tree.begin());
+      assertUnit(tree.find(45) == tree.end());
+      assertUnit(tree.find(99) == tree.end());
+      assertUnit(tree.find(1) == tree.end());
+   }  // teardown
+
+   // runs of repeats that straddle page boundaries bound the same as std
+   void test_bounds_acrossPages()
+   {  // setup
+      std::vector<int> keys;
+      for (int i = 0; i < 10000; i++)
+         keys.push_back(i / 7 * 2);   // 7 of each even number
+      custom::MappedBST<int>::write(keys.begin(), keys.end(), path);
+      custom::MappedBST<int> tree;
+      tree.open(path);
+      bool same = true;
+      // exercise
+      for (int t = -2; t < 2900 && same; t++)
+      {
+         size_t iLower = std::lower_bound(keys.begin(), keys.end(), t) - keys.begin();
+         size_t iUpper = std::upper_bound(keys.begin(), keys.end(), t) - keys.begin();
+         same = (size_t)(tree.lower_bound(t) - tree.begin()) == iLower &&
+                (size_t)(tree.upper_bound(t) - tree.begin()) == iUpper;
+      }
+      // verify
+      assertUnit(same);
+      assertUnit(tree.numPages == (10000 + 1023) / 1024);
+   }  // teardown
+};
+
+#endif // DEBUG
@@ -0,0 +1,225 @@
+/***********************************************************************
+ * Header:
+ *    TEST MERGE
+ * Summary:
+ *    Unit tests for the ordered scan across several trees
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "merge.h"      // class under test
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // for counting comparisons
+
+#include <vector>
+
+/***********************************************
+ * TEST MERGE
+ * Unit tests for the MergeIterator class
+ ***********************************************/
+class TestMerge : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Scan
+      test_scan_noTrees();
+      test_scan_emptyTrees();
+      test_scan_interleaved();
+      test_scan_duplicatesKept();
+      test_scan_unique();
+      test_scan_ranges();
+      test_scan_comparisons();
+
+      // Seek
+      test_seek_forward();
+      test_seek_behind();
+      test_seek_pastEnd();
+      test_seek_rangeEnd();
+      test_seek_unique();
+
+      report("Merge");
+   }
+
+   /***************************************
+    * SCAN
+    ***************************************/
+
+   // nothing to merge is already the end
+   void test_scan_noTrees()
+   {  // setup
+      // exercise
+      custom::MergeIterator<int> it(std::vector<custom::MergeIterator<int>::Range>{});
+      // verify
+      assertUnit(it.done());
+      assertUnit(it == custom::MergeIterator<int>());
+   }  // teardown
+
+   // trees with nothing in them
+   void test_scan_emptyTrees()
+   {  // setup
+      custom::BST<int> a;
+      custom::BST<int> b;
+      // exercise
+      custom::MergeIterator<int> it({ a, b });
+      // verify
+      assertUnit(it.done());
+      assertUnit(it == custom::MergeIterator<int>());
+   }  // teardown
+
+   // every element of every tree, in order
+   void test_scan_interleaved()
+   {  // setup
+      custom::BST<int> a{ 1, 4, 7, 10 };
+      custom::BST<int> b{ 2, 5, 8 };
+      custom::BST<int> c{ 3, 6, 9, 11, 12 };
+      custom::BST<int> d;
+      // exercise
+      std::vector<int> v = scan(custom::MergeIterator<int>({ a, b, c, d }));
+      // verify
+      assertUnit(v == std::vector<int>({ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 }));
+   }  // teardown
+
+   // repeats within and across trees all come out
+   void test_scan_duplicatesKept()
+   {  // setup
+      custom::BST<int> a{ 1, 3, 3 };
+      custom::BST<int> b{ 3, 5 };
+      // exercise
+      std::vector<int> v = scan(custom::MergeIterator<int>({ a, b }));
+      // verify
+      assertUnit(v == std::vector<int>({ 1, 3, 3, 3, 5 }));
+   }  // teardown
+
+   // with unique, each value once
+   void test_scan_unique()
+   {  // setup
+      custom::BST<int> a{ 1, 3, 3, 8 };
+      custom::BST<int> b{ 3, 5, 8 };
+      custom::BST<int> c{ 1, 8, 8, 9 };
+      // exercise
+      std::vector<int> v = scan(custom::MergeIterator<int>({ a, b, c }, true));
+      // verify
+      assertUnit(v == std::vector<int>({ 1, 3, 5, 8, 9 }));
+   }  // teardown
+
+   // part of a tree is a source too
+   void test_scan_ranges()
+   {  // setup
+      custom::BST<int> a{ 1, 2, 3, 4, 5, 6 };
+      custom::BST<int> b{ 10, 20, 30 };
+      // exercise
+      std::vector<int> v = scan(custom::MergeIterator<int>(
+         { { a, a.lower_bound(3), a.lower_bound(6) }, b }));
+      // verify
+      assertUnit(v == std::vector<int>({ 3, 4, 5, 10, 20, 30 }));
+   }  // teardown
+
+   // each step replays one path: ceil(log2 k) comparisons, not k
+   void test_scan_comparisons()
+   {  // setup
+      std::vector<custom::BST<Spy>> trees(8);
+      for (int i = 0; i < 800; i++)
+         trees[i % 8].insert(Spy(i));
+      std::vector<custom::MergeIterator<Spy>::Range> ranges;
+      for (const custom::BST<Spy>& tree : trees)
+         ranges.push_back(tree);
+      Spy::reset();
+      // exercise
+      custom::MergeIterator<Spy> it(ranges);
+      int count = 0;
+      bool inOrder = true;
+      for (int expect = 0; !it.done(); ++it, ++expect, ++count)
+         inOrder = inOrder && (*it).get() == expect;
+      // verify
+      assertUnit(count == 800);
+      assertUnit(inOrder);
+      assertUnit(Spy::numLessthan() <= 7 + 800 * 3);
+   }  // teardown
+
+   /***************************************
+    * SEEK
+    ***************************************/
+
+   // jump to the first element not less than the key
+   void test_seek_forward()
+   {  // setup
+      custom::BST<int> a{ 1, 4, 7, 10 };
+      custom::BST<int> b{ 2, 5, 8 };
+      custom::MergeIterator<int> it({ a, b });
+      // exercise
+      it.seek(6);
+      // verify
+      assertUnit(scan(it) == std::vector<int>({ 7, 8, 10 }));
+   }  // teardown
+
+   // a key behind us does not move us back
+   void test_seek_behind()
+   {  // setup
+      custom::BST<int> a{ 1, 4, 7 };
+      custom::BST<int> b{ 2, 5, 8 };
+      custom::MergeIterator<int> it({ a, b });
+      ++it;
+      ++it;
+      ++it;
+      // exercise
+      it.seek(2);
+      // verify
+      assertUnit(*it == 5);
+      assertUnit(scan(it) == std::vector<int>({ 5, 7, 8 }));
+   }  // teardown
+
+   // past the last element is the end
+   void test_seek_pastEnd()
+   {  // setup
+      custom::BST<int> a{ 1, 4, 7 };
+      custom::BST<int> b{ 2, 5, 8 };
+      custom::MergeIterator<int> it({ a, b });
+      // exercise
+      it.seek(100);
+      // verify
+      assertUnit(it.done());
+      assertUnit(it == custom::MergeIterator<int>());
+   }  // teardown
+
+   // a range stays within its end when seeking past it
+   void test_seek_rangeEnd()
+   {  // setup
+      custom::BST<int> a{ 1, 2, 3, 4, 5, 6 };
+      custom::BST<int> b{ 1, 10 };
+      custom::MergeIterator<int> it({ { a, a.begin(), a.lower_bound(4) }, b });
+      // exercise
+      it.seek(3);
+      // verify
+      assertUnit(scan(it) == std::vector<int>({ 3, 10 }));
+   }  // teardown
+
+   // seeking onto repeats still gives each value once
+   void test_seek_unique()
+   {  // setup
+      custom::BST<int> a{ 1, 5, 5, 9 };
+      custom::BST<int> b{ 2, 5, 9 };
+      custom::MergeIterator<int> it({ a, b }, true);
+      // exercise
+      it.seek(4);
+      // verify
+      assertUnit(scan(it) == std::vector<int>({ 5, 9 }));
+   }  // teardown
+
+   /**************************************************************
+    * HELPERS
+    *************************************************************/
+
+   static std::vector<int> scan(custom::MergeIterator<int> it)
+   {
+      return std::vector<int>(it, custom::MergeIterator<int>());
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,335 @@
+/***********************************************************************
+ * Header:
+ *    TEST OPTIMISTIC
+ * Summary:
+ *    Unit tests for the tree with per-node locks and versions
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "optimistic.h" // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <atomic>       // for std::atomic
+#include <set>          // for std::set to compare against
+#include <thread>       // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST OPTIMISTIC
+ * Unit tests for the OptimisticBST class
+ ***********************************************/
+class TestOptimistic : public UnitTest
+{
+   typedef custom::concurrent::OptimisticBST<int> Tree;
+
+   // counts how many are alive, to see when unlinked nodes are deleted
+   struct Counted
+   {
+      Counted(int value = 0) : value(value) { numAlive++; }
+      Counted(const Counted& rhs) : value(rhs.value) { numAlive++; }
+      ~Counted() { numAlive--; }
+      bool operator < (const Counted& rhs) const { return value < rhs.value; }
+      int value;
+      static inline std::atomic<int> numAlive{ 0 };
+   };
+
+public:
+   void run()
+   {
+      reset();
+
+      // Read
+      test_find_empty();
+      test_find_standard();
+
+      // Write
+      test_insert_duplicate();
+      test_insert_ascending();
+      test_erase_leaf();
+      test_erase_twoChildren_routing();
+      test_insert_revivesRouting();
+      test_clear_freesNodes();
+      test_random_againstSet();
+
+      // Threads
+      test_threads_writers();
+      test_threads_readersSeeStableKeys();
+
+      report("Optimistic");
+   }
+
+   /***************************************
+    * READ
+    ***************************************/
+
+   // nothing to find in an empty tree
+   void test_find_empty()
+   {  // setup
+      Tree tree;
+      // exercise and verify
+      assertUnit(!tree.find(5).has_value());
+      assertUnit(tree.empty());
+      assertUnit(tree.size() == 0);
+   }  // teardown
+
+   // hit and miss
+   void test_find_standard()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      // exercise
+      std::optional<int> hit  = tree.find(40);
+      std::optional<int> miss = tree.find(45);
+      // verify
+      assertUnit(hit.has_value() && *hit == 40);
+      assertUnit(!miss.has_value());
+      assertUnit(tree.contains(80));
+      assertUnit(isAVL(tree));
+   }  // teardown
+
+   /***************************************
+    * WRITE
+    ***************************************/
+
+   // a set: the second insert of a key is turned away
+   void test_insert_duplicate()
+   {  // setup
+      Tree tree;
+      // exercise and verify
+      assertUnit(tree.insert(7));
+      assertUnit(!tree.insert(7));
+      assertUnit(tree.size() == 1);
+   }  // teardown
+
+   // sorted input is rotated into an AVL tree
+   void test_insert_ascending()
+   {  // setup
+      Tree tree;
+      // exercise
+      for (int i = 0; i < 1000; i++)
+         tree.insert(i);
+      // verify
+      assertUnit(tree.size() == 1000);
+      assertUnit(isAVL(tree));
+      assertUnit(tree.holder.pRight.load()->height.load() <= 15);
+   }  // teardown
+
+   // a leaf is unlinked at once
+   void test_erase_leaf()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      // exercise
+      bool erased = tree.erase(20);
+      bool again  = tree.erase(20);
+      // verify
+      assertUnit(erased);
+      assertUnit(!again);
+      assertUnit(tree.snapshot() == std::vector<int>({ 30, 40, 50, 60, 70, 80 }));
+      assertUnit(countNodes(tree.holder.pRight.load()) == 6);
+      assertUnit(isAVL(tree));
+   }  // teardown
+
+   // a node with two children stays as a routing node
+   void test_erase_twoChildren_routing()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      // exercise
+      bool erased = tree.erase(30);
+      // verify
+      assertUnit(erased);
+      assertUnit(!tree.contains(30));
+      assertUnit(countNodes(tree.holder.pRight.load()) == 7);
+      assertUnit(tree.snapshot() == std::vector<int>({ 20, 40, 50, 60, 70, 80 }));
+      // once it is down to one child it goes too
+      tree.erase(20);
+      assertUnit(countNodes(tree.holder.pRight.load()) == 5);
+      assertUnit(isAVL(tree));
+   }  // teardown
+
+   // inserting the key of a routing node makes it present again
+   void test_insert_revivesRouting()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      tree.erase(50);
+      // exercise
+      bool inserted = tree.insert(50);
+      // verify
+      assertUnit(inserted);
+      assertUnit(countNodes(tree.holder.pRight.load()) == 7);
+      assertUnit(tree.snapshot() == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+   }  // teardown
+
+   // clear empties the tree, and every node is freed by the end
+   void test_clear_freesNodes()
+   {  // setup
+      Counted::numAlive = 0;
+      {
+         custom::concurrent::OptimisticBST<Counted> tree;
+         for (int i = 0; i < 200; i++)
+            tree.insert(Counted(i));
+         // exercise
+         tree.clear();
+         // verify
+         assertUnit(tree.empty());
+         assertUnit(tree.holder.pRight.load() == nullptr);
+         assertUnit(Counted::numAlive <= (int)tree.retired.size());
+      }
+      assertUnit(Counted::numAlive == 0);
+   }  // teardown
+
+   // a long mix of inserts and erases agrees with std::set
+   void test_random_againstSet()
+   {  // setup
+      Tree tree;
+      std::set<int> expected;
+      unsigned int seed = 17;
+      bool valid = true;
+      // exercise
+      for (int i = 0; i < 4000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         int value = (int)((seed >> 8) % 300);
+         if ((seed >> 20) % 2)
+            valid = valid && tree.insert(value) == expected.insert(value).second;
+         else
+            valid = valid && tree.erase(value) == (expected.erase(value) == 1);
+         if (i % 200 == 0)
+            valid = valid && isAVL(tree);
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(isAVL(tree));
+      assertUnit(tree.snapshot() == std::vector<int>(expected.begin(), expected.end()));
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // writers on several threads, inserting and erasing, lose nothing
+   void test_threads_writers()
+   {  // setup
+      Tree tree;
+      std::vector<std::thread> threads;
+      // exercise
+      for (int t = 0; t < 4; t++)
+         threads.emplace_back([&tree, t]()
+            {
+               for (int i = 0; i < 2000; i++)
+                  tree.insert(i * 4 + t);
+               for (int i = 0; i < 2000; i += 2)
+                  tree.erase(i * 4 + t);
+            });
+      for (std::thread& thread : threads)
+         thread.join();
+      // verify
+      std::vector<int> elements = tree.snapshot();
+      bool valid = elements.size() == 4000;
+      for (size_t i = 0; valid && i < elements.size(); i++)
+         valid = elements[i] == (int)((i / 4) * 8 + 4 + i % 4);
+      assertUnit(valid);
+      assertUnit(isAVL(tree));
+   }  // teardown
+
+   // keys no writer touches are always found, however the tree rotates
+   void test_threads_readersSeeStableKeys()
+   {  // setup
+      Tree tree;
+      for (int i = 0; i < 1000; i += 2)
+         tree.insert(i);           // the stable keys are even
+      std::atomic<bool> done(false);
+      std::atomic<int> numMissed(0);
+      // exercise
+      std::vector<std::thread> threads;
+      for (int r = 0; r < 2; r++)
+         threads.emplace_back([&, r]()
+            {
+               unsigned int seed = r + 1;
+               while (!done)
+               {
+                  seed = seed * 1103515245 + 12345;
+                  int key = (int)((seed >> 8) % 500) * 2;
+                  if (!tree.contains(key))
+                     numMissed++;
+               }
+            });
+      std::vector<std::thread> writers;
+      for (int w = 0; w < 2; w++)
+         writers.emplace_back([&, w]()
+            {
+               for (int round = 0; round < 10; round++)
+               {
+                  for (int i = 1 + 2 * w; i < 1000; i += 4)
+                     tree.insert(i);
+                  for (int i = 1 + 2 * w; i < 1000; i += 4)
+                     tree.erase(i);
+               }
+            });
+      for (std::thread& writer : writers)
+         writer.join();
+      done = true;
+      for (std::thread& thread : threads)
+         thread.join();
+      // verify
+      assertUnit(numMissed == 0);
+      assertUnit(tree.size() == 500);
+      assertUnit(isAVL(tree));
+   }  // teardown
+
+   /**************************************************************
+    * SETUP STANDARD FIXTURE
+    *************************************************************/
+   void setupStandardFixture(Tree& tree)
+   {
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         tree.insert(i);
+   }
+
+   template <class Node>
+   size_t countNodes(const Node* p)
+   {
+      if (!p)
+         return 0;
+      return 1 + countNodes(p->pLeft.load()) + countNodes(p->pRight.load());
+   }
+
+   // ordered, parents right, heights right, balanced, and no spent routing nodes
+   template <class T>
+   bool isAVL(const custom::concurrent::OptimisticBST<T>& tree)
+   {
+      auto* pRoot = tree.holder.pRight.load();
+      if (pRoot && pRoot->pParent.load() != &tree.holder)
+         return false;
+      return avlHeight(pRoot) >= 0;
+   }
+
+   template <class Node>
+   int avlHeight(const Node* p)
+   {
+      if (!p)
+         return 0;
+      const Node* pLeft  = p->pLeft.load();
+      const Node* pRight = p->pRight.load();
+      if ((pLeft && (pLeft->pParent.load() != p || !(pLeft->key < p->key))) ||
+          (pRight && (pRight->pParent.load() != p || !(p->key < pRight->key))))
+         return -1;
+      if (!p->isPresent.load() && (!pLeft || !pRight))
+         return -1;
+      int hLeft  = avlHeight(pLeft);
+      int hRight = avlHeight(pRight);
+      if (hLeft < 0 || hRight < 0 || hLeft - hRight > 1 || hRight - hLeft > 1)
+         return -1;
+      int h = 1 + (hLeft > hRight ? hLeft : hRight);
+      return h == p->height.load() ? h : -1;
+   }
+};
+
+#endif // DEBUG
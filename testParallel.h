@@ -0,0 +1,488 @@
+/***********************************************************************
+ * Header:
+ *    TEST PARALLEL
+ * Summary:
+ *    Unit tests for the fork-join pool, the parallel algorithms, and
+ *    the bulk build of a BST
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "parallel.h"   // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <algorithm>    // for std::stable_sort
+#include <atomic>       // for std::atomic
+#include <list>         // for input that is not random access
+#include <mutex>        // for std::mutex
+#include <stdexcept>    // for std::runtime_error
+#include <string>       // for an element that is emptied when moved from
+#include <utility>      // for std::pair
+#include <vector>
+
+/***********************************************
+ * TEST PARALLEL
+ * Unit tests for parallel.h
+ ***********************************************/
+class TestParallel : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Pool
+      test_invoke_runsBoth();
+      test_invoke_nested();
+      test_invoke_throws();
+      test_forRange_coversOnce();
+
+      // Algorithms
+      test_sort_matchesStable();
+      test_unique_standard();
+      test_unique_movedFrom();
+
+      // Build
+      test_build_empty();
+      test_build_sequenced();
+      test_build_parallel();
+      test_build_keepUnique();
+      test_build_keepUniqueStrings();
+      test_build_replaces();
+      test_build_fromList();
+
+      // Traverse
+      test_forEach_sequencedInOrder();
+      test_forEach_parallelOnce();
+      test_transformReduce_inOrder();
+      test_transformReduce_empty();
+      test_forEachChunk_offsets();
+      test_forEachChunk_balanced();
+
+      report("Parallel");
+   }
+
+   /***************************************
+    * POOL
+    ***************************************/
+
+   // both halves run before invoke returns
+   void test_invoke_runsBoth()
+   {  // setup
+      custom::parallel::Pool pool(3);
+      int a = 0;
+      int b = 0;
+      // exercise
+      pool.invoke([&]() { a = 1; }, [&]() { b = 2; });
+      // verify
+      assertUnit(a == 1);
+      assertUnit(b == 2);
+      assertUnit(pool.concurrency() == 4);
+   }  // teardown
+
+   // forks inside forks all finish, and nothing is left queued
+   void test_invoke_nested()
+   {  // setup
+      custom::parallel::Pool pool(3);
+      std::atomic<int> sum(0);
+      // exercise
+      sumRange(pool, 0, 1000, sum);
+      // verify
+      assertUnit(sum == 499500);
+      assertUnit(pool.numQueued == 0);
+   }  // teardown
+
+   // an exception from either half comes out of invoke
+   void test_invoke_throws()
+   {  // setup
+      custom::parallel::Pool pool(2);
+      bool caughtF = false;
+      bool caughtG = false;
+      // exercise
+      try
+      {
+         pool.invoke([]() { throw std::runtime_error("f"); }, []() {});
+      }
+      catch (const std::runtime_error&)
+      {
+         caughtF = true;
+      }
+      try
+      {
+         pool.invoke([]() {}, []() { throw std::runtime_error("g"); });
+      }
+      catch (const std::runtime_error&)
+      {
+         caughtG = true;
+      }
+      // verify
+      assertUnit(caughtF);
+      assertUnit(caughtG);
+      assertUnit(pool.numQueued == 0);
+   }  // teardown
+
+   // every index is visited exactly once
+   void test_forRange_coversOnce()
+   {  // setup
+      custom::parallel::Pool pool(3);
+      std::vector<int> visits(100000, 0);
+      // exercise
+      custom::parallel::forRange(0, visits.size(), [&](size_t begin, size_t end)
+         {
+            for (size_t i = begin; i < end; i++)
+               visits[i]++;
+         }, pool);
+      // verify
+      bool once = true;
+      for (int v : visits)
+         once = once && v == 1;
+      assertUnit(once);
+   }  // teardown
+
+   /***************************************
+    * ALGORITHMS
+    ***************************************/
+
+   // the same order as std::stable_sort, ties included
+   void test_sort_matchesStable()
+   {  // setup
+      custom::parallel::Pool pool(3);
+      std::vector<std::pair<int, int>> values;
+      unsigned int seed = 5;
+      for (int i = 0; i < 200000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         values.push_back({ (int)((seed >> 8) % 5000), i });
+      }
+      std::vector<std::pair<int, int>> expected = values;
+      auto byKey = [](const std::pair<int, int>& lhs, const std::pair<int, int>& rhs)
+      {
+         return lhs.first < rhs.first;
+      };
+      std::stable_sort(expected.begin(), expected.end(), byKey);
+      // exercise
+      custom::parallel::sort(values.data(), values.data() + values.size(), byKey, pool);
+      // verify
+      assertUnit(values == expected);
+   }  // teardown
+
+   // one of each, in order
+   void test_unique_standard()
+   {  // setup
+      custom::parallel::Pool pool(3);
+      std::vector<int> values;
+      for (int i = 0; i < 50000; i++)
+         for (int j = 0; j < 1 + i % 3; j++)
+            values.push_back(i);
+      std::vector<int> out(values.size());
+      // exercise
+      size_t num = custom::parallel::unique(values.data(), values.data() + values.size(), out.data(),
+                                            [](int lhs, int rhs) { return lhs < rhs; }, pool);
+      // verify
+      bool inOrder = num == 50000;
+      for (size_t i = 0; inOrder && i < num; i++)
+         inOrder = out[i] == (int)i;
+      assertUnit(inOrder);
+   }  // teardown
+
+   // a string left empty by a move must not be what the next one is compared to
+   void test_unique_movedFrom()
+   {  // setup
+      custom::parallel::Pool pool(3);
+      std::vector<std::string> values;
+      for (int i = 0; i < 20000; i++)
+         for (int j = 0; j < 1 + i % 3; j++)
+            values.push_back("key" + std::to_string(100000 + i));
+      std::vector<std::string> out(values.size());
+      // exercise
+      size_t num = custom::parallel::unique(values.data(), values.data() + values.size(), out.data(),
+                                            [](const std::string& lhs, const std::string& rhs) { return lhs < rhs; },
+                                            pool);
+      // verify
+      bool inOrder = num == 20000;
+      for (size_t i = 0; inOrder && i < num; i++)
+         inOrder = out[i] == "key" + std::to_string(100000 + i);
+      assertUnit(inOrder);
+   }  // teardown
+
+   /***************************************
+    * BUILD
+    ***************************************/
+
+   // nothing in, nothing built
+   void test_build_empty()
+   {  // setup
+      custom::BST<int> bst;
+      std::vector<int> values;
+      // exercise
+      bst.build(values.begin(), values.end(), custom::execution::par);
+      // verify
+      assertUnit(bst.empty());
+      assertUnit(bst.root == nullptr);
+   }  // teardown
+
+   // a small shuffled load, one thread
+   void test_build_sequenced()
+   {  // setup
+      custom::BST<int> bst;
+      std::vector<int> values = { 50, 20, 80, 30, 70, 40, 60, 20 };
+      // exercise
+      bst.build(values.begin(), values.end(), custom::execution::seq);
+      // verify
+      assertUnit(contents(bst) == std::vector<int>({ 20, 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(isValid(bst));
+   }  // teardown
+
+   // a load big enough to fork at every step
+   void test_build_parallel()
+   {  // setup
+      custom::BST<int> bst;
+      std::vector<int> values;
+      unsigned int seed = 11;
+      for (int i = 0; i < 300000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         values.push_back((int)(seed >> 4));
+      }
+      std::vector<int> expected = values;
+      std::sort(expected.begin(), expected.end());
+      // exercise
+      bst.build(values.begin(), values.end(), custom::execution::par);
+      // verify
+      assertUnit(bst.size() == 300000);
+      assertUnit(contents(bst) == expected);
+      assertUnit(isValid(bst));
+   }  // teardown
+
+   // keepUnique drops the repeats
+   void test_build_keepUnique()
+   {  // setup
+      custom::BST<int> bstSeq;
+      custom::BST<int> bstPar;
+      std::vector<int> values;
+      for (int i = 0; i < 100000; i++)
+         values.push_back((i * 7919) % 30000);
+      // exercise
+      bstSeq.build(values.begin(), values.end(), custom::execution::seq, true /*keepUnique*/);
+      bstPar.build(values.begin(), values.end(), custom::execution::par, true /*keepUnique*/);
+      // verify
+      assertUnit(bstSeq.size() == 30000);
+      assertUnit(bstPar.size() == 30000);
+      assertUnit(contents(bstPar) == contents(bstSeq));
+      assertUnit(isValid(bstPar));
+   }  // teardown
+
+   // keepUnique on strings: one of each key, not the first key over and over
+   void test_build_keepUniqueStrings()
+   {  // setup
+      custom::BST<std::string> bst;
+      std::vector<std::string> values;
+      for (int copy = 0; copy < 4; copy++)
+         for (int i = 0; i < 5; i++)
+            values.push_back("key" + std::to_string(i));
+      // exercise
+      bst.build(values.begin(), values.end(), custom::execution::par, true /*keepUnique*/);
+      // verify
+      std::vector<std::string> v(bst.begin(), bst.end());
+      assertUnit(v == std::vector<std::string>({ "key0", "key1", "key2", "key3", "key4" }));
+   }  // teardown
+
+   // the old contents are gone and the tree still works
+   void test_build_replaces()
+   {  // setup
+      custom::BST<int> bst{ 1, 2, 3 };
+      std::vector<int> values = { 9, 7, 8 };
+      // exercise
+      bst.build(values.begin(), values.end(), custom::execution::par);
+      bst.insert(5);
+      bst.erase(8);
+      // verify
+      assertUnit(contents(bst) == std::vector<int>({ 5, 7, 9 }));
+      assertUnit(isValid(bst));
+   }  // teardown
+
+   // input that can only be walked one step at a time
+   void test_build_fromList()
+   {  // setup
+      custom::BST<int> bst;
+      std::list<int> values = { 3, 1, 2 };
+      // exercise
+      bst.build(values.begin(), values.end(), custom::execution::par);
+      // verify
+      assertUnit(contents(bst) == std::vector<int>({ 1, 2, 3 }));
+      assertUnit(isValid(bst));
+   }  // teardown
+
+   /***************************************
+    * TRAVERSE
+    ***************************************/
+
+   // one thread sees the elements in order
+   void test_forEach_sequencedInOrder()
+   {  // setup
+      custom::BST<int> bst{ 50, 20, 80, 30, 70 };
+      std::vector<int> seen;
+      // exercise
+      bst.for_each(custom::execution::seq, [&](int value) { seen.push_back(value); });
+      // verify
+      assertUnit(seen == std::vector<int>({ 20, 30, 50, 70, 80 }));
+   }  // teardown
+
+   // every element once, lopsided tree or not
+   void test_forEach_parallelOnce()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 20000; i++)
+         bst.insert(i);            // ascending, so the right side is deeper
+      std::vector<std::atomic<int>> visits(20000);
+      for (std::atomic<int>& v : visits)
+         v = 0;
+      // exercise
+      bst.for_each(custom::execution::par, [&](int value) { visits[value]++; });
+      bst.for_each(custom::execution::par, [&](int value) { visits[value]++; }, true /*balanced*/);
+      // verify
+      bool twice = true;
+      for (std::atomic<int>& v : visits)
+         twice = twice && v == 2;
+      assertUnit(twice);
+   }  // teardown
+
+   // reduce need not commute: the result is in tree order
+   void test_transformReduce_inOrder()
+   {  // setup
+      custom::BST<int> bst;
+      unsigned int seed = 3;
+      for (int i = 0; i < 20000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         bst.insert((int)((seed >> 8) % 100000));
+      }
+      auto append = [](std::vector<int> lhs, std::vector<int> rhs)
+      {
+         lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+         return lhs;
+      };
+      auto single = [](int value) { return std::vector<int>(1, value); };
+      // exercise
+      std::vector<int> seq      = bst.transform_reduce(custom::execution::seq, std::vector<int>(), append, single);
+      std::vector<int> par      = bst.transform_reduce(custom::execution::par, std::vector<int>(), append, single);
+      std::vector<int> balanced = bst.transform_reduce(custom::execution::par, std::vector<int>(), append, single,
+                                                       true /*balanced*/);
+      // verify
+      assertUnit(seq == contents(bst));
+      assertUnit(par == seq);
+      assertUnit(balanced == seq);
+   }  // teardown
+
+   // an empty tree reduces to init
+   void test_transformReduce_empty()
+   {  // setup
+      custom::BST<int> bst;
+      auto plus = [](long lhs, long rhs) { return lhs + rhs; };
+      auto same = [](int value) { return (long)value; };
+      // exercise
+      long sum = bst.transform_reduce(custom::execution::par, 7L, plus, same);
+      // verify
+      assertUnit(sum == 7);
+   }  // teardown
+
+   // each chunk writes its run to the place the offset gives
+   void test_forEachChunk_offsets()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 20000; i++)
+         bst.insert((i * 7919) % 20000);
+      std::vector<int> out(bst.size(), -1);
+      std::atomic<int> numChunks(0);
+      // exercise
+      bst.for_each_chunk(custom::execution::par, [&](size_t offset, custom::BST<int>::iterator first,
+                                                     custom::BST<int>::iterator last)
+         {
+            numChunks++;
+            for (; first != last; ++first)
+               out[offset++] = *first;
+         });
+      // verify
+      assertUnit(out == contents(bst));
+      assertUnit(numChunks > 1);
+   }  // teardown
+
+   // balanced chunks are close in size even when the tree is lopsided
+   void test_forEachChunk_balanced()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 0; i < 20000; i++)
+         bst.insert(i);
+      std::vector<int> out(bst.size(), -1);
+      std::vector<size_t> sizes;
+      std::mutex mutex;
+      // exercise
+      bst.for_each_chunk(custom::execution::par, [&](size_t offset, custom::BST<int>::iterator first,
+                                                     custom::BST<int>::iterator last)
+         {
+            size_t num = 0;
+            for (; first != last; ++first, num++)
+               out[offset + num] = *first;
+            std::lock_guard<std::mutex> lock(mutex);
+            sizes.push_back(num);
+         });
+      // verify
+      assertUnit(out == contents(bst));
+      size_t largest = *std::max_element(sizes.begin(), sizes.end());
+      assertUnit(largest <= 2 * bst.size() / sizes.size());
+   }  // teardown
+
+   /**************************************************************
+    * HELPERS
+    *************************************************************/
+
+   // add up [begin, end) by forking down to single elements
+   void sumRange(custom::parallel::Pool& pool, int begin, int end, std::atomic<int>& sum)
+   {
+      if (end - begin == 1)
+      {
+         sum += begin;
+         return;
+      }
+      int middle = begin + (end - begin) / 2;
+      pool.invoke([&]() { sumRange(pool, begin, middle, sum); },
+                  [&]() { sumRange(pool, middle, end, sum); });
+   }
+
+   // every element in order
+   std::vector<int> contents(const custom::BST<int>& bst)
+   {
+      std::vector<int> v;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+
+   // red-black, with parent links that agree with the children
+   bool isValid(const custom::BST<int>& bst)
+   {
+      if (!bst.root)
+         return bst.size() == 0;
+      if (bst.root->pParent)
+         return false;
+      return bst.root->verifyRedBlack(bst.root->findDepth()) &&
+             bst.root->computeSize() == (int)bst.size() &&
+             parentsAgree(bst.root);
+   }
+
+   template <class Node>
+   bool parentsAgree(const Node* p)
+   {
+      if (!p)
+         return true;
+      if ((p->pLeft && p->pLeft->pParent != p) || (p->pRight && p->pRight->pParent != p))
+         return false;
+      return parentsAgree(p->pLeft) && parentsAgree(p->pRight);
+   }
+};
+
+#endif // DEBUG
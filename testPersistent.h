@@ -0,0 +1,387 @@
+/***********************************************************************
+ * Header:
+ *    TEST PERSISTENT
+ * Summary:
+ *    Unit tests for the immutable, versioned red-black tree
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "persistent.h" // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <set>          // for std::multiset to compare against
+#include <unordered_set>
+#include <vector>
+
+/***********************************************
+ * TEST PERSISTENT
+ * Unit tests for the PersistentBST class
+ ***********************************************/
+class TestPersistent : public UnitTest
+{
+   typedef custom::PersistentBST<int> Tree;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_default();
+      test_copy_sharesRoot();
+
+      // Insert
+      test_insert_oldVersionUnchanged();
+      test_insert_sharesSubtrees();
+      test_insert_keepUnique();
+      test_insert_ascending();
+
+      // Access
+      test_find_standard();
+      test_bounds_duplicates();
+
+      // Erase
+      test_erase_oldVersionUnchanged();
+      test_erase_sharesSubtrees();
+      test_erase_duplicates();
+      test_erase_all();
+      test_random_againstMultiset();
+
+      // Iterator
+      test_iterator_increment_standard();
+      test_iterator_decrement_standard();
+
+      report("Persistent");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    ***************************************/
+
+   // an empty version
+   void test_construct_default()
+   {  // exercise
+      Tree tree;
+      // verify
+      assertUnit(tree.empty());
+      assertUnit(tree.root == nullptr);
+      assertUnit(tree.begin() == tree.end());
+   }  // teardown
+
+   // a copy is another reference to the same nodes
+   void test_copy_sharesRoot()
+   {  // setup
+      Tree tree = standardTree();
+      // exercise
+      Tree copy(tree);
+      // verify
+      assertUnit(copy.root == tree.root);
+      assertUnit(copy.size() == 7);
+   }  // teardown
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // insert makes a new version and leaves the old one alone
+   void test_insert_oldVersionUnchanged()
+   {  // setup
+      Tree v1 = standardTree();
+      // exercise
+      Tree v2 = v1.insert(55);
+      // verify
+      assertUnit(v1.size() == 7);
+      assertUnit(v2.size() == 8);
+      assertUnit(v1.find(55) == v1.end());
+      assertUnit(v2.find(55) != v2.end());
+      assertUnit(contents(v1) == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(contents(v2) == std::vector<int>({ 20, 30, 40, 50, 55, 60, 70, 80 }));
+      assertUnit(isRedBlack(v1));
+      assertUnit(isRedBlack(v2));
+   }  // teardown
+
+   // only the path to the new element is copied
+   void test_insert_sharesSubtrees()
+   {  // setup
+      Tree v1;
+      for (int i = 0; i < 1000; i++)
+         v1 = v1.insert(i * 2);
+      // exercise
+      Tree v2 = v1.insert(777);
+      // verify
+      size_t numNew = countNotIn(v2, v1);
+      assertUnit(numNew >= 1);
+      assertUnit(numNew <= 2 * 11);   // at most the path, plus a rotation's worth
+      assertUnit(isRedBlack(v2));
+   }  // teardown
+
+   // keepUnique hands back the same version
+   void test_insert_keepUnique()
+   {  // setup
+      Tree v1 = standardTree();
+      // exercise
+      Tree v2 = v1.insert(40, true /*keepUnique*/);
+      // verify
+      assertUnit(v2.root == v1.root);
+      assertUnit(v2.size() == 7);
+   }  // teardown
+
+   // sorted input stays balanced
+   void test_insert_ascending()
+   {  // setup
+      Tree tree;
+      // exercise
+      for (int i = 0; i < 1000; i++)
+         tree = tree.insert(i);
+      // verify
+      assertUnit(tree.size() == 1000);
+      assertUnit(isRedBlack(tree));
+      assertUnit(height(tree.root.get()) <= 20);
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   // hit and miss
+   void test_find_standard()
+   {  // setup
+      Tree tree = standardTree();
+      // exercise
+      auto itHit  = tree.find(60);
+      auto itMiss = tree.find(65);
+      // verify
+      assertUnit(itHit != tree.end() && *itHit == 60);
+      assertUnit(itMiss == tree.end());
+   }  // teardown
+
+   // lower to upper bound covers every copy
+   void test_bounds_duplicates()
+   {  // setup
+      Tree tree{ 10, 20, 20, 30, 20 };
+      // exercise
+      auto itLower = tree.lower_bound(20);
+      auto itUpper = tree.upper_bound(20);
+      // verify
+      int count = 0;
+      for (auto it = itLower; it != itUpper; ++it, ++count)
+         assertUnit(*it == 20);
+      assertUnit(count == 3);
+      assertUnit(itUpper != tree.end() && *itUpper == 30);
+      assertUnit(tree.upper_bound(30) == tree.end());
+   }  // teardown
+
+   /***************************************
+    * ERASE
+    ***************************************/
+
+   // erase makes a new version and leaves the old one alone
+   void test_erase_oldVersionUnchanged()
+   {  // setup
+      Tree v1 = standardTree();
+      // exercise
+      Tree v2 = v1.erase(50);
+      // verify
+      assertUnit(v1.size() == 7);
+      assertUnit(v2.size() == 6);
+      assertUnit(contents(v1) == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(contents(v2) == std::vector<int>({ 20, 30, 40, 60, 70, 80 }));
+      assertUnit(isRedBlack(v2));
+      assertUnit(v1.erase(45).root == v1.root);
+   }  // teardown
+
+   // only about the path to the erased element is copied
+   void test_erase_sharesSubtrees()
+   {  // setup
+      Tree v1;
+      for (int i = 0; i < 1000; i++)
+         v1 = v1.insert(i);
+      // exercise
+      Tree v2 = v1.erase(500);
+      // verify
+      assertUnit(countNotIn(v2, v1) <= 3 * 20);
+      assertUnit(isRedBlack(v2));
+   }  // teardown
+
+   // every copy goes
+   void test_erase_duplicates()
+   {  // setup
+      Tree tree{ 5, 3, 5, 8, 5, 1 };
+      // exercise
+      Tree after = tree.erase(5);
+      // verify
+      assertUnit(after.size() == 3);
+      assertUnit(contents(after) == std::vector<int>({ 1, 3, 8 }));
+      assertUnit(isRedBlack(after));
+   }  // teardown
+
+   // erasing everything leaves an empty version
+   void test_erase_all()
+   {  // setup
+      Tree tree;
+      for (int i = 0; i < 100; i++)
+         tree = tree.insert((i * 37) % 100);
+      // exercise
+      bool valid = true;
+      for (int i = 0; i < 100; i++)
+      {
+         tree = tree.erase(i);
+         valid = valid && isRedBlack(tree) && tree.size() == (size_t)(99 - i);
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(tree.empty());
+      assertUnit(tree.root == nullptr);
+   }  // teardown
+
+   // a long mix of inserts and erases agrees with std::multiset at every version
+   void test_random_againstMultiset()
+   {  // setup
+      std::vector<Tree> versions(1);
+      std::vector<std::multiset<int>> expected(1);
+      unsigned int seed = 7;
+      // exercise
+      for (int i = 0; i < 2000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         int value = (int)((seed >> 8) % 150);
+         std::multiset<int> next = expected.back();
+         if ((seed >> 20) % 3)
+         {
+            versions.push_back(versions.back().insert(value));
+            next.insert(value);
+         }
+         else
+         {
+            versions.push_back(versions.back().erase(value));
+            next.erase(value);
+         }
+         expected.push_back(next);
+      }
+      // verify
+      bool valid = true;
+      for (size_t i = 0; i < versions.size(); i += 37)
+         valid = valid && isRedBlack(versions[i]) &&
+                 contents(versions[i]) == std::vector<int>(expected[i].begin(), expected[i].end());
+      assertUnit(valid);
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    ***************************************/
+
+   // walk forward in order
+   void test_iterator_increment_standard()
+   {  // setup
+      Tree tree = standardTree();
+      // exercise
+      auto it = tree.begin();
+      // verify
+      for (int i : { 20, 30, 40, 50, 60, 70, 80 })
+      {
+         assertUnit(it != tree.end());
+         if (it != tree.end())
+            assertUnit(*it++ == i);
+      }
+      assertUnit(it == tree.end());
+   }  // teardown
+
+   // walk backward from the last element
+   void test_iterator_decrement_standard()
+   {  // setup
+      Tree tree = standardTree();
+      auto it = tree.find(80);
+      // exercise and verify
+      for (int i : { 80, 70, 60, 50, 40, 30, 20 })
+      {
+         assertUnit(it != tree.end());
+         if (it != tree.end())
+            assertUnit(*it-- == i);
+      }
+      assertUnit(it == tree.end());
+   }  // teardown
+
+   /**************************************************************
+    * STANDARD TREE
+    *************************************************************/
+   Tree standardTree()
+   {
+      return Tree{ 50, 30, 70, 20, 40, 60, 80 };
+   }
+
+   // every element in order
+   std::vector<int> contents(const Tree& tree)
+   {
+      std::vector<int> v;
+      for (auto it = tree.begin(); it != tree.end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+
+   // nodes of tree that are not also nodes of old
+   size_t countNotIn(const Tree& tree, const Tree& old)
+   {
+      std::unordered_set<const void*> oldNodes;
+      collect(old.root.get(), oldNodes);
+      std::unordered_set<const void*> nodes;
+      collect(tree.root.get(), nodes);
+      size_t num = 0;
+      for (const void* p : nodes)
+         num += oldNodes.count(p) ? 0 : 1;
+      return num;
+   }
+
+   template <class Node>
+   void collect(const Node* p, std::unordered_set<const void*>& nodes)
+   {
+      if (!p || !nodes.insert(p).second)
+         return;   // a shared subtree is already in the set
+      collect(p->pLeft.get(), nodes);
+      collect(p->pRight.get(), nodes);
+   }
+
+   // ordered, black root, no red-red, equal black heights, and the right size
+   bool isRedBlack(const Tree& tree)
+   {
+      if (tree.root && tree.root->isRed)
+         return false;
+      size_t num = 0;
+      return blackHeight(tree.root.get(), num) >= 0 && num == tree.size();
+   }
+
+   template <class Node>
+   int blackHeight(const Node* p, size_t& num)
+   {
+      if (!p)
+         return 0;
+      num++;
+      const Node* pLeft  = p->pLeft.get();
+      const Node* pRight = p->pRight.get();
+      if ((pLeft && p->data < pLeft->data) || (pRight && pRight->data < p->data))
+         return -1;
+      if (p->isRed && ((pLeft && pLeft->isRed) || (pRight && pRight->isRed)))
+         return -1;
+      int hLeft  = blackHeight(pLeft, num);
+      int hRight = blackHeight(pRight, num);
+      if (hLeft < 0 || hLeft != hRight)
+         return -1;
+      return hLeft + (p->isRed ? 0 : 1);
+   }
+
+   template <class Node>
+   int height(const Node* p)
+   {
+      if (!p)
+         return 0;
+      int hLeft  = height(p->pLeft.get());
+      int hRight = height(p->pRight.get());
+      return 1 + (hLeft > hRight ? hLeft : hRight);
+   }
+};
+
+#endif // DEBUG
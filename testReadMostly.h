@@ -0,0 +1,420 @@
+/***********************************************************************
+ * Header:
+ *    TEST READ MOSTLY
+ * Summary:
+ *    Unit tests for the tree with lock-free reads and for the epoch
+ *    reclamation beneath it
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "readmostly.h" // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <atomic>       // for std::atomic
+#include <set>          // for std::multiset to compare against
+#include <thread>       // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST READ MOSTLY
+ * Unit tests for the ReadMostlyBST class
+ ***********************************************/
+class TestReadMostly : public UnitTest
+{
+   // counts how many are alive, to see when retired nodes are deleted
+   struct Counted
+   {
+      Counted(int value = 0) : value(value) { numAlive++; }
+      Counted(const Counted& rhs) : value(rhs.value) { numAlive++; }
+      ~Counted() { numAlive--; }
+      bool operator < (const Counted& rhs) const { return value < rhs.value; }
+      int value;
+      static inline int numAlive = 0;
+   };
+
+public:
+   void run()
+   {
+      reset();
+
+      // Read
+      test_find_empty();
+      test_find_standard();
+      test_bounds_standard();
+
+      // Write
+      test_insert_ascending();
+      test_insert_keepUnique();
+      test_erase_duplicates();
+      test_clear_standard();
+      test_random_againstMultiset();
+
+      // Epoch
+      test_epoch_pinnedKeepsNode();
+      test_epoch_nestedGuards();
+      test_epoch_overflowKeepsNode();
+
+      // Threads
+      test_threads_readersSeeStableKeys();
+      test_threads_moreReadersThanSlots();
+
+      report("ReadMostly");
+   }
+
+   /***************************************
+    * READ
+    ***************************************/
+
+   // nothing to find
+   void test_find_empty()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      // exercise and verify
+      assertUnit(!tree.find(5).has_value());
+      assertUnit(!tree.lower_bound(5).has_value());
+      assertUnit(tree.snapshot().empty());
+      assertUnit(tree.empty());
+   }  // teardown
+
+   // hits and misses
+   void test_find_standard()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      setupStandardFixture(tree);
+      // exercise and verify
+      assertUnit(tree.find(40) == std::optional<int>(40));
+      assertUnit(!tree.find(45).has_value());
+      assertUnit(tree.contains(80));
+      assertUnit(tree.size() == 7);
+   }  // teardown
+
+   // bounds between, on, and past the elements
+   void test_bounds_standard()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      setupStandardFixture(tree);
+      // exercise and verify
+      assertUnit(tree.lower_bound(45) == std::optional<int>(50));
+      assertUnit(tree.lower_bound(50) == std::optional<int>(50));
+      assertUnit(tree.upper_bound(50) == std::optional<int>(60));
+      assertUnit(!tree.upper_bound(80).has_value());
+      assertUnit(tree.lower_bound(5) == std::optional<int>(20));
+   }  // teardown
+
+   /***************************************
+    * WRITE
+    ***************************************/
+
+   // sorted input stays balanced
+   void test_insert_ascending()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      // exercise
+      for (int i = 0; i < 1000; i++)
+         tree.insert(i);
+      // verify
+      assertUnit(tree.size() == 1000);
+      assertUnit(isRedBlack(tree));
+      assertUnit(height(tree.root.load()) <= 20);
+      std::vector<int> elements = tree.snapshot();
+      assertUnit(elements.size() == 1000);
+      assertUnit(elements.size() == 1000 && elements.front() == 0 && elements.back() == 999);
+   }  // teardown
+
+   // keepUnique turns away a duplicate
+   void test_insert_keepUnique()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      setupStandardFixture(tree);
+      // exercise and verify
+      assertUnit(!tree.insert(40, true /*keepUnique*/));
+      assertUnit(tree.insert(40));
+      assertUnit(tree.size() == 8);
+      assertUnit(isRedBlack(tree));
+   }  // teardown
+
+   // erase removes every copy
+   void test_erase_duplicates()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      for (int i : { 5, 3, 5, 8, 5, 1 })
+         tree.insert(i);
+      // exercise
+      size_t num = tree.erase(5);
+      // verify
+      assertUnit(num == 3);
+      assertUnit(tree.snapshot() == std::vector<int>({ 1, 3, 8 }));
+      assertUnit(tree.erase(5) == 0);
+      assertUnit(isRedBlack(tree));
+   }  // teardown
+
+   // clear retires everything, and nothing is reading, so it is all deleted
+   void test_clear_standard()
+   {  // setup
+      Counted::numAlive = 0;
+      {
+         custom::concurrent::ReadMostlyBST<Counted> tree;
+         for (int i = 0; i < 50; i++)
+            tree.insert(Counted(i));
+         // exercise
+         tree.clear();
+         // verify
+         assertUnit(tree.empty());
+         assertUnit(Counted::numAlive == 0);
+      }
+   }  // teardown
+
+   // a long mix of inserts and erases agrees with std::multiset
+   void test_random_againstMultiset()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      std::multiset<int> expected;
+      unsigned int seed = 99;
+      bool valid = true;
+      // exercise
+      for (int i = 0; i < 3000; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         int value = (int)((seed >> 8) % 200);
+         if ((seed >> 20) % 3)
+         {
+            tree.insert(value);
+            expected.insert(value);
+         }
+         else
+         {
+            tree.erase(value);
+            expected.erase(value);
+         }
+         if (i % 100 == 0)
+            valid = valid && isRedBlack(tree);
+      }
+      // verify
+      assertUnit(valid);
+      assertUnit(isRedBlack(tree));
+      assertUnit(tree.size() == expected.size());
+      assertUnit(tree.snapshot() == std::vector<int>(expected.begin(), expected.end()));
+   }  // teardown
+
+   /***************************************
+    * EPOCH
+    ***************************************/
+
+   // an erased node outlives a reader that was pinned when it was erased
+   void test_epoch_pinnedKeepsNode()
+   {  // setup
+      Counted::numAlive = 0;
+      {
+         custom::concurrent::ReadMostlyBST<Counted> tree;
+         for (int i = 0; i < 10; i++)
+            tree.insert(Counted(i));
+         // exercise
+         {
+            custom::epoch::Guard reader;
+            tree.erase(Counted(4));
+            // verify
+            assertUnit(Counted::numAlive == 10);
+            assertUnit(tree.retired.size() == 1);
+         }
+         tree.erase(Counted(5));
+         assertUnit(tree.retired.size() == 0);
+         assertUnit(Counted::numAlive == 8);
+      }
+      assertUnit(Counted::numAlive == 0);
+   }  // teardown
+
+   // an inner guard does not unpin the outer one
+   void test_epoch_nestedGuards()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      setupStandardFixture(tree);
+      // exercise
+      custom::epoch::Guard outer;
+      {
+         custom::epoch::Guard inner;
+      }
+      tree.erase(20);
+      // verify
+      assertUnit(tree.retired.size() == 1);
+   }  // teardown
+
+   // a reader that found every slot taken still holds off reclamation
+   void test_epoch_overflowKeepsNode()
+   {  // setup
+      Counted::numAlive = 0;
+      {
+         custom::concurrent::ReadMostlyBST<Counted> tree;
+         for (int i = 0; i < 10; i++)
+            tree.insert(Counted(i));
+         std::atomic<size_t> numPinned(0);
+         std::atomic<bool> releaseFillers(false);
+         std::atomic<bool> releaseOverflow(false);
+         std::atomic<bool> overflowed(false);
+         std::vector<std::thread> fillers;
+         for (size_t i = 0; i < custom::epoch::maxThreads; i++)
+            fillers.emplace_back([&]()
+               {
+                  custom::epoch::Guard reader;
+                  numPinned++;
+                  while (!releaseFillers)
+                     std::this_thread::yield();
+               });
+         while (numPinned < custom::epoch::maxThreads)
+            std::this_thread::yield();
+         std::thread late([&]()
+            {
+               custom::epoch::Guard reader;
+               overflowed = custom::epoch::overflow.epoch.load() != 0;
+               numPinned++;
+               while (!releaseOverflow)
+                  std::this_thread::yield();
+            });
+         while (numPinned < custom::epoch::maxThreads + 1)
+            std::this_thread::yield();
+         releaseFillers = true;
+         for (std::thread& filler : fillers)
+            filler.join();
+         // exercise
+         tree.erase(Counted(4));
+         // verify
+         assertUnit(overflowed);
+         assertUnit(tree.retired.size() == 1);
+         assertUnit(Counted::numAlive == 10);
+         releaseOverflow = true;
+         late.join();
+         tree.erase(Counted(5));
+         assertUnit(tree.retired.size() == 0);
+         assertUnit(Counted::numAlive == 8);
+      }
+      assertUnit(Counted::numAlive == 0);
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // keys no writer touches are always found, however the tree rotates
+   void test_threads_readersSeeStableKeys()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      for (int i = 0; i < 1000; i += 2)
+         tree.insert(i);           // the stable keys are even
+      std::atomic<bool> done(false);
+      std::atomic<int> numMissed(0);
+      // exercise
+      std::vector<std::thread> readers;
+      for (int r = 0; r < 3; r++)
+         readers.emplace_back([&, r]()
+            {
+               unsigned int seed = r + 1;
+               while (!done)
+               {
+                  seed = seed * 1103515245 + 12345;
+                  int key = (int)((seed >> 8) % 500) * 2;
+                  if (!tree.contains(key))
+                     numMissed++;
+               }
+            });
+      std::thread writer([&]()
+         {
+            for (int round = 0; round < 20; round++)
+            {
+               for (int i = 1; i < 1000; i += 2)
+                  tree.insert(i);
+               for (int i = 1; i < 1000; i += 2)
+                  tree.erase(i);
+            }
+            done = true;
+         });
+      writer.join();
+      for (std::thread& reader : readers)
+         reader.join();
+      // verify
+      assertUnit(numMissed == 0);
+      assertUnit(tree.size() == 500);
+      assertUnit(isRedBlack(tree));
+   }  // teardown
+
+   // threads that have read and live on do not keep their slots, so
+   // more of them than there are slots never wait for one
+   void test_threads_moreReadersThanSlots()
+   {  // setup
+      custom::concurrent::ReadMostlyBST<int> tree;
+      setupStandardFixture(tree);
+      const size_t numReaders = custom::epoch::maxThreads + 44;
+      std::atomic<size_t> numRead(0);
+      std::atomic<size_t> numFound(0);
+      // exercise
+      std::vector<std::thread> readers;
+      for (size_t r = 0; r < numReaders; r++)
+         readers.emplace_back([&]()
+            {
+               if (tree.contains(40))
+                  numFound++;
+               numRead++;
+               while (numRead < numReaders)   // stay alive until all have read
+                  std::this_thread::yield();
+            });
+      for (std::thread& reader : readers)
+         reader.join();
+      // verify
+      assertUnit(numFound == numReaders);
+      assertUnit(custom::epoch::overflow.epoch.load() == 0);
+   }  // teardown
+
+   /**************************************************************
+    * SETUP STANDARD FIXTURE
+    *************************************************************/
+   template <class Tree>
+   void setupStandardFixture(Tree& tree)
+   {
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         tree.insert(i);
+   }
+
+   // ordered, parents right, black root, no red-red, equal black heights
+   template <class T>
+   bool isRedBlack(const custom::concurrent::ReadMostlyBST<T>& tree)
+   {
+      auto* pRoot = tree.root.load();
+      if (pRoot && (pRoot->isRed || pRoot->pParent))
+         return false;
+      return blackHeight(pRoot) >= 0;
+   }
+
+   template <class Node>
+   int blackHeight(const Node* p)
+   {
+      if (!p)
+         return 0;
+      const Node* pLeft  = p->pLeft.load();
+      const Node* pRight = p->pRight.load();
+      if ((pLeft && (pLeft->pParent != p || p->data < pLeft->data)) ||
+          (pRight && (pRight->pParent != p || pRight->data < p->data)))
+         return -1;
+      if (p->isRed && ((pLeft && pLeft->isRed) || (pRight && pRight->isRed)))
+         return -1;
+      int hLeft  = blackHeight(pLeft);
+      int hRight = blackHeight(pRight);
+      if (hLeft < 0 || hLeft != hRight)
+         return -1;
+      return hLeft + (p->isRed ? 0 : 1);
+   }
+
+   template <class Node>
+   int height(const Node* p)
+   {
+      if (!p)
+         return 0;
+      int hLeft  = height(p->pLeft.load());
+      int hRight = height(p->pRight.load());
+      return 1 + (hLeft > hRight ? hLeft : hRight);
+   }
+};
+
+#endif // DEBUG
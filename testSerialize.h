@@ -0,0 +1,295 @@
+/***********************************************************************
+ * Header:
+ *    TEST SERIALIZE
+ * Summary:
+ *    Unit tests for saving a BST to a stream and loading it back
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "serialize.h"  // class under test
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // for counting comparisons
+
+#include <sstream>      // for std::stringstream
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST SERIALIZE
+ * Unit tests for serialize.h
+ ***********************************************/
+class TestSerialize : public UnitTest
+{
+   // a string is its length and then its characters
+   struct StringCodec
+   {
+      bool write(std::ostream& out, const std::string& s)
+      {
+         uint32_t length = (uint32_t)s.size();
+         out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+         return bool(out.write(s.data(), length));
+      }
+      bool read(std::istream& in, std::string& s)
+      {
+         uint32_t length;
+         if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)))
+            return false;
+         s.resize(length);
+         return bool(in.read(&s[0], length));
+      }
+   };
+
+   // a Spy is the int it holds
+   struct SpyCodec
+   {
+      bool write(std::ostream& out, const Spy& s)
+      {
+         int value = s.get();
+         return bool(out.write(reinterpret_cast<const char*>(&value), sizeof(value)));
+      }
+      bool read(std::istream& in, Spy& s)
+      {
+         int value;
+         if (!in.read(reinterpret_cast<char*>(&value), sizeof(value)))
+            return false;
+         s = Spy(value);
+         return true;
+      }
+   };
+
+public:
+   void run()
+   {
+      reset();
+
+      // Round trip
+      test_roundTrip_empty();
+      test_roundTrip_bitwise();
+      test_roundTrip_manyBlocks();
+      test_roundTrip_codec();
+      test_roundTrip_duplicates();
+      test_deserialize_noInsert();
+
+      // Bad input
+      test_deserialize_badMagic();
+      test_deserialize_wrongWidth();
+      test_deserialize_truncated();
+      test_deserialize_outOfOrder();
+
+      report("Serialize");
+   }
+
+   /***************************************
+    * ROUND TRIP
+    ***************************************/
+
+   // an empty tree comes back empty
+   void test_roundTrip_empty()
+   {  // setup
+      custom::BST<int> src;
+      custom::BST<int> dest{ 1, 2 };
+      std::stringstream stream;
+      // exercise
+      bool saved  = src.serialize(stream);
+      bool loaded = dest.deserialize(stream);
+      // verify
+      assertUnit(saved);
+      assertUnit(loaded);
+      assertUnit(dest.empty());
+      assertUnit(dest.root == nullptr);
+      assertUnit(stream.str().size() == 16);   // just the header
+   }  // teardown
+
+   // every element of a trivially copyable type, and a valid tree
+   void test_roundTrip_bitwise()
+   {  // setup
+      custom::BST<int> src{ 50, 30, 70, 20, 40, 60, 80 };
+      custom::BST<int> dest;
+      std::stringstream stream;
+      // exercise
+      src.serialize(stream);
+      bool loaded = dest.deserialize(stream);
+      // verify
+      assertUnit(loaded);
+      assertUnit(contents(dest) == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+      assertUnit(stream.str().size() == 16 + 7 * sizeof(int));
+      assertUnit(isValid(dest));
+   }  // teardown
+
+   // more elements than one block holds
+   void test_roundTrip_manyBlocks()
+   {  // setup
+      custom::BST<double> src;
+      for (int i = 0; i < 10000; i++)
+         src.insert((i * 7919) % 10007 / 4.0);
+      custom::BST<double> dest;
+      std::stringstream stream;
+      // exercise
+      src.serialize(stream);
+      bool loaded = dest.deserialize(stream);
+      // verify
+      assertUnit(loaded);
+      assertUnit(dest.size() == 10000);
+      bool same = true;
+      for (auto itSrc = src.begin(), itDest = dest.begin(); same && itSrc != src.end(); ++itSrc, ++itDest)
+         same = *itSrc == *itDest;
+      assertUnit(same);
+      assertUnit(dest.root->verifyRedBlack(dest.root->findDepth()));
+   }  // teardown
+
+   // a type that is not trivially copyable brings its own codec
+   void test_roundTrip_codec()
+   {  // setup
+      custom::BST<std::string> src{ "pear", "apple", "fig", "" };
+      custom::BST<std::string> dest;
+      std::stringstream stream;
+      // exercise
+      bool saved  = src.serialize(stream, StringCodec());
+      bool loaded = dest.deserialize(stream, StringCodec());
+      // verify
+      assertUnit(saved);
+      assertUnit(loaded);
+      std::vector<std::string> elements;
+      for (auto it = dest.begin(); it != dest.end(); ++it)
+         elements.push_back(*it);
+      assertUnit(elements == std::vector<std::string>({ "", "apple", "fig", "pear" }));
+   }  // teardown
+
+   // repeats are kept
+   void test_roundTrip_duplicates()
+   {  // setup
+      custom::BST<int> src{ 5, 5, 3, 5 };
+      custom::BST<int> dest;
+      std::stringstream stream;
+      // exercise
+      src.serialize(stream);
+      dest.deserialize(stream);
+      // verify
+      assertUnit(contents(dest) == std::vector<int>({ 3, 5, 5, 5 }));
+      assertUnit(isValid(dest));
+   }  // teardown
+
+   // loading compares each element once, to its neighbor, and nothing more
+   void test_deserialize_noInsert()
+   {  // setup
+      custom::BST<Spy> src;
+      for (int i = 0; i < 100; i++)
+         src.insert(Spy(i));
+      custom::BST<Spy> dest;
+      std::stringstream stream;
+      src.serialize(stream, SpyCodec());
+      Spy::reset();
+      // exercise
+      bool loaded = dest.deserialize(stream, SpyCodec());
+      // verify
+      assertUnit(loaded);
+      assertUnit(Spy::numLessthan() == 99);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(dest.size() == 100);
+      assertUnit(dest.root->verifyRedBlack(dest.root->findDepth()));
+   }  // teardown
+
+   /***************************************
+    * BAD INPUT
+    ***************************************/
+
+   // not something serialize() wrote
+   void test_deserialize_badMagic()
+   {  // setup
+      custom::BST<int> dest{ 1, 2, 3 };
+      std::stringstream stream("this is not a tree at all");
+      // exercise
+      bool loaded = dest.deserialize(stream);
+      // verify
+      assertUnit(!loaded);
+      assertUnit(contents(dest) == std::vector<int>({ 1, 2, 3 }));
+   }  // teardown
+
+   // written with ints, read as doubles
+   void test_deserialize_wrongWidth()
+   {  // setup
+      custom::BST<int> src{ 1, 2, 3 };
+      custom::BST<double> dest;
+      std::stringstream stream;
+      src.serialize(stream);
+      // exercise
+      bool loaded = dest.deserialize(stream);
+      // verify
+      assertUnit(!loaded);
+      assertUnit(dest.empty());
+   }  // teardown
+
+   // the stream ends early; the old contents stay
+   void test_deserialize_truncated()
+   {  // setup
+      custom::BST<int> src{ 1, 2, 3, 4, 5 };
+      custom::BST<int> dest{ 9 };
+      std::stringstream full;
+      src.serialize(full);
+      std::stringstream stream(full.str().substr(0, full.str().size() - 2));
+      // exercise
+      bool loaded = dest.deserialize(stream);
+      // verify
+      assertUnit(!loaded);
+      assertUnit(contents(dest) == std::vector<int>({ 9 }));
+   }  // teardown
+
+   // elements out of order would make a broken tree, so they are refused
+   void test_deserialize_outOfOrder()
+   {  // setup
+      custom::BST<int> src{ 1, 2, 3 };
+      custom::BST<int> dest;
+      std::stringstream full;
+      src.serialize(full);
+      std::string bytes = full.str();
+      int three = 3;
+      bytes.replace(16, sizeof(int), reinterpret_cast<const char*>(&three), sizeof(int));   // 3, 2, 3
+      std::stringstream stream(bytes);
+      // exercise
+      bool loaded = dest.deserialize(stream);
+      // verify
+      assertUnit(!loaded);
+      assertUnit(dest.empty());
+   }  // teardown
+
+   /**************************************************************
+    * HELPERS
+    *************************************************************/
+
+   std::vector<int> contents(const custom::BST<int>& bst)
+   {
+      std::vector<int> v;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+
+   // red-black, with parent links that agree with the children
+   template <typename T>
+   bool isValid(const custom::BST<T>& bst)
+   {
+      if (!bst.root)
+         return bst.size() == 0;
+      return !bst.root->pParent &&
+             bst.root->verifyRedBlack(bst.root->findDepth()) &&
+             bst.root->computeSize() == (int)bst.size() &&
+             parentsAgree(bst.root);
+   }
+
+   template <class Node>
+   bool parentsAgree(const Node* p)
+   {
+      if (!p)
+         return true;
+      if ((p->pLeft && p->pLeft->pParent != p) || (p->pRight && p->pRight->pParent != p))
+         return false;
+      return parentsAgree(p->pLeft) && parentsAgree(p->pRight);
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,310 @@
+/***********************************************************************
+ * Header:
+ *    TEST SHARDED
+ * Summary:
+ *    Unit tests for the range-partitioned concurrent tree
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "sharded.h"    // class under test
+#include "unitTest.h"   // unit test baseclass
+#include "spy.h"        // for counting comparisons
+
+#include <atomic>       // for std::atomic
+#include <thread>       // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST SHARDED
+ * Unit tests for the concurrent::ShardedBST class
+ ***********************************************/
+class TestSharded : public UnitTest
+{
+   typedef custom::concurrent::ShardedBST<int, 4> Tree;
+
+public:
+   void run()
+   {
+      reset();
+
+      // Route
+      test_splitters_route();
+      test_splitters_equalGoesRight();
+      test_noSplitters_firstShard();
+
+      // Read and write
+      test_find_standard();
+      test_insert_keepUnique();
+      test_erase_standard();
+      test_iterator_ordered();
+      test_iterator_skipsEmpty();
+
+      // Rebalance
+      test_rebalance_quantiles();
+      test_rebalance_ascending();
+      test_rebalance_keepsDuplicates();
+      test_rebalance_linear();
+
+      // Threads
+      test_threads_writers();
+      test_threads_readersDuringRebalance();
+
+      report("Sharded");
+   }
+
+   /***************************************
+    * ROUTE
+    ***************************************/
+
+   // each key lands in the shard its splitters say
+   void test_splitters_route()
+   {  // setup
+      Tree tree({ 10, 20, 30 });
+      // exercise
+      for (int i : { 5, 15, 25, 35, 36 })
+         tree.insert(i);
+      // verify
+      assertUnit(tree.shards[0].tree.size() == 1);
+      assertUnit(tree.shards[1].tree.size() == 1);
+      assertUnit(tree.shards[2].tree.size() == 1);
+      assertUnit(tree.shards[3].tree.size() == 2);
+      assertUnit(tree.size() == 5);
+   }  // teardown
+
+   // a key equal to a splitter starts the shard to its right
+   void test_splitters_equalGoesRight()
+   {  // setup
+      Tree tree({ 10, 20, 30 });
+      // exercise
+      tree.insert(20);
+      // verify
+      assertUnit(tree.shards[2].tree.size() == 1);
+      assertUnit(tree.routing().shardOf(19) == 1);
+   }  // teardown
+
+   // before any splitters, everything waits in the first shard
+   void test_noSplitters_firstShard()
+   {  // setup
+      Tree tree;
+      // exercise
+      for (int i = 0; i < 10; i++)
+         tree.insert(i);
+      // verify
+      assertUnit(tree.routing().splitters.empty());
+      assertUnit(tree.shards[0].tree.size() == 10);
+   }  // teardown
+
+   /***************************************
+    * READ AND WRITE
+    ***************************************/
+
+   // find returns a copy, or nothing
+   void test_find_standard()
+   {  // setup
+      Tree tree({ 10, 20, 30 });
+      for (int i : { 50, 30, 7, 20, 14 })
+         tree.insert(i);
+      // exercise
+      std::optional<int> hit  = tree.find(14);
+      std::optional<int> miss = tree.find(15);
+      // verify
+      assertUnit(hit.has_value() && *hit == 14);
+      assertUnit(!miss.has_value());
+      assertUnit(tree.contains(50));
+   }  // teardown
+
+   // keepUnique turns away a duplicate
+   void test_insert_keepUnique()
+   {  // setup
+      Tree tree({ 10, 20, 30 });
+      tree.insert(15);
+      // exercise and verify
+      assertUnit(!tree.insert(15, true /*keepUnique*/));
+      assertUnit(tree.insert(15));
+      assertUnit(tree.size() == 2);
+   }  // teardown
+
+   // erase takes every copy, and clear takes everything
+   void test_erase_standard()
+   {  // setup
+      Tree tree({ 10, 20, 30 });
+      for (int i : { 25, 5, 25, 31 })
+         tree.insert(i);
+      // exercise
+      size_t num = tree.erase(25);
+      // verify
+      assertUnit(num == 2);
+      assertUnit(tree.snapshot() == std::vector<int>({ 5, 31 }));
+      tree.clear();
+      assertUnit(tree.empty());
+   }  // teardown
+
+   // the iterator runs through the shards in order
+   void test_iterator_ordered()
+   {  // setup
+      Tree tree({ 10, 20, 30 });
+      for (int i : { 33, 2, 21, 11, 35, 19, 1 })
+         tree.insert(i);
+      // exercise
+      std::vector<int> elements;
+      for (auto it = tree.begin(); it != tree.end(); ++it)
+         elements.push_back(*it);
+      // verify
+      assertUnit(elements == std::vector<int>({ 1, 2, 11, 19, 21, 33, 35 }));
+      assertUnit(elements == tree.snapshot());
+   }  // teardown
+
+   // empty shards are passed over, and an empty tree has begin() == end()
+   void test_iterator_skipsEmpty()
+   {  // setup
+      Tree tree({ 10, 20, 30 });
+      // exercise and verify
+      assertUnit(tree.begin() == tree.end());
+      tree.insert(25);
+      auto it = tree.begin();
+      assertUnit(it != tree.end() && *it == 25);
+      assertUnit(++it == tree.end());
+   }  // teardown
+
+   /***************************************
+    * REBALANCE
+    ***************************************/
+
+   // the splitters move to the quartiles
+   void test_rebalance_quantiles()
+   {  // setup
+      Tree tree;
+      for (int i = 0; i < 100; i++)
+         tree.insert(i);
+      // exercise
+      tree.rebalance();
+      // verify
+      assertUnit(tree.routing().splitters == std::vector<int>({ 25, 50, 75 }));
+      for (size_t i = 0; i < 4; i++)
+         assertUnit(tree.shards[i].tree.size() == 25);
+      assertUnit(tree.size() == 100);
+   }  // teardown
+
+   // sorted input all lands in the last shard, so the splitters follow it
+   void test_rebalance_ascending()
+   {  // setup
+      Tree tree;
+      // exercise
+      for (int i = 0; i < 5000; i++)
+         tree.insert(i);
+      // verify
+      assertUnit(tree.routing().splitters.size() == 3);
+      assertUnit(tree.lastRebalance >= 5000 * 2 / 3);
+      for (size_t i = 0; i < 3; i++)
+         assertUnit(tree.shards[i].tree.size() >= tree.lastRebalance / 4 - 1);
+      assertUnit(tree.size() == 5000);
+      std::vector<int> elements = tree.snapshot();
+      bool inOrder = elements.size() == 5000;
+      for (int i = 0; inOrder && i < 5000; i++)
+         inOrder = elements[i] == i;
+      assertUnit(inOrder);
+   }  // teardown
+
+   // a run of equal keys stays together through a rebalance
+   void test_rebalance_keepsDuplicates()
+   {  // setup
+      Tree tree;
+      for (int i = 0; i < 40; i++)
+         tree.insert(i < 30 ? 7 : i);
+      // exercise
+      tree.rebalance();
+      // verify
+      assertUnit(tree.size() == 40);
+      assertUnit(tree.erase(7) == 30);
+      assertUnit(tree.size() == 10);
+   }  // teardown
+
+   // the gathered elements are already in order, so each shard is
+   // linked from its slice: a comparison per element, and no taller
+   // than it must be
+   void test_rebalance_linear()
+   {  // setup
+      custom::concurrent::ShardedBST<Spy, 4> tree;
+      for (int i = 0; i < 1024; i++)
+         tree.insert(Spy((i * 7919) % 1024));
+      Spy::reset();
+      // exercise
+      tree.rebalance();
+      // verify
+      assertUnit(Spy::numLessthan() + Spy::numEquals() <= 1024 + 3 * 11);
+      assertUnit(tree.routing().splitters.size() == 3);
+      for (size_t i = 0; i < 4; i++)
+      {
+         custom::ShapeStats stats = tree.shards[i].tree.stats();
+         assertUnit(stats.size == 256);
+         assertUnit(stats.height == stats.minHeight());
+      }
+      assertUnit(tree.size() == 1024);
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // writers on several threads lose nothing, even across rebalances
+   void test_threads_writers()
+   {  // setup
+      Tree tree;
+      std::vector<std::thread> threads;
+      // exercise
+      for (int t = 0; t < 4; t++)
+         threads.emplace_back([&tree, t]()
+            {
+               for (int i = 0; i < 1000; i++)
+                  tree.insert(i * 4 + t);
+            });
+      for (std::thread& thread : threads)
+         thread.join();
+      // verify
+      std::vector<int> elements = tree.snapshot();
+      bool inOrder = elements.size() == 4000;
+      for (int i = 0; inOrder && i < 4000; i++)
+         inOrder = elements[i] == i;
+      assertUnit(inOrder);
+      assertUnit(tree.size() == 4000);
+      assertUnit(tree.routing().splitters.size() == 3);
+   }  // teardown
+
+   // readers routing by splitters that a rebalance swaps out from
+   // under them still find every element that was there all along
+   void test_threads_readersDuringRebalance()
+   {  // setup
+      Tree tree;
+      for (int i = 0; i < 1000; i++)
+         tree.insert(i * 2);
+      std::atomic<bool> done(false);
+      std::atomic<int> numMissed(0);
+      std::vector<std::thread> readers;
+      // exercise
+      for (int r = 0; r < 3; r++)
+         readers.emplace_back([&tree, &done, &numMissed]()
+            {
+               while (!done)
+                  for (int i = 0; i < 1000; i += 7)
+                     if (!tree.contains(i * 2))
+                        numMissed++;
+            });
+      for (int i = 0; i < 20000; i++)
+         tree.insert(2000 + i * 2 + 1);
+      for (int i = 0; i < 10; i++)
+         tree.rebalance();
+      done = true;
+      for (std::thread& reader : readers)
+         reader.join();
+      // verify
+      assertUnit(numMissed == 0);
+      assertUnit(tree.size() == 21000);
+   }  // teardown
+};
+
+#endif // DEBUG
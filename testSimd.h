@@ -0,0 +1,148 @@
+/***********************************************************************
+ * Header:
+ *    TEST SIMD
+ * Summary:
+ *    Unit tests for the node search kernels. They run against whichever
+ *    kernel the compiler picked, so build once with each of -mavx2,
+ *    -msse4.2, and CUSTOM_NO_SIMD to cover them all
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "simd.h"       // functions under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <algorithm>    // for std::lower_bound and std::upper_bound
+#include <limits>       // for std::numeric_limits
+#include <string>
+#include <vector>
+
+/***********************************************
+ * TEST SIMD
+ * Unit tests for lowerBound() and upperBound()
+ ***********************************************/
+class TestSimd : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      test_bounds_empty();
+      test_bounds_standard();
+      test_bounds_int();
+      test_bounds_unsigned();
+      test_bounds_longLong();
+      test_bounds_unsignedLongLong();
+      test_bounds_float();
+      test_bounds_double();
+      test_bounds_short();
+      test_bounds_string();
+
+      report("Simd");
+   }
+
+   // nothing to search
+   void test_bounds_empty()
+   {  // setup
+      int keys[1] = { 5 };
+      // exercise and verify
+      assertUnit(custom::lowerBound(keys, 0, 5) == 0);
+      assertUnit(custom::upperBound(keys, 0, 5) == 0);
+   }  // teardown
+
+   // hit, miss, and duplicates in a run longer than one vector
+   void test_bounds_standard()
+   {  // setup
+      int keys[] = { 10, 20, 20, 20, 30, 40, 50, 60, 70, 80, 90 };
+      // exercise and verify
+      assertUnit(custom::lowerBound(keys, 11, 20) == 1);
+      assertUnit(custom::upperBound(keys, 11, 20) == 4);
+      assertUnit(custom::lowerBound(keys, 11, 25) == 4);
+      assertUnit(custom::upperBound(keys, 11, 25) == 4);
+      assertUnit(custom::lowerBound(keys, 11, 5)  == 0);
+      assertUnit(custom::upperBound(keys, 11, 95) == 11);
+      assertUnit(custom::lowerBound(keys, 11, 90) == 10);
+   }  // teardown
+
+   // every length up to a full node, with the extremes of the type
+   void test_bounds_int()
+   {
+      assertUnit(agreesWithStd<int>({ std::numeric_limits<int>::min(), -7, -1, 0, 3, 1000,
+                                      std::numeric_limits<int>::max() }));
+   }
+
+   // the top bit must not make large keys sort as negative
+   void test_bounds_unsigned()
+   {
+      assertUnit(agreesWithStd<unsigned int>({ 0u, 1u, 7u, 0x7fffffffu, 0x80000000u,
+                                               0xfffffff0u, 0xffffffffu }));
+   }
+
+   void test_bounds_longLong()
+   {
+      assertUnit(agreesWithStd<long long>({ std::numeric_limits<long long>::min(), -5, 0, 9,
+                                            1LL << 40, std::numeric_limits<long long>::max() }));
+   }
+
+   void test_bounds_unsignedLongLong()
+   {
+      assertUnit(agreesWithStd<unsigned long long>({ 0ull, 3ull, 1ull << 40, 1ull << 63,
+                                                     ~0ull - 1, ~0ull }));
+   }
+
+   void test_bounds_float()
+   {
+      assertUnit(agreesWithStd<float>({ -1e30f, -2.5f, -0.0f, 0.5f, 1.0f, 3.25f, 1e30f }));
+   }
+
+   void test_bounds_double()
+   {
+      assertUnit(agreesWithStd<double>({ -1e300, -2.5, 0.0, 0.5, 1.0, 3.25, 1e300 }));
+   }
+
+   // no kernel for 16-bit keys: the portable loop
+   void test_bounds_short()
+   {
+      assertUnit(agreesWithStd<short>({ -32768, -3, 0, 4, 32767 }));
+   }
+
+   // not arithmetic: the scalar scan
+   void test_bounds_string()
+   {
+      assertUnit(agreesWithStd<std::string>({ "", "apple", "kiwi", "pear", "zebra" }));
+   }
+
+   /**************************************************************
+    * AGREES WITH STD
+    * Build sorted runs of every length from 0 to 70 out of the
+    * given values (with repeats), then probe with each value
+    *************************************************************/
+   template <typename T>
+   bool agreesWithStd(const std::vector<T>& values)
+   {
+      for (int num = 0; num <= 70; num++)
+      {
+         std::vector<T> keys;
+         for (int i = 0; i < num; i++)
+            keys.push_back(values[(i * 5 + num) % values.size()]);
+         std::sort(keys.begin(), keys.end());
+
+         for (const T& probe : values)
+         {
+            int lower = (int)(std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin());
+            int upper = (int)(std::upper_bound(keys.begin(), keys.end(), probe) - keys.begin());
+            if (custom::lowerBound(keys.data(), num, probe) != lower ||
+                custom::upperBound(keys.data(), num, probe) != upper)
+               return false;
+         }
+      }
+      return true;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,294 @@
+/***********************************************************************
+ * Header:
+ *    TEST VAN EMDE BOAS
+ * Summary:
+ *    Unit tests for the frozen van Emde Boas snapshot
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "veb.h"        // class under test
+#include "unitTest.h"   // unit test baseclass
+
+#include <set>          // for std::set to compare against
+#include <vector>
+
+/***********************************************
+ * TEST VAN EMDE BOAS
+ * Unit tests for the VanEmdeBoas class
+ ***********************************************/
+class TestVanEmdeBoas : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Construct
+      test_construct_empty();
+      test_construct_standard();
+      test_construct_tall();
+      test_construct_shortLastLevel();
+
+      // Access
+      test_find_standardHit();
+      test_find_standardMissing();
+      test_lowerBound_random();
+
+      // Iterator
+      test_iterator_increment_standard();
+      test_iterator_decrement_standard();
+      test_iterator_walk_random();
+
+      report("VanEmdeBoas");
+   }
+
+   /***************************************
+    * CONSTRUCT
+    *    VanEmdeBoas::VanEmdeBoas(const BST &)
+    ***************************************/
+
+   // an empty tree makes an empty snapshot
+   void test_construct_empty()
+   {  // setup
+      custom::BST<int> bst;
+      // exercise
+      custom::VanEmdeBoas<int> frozen(bst);
+      // verify
+      assertUnit(frozen.empty());
+      assertUnit(frozen.size() == 0);
+      assertUnit(frozen.keys.empty());
+      assertUnit(frozen.begin() == frozen.end());
+      assertUnit(frozen.find(5) == frozen.end());
+   }  // teardown
+
+   // the standard fixture: root, then the left bottom tree, then the right
+   void test_construct_standard()
+   {  // setup
+      //                 50
+      //          +-------+-------+
+      //         30              70
+      //     +----+----+     +----+----+
+      //    20        40    60        80
+      custom::BST<int> bst;
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         bst.insert(i);
+      // exercise
+      custom::VanEmdeBoas<int> frozen(bst);
+      // verify
+      //    [50] [30 20 40] [70 60 80]
+      assertUnit(frozen.size() == 7);
+      assertUnit(frozen.height == 3);
+      int expected[] = { 50, 30, 20, 40, 70, 60, 80 };
+      for (size_t i = 0; i < 7 && i < frozen.keys.size(); i++)
+         assertUnit(frozen.keys[i] == expected[i]);
+   }  // teardown
+
+   // a tree of height 4 splits into two levels of height 2
+   void test_construct_tall()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 1; i <= 15; i++)
+         bst.insert(i);
+      // exercise
+      custom::VanEmdeBoas<int> frozen(bst);
+      // verify
+      //                        8
+      //            +-----------+-----------+
+      //            4                       12
+      //      +-----+-----+           +-----+-----+
+      //      2           6          10          14
+      //   +--+--+     +--+--+     +--+--+     +--+--+
+      //   1     3     5     7     9    11    13    15
+      //    [8 4 12] [2 1 3] [6 5 7] [10 9 11] [14 13 15]
+      assertUnit(frozen.height == 4);
+      int expected[] = { 8, 4, 12, 2, 1, 3, 6, 5, 7, 10, 9, 11, 14, 13, 15 };
+      for (size_t i = 0; i < 15 && i < frozen.keys.size(); i++)
+         assertUnit(frozen.keys[i] == expected[i]);
+   }  // teardown
+
+   // a short last level follows the full levels in order, with no gaps
+   void test_construct_shortLastLevel()
+   {  // setup
+      custom::BST<int> bst;
+      for (int i = 1; i <= 10; i++)
+         bst.insert(i);
+      // exercise
+      custom::VanEmdeBoas<int> frozen(bst);
+      // verify
+      //                        7
+      //            +-----------+-----------+
+      //            4                       9
+      //      +-----+-----+           +-----+-----+
+      //      2           6           8          10
+      //   +--+--+     +--+
+      //   1     3     5
+      //    [7] [4 2 6] [9 8 10]   [1 3 5]
+      assertUnit(frozen.height == 4);
+      assertUnit(frozen.keys.size() == 10);
+      int expected[] = { 7, 4, 2, 6, 9, 8, 10, 1, 3, 5 };
+      for (size_t i = 0; i < 10 && i < frozen.keys.size(); i++)
+         assertUnit(frozen.keys[i] == expected[i]);
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    *    VanEmdeBoas::find()
+    *    VanEmdeBoas::lower_bound()
+    ***************************************/
+
+   // find something that is there
+   void test_find_standardHit()
+   {  // setup
+      custom::VanEmdeBoas<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.find(40);
+      // verify
+      assertUnit(it != frozen.end());
+      if (it != frozen.end())
+         assertUnit(*it == 40);
+   }  // teardown
+
+   // find something that is not there
+   void test_find_standardMissing()
+   {  // setup
+      custom::VanEmdeBoas<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.find(45);
+      // verify
+      assertUnit(it == frozen.end());
+   }  // teardown
+
+   // lower bound agrees with std::set for sizes that do not fill the tree
+   void test_lowerBound_random()
+   {  // setup
+      unsigned int seed = 54321;
+      for (int num : { 1, 2, 3, 5, 8, 13, 31, 32, 33, 100, 255, 256, 1000 })
+      {
+         custom::BST<int> bst;
+         std::set<int> expected;
+         for (int i = 0; i < num; i++)
+         {
+            seed = seed * 1103515245 + 12345;
+            int value = (int)((seed >> 8) % 5000) * 2;
+            if (bst.insert(value, true /*keepUnique*/).second)
+               expected.insert(value);
+         }
+         // exercise
+         custom::VanEmdeBoas<int> frozen(bst);
+         // verify
+         assertUnit(frozen.size() == expected.size());
+         for (int probe = -1; probe <= 10001; probe += 7)
+         {
+            auto itExpected = expected.lower_bound(probe);
+            auto it = frozen.lower_bound(probe);
+            if (itExpected == expected.end())
+               assertUnit(it == frozen.end());
+            else
+               assertUnit(it != frozen.end() && *it == *itExpected);
+         }
+         auto it = frozen.begin();
+         for (int value : expected)
+            assertUnit(it != frozen.end() && *it++ == value);
+         assertUnit(it == frozen.end());
+      }
+   }  // teardown
+
+   /***************************************
+    * ITERATOR
+    *    VanEmdeBoas::iterator::operator++()
+    *    VanEmdeBoas::iterator::operator--()
+    ***************************************/
+
+   // walk forward in order
+   void test_iterator_increment_standard()
+   {  // setup
+      custom::VanEmdeBoas<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.begin();
+      // verify
+      for (int i : { 20, 30, 40, 50, 60, 70, 80 })
+      {
+         assertUnit(it != frozen.end());
+         if (it != frozen.end())
+            assertUnit(*it++ == i);
+      }
+      assertUnit(it == frozen.end());
+   }  // teardown
+
+   // walk backward in order starting from the end
+   void test_iterator_decrement_standard()
+   {  // setup
+      custom::VanEmdeBoas<int> frozen = standardFrozen();
+      // exercise
+      auto it = frozen.end();
+      // verify
+      for (int i : { 80, 70, 60, 50, 40, 30, 20 })
+      {
+         --it;
+         assertUnit(it != frozen.end());
+         if (it != frozen.end())
+            assertUnit(*it == i);
+      }
+   }  // teardown
+
+   // walk every size both ways, and from the middle both ways
+   void test_iterator_walk_random()
+   {  // setup
+      for (int num : { 1, 2, 3, 4, 6, 10, 31, 32, 33, 100, 1000 })
+      {
+         custom::BST<int> bst;
+         for (int i = 0; i < num; i++)
+            bst.insert((i * 37) % num);
+         custom::VanEmdeBoas<int> frozen(bst);
+         // exercise
+         std::vector<int> forward;
+         for (auto it = frozen.begin(); it != frozen.end(); ++it)
+            forward.push_back(*it);
+         std::vector<int> backward;
+         auto it = frozen.end();
+         for (int i = 0; i < num; i++)
+            backward.push_back(*--it);
+         auto itMiddle = frozen.find(num / 2);
+         auto itNext = itMiddle;
+         auto itPrev = itMiddle;
+         ++itNext;
+         --itPrev;
+         // verify
+         bool inOrder = forward.size() == size_t(num) && backward.size() == size_t(num);
+         for (int i = 0; inOrder && i < num; i++)
+            inOrder = forward[i] == i && backward[i] == num - 1 - i;
+         assertUnit(inOrder);
+         assertUnit(it == frozen.begin());
+         assertUnit(itMiddle != frozen.end() && *itMiddle == num / 2);
+         if (num / 2 + 1 < num)
+            assertUnit(itNext != frozen.end() && *itNext == num / 2 + 1);
+         else
+            assertUnit(itNext == frozen.end());
+         if (num / 2 > 0)
+            assertUnit(itPrev != frozen.end() && *itPrev == num / 2 - 1);
+      }
+   }  // teardown
+
+   /**************************************************************
+    * STANDARD FROZEN
+    *                 50
+    *          +-------+-------+
+    *         30              70
+    *     +----+----+     +----+----+
+    *    20        40    60        80
+    *************************************************************/
+   custom::VanEmdeBoas<int> standardFrozen()
+   {
+      custom::BST<int> bst;
+      for (int i : { 50, 30, 70, 20, 40, 60, 80 })
+         bst.insert(i);
+      return custom::VanEmdeBoas<int>(bst);
+   }
+};
+
+#endif // DEBUG
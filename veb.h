@@ -0,0 +1,370 @@
+/***********************************************************************
+ * Header:
+ *    VEB
+ * Summary:
+ *    A frozen, read-only snapshot of a BST in van Emde Boas order. The
+ *    implicit tree of height h is cut in the middle into a top tree of
+ *    height h/2 and the bottom trees hanging off of it; the top tree is
+ *    stored first, then each bottom tree, each laid out the same way
+ *    recursively. Whatever the block size B of a cache level (L1, L2,
+ *    TLB, disk), a root-to-leaf walk touches O(log_B n) blocks.
+ *
+ *    The shape is the same complete tree used by the Eytzinger layout,
+ *    so position k in breadth-first order has children 2k and 2k+1.
+ *    When the last level is short, only the full levels above it are
+ *    laid out recursively and the last level follows them in order, so
+ *    the array holds exactly n keys. A search then reads at most one
+ *    block more than it would in the full tree.
+ *
+ *    This will contain the class definition of:
+ *        VanEmdeBoas           : A frozen vEB snapshot of a BST
+ *        VanEmdeBoas::iterator : An in-order iterator through the snapshot
+ * Author
+ *    Nathan Bird, Brock Hoskins
+ ************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <vector>     // for std::vector
+#include "bst.h"
+#include "eytzinger.h" // for the breadth-first navigation
+#include "cache.h"     // for countTrailingZeros
+
+class TestVanEmdeBoas; // forward declaration for unit tests
+
+namespace custom
+{
+
+   /*****************************************************************
+    * VAN EMDE BOAS
+    * An immutable snapshot of a BST
+    *****************************************************************/
+   template <typename T>
+   class VanEmdeBoas
+   {
+      friend class ::TestVanEmdeBoas; // give unit tests access to private members
+   public:
+      //
+      // Construct
+      //
+
+      VanEmdeBoas() : num(0), height(0) {}
+      VanEmdeBoas(const BST<T>& bst) : VanEmdeBoas(bst.begin(), bst.size()) {}
+      template <typename InputIt>
+      VanEmdeBoas(InputIt first, size_t num);
+
+      //
+      // Iterator
+      //
+
+      class iterator;
+      iterator begin() const noexcept { return iterator(this, eytzinger::first(num)); }
+      iterator end()   const noexcept { return iterator(this, 0); }
+
+      //
+      // Access
+      //
+
+      iterator find(const T& t) const;
+      iterator lower_bound(const T& t) const;
+      iterator upper_bound(const T& t) const;
+
+      //
+      // Status
+      //
+
+      bool   empty() const noexcept { return num == 0; }
+      size_t size()  const noexcept { return num; }
+
+   private:
+
+      // walk down one level: the slot of the child at depth d whose
+      // breadth-first position is k, given the slots of its ancestors
+      size_t child(const size_t* slots, size_t depth, size_t k) const
+      {
+         const Level& level = levels[depth];
+         return slots[level.topDepth] + level.topSize + (k & level.topSize) * level.bottomSize;
+      }
+
+      size_t pathTo(size_t k, size_t* slots) const;
+      void   computeLevels(size_t depth, size_t h);
+      template <typename InputIt>
+      void   fill(InputIt& it, size_t* slots, size_t k, size_t depth);
+      template <typename GoRight>
+      size_t descend(GoRight goRight) const;
+
+      // For every depth d > 0, the recursive split that makes a node at
+      // depth d the root of a bottom tree
+      struct Level
+      {
+         size_t topSize;        // nodes in the top tree of that split
+         size_t bottomSize;     // nodes in each bottom tree of that split
+         size_t topDepth;       // depth of the root of that top tree
+      };
+
+      std::vector<T>     keys;  // the keys in vEB order
+      std::vector<Level> levels;// one entry per depth
+      size_t num;               // number of keys
+      size_t height;            // levels in the tree
+   };
+
+   /**********************************************************
+    * VAN EMDE BOAS ITERATOR
+    * Forward and reverse iterator through the snapshot in order.
+    * The iterator remembers the breadth-first position and the slots
+    * of it and its ancestors, so a dereference is one array read and
+    * a step moves up or down the path, amortized O(1)
+    *********************************************************/
+   template <typename T>
+   class VanEmdeBoas<T>::iterator
+   {
+      friend class ::TestVanEmdeBoas; // give unit tests access to the privates
+   public:
+      // constructors and assignment
+      iterator() : pTree(nullptr), k(0), depth(0)
+      {}
+      iterator(const VanEmdeBoas* pTree, size_t k) : pTree(pTree), k(k), depth(0)
+      {
+         if (k)
+            depth = pTree->pathTo(k, slots);
+      }
+
+      // compare
+      bool operator ==(const iterator& rhs) const { return k == rhs.k; }
+      bool operator !=(const iterator& rhs) const { return k != rhs.k; }
+
+      // de-reference. Cannot change because the snapshot is frozen
+      const T& operator *() const
+      {
+         assert(k != 0);
+         return pTree->keys[slots[depth]];
+      }
+
+      // increment and decrement: the same moves as eytzinger::next()
+      // and eytzinger::prev(), keeping the path as they go
+      iterator& operator ++()
+      {
+         if (k == 0)
+            return *this;
+         if (2 * k + 1 <= pTree->num)
+         {
+            down(2 * k + 1);
+            while (2 * k <= pTree->num)
+               down(2 * k);
+         }
+         else
+            up(countTrailingZeros(~k) + 1);
+         return *this;
+      }
+      iterator  operator ++(int)
+      {
+         iterator temp(*this);
+         ++(*this);
+         return temp;
+      }
+      iterator& operator --()
+      {
+         if (k == 0)
+         {
+            k = eytzinger::last(pTree->num);
+            if (k)
+               depth = pTree->pathTo(k, slots);
+         }
+         else if (2 * k <= pTree->num)
+         {
+            down(2 * k);
+            while (2 * k + 1 <= pTree->num)
+               down(2 * k + 1);
+         }
+         else
+            up(countTrailingZeros(k) + 1);
+         return *this;
+      }
+      iterator  operator --(int)
+      {
+         iterator temp(*this);
+         --(*this);
+         return temp;
+      }
+
+   private:
+      // to the child at breadth-first position kChild
+      void down(size_t kChild)
+      {
+         k = kChild;
+         depth++;
+         slots[depth] = pTree->child(slots, depth, k);
+      }
+
+      // up the given number of levels, or off the root to the end
+      void up(size_t numLevels)
+      {
+         k >>= numLevels;
+         depth = k ? depth - numLevels : 0;
+      }
+
+      const VanEmdeBoas* pTree; // the snapshot we belong to
+      size_t k;                 // 1-based breadth-first position; 0 is the end
+      size_t depth;             // depth of k; the root is 0
+      size_t slots[sizeof(size_t) * 8]; // slots of k and its ancestors, by depth
+   };
+
+   /*********************************************
+    * VAN EMDE BOAS :: CONSTRUCTOR from a sorted sequence
+    * Read num sorted elements starting at first. The in-order
+    * walk of the implicit tree tracks the slot of every node on
+    * the current path, so each key goes straight to its slot
+    * and the array holds exactly num of them
+    ********************************************/
+   template <typename T>
+   template <typename InputIt>
+   VanEmdeBoas<T>::VanEmdeBoas(InputIt first, size_t num) : num(num), height(0)
+   {
+      while (num >> height)
+         height++;
+      if (height == 0)
+         return;
+
+      // one spare, zeroed level: the descent computes a harmless slot below
+      // the leaves before it notices it has fallen off the tree
+      levels.resize(height + 1, Level{ 0, 0, 0 });
+      if (num == ((size_t)1 << height) - 1)
+         computeLevels(0, height);
+      else
+      {
+         // a short last level: the full levels above it form the top
+         // tree, and each node of the last level is a bottom tree of one
+         Level& level = levels[height - 1];
+         level.topSize    = ((size_t)1 << (height - 1)) - 1;
+         level.bottomSize = 1;
+         level.topDepth   = 0;
+         computeLevels(0, height - 1);
+      }
+      keys.resize(num);
+
+      std::vector<size_t> slots(height);
+      slots[0] = 0;
+      fill(first, slots.data(), 1, 0);
+   }
+
+   /*********************************************
+    * VAN EMDE BOAS :: COMPUTE LEVELS
+    * Split a tree of height h whose root is at the given depth
+    * into a top of height h/2 and bottoms of the rest, then
+    * split those the same way
+    ********************************************/
+   template <typename T>
+   void VanEmdeBoas<T>::computeLevels(size_t depth, size_t h)
+   {
+      if (h <= 1)
+         return;
+
+      size_t hTop    = h / 2;
+      size_t hBottom = h - hTop;
+      Level& level = levels[depth + hTop];
+      level.topSize    = ((size_t)1 << hTop) - 1;
+      level.bottomSize = ((size_t)1 << hBottom) - 1;
+      level.topDepth   = depth;
+
+      computeLevels(depth, hTop);
+      computeLevels(depth + hTop, hBottom);
+   }
+
+   /*********************************************
+    * VAN EMDE BOAS :: FILL
+    * In-order walk of the implicit tree placing one key per node
+    ********************************************/
+   template <typename T>
+   template <typename InputIt>
+   void VanEmdeBoas<T>::fill(InputIt& it, size_t* slots, size_t k, size_t depth)
+   {
+      if (k > num)
+         return;
+      if (depth)
+         slots[depth] = child(slots, depth, k);
+
+      fill(it, slots, 2 * k, depth + 1);
+      keys[slots[depth]] = *it;
+      ++it;
+      fill(it, slots, 2 * k + 1, depth + 1);
+   }
+
+   /*********************************************
+    * VAN EMDE BOAS :: PATH TO
+    * Fill slots with the array slots of breadth-first position
+    * k and its ancestors, following the bits of k down from the
+    * root. Return the depth of k
+    ********************************************/
+   template <typename T>
+   size_t VanEmdeBoas<T>::pathTo(size_t k, size_t* slots) const
+   {
+      size_t depth = 0;
+      while (k >> (depth + 1))
+         depth++;
+
+      slots[0] = 0;
+      for (size_t d = 1; d <= depth; d++)
+         slots[d] = child(slots, d, k >> (depth - d));
+      return depth;
+   }
+
+   /*********************************************
+    * VAN EMDE BOAS :: DESCEND
+    * Walk from the root to a leaf: right when goRight() is true,
+    * left otherwise. Return the breadth-first position of the
+    * last node where we went left, or 0
+    ********************************************/
+   template <typename T>
+   template <typename GoRight>
+   size_t VanEmdeBoas<T>::descend(GoRight goRight) const
+   {
+      const T*     pKeys   = keys.data();
+      const Level* pLevels = levels.data();
+      size_t slots[sizeof(size_t) * 8];
+      size_t k = 1;
+      size_t depth = 0;
+      slots[0] = 0;
+      while (k <= num)
+      {
+         k = 2 * k + (goRight(pKeys[slots[depth]]) ? 1 : 0);
+         const Level& level = pLevels[++depth];
+         slots[depth] = slots[level.topDepth] + level.topSize + (k & level.topSize) * level.bottomSize;
+      }
+      return k >> (countTrailingZeros(~k) + 1);
+   }
+
+   /****************************************************
+    * VAN EMDE BOAS :: LOWER BOUND
+    * The first element that is not less than t
+    ****************************************************/
+   template <typename T>
+   typename VanEmdeBoas<T>::iterator VanEmdeBoas<T>::lower_bound(const T& t) const
+   {
+      return iterator(this, descend([&t](const T& key) { return key < t; }));
+   }
+
+   /****************************************************
+    * VAN EMDE BOAS :: UPPER BOUND
+    * The first element that is greater than t
+    ****************************************************/
+   template <typename T>
+   typename VanEmdeBoas<T>::iterator VanEmdeBoas<T>::upper_bound(const T& t) const
+   {
+      return iterator(this, descend([&t](const T& key) { return !(t < key); }));
+   }
+
+   /****************************************************
+    * VAN EMDE BOAS :: FIND
+    * Return the element equivalent to t, or end()
+    ****************************************************/
+   template <typename T>
+   typename VanEmdeBoas<T>::iterator VanEmdeBoas<T>::find(const T& t) const
+   {
+      iterator it = lower_bound(t);
+      if (it != end() && !(t < *it))
+         return it;
+      return end();
+   }
+
+} // namespace custom